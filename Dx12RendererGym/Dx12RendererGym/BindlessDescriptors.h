@@ -0,0 +1,202 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Bindless descriptors. Every shader visible CBV/SRV/UAV descriptor lives in one large heap and shaders
+// reach resources by their index in it, the root signature binds the whole heap once. The heap is split
+// into a persistent part, descriptors that live as long as their resource, and a ring of per frame slices
+// for descriptors that are written every frame:
+//
+//   [0, persistentCount)                                      persistent, lock free free list
+//   [persistentCount + frame * dynamicPerFrame, ... + dynamicPerFrame)   dynamic, frame's slice
+//
+// A freed persistent descriptor may still be read by frames in flight, it only returns to the free list
+// once the GPU finished the frame it was freed in. Only indices are managed here, the caller owns the heap.
+
+const uint32_t InvalidDescriptorIndex = 0xffffffff;
+
+// Treiber stack of free indices over a fixed range. The head carries a tag that changes with every update,
+// a thread that read a stale next link loses its compare exchange instead of corrupting the list (ABA).
+class DescriptorIndexAllocator
+{
+public:
+    void Init(uint32_t capacity)
+    {
+        next.reset(new std::atomic<uint32_t>[capacity]);
+        for (uint32_t i = 0; i < capacity; ++i)
+        {
+            next[i].store(i + 1 < capacity ? i + 1 : InvalidDescriptorIndex, std::memory_order_relaxed);
+        }
+        size = capacity;
+        allocated.store(0, std::memory_order_relaxed);
+        head.store(Pack(capacity > 0 ? 0 : InvalidDescriptorIndex, 0), std::memory_order_release);
+    }
+
+    // InvalidDescriptorIndex when every index is in use
+    uint32_t Allocate()
+    {
+        uint64_t current = head.load(std::memory_order_acquire);
+        for (;;)
+        {
+            uint32_t index = uint32_t(current);
+            if (index == InvalidDescriptorIndex)
+            {
+                return InvalidDescriptorIndex;
+            }
+            uint64_t replacement = Pack(next[index].load(std::memory_order_relaxed), Tag(current) + 1);
+            if (head.compare_exchange_weak(current, replacement, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                allocated.fetch_add(1, std::memory_order_relaxed);
+                return index;
+            }
+        }
+    }
+
+    void Free(uint32_t index)
+    {
+        uint64_t current = head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            next[index].store(uint32_t(current), std::memory_order_relaxed);
+            uint64_t replacement = Pack(index, Tag(current) + 1);
+            if (head.compare_exchange_weak(current, replacement, std::memory_order_release, std::memory_order_relaxed))
+            {
+                allocated.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    uint32_t Capacity() const { return size; }
+    uint32_t AllocatedCount() const { return allocated.load(std::memory_order_relaxed); }
+
+private:
+    static uint64_t Pack(uint32_t index, uint32_t tag) { return (uint64_t(tag) << 32) | index; }
+    static uint32_t Tag(uint64_t head) { return uint32_t(head >> 32); }
+
+    std::unique_ptr<std::atomic<uint32_t>[]> next;
+    std::atomic<uint64_t> head{ Pack(InvalidDescriptorIndex, 0) };
+    std::atomic<uint32_t> allocated{ 0 };
+    uint32_t size = 0;
+};
+
+struct BindlessStatistics
+{
+    uint32_t persistentAllocated;
+    uint32_t persistentCapacity;
+    uint32_t pendingFrees;          // freed, waiting for the GPU
+    uint32_t dynamicPeak;           // most dynamic descriptors a frame used
+    uint32_t dynamicPerFrame;
+    uint32_t dynamicOverflows;      // AllocateDynamic calls that did not fit
+};
+
+class BindlessDescriptorHeap
+{
+public:
+    void Init(uint32_t persistentCount, uint32_t framesInFlight, uint32_t dynamicDescriptorsPerFrame)
+    {
+        persistent.Init(persistentCount);
+        frameCount = framesInFlight;
+        dynamicPerFrame = dynamicDescriptorsPerFrame;
+        dynamicUsed.reset(new std::atomic<uint32_t>[framesInFlight]);
+        for (uint32_t i = 0; i < framesInFlight; ++i)
+        {
+            dynamicUsed[i].store(0, std::memory_order_relaxed);
+        }
+        frame = 0;
+        dynamicPeak = 0;
+        dynamicOverflows.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(retireMutex);
+        retired.clear();
+    }
+
+    // size of the heap the indices go into
+    uint32_t Capacity() const { return persistent.Capacity() + frameCount * dynamicPerFrame; }
+
+    // any thread, InvalidDescriptorIndex when the persistent part is full
+    uint32_t AllocatePersistent() { return persistent.Allocate(); }
+
+    // any thread, index can be allocated again once the frame with value frameValue completed
+    void FreePersistent(uint32_t index, uint64_t frameValue)
+    {
+        std::lock_guard<std::mutex> lock(retireMutex);
+        RetiredIndex entry = { index, frameValue };
+        retired.push_back(entry);
+    }
+
+    // Start frame slot, every frame up to completedFrameValue finished on the GPU: the slot's dynamic
+    // descriptors are free again, and so are the persistent ones freed in those frames.
+    void BeginFrame(uint32_t slot, uint64_t completedFrameValue)
+    {
+        frame = slot;
+        uint32_t used = dynamicUsed[slot].exchange(0, std::memory_order_relaxed);
+        dynamicPeak = std::max(dynamicPeak, std::min(used, dynamicPerFrame));
+
+        std::lock_guard<std::mutex> lock(retireMutex);
+        size_t kept = 0;
+        for (size_t i = 0; i < retired.size(); ++i)
+        {
+            if (retired[i].frameValue <= completedFrameValue)
+            {
+                persistent.Free(retired[i].index);
+            }
+            else
+            {
+                retired[kept++] = retired[i];
+            }
+        }
+        retired.resize(kept);
+    }
+
+    // any thread, count contiguous descriptors in the current frame's slice, valid until the slot comes
+    // around again, InvalidDescriptorIndex when the slice is full
+    uint32_t AllocateDynamic(uint32_t count)
+    {
+        uint32_t first = dynamicUsed[frame].fetch_add(count, std::memory_order_relaxed);
+        if (first + count > dynamicPerFrame || first + count < first)
+        {
+            dynamicOverflows.fetch_add(1, std::memory_order_relaxed);
+            return InvalidDescriptorIndex;
+        }
+        return persistent.Capacity() + frame * dynamicPerFrame + first;
+    }
+
+    BindlessStatistics Statistics() const
+    {
+        BindlessStatistics statistics = {};
+        statistics.persistentAllocated = persistent.AllocatedCount();
+        statistics.persistentCapacity = persistent.Capacity();
+        {
+            std::lock_guard<std::mutex> lock(retireMutex);
+            statistics.pendingFrees = uint32_t(retired.size());
+        }
+        statistics.dynamicPeak = dynamicPeak;
+        statistics.dynamicPerFrame = dynamicPerFrame;
+        statistics.dynamicOverflows = dynamicOverflows.load(std::memory_order_relaxed);
+        return statistics;
+    }
+
+private:
+    struct RetiredIndex
+    {
+        uint32_t index;
+        uint64_t frameValue;
+    };
+
+    DescriptorIndexAllocator persistent;
+    uint32_t frameCount = 0;
+    uint32_t dynamicPerFrame = 0;
+    // the slot being recorded, changes in BeginFrame only
+    uint32_t frame = 0;
+    std::unique_ptr<std::atomic<uint32_t>[]> dynamicUsed;
+    uint32_t dynamicPeak = 0;
+    std::atomic<uint32_t> dynamicOverflows{ 0 };
+
+    mutable std::mutex retireMutex;
+    std::vector<RetiredIndex> retired;
+};
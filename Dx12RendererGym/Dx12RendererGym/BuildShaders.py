@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+"""Compile the shader permutations listed in ShaderList.txt with DXC into ShaderCache/.
+
+Every permutation ends up in ShaderCache/<key>.cso where key is a 64 bit FNV-1a hash of the permutation
+name, the compiler arguments and the text of the source and every file it includes, computed exactly like
+ComputeShaderKey in ShaderCache.h. Blobs whose key already exists are not compiled again.
+ShaderCache/manifest.txt maps the permutation names to keys for the runtime.
+
+Runs as the pre-build step of the project and on Linux alike, DXC is taken from --dxc, the DXC environment
+variable or PATH. Without DXC it only warns, debug builds compile the shaders at runtime then.
+"""
+import argparse
+import collections
+import concurrent.futures
+import itertools
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def fnv1a64(data, h=14695981039346656037):
+    for b in data:
+        h = ((h ^ b) * 1099511628211) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def compiler_arguments():
+    with open(os.path.join(HERE, "ShaderCache.h"), encoding="utf-8") as f:
+        match = re.search(r'ShaderCompilerArguments = "([^"]*)"', f.read())
+    if not match:
+        sys.exit("BuildShaders: ShaderCompilerArguments not found in ShaderCache.h")
+    return match.group(1)
+
+
+def expand_defines(defines):
+    """NAME=VALUE, NAME (=1) and NAME={A,B,...}, a list of define sets, one per combination of the value sets"""
+    choices = []
+    for define in defines:
+        name, value = define.split("=", 1) if "=" in define else (define, "1")
+        if value.startswith("{") and value.endswith("}"):
+            choices.append([(name, v.strip()) for v in value[1:-1].split(",")])
+        else:
+            choices.append([(name, value)])
+    return [sorted(combination) for combination in itertools.product(*choices)]
+
+
+def read_list(path):
+    permutations = []
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            parts = line.split("#", 1)[0].split()
+            if not parts:
+                continue
+            if len(parts) < 3:
+                sys.exit("BuildShaders: expected 'source entry profile [NAME=VALUE ...]': " + line.strip())
+            for defines in expand_defines(parts[3:]):
+                permutations.append((parts[0], parts[1], parts[2], defines))
+    return permutations
+
+
+def permutation_name(source, entry, profile, defines):
+    return "%s|%s|%s|%s" % (source, entry, profile, ";".join("%s=%s" % d for d in defines))
+
+
+INCLUDE = re.compile(r'^[ \t]*#include[^"\n]*"([^"]+)"', re.M)
+
+
+def collect_files(path, files):
+    """source and every file it includes, depth first in include order, each file once"""
+    if path in files:
+        return
+    with open(path, "rb") as f:
+        text = f.read()
+    files.append(path)
+    for include in INCLUDE.findall(text.decode("utf-8", "replace")):
+        collect_files(os.path.join(os.path.dirname(path), include), files)
+
+
+def shader_key(directory, permutation, arguments):
+    name = permutation_name(*permutation)
+    h = fnv1a64((name + "\n" + arguments + "\n").encode())
+    files = []
+    collect_files(os.path.join(directory, permutation[0]), files)
+    prefix = os.path.join(directory, "")
+    for path in files:
+        # the path as it was followed, not normalized, ComputeShaderKey hashes "lighting/../Common.hlsli" as is
+        relative = path[len(prefix):].replace(os.sep, "/")
+        h = fnv1a64((relative + "\n").encode(), h)
+        with open(path, "rb") as f:
+            h = fnv1a64(f.read(), h)
+    return name, h
+
+
+def compiler_version(dxc):
+    result = subprocess.run([dxc, "--version"], capture_output=True, text=True)
+    return (result.stdout or result.stderr).strip().splitlines()[0] if result.returncode == 0 else "unknown"
+
+
+def compile_permutation(dxc, directory, permutation, arguments, output):
+    source, entry, profile, defines = permutation
+    command = [dxc, "-nologo", "-T", profile, "-E", entry] + arguments.split()
+    for name, value in defines:
+        command += ["-D", "%s=%s" % (name, value)]
+    # write next to the target and rename, an interrupted build never leaves a truncated blob behind
+    temporary = output + ".tmp"
+    command += ["-Fo", temporary, os.path.join(directory, source)]
+    start = time.perf_counter()
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        return False, result.stderr or result.stdout, 0.0
+    os.replace(temporary, output)
+    return True, "", time.perf_counter() - start
+
+
+def print_counts(permutations, times=None):
+    """permutations per source entry and profile, and the compile times of the ones compiled this run"""
+    counts = collections.Counter(p[:3] for p in permutations)
+    for shader, count in sorted(counts.items()):
+        line = "BuildShaders: %s %s %s: %d permutations" % (shader + (count,))
+        compiled = times.get(shader) if times else None
+        if compiled:
+            line += ", %d compiled, %.1f ms average, %.1f ms max" % (
+                len(compiled), 1000.0 * sum(compiled) / len(compiled), 1000.0 * max(compiled))
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--list", default=os.path.join(HERE, "ShaderList.txt"))
+    parser.add_argument("--out", default=os.path.join(HERE, "ShaderCache"))
+    parser.add_argument("--dxc", default=os.environ.get("DXC") or shutil.which("dxc"))
+    parser.add_argument("--jobs", type=int, default=os.cpu_count() or 1)
+    parser.add_argument("--keys", action="store_true", help="print the keys, compile nothing")
+    parser.add_argument("--prune", action="store_true", help="delete blobs no permutation uses")
+    parser.add_argument("--strict", action="store_true", help="fail when DXC is missing")
+    args = parser.parse_args()
+
+    directory = os.path.dirname(os.path.abspath(args.list))
+    arguments = compiler_arguments()
+    permutations = read_list(args.list)
+    keyed = [(p,) + shader_key(directory, p, arguments) for p in permutations]
+
+    if args.keys:
+        for _, name, key in keyed:
+            print("%016x %s" % (key, name))
+        print_counts(permutations)
+        return 0
+
+    if not args.dxc:
+        print("BuildShaders: warning: dxc not found, shaders are compiled at runtime in debug builds only")
+        return 1 if args.strict else 0
+
+    os.makedirs(args.out, exist_ok=True)
+    version = compiler_version(args.dxc)
+    manifest_path = os.path.join(args.out, "manifest.txt")
+    previous_version = None
+    if os.path.exists(manifest_path):
+        with open(manifest_path, encoding="utf-8") as f:
+            first = f.readline()
+            if first.startswith("# compiler "):
+                previous_version = first[len("# compiler "):].strip()
+    # another compiler may produce other code for the same key
+    rebuild = previous_version != version
+
+    start = time.perf_counter()
+    pending = [(p, key) for p, _, key in keyed
+               if rebuild or not os.path.exists(os.path.join(args.out, "%016x.cso" % key))]
+    failed = 0
+    compile_seconds = 0.0
+    times = collections.defaultdict(list)
+    with concurrent.futures.ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+        futures = {pool.submit(compile_permutation, args.dxc, directory, p, arguments,
+                               os.path.join(args.out, "%016x.cso" % key)): p for p, key in pending}
+        for future in concurrent.futures.as_completed(futures):
+            ok, errors, seconds = future.result()
+            compile_seconds += seconds
+            if ok:
+                times[futures[future][:3]].append(seconds)
+            else:
+                failed += 1
+                print("BuildShaders: error: %s\n%s" % (permutation_name(*futures[future]), errors), file=sys.stderr)
+
+    with open(manifest_path + ".tmp", "w", encoding="utf-8") as f:
+        f.write("# compiler %s\n" % version)
+        for _, name, key in keyed:
+            f.write("%s %016x\n" % (name, key))
+    os.replace(manifest_path + ".tmp", manifest_path)
+
+    if args.prune:
+        used = {"%016x.cso" % key for _, _, key in keyed}
+        for entry in os.listdir(args.out):
+            if entry.endswith(".cso") and entry not in used:
+                os.remove(os.path.join(args.out, entry))
+
+    print_counts(permutations, times)
+    print("BuildShaders: %d permutations, %d compiled (%.2f s compiler time), %d cached, %d failed in %.2f s"
+          % (len(keyed), len(pending) - failed, compile_seconds, len(keyed) - len(pending), failed,
+             time.perf_counter() - start))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,197 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Free fly and orbit camera driven by the fixed simulation step (GameTime.h). Both modes share one state: a
+// pivot, yaw and pitch of the view direction and a distance. Free fly pivots around the eye and the target
+// is distance ahead of it, orbit pivots around the target and the eye is distance behind it. Step keeps the
+// state before and after every step and Interpolate blends the two by the frame's alpha, through the
+// angles, so orbiting follows the circle instead of cutting across it. Interpolate only reports a new pose
+// while the camera moves or after it was set, the caller rebuilds its view matrix just for those frames.
+// Left handed, +y up, yaw 0 looks along +z.
+
+enum class CameraMode
+{
+    FreeFly,
+    Orbit,
+};
+
+// input gathered since the last step
+struct CameraInput
+{
+    float move[3];   // right, up, forward from held keys, -1 to 1. Orbit: yaw, pitch and dolly
+    float lookYaw;   // radians of mouse look, used up by the next step
+    float lookPitch;
+    float zoom;      // mouse wheel notches, used up by the next step
+    bool fast;
+};
+
+struct CameraPose
+{
+    float eye[3];
+    float target[3];
+};
+
+class CameraController
+{
+public:
+    float moveSpeed = 10.0f;       // free fly units per second
+    float fastMultiplier = 4.0f;
+    float orbitSpeed = 1.5f;       // radians per second from keys
+    float dollySpeed = 1.0f;       // orbit distance doublings per second from keys
+    float zoomFactor = 0.9f;       // orbit distance scale per wheel notch
+    float minDistance = 0.1f;
+
+    void SetLookAt(const float* eye, const float* target)
+    {
+        float direction[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+        float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        current.distance = std::max(length, minDistance);
+        current.yaw = length > 0.0f ? std::atan2(direction[0], direction[2]) : 0.0f;
+        current.pitch = length > 0.0f ? ClampPitch(std::asin(std::max(-1.0f, std::min(1.0f, direction[1] / length)))) : 0.0f;
+        memcpy(current.pivot, mode == CameraMode::Orbit ? target : eye, sizeof(current.pivot));
+        Snap();
+    }
+
+    // the view stays where it is, only the pivot moves between the eye and the target
+    void SetMode(CameraMode newMode)
+    {
+        if (newMode == mode)
+        {
+            return;
+        }
+        CameraPose pose = Pose(current);
+        mode = newMode;
+        memcpy(current.pivot, mode == CameraMode::Orbit ? pose.target : pose.eye, sizeof(current.pivot));
+        Snap();
+    }
+
+    CameraMode Mode() const { return mode; }
+
+    // one fixed step of seconds, the mouse look and zoom of input are used up
+    void Step(CameraInput& input, float seconds)
+    {
+        previous = current;
+
+        current.yaw += input.lookYaw;
+        current.pitch = ClampPitch(current.pitch + input.lookPitch);
+        if (input.zoom != 0.0f)
+        {
+            current.distance = std::max(current.distance * std::pow(zoomFactor, input.zoom), minDistance);
+        }
+        input.lookYaw = 0.0f;
+        input.lookPitch = 0.0f;
+        input.zoom = 0.0f;
+
+        float speedScale = input.fast ? fastMultiplier : 1.0f;
+        if (mode == CameraMode::FreeFly)
+        {
+            float forward[3], right[3];
+            Forward(current.yaw, current.pitch, forward);
+            // strafing stays level whatever the pitch
+            right[0] = std::cos(current.yaw);
+            right[1] = 0.0f;
+            right[2] = -std::sin(current.yaw);
+            float distance = moveSpeed * speedScale * seconds;
+            for (int k = 0; k < 3; ++k)
+            {
+                current.pivot[k] += (right[k] * input.move[0] + forward[k] * input.move[2]) * distance;
+            }
+            current.pivot[1] += input.move[1] * distance;
+        }
+        else
+        {
+            float angle = orbitSpeed * speedScale * seconds;
+            current.yaw -= input.move[0] * angle;
+            current.pitch = ClampPitch(current.pitch - input.move[1] * angle);
+            current.distance = std::max(current.distance * std::pow(2.0f, -input.move[2] * dollySpeed * speedScale * seconds), minDistance);
+        }
+
+        moving = memcmp(&previous, &current, sizeof(State)) != 0;
+        // a move that started and ended within one frame's steps still needs its pose reported
+        settled = settled && !moving;
+    }
+
+    // the pose alpha of the way from the state before the last step to the one after it, false when that
+    // is the pose the last call returned
+    bool Interpolate(float alpha, CameraPose& pose)
+    {
+        if (settled && !moving)
+        {
+            return false;
+        }
+        State blended;
+        for (int k = 0; k < 3; ++k)
+        {
+            blended.pivot[k] = previous.pivot[k] + (current.pivot[k] - previous.pivot[k]) * alpha;
+        }
+        blended.yaw = previous.yaw + (current.yaw - previous.yaw) * alpha;
+        blended.pitch = previous.pitch + (current.pitch - previous.pitch) * alpha;
+        blended.distance = previous.distance + (current.distance - previous.distance) * alpha;
+        pose = Pose(blended);
+        settled = !moving;
+        return true;
+    }
+
+    // the pose after the last step
+    CameraPose CurrentPose() const { return Pose(current); }
+
+private:
+    struct State
+    {
+        float pivot[3];
+        float yaw;
+        float pitch;
+        float distance;
+    };
+
+    static float ClampPitch(float pitch)
+    {
+        // looking straight up or down would leave the look at matrix without a right vector
+        const float Limit = 1.55f;
+        return std::max(-Limit, std::min(Limit, pitch));
+    }
+
+    static void Forward(float yaw, float pitch, float* forward)
+    {
+        forward[0] = std::cos(pitch) * std::sin(yaw);
+        forward[1] = std::sin(pitch);
+        forward[2] = std::cos(pitch) * std::cos(yaw);
+    }
+
+    CameraPose Pose(const State& state) const
+    {
+        float forward[3];
+        Forward(state.yaw, state.pitch, forward);
+        CameraPose pose;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (mode == CameraMode::Orbit)
+            {
+                pose.target[k] = state.pivot[k];
+                pose.eye[k] = state.pivot[k] - forward[k] * state.distance;
+            }
+            else
+            {
+                pose.eye[k] = state.pivot[k];
+                pose.target[k] = state.pivot[k] + forward[k] * state.distance;
+            }
+        }
+        return pose;
+    }
+
+    // no blend from the old state, the next Interpolate reports the new pose
+    void Snap()
+    {
+        previous = current;
+        moving = false;
+        settled = false;
+    }
+
+    CameraMode mode = CameraMode::FreeFly;
+    State current = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0.0f, 1.0f };
+    State previous = current;
+    bool moving = false;
+    bool settled = false;
+};
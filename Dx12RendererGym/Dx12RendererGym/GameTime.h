@@ -0,0 +1,61 @@
+#pragma once
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+// Game thread timing. GameClock measures the wall time between frames, FixedTimestep turns it into a whole
+// number of simulation steps of constant length and keeps the remainder for the next frame, so the
+// simulation advances the same for any frame rate. The renderer draws between the last two simulated
+// states by Alpha(). Time is counted in integer nanoseconds: frames of any lengths that add up to the same
+// time run exactly the same steps, which a floating point accumulator would only get close to.
+
+class GameClock
+{
+public:
+    GameClock() : last(Clock::now()) {}
+
+    // nanoseconds since the previous Tick, the first one counts from construction
+    int64_t Tick()
+    {
+        Clock::time_point now = Clock::now();
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+        last = now;
+        return elapsed;
+    }
+
+private:
+    // QueryPerformanceCounter with MSVC, unlike high_resolution_clock never goes backwards on any library
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point last;
+};
+
+class FixedTimestep
+{
+public:
+    // maxFrameNanoseconds caps what one frame may add, after a breakpoint or a stall the simulation slows
+    // down instead of running ever more steps to catch up
+    explicit FixedTimestep(int64_t stepNanoseconds = 1000000000 / 120, int64_t maxFrameNanoseconds = 250000000)
+        : step(std::max<int64_t>(stepNanoseconds, 1)), maxFrame(maxFrameNanoseconds) {}
+
+    // adds the time of a frame, returns the steps to simulate for it
+    uint32_t Advance(int64_t frameNanoseconds)
+    {
+        accumulator += std::min(std::max<int64_t>(frameNanoseconds, 0), maxFrame);
+        int64_t steps = accumulator / step;
+        accumulator -= steps * step;
+        totalSteps += uint64_t(steps);
+        return uint32_t(steps);
+    }
+
+    // where the frame is between the state before the last step (0) and after it (1)
+    float Alpha() const { return float(double(accumulator) / double(step)); }
+
+    float StepSeconds() const { return float(double(step) * 1e-9); }
+    uint64_t TotalSteps() const { return totalSteps; }
+
+private:
+    int64_t step;
+    int64_t maxFrame;
+    int64_t accumulator = 0;
+    uint64_t totalSteps = 0;
+};
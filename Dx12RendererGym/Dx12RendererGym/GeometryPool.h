@@ -0,0 +1,199 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "GpuMemoryAllocator.h"
+
+// Static geometry of every mesh packed into one vertex and one index megabuffer. A mesh gets a range of
+// vertices and a range of indices, its indices stay relative to its first vertex so draws only differ in
+// base vertex and start index and the buffers are bound once per list. Ranges come from the TLSF allocator
+// of GpuMemoryAllocator.h counting elements instead of bytes.
+//
+// Freed ranges leave holes, Compact packs the live meshes to the front of new megabuffers and returns the
+// copies that move their data there. Mesh handles stay valid across compaction, only their ranges change.
+// One thread uses a pool at a time.
+
+struct GeometryRange
+{
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+// bytes from the old megabuffer to the new one
+struct GeometryCopy
+{
+    uint64_t sourceOffset;
+    uint64_t destinationOffset;
+    uint64_t size;
+};
+
+struct GeometryPoolStatistics
+{
+    uint32_t meshes;
+    uint32_t vertexCapacity;
+    uint32_t verticesUsed;
+    uint32_t largestFreeVertices;
+    uint32_t indexCapacity;
+    uint32_t indicesUsed;
+    uint32_t largestFreeIndices;
+    // of the free space, 1 - largest free range / free elements, the worse of vertices and indices
+    double fragmentation;
+};
+
+class GeometryPool
+{
+public:
+    void Init(uint32_t vertexCapacity, uint32_t vertexStrideBytes, uint32_t indexCapacity, uint32_t indexSizeBytes)
+    {
+        vertexStride = vertexStrideBytes;
+        indexSize = indexSizeBytes;
+        vertices.Init(vertexCapacity, 1);
+        indices.Init(indexCapacity, 1);
+        meshes.clear();
+        unusedMeshes.clear();
+        meshCount = 0;
+    }
+
+    uint32_t VertexStride() const { return vertexStride; }
+    uint32_t IndexSize() const { return indexSize; }
+    uint64_t VertexBufferSize() const { return vertices.Size() * vertexStride; }
+    uint64_t IndexBufferSize() const { return indices.Size() * indexSize; }
+
+    // InvalidAllocation when either megabuffer has no range left that fits
+    uint32_t Allocate(uint32_t vertexCount, uint32_t indexCount)
+    {
+        Mesh mesh = {};
+        if (!vertices.Allocate(vertexCount, 1, mesh.vertices))
+        {
+            return InvalidAllocation;
+        }
+        if (!indices.Allocate(indexCount, 1, mesh.indices))
+        {
+            vertices.Free(mesh.vertices.handle);
+            return InvalidAllocation;
+        }
+        mesh.vertexCount = vertexCount;
+        mesh.indexCount = indexCount;
+        mesh.live = true;
+        meshCount++;
+        if (!unusedMeshes.empty())
+        {
+            uint32_t handle = unusedMeshes.back();
+            unusedMeshes.pop_back();
+            meshes[handle] = mesh;
+            return handle;
+        }
+        meshes.push_back(mesh);
+        return uint32_t(meshes.size() - 1);
+    }
+
+    // the caller makes sure the GPU is done with the mesh
+    void Free(uint32_t handle)
+    {
+        Mesh& mesh = meshes[handle];
+        vertices.Free(mesh.vertices.handle);
+        indices.Free(mesh.indices.handle);
+        mesh.live = false;
+        meshCount--;
+        unusedMeshes.push_back(handle);
+    }
+
+    GeometryRange Range(uint32_t handle) const
+    {
+        const Mesh& mesh = meshes[handle];
+        GeometryRange range = { uint32_t(mesh.vertices.offset), mesh.vertexCount, uint32_t(mesh.indices.offset), mesh.indexCount };
+        return range;
+    }
+
+    uint64_t VertexOffset(uint32_t handle) const { return meshes[handle].vertices.offset * vertexStride; }
+    uint64_t IndexOffset(uint32_t handle) const { return meshes[handle].indices.offset * indexSize; }
+
+    // Move every mesh to the front of new megabuffers of the same size, in the order they are in now.
+    // Copies of neighbouring meshes are merged, the caller copies from the old buffers into new ones.
+    void Compact(std::vector<GeometryCopy>& vertexCopies, std::vector<GeometryCopy>& indexCopies)
+    {
+        std::vector<uint32_t> live;
+        for (uint32_t i = 0; i < meshes.size(); ++i)
+        {
+            if (meshes[i].live)
+            {
+                live.push_back(i);
+            }
+        }
+
+        std::sort(live.begin(), live.end(), [this](uint32_t a, uint32_t b) { return meshes[a].vertices.offset < meshes[b].vertices.offset; });
+        vertices.Init(vertices.Size(), 1);
+        for (size_t i = 0; i < live.size(); ++i)
+        {
+            TlsfAllocation& range = meshes[live[i]].vertices;
+            uint64_t source = range.offset;
+            // an empty allocator hands out ranges front to back, in this order they only move down
+            vertices.Allocate(meshes[live[i]].vertexCount, 1, range);
+            AppendCopy(source * vertexStride, range.offset * vertexStride, range.size * vertexStride, vertexCopies);
+        }
+
+        std::sort(live.begin(), live.end(), [this](uint32_t a, uint32_t b) { return meshes[a].indices.offset < meshes[b].indices.offset; });
+        indices.Init(indices.Size(), 1);
+        for (size_t i = 0; i < live.size(); ++i)
+        {
+            TlsfAllocation& range = meshes[live[i]].indices;
+            uint64_t source = range.offset;
+            indices.Allocate(meshes[live[i]].indexCount, 1, range);
+            AppendCopy(source * indexSize, range.offset * indexSize, range.size * indexSize, indexCopies);
+        }
+    }
+
+    GeometryPoolStatistics Statistics() const
+    {
+        GeometryPoolStatistics statistics = {};
+        statistics.meshes = meshCount;
+        statistics.vertexCapacity = uint32_t(vertices.Size());
+        statistics.verticesUsed = uint32_t(vertices.UsedSize());
+        statistics.largestFreeVertices = uint32_t(vertices.LargestFreeBlock());
+        statistics.indexCapacity = uint32_t(indices.Size());
+        statistics.indicesUsed = uint32_t(indices.UsedSize());
+        statistics.largestFreeIndices = uint32_t(indices.LargestFreeBlock());
+        statistics.fragmentation = std::max(vertices.Fragmentation(), indices.Fragmentation());
+        return statistics;
+    }
+
+private:
+    struct Mesh
+    {
+        TlsfAllocation vertices;
+        TlsfAllocation indices;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        bool live;
+    };
+
+    static void AppendCopy(uint64_t source, uint64_t destination, uint64_t size, std::vector<GeometryCopy>& copies)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+        if (!copies.empty())
+        {
+            GeometryCopy& last = copies.back();
+            if (last.sourceOffset + last.size == source && last.destinationOffset + last.size == destination)
+            {
+                last.size += size;
+                return;
+            }
+        }
+        GeometryCopy copy = { source, destination, size };
+        copies.push_back(copy);
+    }
+
+    TlsfAllocator vertices;
+    TlsfAllocator indices;
+    uint32_t vertexStride = 0;
+    uint32_t indexSize = 0;
+    std::vector<Mesh> meshes;
+    std::vector<uint32_t> unusedMeshes;
+    uint32_t meshCount = 0;
+};
@@ -0,0 +1,549 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// GPU memory sub-allocation. Resources are placed into a few large heaps instead of each getting its own
+// committed allocation. Heaps are kept apart by category, resource heap tier 1 does not allow buffers,
+// textures and render targets in one heap and upload memory is a heap type of its own. Inside a heap a TLSF
+// allocator (Masmano et al., "TLSF: a New Dynamic Memory Allocator for Real-Time Systems") hands out ranges
+// in constant time with a good fit: free blocks are binned by a first level (power of two) and a second
+// level (16 linear steps within it), two bitmaps find the smallest non empty bin that fits.
+//
+// Traits adapts the graphics API:
+//   typedef ... Heap;
+//   static uint64_t Granularity(uint32_t category);               smallest alignment of a category
+//   static Heap* CreateHeap(uint32_t category, uint64_t size);     nullptr on failure
+//   static void DestroyHeap(Heap* heap);
+
+const uint32_t InvalidAllocation = 0xffffffff;
+
+namespace tlsf
+{
+    inline uint32_t LowestBit(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return uint32_t(index);
+#else
+        return uint32_t(__builtin_ctzll(value));
+#endif
+    }
+
+    inline uint32_t HighestBit(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return uint32_t(index);
+#else
+        return uint32_t(63 - __builtin_clzll(value));
+#endif
+    }
+
+    inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+struct TlsfAllocation
+{
+    uint32_t handle;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// ranges of [0, size), every offset and size a multiple of granularity
+class TlsfAllocator
+{
+public:
+    static const uint32_t SecondLevelBits = 4;
+    static const uint32_t SecondLevelCount = 1 << SecondLevelBits;
+    static const uint32_t FirstLevelCount = 64;
+
+    void Init(uint64_t size, uint64_t granularityBytes)
+    {
+        granularity = granularityBytes;
+        capacity = size / granularity * granularity;
+        nodes.clear();
+        unusedNodes.clear();
+        firstLevelBitmap = 0;
+        std::fill(secondLevelBitmaps, secondLevelBitmaps + FirstLevelCount, 0u);
+        std::fill(&bins[0][0], &bins[0][0] + FirstLevelCount * SecondLevelCount, InvalidAllocation);
+        used = 0;
+        allocationCount = 0;
+        if (capacity > 0)
+        {
+            uint32_t node = NewNode(0, capacity);
+            InsertFree(node);
+        }
+    }
+
+    // false when no free block fits, alignment is a power of two
+    bool Allocate(uint64_t size, uint64_t alignment, TlsfAllocation& allocation)
+    {
+        size = tlsf::AlignUp(std::max<uint64_t>(size, 1), granularity);
+        alignment = std::max(alignment, granularity);
+        // a block that is not aligned loses up to alignment - granularity bytes in front
+        uint64_t search = size + alignment - granularity;
+        uint32_t node = search <= capacity ? FindFree(search) : InvalidAllocation;
+        if (node == InvalidAllocation && alignment > granularity && size <= capacity)
+        {
+            // no block fits the worst case, a smaller one may still happen to be aligned well enough
+            node = FindFree(size);
+            if (node != InvalidAllocation && !Fits(node, size, alignment))
+            {
+                node = InvalidAllocation;
+            }
+        }
+        if (node == InvalidAllocation && size <= capacity)
+        {
+            // the bins searched above start at size or more, blocks in the bin of size itself can fit too,
+            // the last free block that exactly fits the request is only found here
+            node = FindInBin(size, alignment);
+        }
+        if (node == InvalidAllocation)
+        {
+            return false;
+        }
+        RemoveFree(node);
+
+        uint64_t aligned = tlsf::AlignUp(nodes[node].offset, alignment);
+        if (aligned > nodes[node].offset)
+        {
+            // the front padding stays free, its physical predecessor is used or it would have merged
+            uint32_t front = Split(node, aligned - nodes[node].offset);
+            InsertFree(node);
+            node = front;
+        }
+        if (nodes[node].size > size)
+        {
+            uint32_t rest = Split(node, size);
+            InsertFree(rest);
+        }
+
+        nodes[node].free = false;
+        used += nodes[node].size;
+        allocationCount++;
+        allocation.handle = node;
+        allocation.offset = nodes[node].offset;
+        allocation.size = nodes[node].size;
+        return true;
+    }
+
+    void Free(uint32_t handle)
+    {
+        uint32_t node = handle;
+        used -= nodes[node].size;
+        allocationCount--;
+        nodes[node].free = true;
+
+        uint32_t next = nodes[node].nextPhysical;
+        if (next != InvalidAllocation && nodes[next].free)
+        {
+            RemoveFree(next);
+            Merge(node, next);
+        }
+        uint32_t previous = nodes[node].previousPhysical;
+        if (previous != InvalidAllocation && nodes[previous].free)
+        {
+            RemoveFree(previous);
+            Merge(previous, node);
+            node = previous;
+        }
+        InsertFree(node);
+    }
+
+    uint64_t Size() const { return capacity; }
+    uint64_t UsedSize() const { return used; }
+    uint32_t AllocationCount() const { return allocationCount; }
+    bool Empty() const { return allocationCount == 0; }
+
+    uint64_t LargestFreeBlock() const
+    {
+        if (firstLevelBitmap == 0)
+        {
+            return 0;
+        }
+        uint32_t first = tlsf::HighestBit(firstLevelBitmap);
+        uint32_t second = tlsf::HighestBit(secondLevelBitmaps[first]);
+        uint64_t largest = 0;
+        for (uint32_t node = bins[first][second]; node != InvalidAllocation; node = nodes[node].nextFree)
+        {
+            largest = std::max(largest, nodes[node].size);
+        }
+        return largest;
+    }
+
+    uint32_t FreeBlockCount() const
+    {
+        uint32_t count = 0;
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            count += nodes[i].free && nodes[i].size > 0 ? 1 : 0;
+        }
+        return count;
+    }
+
+    // 0 when the free memory is one block, towards 1 the more it is split up
+    double Fragmentation() const
+    {
+        uint64_t freeSize = capacity - used;
+        return freeSize == 0 ? 0.0 : 1.0 - double(LargestFreeBlock()) / double(freeSize);
+    }
+
+private:
+    struct Node
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t previousPhysical;
+        uint32_t nextPhysical;
+        uint32_t previousFree;
+        uint32_t nextFree;
+        bool free;
+    };
+
+    // bin of a block of size, blocks in it are at least as large as the bin start
+    void Mapping(uint64_t size, uint32_t& first, uint32_t& second) const
+    {
+        uint64_t units = size / granularity;
+        first = tlsf::HighestBit(units);
+        second = first < SecondLevelBits ? uint32_t(units << (SecondLevelBits - first)) & (SecondLevelCount - 1)
+            : uint32_t(units >> (first - SecondLevelBits)) & (SecondLevelCount - 1);
+    }
+
+    // smallest non empty bin whose blocks are all at least size
+    uint32_t FindFree(uint64_t size) const
+    {
+        uint64_t units = size / granularity;
+        uint32_t top = tlsf::HighestBit(units);
+        if (top >= SecondLevelBits)
+        {
+            // round up to the next bin start
+            units += (uint64_t(1) << (top - SecondLevelBits)) - 1;
+        }
+        uint32_t first, second;
+        Mapping(units * granularity, first, second);
+        if (first >= FirstLevelCount)
+        {
+            return InvalidAllocation;
+        }
+
+        uint32_t secondMap = secondLevelBitmaps[first] & (~0u << second);
+        if (secondMap == 0)
+        {
+            uint64_t firstMap = first + 1 < FirstLevelCount ? firstLevelBitmap & (~uint64_t(0) << (first + 1)) : 0;
+            if (firstMap == 0)
+            {
+                return InvalidAllocation;
+            }
+            first = tlsf::LowestBit(firstMap);
+            secondMap = secondLevelBitmaps[first];
+        }
+        second = tlsf::LowestBit(secondMap);
+        return bins[first][second];
+    }
+
+    // first block of the bin of size that holds size bytes at alignment, linear in the length of the bin
+    uint32_t FindInBin(uint64_t size, uint64_t alignment) const
+    {
+        uint32_t first, second;
+        Mapping(size, first, second);
+        uint32_t node = bins[first][second];
+        while (node != InvalidAllocation && !Fits(node, size, alignment))
+        {
+            node = nodes[node].nextFree;
+        }
+        return node;
+    }
+
+    bool Fits(uint32_t node, uint64_t size, uint64_t alignment) const
+    {
+        return tlsf::AlignUp(nodes[node].offset, alignment) + size <= nodes[node].offset + nodes[node].size;
+    }
+
+    void InsertFree(uint32_t node)
+    {
+        uint32_t first, second;
+        Mapping(nodes[node].size, first, second);
+        nodes[node].free = true;
+        nodes[node].previousFree = InvalidAllocation;
+        nodes[node].nextFree = bins[first][second];
+        if (bins[first][second] != InvalidAllocation)
+        {
+            nodes[bins[first][second]].previousFree = node;
+        }
+        bins[first][second] = node;
+        firstLevelBitmap |= uint64_t(1) << first;
+        secondLevelBitmaps[first] |= 1u << second;
+    }
+
+    void RemoveFree(uint32_t node)
+    {
+        uint32_t first, second;
+        Mapping(nodes[node].size, first, second);
+        uint32_t previous = nodes[node].previousFree;
+        uint32_t next = nodes[node].nextFree;
+        if (previous != InvalidAllocation)
+        {
+            nodes[previous].nextFree = next;
+        }
+        else
+        {
+            bins[first][second] = next;
+        }
+        if (next != InvalidAllocation)
+        {
+            nodes[next].previousFree = previous;
+        }
+        if (bins[first][second] == InvalidAllocation)
+        {
+            secondLevelBitmaps[first] &= ~(1u << second);
+            if (secondLevelBitmaps[first] == 0)
+            {
+                firstLevelBitmap &= ~(uint64_t(1) << first);
+            }
+        }
+    }
+
+    // node keeps the first size bytes, returns the node of the rest
+    uint32_t Split(uint32_t node, uint64_t size)
+    {
+        uint32_t rest = NewNode(nodes[node].offset + size, nodes[node].size - size);
+        nodes[node].size = size;
+        nodes[rest].previousPhysical = node;
+        nodes[rest].nextPhysical = nodes[node].nextPhysical;
+        if (nodes[node].nextPhysical != InvalidAllocation)
+        {
+            nodes[nodes[node].nextPhysical].previousPhysical = rest;
+        }
+        nodes[node].nextPhysical = rest;
+        return rest;
+    }
+
+    // append next, its physical successor, to node
+    void Merge(uint32_t node, uint32_t next)
+    {
+        nodes[node].size += nodes[next].size;
+        nodes[node].nextPhysical = nodes[next].nextPhysical;
+        if (nodes[next].nextPhysical != InvalidAllocation)
+        {
+            nodes[nodes[next].nextPhysical].previousPhysical = node;
+        }
+        nodes[next].size = 0;
+        nodes[next].free = false;
+        unusedNodes.push_back(next);
+    }
+
+    uint32_t NewNode(uint64_t offset, uint64_t size)
+    {
+        Node node = { offset, size, InvalidAllocation, InvalidAllocation, InvalidAllocation, InvalidAllocation, false };
+        if (!unusedNodes.empty())
+        {
+            uint32_t index = unusedNodes.back();
+            unusedNodes.pop_back();
+            nodes[index] = node;
+            return index;
+        }
+        nodes.push_back(node);
+        return uint32_t(nodes.size() - 1);
+    }
+
+    uint64_t granularity = 1;
+    uint64_t capacity = 0;
+    uint64_t used = 0;
+    uint32_t allocationCount = 0;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes;
+    uint64_t firstLevelBitmap = 0;
+    uint32_t secondLevelBitmaps[FirstLevelCount] = {};
+    uint32_t bins[FirstLevelCount][SecondLevelCount];
+};
+
+enum GpuMemoryCategory
+{
+    GpuMemoryBuffers,           // default heap buffers
+    GpuMemoryTextures,          // default heap textures that are neither render targets nor depth
+    GpuMemoryRenderTargets,     // render targets and depth stencil textures
+    GpuMemoryUpload,            // upload heap buffers
+    GpuMemoryCategoryCount
+};
+
+struct GpuAllocation
+{
+    uint32_t category = 0;
+    uint32_t block = 0;
+    uint32_t handle = InvalidAllocation;    // InvalidAllocation: nothing allocated
+    uint64_t offset = 0;                    // in the block's heap
+    uint64_t size = 0;
+};
+
+struct GpuMemoryStatistics
+{
+    uint32_t blocks;
+    uint32_t allocations;
+    uint64_t reserved;      // heap memory
+    uint64_t used;          // allocated ranges, alignment included
+    uint64_t largestFree;
+    double fragmentation;   // of the free memory over all blocks
+};
+
+template <typename Traits>
+class GpuMemoryAllocator
+{
+public:
+    typedef typename Traits::Heap Heap;
+
+    ~GpuMemoryAllocator() { Destroy(); }
+
+    // allocations larger than blockSize get a heap of their own
+    void Init(uint64_t heapBlockSize)
+    {
+        blockSize = heapBlockSize;
+    }
+
+    void Destroy()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t c = 0; c < GpuMemoryCategoryCount; ++c)
+        {
+            for (size_t b = 0; b < blocks[c].size(); ++b)
+            {
+                if (blocks[c][b].heap)
+                {
+                    Traits::DestroyHeap(blocks[c][b].heap);
+                }
+            }
+            blocks[c].clear();
+        }
+    }
+
+    bool Allocate(uint32_t category, uint64_t size, uint64_t alignment, GpuAllocation& allocation)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Block>& pool = blocks[category];
+        TlsfAllocation range;
+        for (size_t b = 0; b < pool.size(); ++b)
+        {
+            if (pool[b].heap && pool[b].allocator->Allocate(size, alignment, range))
+            {
+                Fill(category, uint32_t(b), range, allocation);
+                return true;
+            }
+        }
+
+        uint64_t granularity = Traits::Granularity(category);
+        uint64_t heapSize = std::max(blockSize, tlsf::AlignUp(size, std::max(alignment, granularity)));
+        Heap* heap = Traits::CreateHeap(category, heapSize);
+        if (heap == nullptr)
+        {
+            return false;
+        }
+        size_t slot = 0;
+        while (slot < pool.size() && pool[slot].heap)
+        {
+            slot++;
+        }
+        if (slot == pool.size())
+        {
+            pool.push_back(Block());
+        }
+        pool[slot].heap = heap;
+        pool[slot].allocator.reset(new TlsfAllocator());
+        pool[slot].allocator->Init(heapSize, granularity);
+        if (!pool[slot].allocator->Allocate(size, alignment, range))
+        {
+            return false;
+        }
+        Fill(category, uint32_t(slot), range, allocation);
+        return true;
+    }
+
+    // the memory is reused right away, the caller makes sure the GPU is done with it
+    void Free(GpuAllocation& allocation)
+    {
+        if (allocation.handle == InvalidAllocation)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Block>& pool = blocks[allocation.category];
+        Block& block = pool[allocation.block];
+        block.allocator->Free(allocation.handle);
+        allocation.handle = InvalidAllocation;
+
+        // an empty block goes back to the OS unless it is the last one of the category
+        if (block.allocator->Empty())
+        {
+            size_t live = 0;
+            for (size_t b = 0; b < pool.size(); ++b)
+            {
+                live += pool[b].heap ? 1 : 0;
+            }
+            if (live > 1)
+            {
+                Traits::DestroyHeap(block.heap);
+                block.heap = nullptr;
+                block.allocator.reset();
+            }
+        }
+    }
+
+    Heap* HeapOf(const GpuAllocation& allocation) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return blocks[allocation.category][allocation.block].heap;
+    }
+
+    GpuMemoryStatistics Statistics(uint32_t category) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        GpuMemoryStatistics statistics = {};
+        uint64_t freeSize = 0;
+        for (size_t b = 0; b < blocks[category].size(); ++b)
+        {
+            const Block& block = blocks[category][b];
+            if (!block.heap)
+            {
+                continue;
+            }
+            statistics.blocks++;
+            statistics.allocations += block.allocator->AllocationCount();
+            statistics.reserved += block.allocator->Size();
+            statistics.used += block.allocator->UsedSize();
+            statistics.largestFree = std::max(statistics.largestFree, block.allocator->LargestFreeBlock());
+            freeSize += block.allocator->Size() - block.allocator->UsedSize();
+        }
+        statistics.fragmentation = freeSize == 0 ? 0.0 : 1.0 - double(statistics.largestFree) / double(freeSize);
+        return statistics;
+    }
+
+private:
+    struct Block
+    {
+        Heap* heap = nullptr;
+        std::unique_ptr<TlsfAllocator> allocator;
+    };
+
+    static void Fill(uint32_t category, uint32_t block, const TlsfAllocation& range, GpuAllocation& allocation)
+    {
+        allocation.category = category;
+        allocation.block = block;
+        allocation.handle = range.handle;
+        allocation.offset = range.offset;
+        allocation.size = range.size;
+    }
+
+    mutable std::mutex mutex;
+    uint64_t blockSize = 64 * 1024 * 1024;
+    std::vector<Block> blocks[GpuMemoryCategoryCount];
+};
@@ -0,0 +1,233 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Index buffer codec for the mesh asset. Every index is stored as the zigzag encoded delta to the
+// previous index, written as a little endian base 128 varint. After the vertex cache and vertex fetch
+// passes most deltas are tiny, so the varint bytes are then entropy coded with an adaptive binary
+// range coder (the LZMA coder) using separate byte models for the first and the following varint bytes.
+
+namespace indexcodec
+{
+    const int kNumBitModelTotalBits = 11;
+    const uint32_t kBitModelTotal = 1 << kNumBitModelTotalBits;
+    const int kNumMoveBits = 5;
+    const uint32_t kTopValue = 1 << 24;
+
+    // 255 bit probabilities per byte model, addressed as a binary tree by the bits seen so far
+    struct ByteModel
+    {
+        uint16_t probs[256];
+
+        ByteModel()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                probs[i] = kBitModelTotal / 2;
+            }
+        }
+    };
+
+    class RangeEncoder
+    {
+    public:
+        RangeEncoder(std::vector<unsigned char>& output) : out(output) {}
+
+        void EncodeBit(uint16_t& prob, uint32_t bit)
+        {
+            uint32_t bound = (range >> kNumBitModelTotalBits) * prob;
+            if (bit == 0)
+            {
+                range = bound;
+                prob = uint16_t(prob + ((kBitModelTotal - prob) >> kNumMoveBits));
+            }
+            else
+            {
+                low += bound;
+                range -= bound;
+                prob = uint16_t(prob - (prob >> kNumMoveBits));
+            }
+            while (range < kTopValue)
+            {
+                range <<= 8;
+                ShiftLow();
+            }
+        }
+
+        void EncodeByte(ByteModel& model, uint32_t value)
+        {
+            uint32_t node = 1;
+            for (int i = 7; i >= 0; --i)
+            {
+                uint32_t bit = (value >> i) & 1;
+                EncodeBit(model.probs[node], bit);
+                node = (node << 1) | bit;
+            }
+        }
+
+        void Flush()
+        {
+            for (int i = 0; i < 5; ++i)
+            {
+                ShiftLow();
+            }
+        }
+
+    private:
+        void ShiftLow()
+        {
+            // carry propagation, bytes equal to 0xFF are held back until we know if a carry reaches them
+            if (uint32_t(low) < 0xFF000000u || (low >> 32) != 0)
+            {
+                unsigned char temp = cache;
+                do
+                {
+                    out.push_back((unsigned char)(temp + (unsigned char)(low >> 32)));
+                    temp = 0xFF;
+                } while (--cacheSize != 0);
+                cache = (unsigned char)(uint32_t(low) >> 24);
+            }
+            cacheSize++;
+            low = uint64_t(uint32_t(low) << 8);
+        }
+
+        std::vector<unsigned char>& out;
+        uint64_t low = 0;
+        uint32_t range = 0xFFFFFFFFu;
+        unsigned char cache = 0;
+        uint64_t cacheSize = 1;
+    };
+
+    class RangeDecoder
+    {
+    public:
+        RangeDecoder(const unsigned char* data, size_t size) : in(data), end(data + size)
+        {
+            for (int i = 0; i < 5; ++i)
+            {
+                code = (code << 8) | NextByte();
+            }
+        }
+
+        uint32_t DecodeBit(uint16_t& prob)
+        {
+            uint32_t bound = (range >> kNumBitModelTotalBits) * prob;
+            uint32_t bit;
+            if (code < bound)
+            {
+                range = bound;
+                prob = uint16_t(prob + ((kBitModelTotal - prob) >> kNumMoveBits));
+                bit = 0;
+            }
+            else
+            {
+                code -= bound;
+                range -= bound;
+                prob = uint16_t(prob - (prob >> kNumMoveBits));
+                bit = 1;
+            }
+            if (range < kTopValue)
+            {
+                range <<= 8;
+                code = (code << 8) | NextByte();
+            }
+            return bit;
+        }
+
+        uint32_t DecodeByte(ByteModel& model)
+        {
+            uint32_t node = 1;
+            for (int i = 0; i < 8; ++i)
+            {
+                node = (node << 1) | DecodeBit(model.probs[node]);
+            }
+            return node - 256;
+        }
+
+        // true if the decoder had to read past the end of the stream
+        bool Overrun() const { return overrun; }
+
+    private:
+        uint32_t NextByte()
+        {
+            if (in == end)
+            {
+                overrun = true;
+                return 0;
+            }
+            return *in++;
+        }
+
+        const unsigned char* in;
+        const unsigned char* end;
+        uint32_t code = 0;
+        uint32_t range = 0xFFFFFFFFu;
+        bool overrun = false;
+    };
+}
+
+inline void EncodeIndexBuffer(const std::vector<uint32_t>& indices, std::vector<unsigned char>& output)
+{
+    output.clear();
+    indexcodec::RangeEncoder encoder(output);
+    indexcodec::ByteModel firstByteModel;
+    indexcodec::ByteModel nextByteModel;
+
+    uint32_t previous = 0;
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        int32_t delta = int32_t(indices[i] - previous);
+        uint32_t zigzag = (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+        previous = indices[i];
+
+        indexcodec::ByteModel* model = &firstByteModel;
+        do
+        {
+            uint32_t byte = zigzag & 0x7f;
+            zigzag >>= 7;
+            if (zigzag != 0)
+            {
+                byte |= 0x80;
+            }
+            encoder.EncodeByte(*model, byte);
+            model = &nextByteModel;
+        } while (zigzag != 0);
+    }
+
+    encoder.Flush();
+}
+
+// returns false if the stream is truncated or corrupt
+inline bool DecodeIndexBuffer(const unsigned char* data, size_t size, size_t indexCount, std::vector<uint32_t>& indices)
+{
+    indices.resize(indexCount);
+    indexcodec::RangeDecoder decoder(data, size);
+    indexcodec::ByteModel firstByteModel;
+    indexcodec::ByteModel nextByteModel;
+
+    uint32_t previous = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t zigzag = 0;
+        int shift = 0;
+        uint32_t byte = decoder.DecodeByte(firstByteModel);
+        zigzag |= (byte & 0x7f);
+        while (byte & 0x80)
+        {
+            shift += 7;
+            if (shift > 28)
+            {
+                return false;
+            }
+            byte = decoder.DecodeByte(nextByteModel);
+            zigzag |= (byte & 0x7f) << shift;
+        }
+
+        int32_t delta = int32_t(zigzag >> 1) ^ -int32_t(zigzag & 1);
+        previous += uint32_t(delta);
+        indices[i] = previous;
+    }
+
+    return !decoder.Overrun();
+}
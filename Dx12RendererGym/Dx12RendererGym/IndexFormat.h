@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// a range of the index buffer drawn with one DrawIndexedInstanced call
+struct Submesh
+{
+    uint32_t startIndex;
+    uint32_t indexCount;
+    int32_t baseVertex;
+};
+
+// Convert a 32 bit triangle list to 16 bit indices. Meshes with more than 65536 vertices are split
+// into submeshes whose referenced vertex range fits 16 bits, the range start becomes the submesh
+// baseVertex. Relies on the vertex fetch pass having put vertices in first use order, which keeps
+// the ranges of consecutive triangles tight.
+// Returns false and leaves the outputs empty when it would take more than maxSubmeshes draws,
+// the caller keeps 32 bit indices in that case.
+inline bool ConvertTo16BitIndices(const std::vector<uint32_t>& indices, size_t maxSubmeshes,
+    std::vector<uint16_t>& indices16, std::vector<Submesh>& submeshes)
+{
+    const uint32_t maxRange = 0xFFFF;
+
+    indices16.clear();
+    submeshes.clear();
+    indices16.reserve(indices.size());
+
+    size_t triangleCount = indices.size() / 3;
+    size_t start = 0;
+    while (start < triangleCount)
+    {
+        uint32_t rangeMin = UINT32_MAX;
+        uint32_t rangeMax = 0;
+        size_t end = start;
+        for (; end < triangleCount; ++end)
+        {
+            uint32_t a = indices[end * 3 + 0];
+            uint32_t b = indices[end * 3 + 1];
+            uint32_t c = indices[end * 3 + 2];
+            uint32_t newMin = std::min(rangeMin, std::min(a, std::min(b, c)));
+            uint32_t newMax = std::max(rangeMax, std::max(a, std::max(b, c)));
+            if (newMax - newMin > maxRange)
+            {
+                break;
+            }
+            rangeMin = newMin;
+            rangeMax = newMax;
+        }
+
+        if (end == start || submeshes.size() == maxSubmeshes)
+        {
+            // a single triangle spans more than 16 bits or the split is not worth the extra draws
+            indices16.clear();
+            submeshes.clear();
+            return false;
+        }
+
+        Submesh submesh;
+        submesh.startIndex = uint32_t(start * 3);
+        submesh.indexCount = uint32_t((end - start) * 3);
+        submesh.baseVertex = int32_t(rangeMin);
+        submeshes.push_back(submesh);
+
+        for (size_t i = start * 3; i < end * 3; ++i)
+        {
+            indices16.push_back(uint16_t(indices[i] - rangeMin));
+        }
+        start = end;
+    }
+
+    return true;
+}
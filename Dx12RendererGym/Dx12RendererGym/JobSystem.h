@@ -0,0 +1,430 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Work stealing job scheduler. Every thread that joined the scheduler (the thread that called Init and the
+// workers) owns a Chase-Lev deque: it pushes and pops jobs at the bottom, idle threads steal from the top.
+// Jobs signal a JobCounter when they finish, Wait helps executing jobs until the counter drops to zero, and
+// RunAfter defers a job until another counter reached zero. Threads outside the scheduler may submit jobs,
+// those go through a locked queue the workers also poll.
+
+class JobSystem;
+struct Job;
+
+class JobCounter
+{
+public:
+    JobCounter() : pending(0), finishing(0) {}
+
+    // once true the counter may be destroyed, no job touches it anymore
+    bool Done() const
+    {
+        return pending.load(std::memory_order_acquire) == 0 && finishing.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending;
+    // jobs between their decrement and their last access to the counter, the one reaching zero still has
+    // to hand off the continuations
+    std::atomic<int> finishing;
+    // jobs started by RunAfter once pending reaches zero
+    std::mutex mutex;
+    std::vector<Job*> continuations;
+};
+
+struct Job
+{
+    std::function<void()> task;
+    JobCounter* counter;
+};
+
+namespace jobs
+{
+    // fixed size Chase-Lev deque, Le et al. "Correct and Efficient Work-Stealing for Weak Memory Models"
+    class WorkStealingQueue
+    {
+    public:
+        static const int64_t Capacity = 4096;
+
+        WorkStealingQueue() : top(0), bottom(0)
+        {
+            for (int64_t i = 0; i < Capacity; ++i)
+            {
+                entries[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        // owner thread only, false when the queue is full
+        bool Push(Job* job)
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= Capacity)
+            {
+                return false;
+            }
+            entries[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // owner thread only, newest job first
+        Job* Pop()
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b)
+            {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job* job = entries[b & (Capacity - 1)].load(std::memory_order_relaxed);
+            if (t == b)
+            {
+                // last job, race the thieves for it
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    job = nullptr;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        // any thread, oldest job first
+        Job* Steal()
+        {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+            {
+                return nullptr;
+            }
+            Job* job = entries[t & (Capacity - 1)].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return nullptr;
+            }
+            return job;
+        }
+
+    private:
+        std::atomic<int64_t> top;
+        std::atomic<int64_t> bottom;
+        std::atomic<Job*> entries[Capacity];
+    };
+
+    // index of the calling thread in the scheduler, -1 for threads outside of it
+    inline int& ThreadIndex()
+    {
+        static thread_local int index = -1;
+        return index;
+    }
+}
+
+class JobSystem
+{
+public:
+    JobSystem() : running(false), externalSize(0), sleepers(0) {}
+    ~JobSystem() { Shutdown(); }
+
+    // workerCount 0 starts one worker per hardware thread besides the calling thread, which becomes thread 0
+    void Init(size_t workerCount = 0)
+    {
+        Shutdown();
+        if (workerCount == 0)
+        {
+            unsigned int hardwareThreads = std::thread::hardware_concurrency();
+            workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        queues.clear();
+        for (size_t i = 0; i < workerCount + 1; ++i)
+        {
+            queues.emplace_back(new jobs::WorkStealingQueue());
+        }
+        jobs::ThreadIndex() = 0;
+        running = true;
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            workers.emplace_back([this, i]() { WorkerMain(int(i + 1)); });
+        }
+    }
+
+    void Shutdown()
+    {
+        if (!running)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running = false;
+        }
+        sleepCondition.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            workers[i].join();
+        }
+        workers.clear();
+        for (size_t i = 0; i < queues.size(); ++i)
+        {
+            delete queues[i];
+        }
+        queues.clear();
+        jobs::ThreadIndex() = -1;
+    }
+
+    // threads that execute jobs, including the thread that called Init
+    size_t ThreadCount() const { return queues.size(); }
+
+    // run task on any thread, counter (optional) is decremented when it finished
+    void Run(std::function<void()> task, JobCounter* counter = nullptr)
+    {
+        if (counter)
+        {
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        Job* job = new Job;
+        job->task = std::move(task);
+        job->counter = counter;
+        Submit(job);
+    }
+
+    // run task once dependency reached zero, counter (optional) covers the deferred job as well
+    void RunAfter(JobCounter& dependency, std::function<void()> task, JobCounter* counter = nullptr)
+    {
+        if (counter)
+        {
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        Job* job = new Job;
+        job->task = std::move(task);
+        job->counter = counter;
+
+        {
+            // pending alone: the job that reached zero takes the continuations only after it locked the mutex
+            std::lock_guard<std::mutex> lock(dependency.mutex);
+            if (dependency.pending.load(std::memory_order_acquire) != 0)
+            {
+                dependency.continuations.push_back(job);
+                return;
+            }
+        }
+        Submit(job);
+    }
+
+    // execute jobs on the calling thread until counter reached zero
+    void Wait(const JobCounter& counter)
+    {
+        unsigned int idle = 0;
+        while (!counter.Done())
+        {
+            if (!ExecuteOne())
+            {
+                Backoff(idle);
+            }
+            else
+            {
+                idle = 0;
+            }
+        }
+    }
+
+    // Call body(begin, end) for chunks of at most grainSize elements of [0, count) in parallel and wait.
+    // Ranges are split in halves, the half not worked on is left for thieves, so idle threads take big
+    // pieces first and fine grained loops do not flood the queues.
+    template <typename Body>
+    void ParallelFor(size_t count, size_t grainSize, const Body& body)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        JobCounter counter;
+        Split(0, count, std::max<size_t>(grainSize, 1), body, counter);
+        Wait(counter);
+    }
+
+private:
+    template <typename Body>
+    void Split(size_t begin, size_t end, size_t grainSize, const Body& body, JobCounter& counter)
+    {
+        while (end - begin > grainSize)
+        {
+            size_t middle = begin + (end - begin) / 2;
+            Run([this, middle, end, grainSize, &body, &counter]() { Split(middle, end, grainSize, body, counter); }, &counter);
+            end = middle;
+        }
+        body(begin, end);
+    }
+
+    void Submit(Job* job)
+    {
+        int index = jobs::ThreadIndex();
+        if (index < 0 || index >= int(queues.size()) || !queues[index]->Push(job))
+        {
+            if (index >= 0 && index < int(queues.size()))
+            {
+                // the deque is full, running it right away still makes progress
+                Execute(job);
+                return;
+            }
+            std::lock_guard<std::mutex> lock(externalMutex);
+            external.push_back(job);
+            externalSize.fetch_add(1, std::memory_order_release);
+        }
+        if (sleepers.load(std::memory_order_relaxed) > 0)
+        {
+            sleepCondition.notify_one();
+        }
+    }
+
+    Job* FindJob()
+    {
+        int index = jobs::ThreadIndex();
+        if (index >= 0 && index < int(queues.size()))
+        {
+            if (Job* job = queues[index]->Pop())
+            {
+                return job;
+            }
+        }
+
+        if (externalSize.load(std::memory_order_acquire) > 0)
+        {
+            std::lock_guard<std::mutex> lock(externalMutex);
+            if (!external.empty())
+            {
+                Job* job = external.front();
+                external.pop_front();
+                externalSize.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+
+        // steal, starting after our own queue so thieves spread out
+        size_t queueCount = queues.size();
+        size_t start = size_t(index + 1);
+        for (size_t i = 0; i < queueCount; ++i)
+        {
+            size_t victim = (start + i) % queueCount;
+            if (int(victim) == index)
+            {
+                continue;
+            }
+            if (Job* job = queues[victim]->Steal())
+            {
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    bool ExecuteOne()
+    {
+        Job* job = FindJob();
+        if (job == nullptr)
+        {
+            return false;
+        }
+        Execute(job);
+        return true;
+    }
+
+    void Execute(Job* job)
+    {
+        job->task();
+        JobCounter* counter = job->counter;
+        delete job;
+
+        if (counter == nullptr)
+        {
+            return;
+        }
+
+        // Wait may return and the owner destroy the counter as soon as Done is true, so finishing covers
+        // the handoff and its decrement is the last access
+        std::vector<Job*> ready;
+        counter->finishing.fetch_add(1, std::memory_order_relaxed);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            ready.swap(counter->continuations);
+        }
+        counter->finishing.fetch_sub(1, std::memory_order_release);
+
+        for (size_t i = 0; i < ready.size(); ++i)
+        {
+            Submit(ready[i]);
+        }
+    }
+
+    // spin a little, then yield, then sleep until new work is submitted
+    void Backoff(unsigned int& idle)
+    {
+        idle++;
+        if (idle < 64)
+        {
+            return;
+        }
+        if (idle < 256 || jobs::ThreadIndex() == 0)
+        {
+            std::this_thread::yield();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (!running)
+        {
+            return;
+        }
+        sleepers++;
+        sleepCondition.wait_for(lock, std::chrono::milliseconds(1));
+        sleepers--;
+    }
+
+    void WorkerMain(int index)
+    {
+        jobs::ThreadIndex() = index;
+        unsigned int idle = 0;
+        while (running)
+        {
+            if (ExecuteOne())
+            {
+                idle = 0;
+            }
+            else
+            {
+                Backoff(idle);
+            }
+        }
+        jobs::ThreadIndex() = -1;
+    }
+
+    std::vector<jobs::WorkStealingQueue*> queues;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running;
+
+    std::mutex externalMutex;
+    std::deque<Job*> external;
+    std::atomic<size_t> externalSize;
+
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<int> sleepers;
+};
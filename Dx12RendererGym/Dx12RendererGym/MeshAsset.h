@@ -0,0 +1,360 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "Meshlets.h"
+
+// Binary mesh asset written by the obj converter next to the source file (teapot.obj -> teapot.mesh).
+// Layout: MeshAssetFileHeader, then for every mesh a MeshAssetMeshHeader followed by
+// vertexCount * vertexStride bytes of vertex data, lodCount MeshLod entries, meshletCount Meshlet entries,
+// meshletVertexCount 32 bit meshlet vertices, meshletTriangleSize bytes of meshlet triangles and indexCount
+// 32 bit indices, or compressedIndexSize bytes of EncodeIndexBuffer output when MeshAssetFlagCompressedIndices is set.
+// The indices of all LODs are stored back to back, LOD 0 is the full resolution mesh. Meshlets cover LOD 0.
+// The meshes are followed by materialCount materials, each a MeshAssetMaterialHeader and its name, diffuse
+// map and bump map strings. Every mesh names the material it is drawn with.
+// Bump MeshAssetVersion whenever the layout or the converter output changes, stale files are reconverted.
+
+const uint32_t MeshAssetMagic = 0x4D475844; // "DXGM"
+const uint32_t MeshAssetVersion = 8;
+
+// vertex data is CompressedVertex, positions are quantized relative to the bounds
+const uint32_t MeshAssetFlagCompressedVertices = 0x1;
+// index data is compressed with EncodeIndexBuffer, MeshAsset::indices is empty after reading
+const uint32_t MeshAssetFlagCompressedIndices = 0x2;
+
+struct MeshAssetFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceTimestamp;
+    uint32_t meshCount;
+    uint32_t materialCount;
+};
+
+struct MeshAssetMeshHeader
+{
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t indexCount;
+    uint32_t flags;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t compressedIndexSize;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    uint32_t meshletVertexCount;
+    uint32_t meshletTriangleSize;
+    uint32_t material;
+};
+
+struct MeshAssetMaterialHeader
+{
+    float diffuse[3];
+    float specular[3];
+    float specularPower;
+    uint32_t nameLength;
+    uint32_t diffuseMapLength;
+    uint32_t bumpMapLength;
+};
+
+// the defaults are the white material meshes without one are drawn with
+struct MeshAssetMaterial
+{
+    std::string name;
+    float diffuse[3] = { 1.0f, 1.0f, 1.0f };
+    float specular[3] = { 1.0f, 1.0f, 1.0f };
+    float specularPower = 50.0f;
+    std::string diffuseMap;     // path of the texture, empty when untextured
+    std::string bumpMap;
+};
+
+// one level of the LOD chain, all levels share the mesh vertex buffer
+struct MeshLod
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error; // object space distance to the full resolution surface
+};
+
+struct MeshAsset
+{
+    uint32_t vertexStride = 0;
+    uint32_t flags = 0;
+    float boundsMin[3] = { 0, 0, 0 };
+    float boundsMax[3] = { 0, 0, 0 };
+    std::vector<unsigned char> vertexData;
+    std::vector<uint32_t> indices;
+    uint32_t indexCount = 0;
+    std::vector<unsigned char> compressedIndices;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<unsigned char> meshletTriangles;
+    uint32_t material = 0;
+
+    uint32_t VertexCount() const { return vertexStride == 0 ? 0 : uint32_t(vertexData.size() / vertexStride); }
+};
+
+// union of the mesh bounds, compressed vertices of every mesh are quantized relative to it
+inline void MeshAssetSceneBounds(const std::vector<MeshAsset>& meshes, float boundsMin[3], float boundsMax[3])
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        boundsMin[k] = meshes.empty() ? 0.0f : meshes[0].boundsMin[k];
+        boundsMax[k] = meshes.empty() ? 0.0f : meshes[0].boundsMax[k];
+    }
+    for (size_t i = 1; i < meshes.size(); ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            boundsMin[k] = std::min(boundsMin[k], meshes[i].boundsMin[k]);
+            boundsMax[k] = std::max(boundsMax[k], meshes[i].boundsMax[k]);
+        }
+    }
+}
+
+// size of a file in bytes, 0 if it does not exist
+inline uint64_t GetFileSizeBytes(const std::string& path)
+{
+#ifdef _WIN32
+    struct _stat64 fileStat;
+    if (_stat64(path.c_str(), &fileStat) != 0)
+    {
+        return 0;
+    }
+#else
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0)
+    {
+        return 0;
+    }
+#endif
+    return uint64_t(fileStat.st_size);
+}
+
+// last modification time of a file, 0 if it does not exist
+inline uint64_t GetFileTimestamp(const std::string& path)
+{
+#ifdef _WIN32
+    struct _stat64 fileStat;
+    if (_stat64(path.c_str(), &fileStat) != 0)
+    {
+        return 0;
+    }
+#else
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0)
+    {
+        return 0;
+    }
+#endif
+    return uint64_t(fileStat.st_mtime);
+}
+
+// Writes a mesh asset one mesh at a time, for converters that never hold the whole scene. Open leaves the
+// magic out of the file header, Finish appends the materials and completes the header, so a file that was
+// not finished is never read back.
+class MeshAssetWriter
+{
+public:
+    bool Open(const std::string& path, uint64_t sourceTimestamp)
+    {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        header = {};
+        header.version = MeshAssetVersion;
+        header.sourceTimestamp = sourceTimestamp;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        return file.good();
+    }
+
+    void AddMesh(const MeshAsset& mesh)
+    {
+        MeshAssetMeshHeader meshHeader = {};
+        meshHeader.vertexCount = mesh.VertexCount();
+        meshHeader.vertexStride = mesh.vertexStride;
+        meshHeader.indexCount = mesh.indexCount;
+        meshHeader.compressedIndexSize = uint32_t(mesh.compressedIndices.size());
+        meshHeader.flags = mesh.flags;
+        meshHeader.lodCount = uint32_t(mesh.lods.size());
+        meshHeader.meshletCount = uint32_t(mesh.meshlets.size());
+        meshHeader.meshletVertexCount = uint32_t(mesh.meshletVertices.size());
+        meshHeader.meshletTriangleSize = uint32_t(mesh.meshletTriangles.size());
+        meshHeader.material = mesh.material;
+        for (int k = 0; k < 3; ++k)
+        {
+            meshHeader.boundsMin[k] = mesh.boundsMin[k];
+            meshHeader.boundsMax[k] = mesh.boundsMax[k];
+        }
+        file.write(reinterpret_cast<const char*>(&meshHeader), sizeof(meshHeader));
+        file.write(reinterpret_cast<const char*>(mesh.vertexData.data()), mesh.vertexData.size());
+        file.write(reinterpret_cast<const char*>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+        file.write(reinterpret_cast<const char*>(mesh.meshlets.data()), mesh.meshlets.size() * sizeof(Meshlet));
+        file.write(reinterpret_cast<const char*>(mesh.meshletVertices.data()), mesh.meshletVertices.size() * sizeof(uint32_t));
+        file.write(reinterpret_cast<const char*>(mesh.meshletTriangles.data()), mesh.meshletTriangles.size());
+        if (mesh.flags & MeshAssetFlagCompressedIndices)
+        {
+            file.write(reinterpret_cast<const char*>(mesh.compressedIndices.data()), mesh.compressedIndices.size());
+        }
+        else
+        {
+            file.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+        }
+        header.meshCount++;
+    }
+
+    bool Finish(const std::vector<MeshAssetMaterial>& materials)
+    {
+        for (size_t i = 0; i < materials.size(); ++i)
+        {
+            const MeshAssetMaterial& material = materials[i];
+            MeshAssetMaterialHeader materialHeader = {};
+            for (int k = 0; k < 3; ++k)
+            {
+                materialHeader.diffuse[k] = material.diffuse[k];
+                materialHeader.specular[k] = material.specular[k];
+            }
+            materialHeader.specularPower = material.specularPower;
+            materialHeader.nameLength = uint32_t(material.name.size());
+            materialHeader.diffuseMapLength = uint32_t(material.diffuseMap.size());
+            materialHeader.bumpMapLength = uint32_t(material.bumpMap.size());
+            file.write(reinterpret_cast<const char*>(&materialHeader), sizeof(materialHeader));
+            file.write(material.name.data(), material.name.size());
+            file.write(material.diffuseMap.data(), material.diffuseMap.size());
+            file.write(material.bumpMap.data(), material.bumpMap.size());
+        }
+
+        header.magic = MeshAssetMagic;
+        header.materialCount = uint32_t(materials.size());
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.close();
+        return !file.fail();
+    }
+
+    uint32_t MeshCount() const { return header.meshCount; }
+
+private:
+    std::ofstream file;
+    MeshAssetFileHeader header = {};
+};
+
+inline bool WriteMeshAsset(const std::string& path, uint64_t sourceTimestamp, const std::vector<MeshAsset>& meshes,
+    const std::vector<MeshAssetMaterial>& materials)
+{
+    MeshAssetWriter writer;
+    if (!writer.Open(path, sourceTimestamp))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        writer.AddMesh(meshes[i]);
+    }
+    return writer.Finish(materials);
+}
+
+// fails if the file is missing, corrupt, from another version or older than the source
+inline bool ReadMeshAsset(const std::string& path, uint64_t sourceTimestamp, std::vector<MeshAsset>& meshes,
+    std::vector<MeshAssetMaterial>& materials)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    MeshAssetFileHeader header = {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != MeshAssetMagic || header.version != MeshAssetVersion || header.sourceTimestamp != sourceTimestamp)
+    {
+        return false;
+    }
+
+    meshes.clear();
+    meshes.resize(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; ++i)
+    {
+        MeshAssetMeshHeader meshHeader = {};
+        file.read(reinterpret_cast<char*>(&meshHeader), sizeof(meshHeader));
+        if (!file)
+        {
+            return false;
+        }
+
+        MeshAsset& mesh = meshes[i];
+        if (meshHeader.material >= header.materialCount)
+        {
+            return false;
+        }
+        mesh.material = meshHeader.material;
+        mesh.vertexStride = meshHeader.vertexStride;
+        mesh.flags = meshHeader.flags;
+        for (int k = 0; k < 3; ++k)
+        {
+            mesh.boundsMin[k] = meshHeader.boundsMin[k];
+            mesh.boundsMax[k] = meshHeader.boundsMax[k];
+        }
+        mesh.vertexData.resize(size_t(meshHeader.vertexCount) * meshHeader.vertexStride);
+        mesh.indexCount = meshHeader.indexCount;
+        file.read(reinterpret_cast<char*>(mesh.vertexData.data()), mesh.vertexData.size());
+        mesh.lods.resize(meshHeader.lodCount);
+        file.read(reinterpret_cast<char*>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+        mesh.meshlets.resize(meshHeader.meshletCount);
+        file.read(reinterpret_cast<char*>(mesh.meshlets.data()), mesh.meshlets.size() * sizeof(Meshlet));
+        mesh.meshletVertices.resize(meshHeader.meshletVertexCount);
+        file.read(reinterpret_cast<char*>(mesh.meshletVertices.data()), mesh.meshletVertices.size() * sizeof(uint32_t));
+        mesh.meshletTriangles.resize(meshHeader.meshletTriangleSize);
+        file.read(reinterpret_cast<char*>(mesh.meshletTriangles.data()), mesh.meshletTriangles.size());
+        if (mesh.flags & MeshAssetFlagCompressedIndices)
+        {
+            // decoded by the caller, typically off the main thread
+            mesh.compressedIndices.resize(meshHeader.compressedIndexSize);
+            file.read(reinterpret_cast<char*>(mesh.compressedIndices.data()), mesh.compressedIndices.size());
+        }
+        else
+        {
+            mesh.indices.resize(meshHeader.indexCount);
+            file.read(reinterpret_cast<char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+        }
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    materials.clear();
+    materials.resize(header.materialCount);
+    for (uint32_t i = 0; i < header.materialCount; ++i)
+    {
+        MeshAssetMaterialHeader materialHeader = {};
+        file.read(reinterpret_cast<char*>(&materialHeader), sizeof(materialHeader));
+        if (!file)
+        {
+            return false;
+        }
+
+        MeshAssetMaterial& material = materials[i];
+        for (int k = 0; k < 3; ++k)
+        {
+            material.diffuse[k] = materialHeader.diffuse[k];
+            material.specular[k] = materialHeader.specular[k];
+        }
+        material.specularPower = materialHeader.specularPower;
+        material.name.resize(materialHeader.nameLength);
+        file.read(&material.name[0], materialHeader.nameLength);
+        material.diffuseMap.resize(materialHeader.diffuseMapLength);
+        file.read(&material.diffuseMap[0], materialHeader.diffuseMapLength);
+        material.bumpMap.resize(materialHeader.bumpMapLength);
+        file.read(&material.bumpMap[0], materialHeader.bumpMapLength);
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,427 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+// Mesh optimization passes run on loaded meshes before they are written to the mesh asset.
+// The expected order is WeldVertices -> OptimizeVertexCache -> OptimizeOverdraw -> OptimizeVertexFetch.
+
+struct VertexCacheStatistics
+{
+    unsigned int verticesTransformed;
+    unsigned int triangleCount;
+    unsigned int vertexCount;
+    float acmr; // average cache miss ratio, transformed vertices per triangle (best ~0.5, worst 3)
+    float atvr; // average transformed vertex ratio, transformed vertices per vertex (best 1)
+};
+
+// simulate a FIFO post-transform cache and count the vertex shader invocations
+template <typename IndexType>
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<IndexType>& indices, size_t vertexCount, unsigned int cacheSize = 16)
+{
+    VertexCacheStatistics stats = {};
+    stats.triangleCount = (unsigned int)(indices.size() / 3);
+    stats.vertexCount = (unsigned int)vertexCount;
+
+    std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+    unsigned int timestamp = cacheSize + 1;
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        unsigned int index = (unsigned int)indices[i];
+        // a vertex is in the cache if it was pushed within the last cacheSize misses
+        if (timestamp - cacheTimestamps[index] > cacheSize)
+        {
+            cacheTimestamps[index] = timestamp++;
+            stats.verticesTransformed++;
+        }
+    }
+
+    stats.acmr = stats.triangleCount == 0 ? 0.f : float(stats.verticesTransformed) / float(stats.triangleCount);
+    stats.atvr = stats.vertexCount == 0 ? 0.f : float(stats.verticesTransformed) / float(stats.vertexCount);
+    return stats;
+}
+
+// merge bitwise identical vertices, the obj loader emits a new vertex for every face corner
+// returns the number of unique vertices
+template <typename VertexType, typename IndexType>
+size_t WeldVertices(std::vector<VertexType>& vertices, std::vector<IndexType>& indices)
+{
+    struct VertexHash
+    {
+        const std::vector<VertexType>* vertices;
+        size_t operator()(unsigned int index) const
+        {
+            // FNV-1a over the vertex bytes
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&(*vertices)[index]);
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(VertexType); ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return size_t(hash);
+        }
+    };
+    struct VertexEqual
+    {
+        const std::vector<VertexType>* vertices;
+        bool operator()(unsigned int a, unsigned int b) const
+        {
+            return memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(VertexType)) == 0;
+        }
+    };
+
+    std::vector<VertexType> unique;
+    unique.reserve(vertices.size());
+
+    std::unordered_map<unsigned int, unsigned int, VertexHash, VertexEqual> lookup(
+        vertices.size(), VertexHash{ &vertices }, VertexEqual{ &vertices });
+
+    std::vector<unsigned int> remap(vertices.size());
+    for (unsigned int i = 0; i < (unsigned int)vertices.size(); ++i)
+    {
+        auto inserted = lookup.insert(std::make_pair(i, (unsigned int)unique.size()));
+        if (inserted.second)
+        {
+            unique.push_back(vertices[i]);
+        }
+        remap[i] = inserted.first->second;
+    }
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        indices[i] = IndexType(remap[(unsigned int)indices[i]]);
+    }
+    vertices.swap(unique);
+    return vertices.size();
+}
+
+// Tom Forsyth's linear-speed vertex cache optimisation, reorders triangles in place
+template <typename IndexType>
+void OptimizeVertexCache(std::vector<IndexType>& indices, size_t vertexCount)
+{
+    const int cacheSize = 32;
+    const float cacheDecayPower = 1.5f;
+    const float lastTriScore = 0.75f;
+    const float valenceBoostScale = 2.0f;
+    const float valenceBoostPower = 0.5f;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    auto vertexScore = [&](int cachePosition, unsigned int remainingTriangles) -> float
+    {
+        if (remainingTriangles == 0)
+        {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+            {
+                // the three vertices of the last triangle get a fixed score so that it is not
+                // favoured over a fresh triangle sharing two of them
+                score = lastTriScore;
+            }
+            else
+            {
+                float scaler = 1.0f / (cacheSize - 3);
+                score = powf(1.0f - (cachePosition - 3) * scaler, cacheDecayPower);
+            }
+        }
+        // bonus for vertices with few triangles left so that lone triangles get emitted early
+        score += valenceBoostScale * powf(float(remainingTriangles), -valenceBoostPower);
+        return score;
+    };
+
+    // vertex -> triangle adjacency
+    std::vector<unsigned int> triangleOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        triangleOffsets[(unsigned int)indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        triangleOffsets[v + 1] += triangleOffsets[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        adjacency[fill[(unsigned int)indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<unsigned int> remaining(vertexCount);
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        remaining[v] = triangleOffsets[v + 1] - triangleOffsets[v];
+        vertexScores[v] = vertexScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        triangleScores[t] = vertexScores[(unsigned int)indices[t * 3 + 0]] +
+            vertexScores[(unsigned int)indices[t * 3 + 1]] +
+            vertexScores[(unsigned int)indices[t * 3 + 2]];
+    }
+
+    std::vector<IndexType> output;
+    output.reserve(indices.size());
+
+    // the cache holds 3 extra slots so vertices pushed out by the new triangle can be rescored
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> newCache;
+    cache.reserve(cacheSize + 3);
+    newCache.reserve(cacheSize + 3);
+
+    size_t inputCursor = 0;
+    int bestTriangle = -1;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (bestTriangle < 0)
+        {
+            // nothing useful in the cache, take the next triangle in input order
+            while (emitted[inputCursor])
+            {
+                ++inputCursor;
+            }
+            bestTriangle = int(inputCursor);
+        }
+
+        unsigned int tri[3] = {
+            (unsigned int)indices[bestTriangle * 3 + 0],
+            (unsigned int)indices[bestTriangle * 3 + 1],
+            (unsigned int)indices[bestTriangle * 3 + 2] };
+
+        output.push_back(IndexType(tri[0]));
+        output.push_back(IndexType(tri[1]));
+        output.push_back(IndexType(tri[2]));
+        emitted[bestTriangle] = true;
+
+        // remove the triangle from the adjacency of its vertices
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = tri[k];
+            unsigned int* begin = &adjacency[triangleOffsets[v]];
+            unsigned int* end = begin + remaining[v];
+            unsigned int* found = std::find(begin, end, (unsigned int)bestTriangle);
+            if (found != end)
+            {
+                std::swap(*found, *(end - 1));
+                remaining[v]--;
+            }
+        }
+
+        // move the triangle's vertices to the front of the LRU cache
+        newCache.clear();
+        newCache.push_back(tri[0]);
+        newCache.push_back(tri[1]);
+        newCache.push_back(tri[2]);
+        for (size_t c = 0; c < cache.size(); ++c)
+        {
+            unsigned int v = cache[c];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+            {
+                newCache.push_back(v);
+            }
+        }
+        for (size_t c = cacheSize; c < newCache.size(); ++c)
+        {
+            cachePositions[newCache[c]] = -1;
+        }
+        cache.swap(newCache);
+
+        // rescore the vertices that were touched and find the best candidate among their triangles
+        float bestScore = -1.0f;
+        bestTriangle = -1;
+        for (size_t c = 0; c < cache.size(); ++c)
+        {
+            unsigned int v = cache[c];
+            int position = c < size_t(cacheSize) ? int(c) : -1;
+            cachePositions[v] = position;
+
+            float newScore = vertexScore(position, remaining[v]);
+            float delta = newScore - vertexScores[v];
+            vertexScores[v] = newScore;
+
+            for (unsigned int a = 0; a < remaining[v]; ++a)
+            {
+                unsigned int t = adjacency[triangleOffsets[v] + a];
+                triangleScores[t] += delta;
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    bestTriangle = int(t);
+                }
+            }
+        }
+        if (cache.size() > size_t(cacheSize))
+        {
+            cache.resize(cacheSize);
+        }
+    }
+
+    indices.swap(output);
+}
+
+// Reorder clusters of cache optimised triangles so that outward facing clusters are drawn first,
+// which lets the depth test reject more of the hidden surface behind them. Clusters are split where
+// the vertex cache was flushed so the cache efficiency is mostly kept, the result is only accepted
+// when the ACMR does not grow by more than the threshold (1.05 = 5% worse).
+template <typename IndexType>
+void OptimizeOverdraw(std::vector<IndexType>& indices, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride, float threshold = 1.05f)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    auto position = [&](unsigned int v) -> const float*
+    {
+        return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(vertexPositions) + v * vertexPositionsStride);
+    };
+
+    // hard boundaries, a triangle that misses the cache with all three vertices starts a new cluster
+    const unsigned int cacheSize = 16;
+    std::vector<unsigned int> clusterStarts;
+    std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+    unsigned int timestamp = cacheSize + 1;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        unsigned int misses = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = (unsigned int)indices[t * 3 + k];
+            if (timestamp - cacheTimestamps[v] > cacheSize)
+            {
+                cacheTimestamps[v] = timestamp++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+        {
+            clusterStarts.push_back((unsigned int)t);
+        }
+    }
+    clusterStarts.push_back((unsigned int)triangleCount);
+
+    size_t clusterCount = clusterStarts.size() - 1;
+    if (clusterCount <= 1)
+    {
+        return;
+    }
+
+    // mesh centroid
+    float meshCentroid[3] = { 0, 0, 0 };
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        const float* p = position((unsigned int)v);
+        meshCentroid[0] += p[0];
+        meshCentroid[1] += p[1];
+        meshCentroid[2] += p[2];
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+        meshCentroid[k] /= float(vertexCount);
+    }
+
+    // sort key: how much the cluster faces away from the mesh centre
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        float centroid[3] = { 0, 0, 0 };
+        float normal[3] = { 0, 0, 0 };
+        float area = 0;
+        for (unsigned int t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+        {
+            const float* p0 = position((unsigned int)indices[t * 3 + 0]);
+            const float* p1 = position((unsigned int)indices[t * 3 + 1]);
+            const float* p2 = position((unsigned int)indices[t * 3 + 2]);
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                // area weighted, the cross product length is twice the triangle area
+                centroid[k] += (p0[k] + p1[k] + p2[k]) * (a / 3.0f);
+                normal[k] += n[k];
+            }
+            area += a;
+        }
+        float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float key = 0;
+        if (area > 0 && normalLength > 0)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                key += (centroid[k] / area - meshCentroid[k]) * (normal[k] / normalLength);
+            }
+        }
+        sortKeys[c] = key;
+    }
+
+    std::vector<unsigned int> clusterOrder(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        clusterOrder[c] = (unsigned int)c;
+    }
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+        [&](unsigned int a, unsigned int b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<IndexType> output;
+    output.reserve(indices.size());
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        unsigned int cluster = clusterOrder[c];
+        output.insert(output.end(),
+            indices.begin() + clusterStarts[cluster] * 3,
+            indices.begin() + clusterStarts[cluster + 1] * 3);
+    }
+
+    float before = AnalyzeVertexCache(indices, vertexCount).acmr;
+    float after = AnalyzeVertexCache(output, vertexCount).acmr;
+    if (after <= before * threshold)
+    {
+        indices.swap(output);
+    }
+}
+
+// reorder vertices in the order they are first referenced so vertex fetch walks memory linearly,
+// unreferenced vertices are dropped. returns the new vertex count
+template <typename VertexType, typename IndexType>
+size_t OptimizeVertexFetch(std::vector<VertexType>& vertices, std::vector<IndexType>& indices)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<VertexType> output;
+    output.reserve(vertices.size());
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        unsigned int v = (unsigned int)indices[i];
+        if (remap[v] == unused)
+        {
+            remap[v] = (unsigned int)output.size();
+            output.push_back(vertices[v]);
+        }
+        indices[i] = IndexType(remap[v]);
+    }
+
+    vertices.swap(output);
+    return vertices.size();
+}
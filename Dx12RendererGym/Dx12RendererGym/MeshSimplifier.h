@@ -0,0 +1,352 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+// Quadric error metric simplifier used to build the LOD chain of a mesh.
+// Edges are removed by half edge collapses (u moves onto v), so the simplified index list keeps
+// referencing the original vertex buffer and every LOD can share it. Vertices on an attribute seam
+// (several vertices sharing one position, e.g. a UV seam) or on an open border are never moved,
+// which keeps seams and silhouettes intact, and collapses that flip or strongly rotate a triangle
+// are rejected so the shading normals stay valid.
+
+namespace simplify
+{
+    // symmetric 4x4 plane quadric, stored as the 10 unique coefficients
+    struct Quadric
+    {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+        void Clear()
+        {
+            a2 = ab = ac = ad = b2 = bc = bd = c2 = cd = d2 = 0;
+        }
+
+        void AddPlane(double a, double b, double c, double d)
+        {
+            a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+            b2 += b * b; bc += b * c; bd += b * d;
+            c2 += c * c; cd += c * d;
+            d2 += d * d;
+        }
+
+        void Add(const Quadric& other)
+        {
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+            b2 += other.b2; bc += other.bc; bd += other.bd;
+            c2 += other.c2; cd += other.cd;
+            d2 += other.d2;
+        }
+
+        // sum of squared distances of p to the accumulated planes
+        double Evaluate(const float* p) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+            double result = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                + c2 * z * z + 2 * cd * z
+                + d2;
+            return result > 0 ? result : 0;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double error;
+    };
+
+    inline void TriangleNormal(const float* p0, const float* p1, const float* p2, float* n)
+    {
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+}
+
+// Simplify a triangle list towards targetIndexCount. indices must reference vertexCount vertices whose
+// float3 positions start at positions with the given byte stride. Stops early when no collapse below
+// maxError (object space distance) is left. Returns the error of the result as an object space distance.
+inline float SimplifyMesh(const std::vector<uint32_t>& indices, const float* positions, size_t vertexCount, size_t stride,
+    size_t targetIndexCount, float maxError, std::vector<uint32_t>& output)
+{
+    using namespace simplify;
+
+    auto position = [&](uint32_t v) -> const float*
+    {
+        return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * stride);
+    };
+
+    output = indices;
+    if (indices.size() <= targetIndexCount)
+    {
+        return 0.0f;
+    }
+
+    // group vertices that share a position, more than one vertex in a group means an attribute seam
+    std::vector<uint32_t> positionGroup(vertexCount);
+    std::vector<uint32_t> groupSize;
+    {
+        struct PositionKey
+        {
+            float p[3];
+            bool operator==(const PositionKey& other) const { return memcmp(p, other.p, sizeof(p)) == 0; }
+        };
+        struct PositionHash
+        {
+            size_t operator()(const PositionKey& key) const
+            {
+                uint32_t bits[3];
+                memcpy(bits, key.p, sizeof(bits));
+                return size_t((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u));
+            }
+        };
+        std::unordered_map<PositionKey, uint32_t, PositionHash> groups(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; ++v)
+        {
+            PositionKey key;
+            memcpy(key.p, position(v), sizeof(key.p));
+            auto inserted = groups.insert(std::make_pair(key, uint32_t(groupSize.size())));
+            if (inserted.second)
+            {
+                groupSize.push_back(0);
+            }
+            positionGroup[v] = inserted.first->second;
+            groupSize[positionGroup[v]]++;
+        }
+    }
+
+    std::vector<bool> locked(vertexCount, false);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        locked[v] = groupSize[positionGroup[v]] > 1;
+    }
+
+    // open borders, an edge between two positions used by a single triangle
+    {
+        std::unordered_map<uint64_t, int> edgeUse(indices.size());
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint64_t a = positionGroup[indices[t + k]];
+                uint64_t b = positionGroup[indices[t + (k + 1) % 3]];
+                uint64_t key = a < b ? (a << 32) | b : (b << 32) | a;
+                edgeUse[key]++;
+            }
+        }
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t a = indices[t + k];
+                uint32_t b = indices[t + (k + 1) % 3];
+                uint64_t ga = positionGroup[a];
+                uint64_t gb = positionGroup[b];
+                uint64_t key = ga < gb ? (ga << 32) | gb : (gb << 32) | ga;
+                if (edgeUse[key] == 1)
+                {
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+            }
+        }
+    }
+
+    // plane quadrics, accumulated per vertex
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        quadrics[v].Clear();
+    }
+    for (size_t t = 0; t < indices.size(); t += 3)
+    {
+        const float* p0 = position(indices[t + 0]);
+        float n[3];
+        TriangleNormal(p0, position(indices[t + 1]), position(indices[t + 2]), n);
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0)
+        {
+            continue;
+        }
+        double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+        double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+        for (int k = 0; k < 3; ++k)
+        {
+            quadrics[indices[t + k]].AddPlane(a, b, c, d);
+        }
+    }
+
+    const double maxErrorSquared = double(maxError) * double(maxError);
+    double resultError = 0;
+
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+
+    while (output.size() > targetIndexCount)
+    {
+        size_t triangleCount = output.size() / 3;
+
+        // vertex -> triangle adjacency of the current mesh
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (size_t i = 0; i < output.size(); ++i)
+        {
+            triangleOffsets[output[i] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        }
+        adjacency.resize(output.size());
+        {
+            std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < output.size(); ++i)
+            {
+                adjacency[fill[output[i]]++] = uint32_t(i / 3);
+            }
+        }
+
+        // cheapest collapse for every edge, both directions are considered
+        collapses.clear();
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t u = output[t * 3 + k];
+                uint32_t v = output[t * 3 + (k + 1) % 3];
+                Quadric q = quadrics[u];
+                q.Add(quadrics[v]);
+                if (!locked[u])
+                {
+                    Collapse collapse = { u, v, q.Evaluate(position(v)) };
+                    collapses.push_back(collapse);
+                }
+                if (!locked[v])
+                {
+                    Collapse collapse = { v, u, q.Evaluate(position(u)) };
+                    collapses.push_back(collapse);
+                }
+            }
+        }
+        if (collapses.empty())
+        {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(),
+            [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        for (uint32_t v = 0; v < vertexCount; ++v)
+        {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+
+        // every collapse removes about two triangles
+        size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+
+        for (size_t c = 0; c < collapses.size() && removed < trianglesToRemove; ++c)
+        {
+            const Collapse& collapse = collapses[c];
+            if (collapse.error > maxErrorSquared)
+            {
+                break;
+            }
+            uint32_t u = collapse.from;
+            uint32_t v = collapse.to;
+            if (touched[u] || touched[v])
+            {
+                continue;
+            }
+
+            // reject collapses that flip or strongly rotate one of the remaining triangles around u
+            bool valid = true;
+            unsigned int collapsedTriangles = 0;
+            for (uint32_t a = triangleOffsets[u]; a < triangleOffsets[u + 1] && valid; ++a)
+            {
+                uint32_t t = adjacency[a];
+                uint32_t tri[3] = { output[t * 3 + 0], output[t * 3 + 1], output[t * 3 + 2] };
+                if (positionGroup[tri[0]] == positionGroup[v] || positionGroup[tri[1]] == positionGroup[v] || positionGroup[tri[2]] == positionGroup[v])
+                {
+                    collapsedTriangles++;
+                    continue;
+                }
+                float before[3];
+                TriangleNormal(position(tri[0]), position(tri[1]), position(tri[2]), before);
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (tri[k] == u)
+                    {
+                        tri[k] = v;
+                    }
+                }
+                float after[3];
+                TriangleNormal(position(tri[0]), position(tri[1]), position(tri[2]), after);
+                float lengthBefore = sqrtf(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+                float lengthAfter = sqrtf(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+                float dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                if (lengthAfter == 0 || dot < 0.25f * lengthBefore * lengthAfter)
+                {
+                    valid = false;
+                }
+            }
+            if (!valid || collapsedTriangles == 0)
+            {
+                continue;
+            }
+
+            // lock the one ring of u and v for the rest of this pass so the adjacency stays valid
+            for (uint32_t a = triangleOffsets[u]; a < triangleOffsets[u + 1]; ++a)
+            {
+                uint32_t t = adjacency[a];
+                touched[output[t * 3 + 0]] = touched[output[t * 3 + 1]] = touched[output[t * 3 + 2]] = true;
+            }
+            for (uint32_t a = triangleOffsets[v]; a < triangleOffsets[v + 1]; ++a)
+            {
+                uint32_t t = adjacency[a];
+                touched[output[t * 3 + 0]] = touched[output[t * 3 + 1]] = touched[output[t * 3 + 2]] = true;
+            }
+
+            remap[u] = v;
+            quadrics[v].Add(quadrics[u]);
+            resultError = std::max(resultError, collapse.error);
+            removed += collapsedTriangles;
+            applied++;
+        }
+
+        if (applied == 0)
+        {
+            break;
+        }
+
+        // apply the collapses and drop the degenerate triangles
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            uint32_t a = remap[output[t * 3 + 0]];
+            uint32_t b = remap[output[t * 3 + 1]];
+            uint32_t c = remap[output[t * 3 + 2]];
+            if (positionGroup[a] == positionGroup[b] || positionGroup[b] == positionGroup[c] || positionGroup[a] == positionGroup[c])
+            {
+                continue;
+            }
+            output[write++] = a;
+            output[write++] = b;
+            output[write++] = c;
+        }
+        output.resize(write);
+    }
+
+    return float(sqrt(resultError));
+}
@@ -0,0 +1,415 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <cmath>
+
+// Meshlets (clusters) of a triangle list, sized for mesh shaders and compute culling.
+// Every meshlet references up to MeshletMaxVertices vertices through the meshlet vertex list and stores
+// its triangles as 8 bit indices into that list. The bounding sphere and the normal cone let a culling
+// pass reject a whole meshlet that is outside the frustum or faces away from the camera.
+
+const size_t MeshletMaxVertices = 64;
+const size_t MeshletMaxTriangles = 124;
+
+struct Meshlet
+{
+    uint32_t vertexOffset;   // first entry in the meshlet vertex list
+    uint32_t triangleOffset; // first byte in the meshlet triangle list, 3 bytes per triangle
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+
+    float center[3];
+    float radius;
+
+    // the meshlet is backfacing when dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff,
+    // a cutoff of 1 disables the test for meshlets with spread out normals
+    float coneApex[3];
+    float coneAxis[3];
+    float coneCutoff;
+};
+
+struct MeshletCullingStatistics
+{
+    unsigned int meshletCount;
+    unsigned int triangleCount;
+    unsigned int frustumCulledMeshlets;
+    unsigned int backfaceCulledMeshlets;
+    unsigned int culledTriangles;
+};
+
+namespace meshlets
+{
+    inline void ComputeBounds(const uint32_t* vertices, const unsigned char* triangles, Meshlet& meshlet,
+        const float* positions, size_t stride)
+    {
+        auto position = [&](uint32_t v) -> const float*
+        {
+            return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * stride);
+        };
+
+        // sphere around the box center, a little looser than a minimal sphere but stable
+        float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            const float* p = position(vertices[i]);
+            for (int k = 0; k < 3; ++k)
+            {
+                boundsMin[k] = std::min(boundsMin[k], p[k]);
+                boundsMax[k] = std::max(boundsMax[k], p[k]);
+            }
+        }
+        float radiusSquared = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            meshlet.center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+        }
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            const float* p = position(vertices[i]);
+            float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+            radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+        }
+        meshlet.radius = sqrtf(radiusSquared);
+
+        // normal cone, the axis is the average of the unit triangle normals
+        std::vector<float> normals(meshlet.triangleCount * 3);
+        float axis[3] = { 0, 0, 0 };
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            const float* p0 = position(vertices[triangles[t * 3 + 0]]);
+            const float* p1 = position(vertices[triangles[t * 3 + 1]]);
+            const float* p2 = position(vertices[triangles[t * 3 + 2]]);
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float* n = &normals[t * 3];
+            n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            float scale = length > 0 ? 1.0f / length : 0.0f;
+            for (int k = 0; k < 3; ++k)
+            {
+                n[k] *= scale;
+                axis[k] += n[k];
+            }
+        }
+
+        for (int k = 0; k < 3; ++k)
+        {
+            meshlet.coneApex[k] = meshlet.center[k];
+            meshlet.coneAxis[k] = 0;
+        }
+        meshlet.coneCutoff = 1.0f;
+
+        float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        if (axisLength == 0)
+        {
+            return;
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            axis[k] /= axisLength;
+        }
+
+        float minDot = 1.0f;
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            const float* n = &normals[t * 3];
+            minDot = std::min(minDot, n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
+        }
+        // normals spread over more than ~84 degrees from the axis leave nothing to cull
+        if (minDot <= 0.1f)
+        {
+            return;
+        }
+
+        // move the apex back along the axis until it is behind every triangle plane, then a camera inside
+        // the cone that starts there sees the back of every triangle
+        float maxT = 0;
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            const float* n = &normals[t * 3];
+            const float* p0 = position(vertices[triangles[t * 3 + 0]]);
+            float dc = (p0[0] - meshlet.center[0]) * n[0] + (p0[1] - meshlet.center[1]) * n[1] + (p0[2] - meshlet.center[2]) * n[2];
+            float dn = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+            maxT = std::max(maxT, -dc / dn);
+        }
+
+        for (int k = 0; k < 3; ++k)
+        {
+            meshlet.coneApex[k] = meshlet.center[k] - axis[k] * maxT;
+            meshlet.coneAxis[k] = axis[k];
+        }
+        // the view direction must be within 90 degrees minus the cone half angle of the axis
+        meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+    }
+}
+
+// Split a triangle list into meshlets. Every meshlet grows from a seed triangle over its neighbours,
+// preferring triangles that add few new vertices and whose normal is close to the meshlet normal so the
+// normal cones stay narrow. coneWeight trades vertex reuse (0) for cone culling efficiency.
+inline void BuildMeshlets(const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t stride,
+    std::vector<Meshlet>& meshletList, std::vector<uint32_t>& meshletVertices, std::vector<unsigned char>& meshletTriangles,
+    float coneWeight = 0.5f)
+{
+    meshletList.clear();
+    meshletVertices.clear();
+    meshletTriangles.clear();
+
+    auto position = [&](uint32_t v) -> const float*
+    {
+        return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * stride);
+    };
+
+    size_t triangleCount = indexCount / 3;
+
+    // unit triangle normals
+    std::vector<float> normals(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const float* p0 = position(indices[t * 3 + 0]);
+        const float* p1 = position(indices[t * 3 + 1]);
+        const float* p2 = position(indices[t * 3 + 2]);
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        float* n = &normals[t * 3];
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        float scale = length > 0 ? 1.0f / length : 0.0f;
+        n[0] *= scale;
+        n[1] *= scale;
+        n[2] *= scale;
+    }
+
+    // vertex -> triangle adjacency
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        triangleOffsets[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        triangleOffsets[v + 1] += triangleOffsets[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+        {
+            adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+        }
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    // local index of every vertex in the current meshlet, 0xFF when it is not part of it
+    std::vector<unsigned char> localIndex(vertexCount, 0xFF);
+
+    Meshlet current = {};
+    float axis[3] = { 0, 0, 0 };
+    auto flush = [&]()
+    {
+        if (current.triangleCount == 0)
+        {
+            return;
+        }
+        meshlets::ComputeBounds(&meshletVertices[current.vertexOffset], &meshletTriangles[current.triangleOffset], current,
+            positions, stride);
+        for (uint32_t i = 0; i < current.vertexCount; ++i)
+        {
+            localIndex[meshletVertices[current.vertexOffset + i]] = 0xFF;
+        }
+        meshletList.push_back(current);
+        current = {};
+        current.vertexOffset = uint32_t(meshletVertices.size());
+        current.triangleOffset = uint32_t(meshletTriangles.size());
+        axis[0] = axis[1] = axis[2] = 0;
+    };
+
+    auto newVertexCount = [&](size_t t) -> unsigned int
+    {
+        return (localIndex[indices[t * 3 + 0]] == 0xFF) + (localIndex[indices[t * 3 + 1]] == 0xFF) + (localIndex[indices[t * 3 + 2]] == 0xFF);
+    };
+
+    size_t nextSeed = 0;
+    size_t remaining = triangleCount;
+    while (remaining > 0)
+    {
+        // best unemitted neighbour of the current meshlet that still fits
+        size_t best = SIZE_MAX;
+        float bestScore = FLT_MAX;
+        float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        for (uint32_t i = 0; i < current.vertexCount; ++i)
+        {
+            uint32_t v = meshletVertices[current.vertexOffset + i];
+            for (uint32_t a = triangleOffsets[v]; a < triangleOffsets[v + 1]; ++a)
+            {
+                uint32_t t = adjacency[a];
+                if (emitted[t])
+                {
+                    continue;
+                }
+                unsigned int extra = newVertexCount(t);
+                if (current.vertexCount + extra > MeshletMaxVertices)
+                {
+                    continue;
+                }
+                const float* n = &normals[t * 3];
+                float spread = axisLength > 0 ? 1.0f - (n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]) / axisLength : 0.0f;
+                float score = float(extra) + coneWeight * spread * 3.0f;
+                if (score < bestScore)
+                {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        while (emitted[nextSeed])
+        {
+            nextSeed++;
+        }
+
+        if (best == SIZE_MAX && current.triangleCount > 0 && current.triangleCount < MeshletMaxTriangles)
+        {
+            // nothing connected fits (an attribute seam or a separate part), keep filling the meshlet with the
+            // closest of the next unemitted triangles in index order, the vertex cache order keeps them nearby.
+            // The window is bounded, a nearly full meshlet fits few triangles and the scan would run to the end
+            float center[3] = { 0, 0, 0 };
+            for (uint32_t i = 0; i < current.vertexCount; ++i)
+            {
+                const float* p = position(meshletVertices[current.vertexOffset + i]);
+                center[0] += p[0];
+                center[1] += p[1];
+                center[2] += p[2];
+            }
+            float bestDistance = FLT_MAX;
+            size_t candidates = 0;
+            size_t windowEnd = std::min(triangleCount, nextSeed + 1024);
+            for (size_t t = nextSeed; t < windowEnd && candidates < 64; ++t)
+            {
+                if (emitted[t] || current.vertexCount + newVertexCount(t) > MeshletMaxVertices)
+                {
+                    continue;
+                }
+                candidates++;
+                const float* p = position(indices[t * 3]);
+                float dx = p[0] - center[0] / current.vertexCount, dy = p[1] - center[1] / current.vertexCount, dz = p[2] - center[2] / current.vertexCount;
+                float distance = dx * dx + dy * dy + dz * dz;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = t;
+                }
+            }
+        }
+
+        if (best == SIZE_MAX)
+        {
+            // the meshlet is full, start the next one at the first unemitted triangle
+            flush();
+            best = nextSeed;
+        }
+        else if (current.triangleCount + 1 > MeshletMaxTriangles)
+        {
+            flush();
+            continue;
+        }
+
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = indices[best * 3 + k];
+            if (localIndex[v] == 0xFF)
+            {
+                localIndex[v] = (unsigned char)current.vertexCount++;
+                meshletVertices.push_back(v);
+            }
+            meshletTriangles.push_back(localIndex[v]);
+            axis[k] += normals[best * 3 + k];
+        }
+        current.triangleCount++;
+        emitted[best] = true;
+        remaining--;
+    }
+    flush();
+}
+
+// Frustum planes (a, b, c, d with the normal pointing inside) of a row vector view projection matrix with
+// D3D clip space (0 <= z <= w), m is row major. Use the world view projection matrix to get object space planes.
+inline void ExtractFrustumPlanes(const float* m, float planes[6][4])
+{
+    for (int k = 0; k < 4; ++k)
+    {
+        float c0 = m[k * 4 + 0], c1 = m[k * 4 + 1], c2 = m[k * 4 + 2], c3 = m[k * 4 + 3];
+        planes[0][k] = c3 + c0; // left
+        planes[1][k] = c3 - c0; // right
+        planes[2][k] = c3 + c1; // bottom
+        planes[3][k] = c3 - c1; // top
+        planes[4][k] = c2;      // near
+        planes[5][k] = c3 - c2; // far
+    }
+    for (int p = 0; p < 6; ++p)
+    {
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        for (int k = 0; k < 4; ++k)
+        {
+            planes[p][k] /= length;
+        }
+    }
+}
+
+// CPU reference of the cluster culling a GPU pass would do. planes and cameraPosition must be in the
+// space of the meshlet bounds. visible (optional) receives one flag per meshlet.
+inline MeshletCullingStatistics CullMeshlets(const std::vector<Meshlet>& meshletList, const float planes[6][4],
+    const float* cameraPosition, std::vector<bool>* visible = nullptr)
+{
+    MeshletCullingStatistics stats = {};
+    stats.meshletCount = unsigned(meshletList.size());
+    if (visible)
+    {
+        visible->assign(meshletList.size(), true);
+    }
+
+    for (size_t i = 0; i < meshletList.size(); ++i)
+    {
+        const Meshlet& meshlet = meshletList[i];
+        stats.triangleCount += meshlet.triangleCount;
+
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p)
+        {
+            float distance = planes[p][0] * meshlet.center[0] + planes[p][1] * meshlet.center[1] + planes[p][2] * meshlet.center[2] + planes[p][3];
+            inside = distance >= -meshlet.radius;
+        }
+        if (!inside)
+        {
+            stats.frustumCulledMeshlets++;
+            stats.culledTriangles += meshlet.triangleCount;
+            if (visible)
+            {
+                (*visible)[i] = false;
+            }
+            continue;
+        }
+
+        float view[3] = { meshlet.coneApex[0] - cameraPosition[0], meshlet.coneApex[1] - cameraPosition[1], meshlet.coneApex[2] - cameraPosition[2] };
+        float viewLength = sqrtf(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]);
+        float dot = view[0] * meshlet.coneAxis[0] + view[1] * meshlet.coneAxis[1] + view[2] * meshlet.coneAxis[2];
+        if (meshlet.coneCutoff < 1.0f && dot >= meshlet.coneCutoff * viewLength)
+        {
+            stats.backfaceCulledMeshlets++;
+            stats.culledTriangles += meshlet.triangleCount;
+            if (visible)
+            {
+                (*visible)[i] = false;
+            }
+        }
+    }
+
+    return stats;
+}
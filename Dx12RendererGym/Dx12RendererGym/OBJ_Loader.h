@@ -11,6 +11,13 @@
 // String - STD String Library
 #include <string>
 
+// Unordered Map / Set - name lookups while loading
+#include <unordered_map>
+#include <unordered_set>
+
+// Utility - std::move
+#include <utility>
+
 // fStream - STD File I/O Library
 #include <fstream>
 
@@ -204,6 +211,11 @@ namespace objl
 			Vertices = _Vertices;
 			Indices = _Indices;
 		}
+		// Variable Set Constructor, takes over the lists without copying them
+		Mesh(std::vector<Vertex>&& _Vertices, std::vector<unsigned int>&& _Indices)
+			: Vertices(std::move(_Vertices)), Indices(std::move(_Indices))
+		{
+		}
 		// Mesh Name
 		std::string MeshName;
 		// Vertex List
@@ -406,6 +418,24 @@ namespace objl
 		}
 	}
 
+	// Class: MeshSink
+	//
+	// Description: Receives the meshes of LoadFile while the file
+	//	is read, so the caller can write the vertices straight into
+	//	its own layout and memory instead of the loader keeping them.
+	//	The faces of a mesh arrive one at a time, indices relative to
+	//	the first vertex of the mesh, EndMesh closes the mesh.
+	class MeshSink
+	{
+	public:
+		virtual ~MeshSink()
+		{
+
+		}
+		virtual void AddFace(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) = 0;
+		virtual void EndMesh(const std::string& name, const std::string& materialName) = 0;
+	};
+
 	// Class: Loader
 	//
 	// Description: The OBJ Model Loader
@@ -429,6 +459,50 @@ namespace objl
 		// If the file is unable to be found
 		// or unable to be loaded return false
 		bool LoadFile(std::string Path)
+		{
+			LoadedMeshes.clear();
+			LoadedVertices.clear();
+			LoadedIndices.clear();
+
+			MeshListSink sink(*this);
+			if (!LoadFile(Path, sink))
+			{
+				return false;
+			}
+
+			// Set Materials for each Mesh
+			// every mesh carries the name of the material its faces were read with, hashed lookup of the
+			// loaded materials copies that material in, names the material files do not define are dropped
+			std::unordered_map<std::string, size_t> materialIndices = MaterialIndices();
+			for (size_t i = 0; i < LoadedMeshes.size(); i++)
+			{
+				auto found = materialIndices.find(LoadedMeshes[i].MeshMaterial.name);
+				if (found != materialIndices.end())
+				{
+					LoadedMeshes[i].MeshMaterial = LoadedMaterials[found->second];
+				}
+				else
+				{
+					LoadedMeshes[i].MeshMaterial = Material();
+				}
+			}
+			return true;
+		}
+
+		// Load the materials of a .mtl file into LoadedMaterials, for
+		// readers that parse the .obj file themselves
+		//
+		// Returns false when the file cannot be read
+		bool LoadMaterialFile(std::string Path)
+		{
+			return LoadMaterials(Path);
+		}
+
+		// Load a file, the meshes go to sink and only the materials
+		// are kept in LoadedMaterials
+		//
+		// Returns false when the file cannot be read or has no faces
+		bool LoadFile(std::string Path, MeshSink& sink)
 		{
 			// If the file is not an .obj file return false
 			if (Path.substr(Path.size() - 4, 4) != ".obj")
@@ -440,24 +514,30 @@ namespace objl
 			if (!file.is_open())
 				return false;
 
-			LoadedMeshes.clear();
-			LoadedVertices.clear();
-			LoadedIndices.clear();
+			LoadedMaterials.clear();
 
 			std::vector<Vector3> Positions;
 			std::vector<Vector2> TCoords;
 			std::vector<Vector3> Normals;
 
-			std::vector<Vertex> Vertices;
-			std::vector<unsigned int> Indices;
+			// Size of the mesh being read, its faces are in the sink
+			unsigned int meshVertexCount = 0;
+			unsigned int meshIndexCount = 0;
+			unsigned int meshCount = 0;
+			// Reused for every face
+			std::vector<Vertex> vVerts;
+			std::vector<unsigned int> iIndices;
 
 			std::vector<std::string> MeshMatNames;
+			// Material of the faces being read, meshes keep its name until the materials are bound
+			std::string currentMaterial;
+			// Names of the loaded meshes and the next suffix to try per base name
+			std::unordered_set<std::string> meshNames;
+			std::unordered_map<std::string, int> meshNameSuffixes;
 
 			bool listening = false;
 			std::string meshname;
 
-			Mesh tempMesh;
-
 			#ifdef OBJL_CONSOLE_OUTPUT
 			const unsigned int outputEveryNth = 1000;
 			unsigned int outputIndicator = outputEveryNth;
@@ -476,7 +556,7 @@ namespace objl
 							<< "\t| vertices > " << Positions.size()
 							<< "\t| texcoords > " << TCoords.size()
 							<< "\t| normals > " << Normals.size()
-							<< "\t| triangles > " << (Vertices.size() / 3)
+							<< "\t| triangles > " << (meshVertexCount / 3)
 							<< (!MeshMatNames.empty() ? "\t| material: " + MeshMatNames.back() : "");
 					}
 				}
@@ -502,18 +582,12 @@ namespace objl
 					{
 						// Generate the mesh to put into the array
 
-						if (!Indices.empty() && !Vertices.empty())
+						if (meshIndexCount > 0 && meshVertexCount > 0)
 						{
 							// Create Mesh
-							tempMesh = Mesh(Vertices, Indices);
-							tempMesh.MeshName = meshname;
-
-							// Insert Mesh
-							LoadedMeshes.push_back(tempMesh);
+							EndMesh(sink, meshname, currentMaterial, meshNames, meshVertexCount, meshIndexCount, meshCount);
 
 							// Cleanup
-							Vertices.clear();
-							Indices.clear();
 							meshname.clear();
 
 							meshname = algorithm::tail(curline);
@@ -577,31 +651,21 @@ namespace objl
 				if (algorithm::firstToken(curline) == "f")
 				{
 					// Generate the vertices
-					std::vector<Vertex> vVerts;
+					vVerts.clear();
 					GenVerticesFromRawOBJ(vVerts, Positions, TCoords, Normals, curline);
 
-					// Add Vertices
-					for (int i = 0; i < int(vVerts.size()); i++)
-					{
-						Vertices.push_back(vVerts[i]);
-
-						LoadedVertices.push_back(vVerts[i]);
-					}
-
-					std::vector<unsigned int> iIndices;
-
+					iIndices.clear();
 					VertexTriangluation(iIndices, vVerts);
 
-					// Add Indices
+					// Indices relative to the mesh
 					for (int i = 0; i < int(iIndices.size()); i++)
 					{
-						unsigned int indnum = (unsigned int)((Vertices.size()) - vVerts.size()) + iIndices[i];
-						Indices.push_back(indnum);
-
-						indnum = (unsigned int)((LoadedVertices.size()) - vVerts.size()) + iIndices[i];
-						LoadedIndices.push_back(indnum);
-
+						iIndices[i] += meshVertexCount;
 					}
+
+					sink.AddFace(vVerts, iIndices);
+					meshVertexCount += (unsigned int)vVerts.size();
+					meshIndexCount += (unsigned int)iIndices.size();
 				}
 				// Get Mesh Material Name
 				if (algorithm::firstToken(curline) == "usemtl")
@@ -609,28 +673,20 @@ namespace objl
 					MeshMatNames.push_back(algorithm::tail(curline));
 
 					// Create new Mesh, if Material changes within a group
-					if (!Indices.empty() && !Vertices.empty())
+					if (meshIndexCount > 0 && meshVertexCount > 0)
 					{
-						// Create Mesh
-						tempMesh = Mesh(Vertices, Indices);
-						tempMesh.MeshName = meshname;
-						int i = 2;
-						while(1) {
-							tempMesh.MeshName = meshname + "_" + std::to_string(i);
-
-							for (auto &m : LoadedMeshes)
-								if (m.MeshName == tempMesh.MeshName)
-									continue;
-							break;
-						}
-
-						// Insert Mesh
-						LoadedMeshes.push_back(tempMesh);
+						// the part of the group before the switch gets the first free name_2, name_3, ...
+						int& suffix = meshNameSuffixes.insert(std::make_pair(meshname, 2)).first->second;
+						std::string uniqueName;
+						do
+						{
+							uniqueName = meshname + "_" + std::to_string(suffix++);
+						} while (meshNames.count(uniqueName) != 0);
 
-						// Cleanup
-						Vertices.clear();
-						Indices.clear();
+						// Create Mesh
+						EndMesh(sink, uniqueName, currentMaterial, meshNames, meshVertexCount, meshIndexCount, meshCount);
 					}
+					currentMaterial = MeshMatNames.back();
 
 					#ifdef OBJL_CONSOLE_OUTPUT
 					outputIndicator = 0;
@@ -673,43 +729,26 @@ namespace objl
 
 			// Deal with last mesh
 
-			if (!Indices.empty() && !Vertices.empty())
+			if (meshIndexCount > 0 && meshVertexCount > 0)
 			{
 				// Create Mesh
-				tempMesh = Mesh(Vertices, Indices);
-				tempMesh.MeshName = meshname;
-
-				// Insert Mesh
-				LoadedMeshes.push_back(tempMesh);
+				EndMesh(sink, meshname, currentMaterial, meshNames, meshVertexCount, meshIndexCount, meshCount);
 			}
 
 			file.close();
 
-			// Set Materials for each Mesh
-			for (int i = 0; i < MeshMatNames.size(); i++)
-			{
-				std::string matname = MeshMatNames[i];
-
-				// Find corresponding material name in loaded materials
-				// when found copy material variables into mesh material
-				for (int j = 0; j < LoadedMaterials.size(); j++)
-				{
-					if (LoadedMaterials[j].name == matname)
-					{
-						LoadedMeshes[i].MeshMaterial = LoadedMaterials[j];
-						break;
-					}
-				}
-			}
+			return meshCount > 0;
+		}
 
-			if (LoadedMeshes.empty() && LoadedVertices.empty() && LoadedIndices.empty())
-			{
-				return false;
-			}
-			else
+		// Index of every loaded material by name
+		std::unordered_map<std::string, size_t> MaterialIndices() const
+		{
+			std::unordered_map<std::string, size_t> materialIndices;
+			for (size_t j = 0; j < LoadedMaterials.size(); j++)
 			{
-				return true;
+				materialIndices.insert(std::make_pair(LoadedMaterials[j].name, j));
 			}
+			return materialIndices;
 		}
 
 		// Loaded Mesh Objects
@@ -721,7 +760,60 @@ namespace objl
 		// Loaded Material Objects
 		std::vector<Material> LoadedMaterials;
 
+		// Faces without normals get their unit face normal, false
+		// leaves them at zero for a smoothing pass later on
+		// (GenerateSmoothNormals)
+		bool FlatNormalsWhenMissing = true;
+
 	private:
+		// The sink of LoadFile(Path), keeps the meshes in LoadedMeshes
+		// and every vertex and index once more in LoadedVertices and
+		// LoadedIndices
+		class MeshListSink : public MeshSink
+		{
+		public:
+			MeshListSink(Loader& iLoader) : loader(iLoader)
+			{
+
+			}
+			void AddFace(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) override
+			{
+				unsigned int loadedBase = (unsigned int)(loader.LoadedVertices.size() - Vertices.size());
+				Vertices.insert(Vertices.end(), vertices.begin(), vertices.end());
+				loader.LoadedVertices.insert(loader.LoadedVertices.end(), vertices.begin(), vertices.end());
+				for (size_t i = 0; i < indices.size(); i++)
+				{
+					Indices.push_back(indices[i]);
+					loader.LoadedIndices.push_back(loadedBase + indices[i]);
+				}
+			}
+			// Move the vertices and indices read so far into a new mesh, they are left empty
+			void EndMesh(const std::string& name, const std::string& materialName) override
+			{
+				loader.LoadedMeshes.emplace_back(std::move(Vertices), std::move(Indices));
+				loader.LoadedMeshes.back().MeshName = name;
+				loader.LoadedMeshes.back().MeshMaterial.name = materialName;
+
+				Vertices.clear();
+				Indices.clear();
+			}
+
+		private:
+			Loader& loader;
+			std::vector<Vertex> Vertices;
+			std::vector<unsigned int> Indices;
+		};
+
+		void EndMesh(MeshSink& sink, const std::string& name, const std::string& materialName, std::unordered_set<std::string>& meshNames,
+			unsigned int& meshVertexCount, unsigned int& meshIndexCount, unsigned int& meshCount)
+		{
+			sink.EndMesh(name, materialName);
+			meshNames.insert(name);
+			meshVertexCount = 0;
+			meshIndexCount = 0;
+			meshCount++;
+		}
+
 		// Generate vertices from a list of positions, 
 		//	tcoords, normals and a face line
 		void GenVerticesFromRawOBJ(std::vector<Vertex>& oVerts,
@@ -817,14 +909,23 @@ namespace objl
 			}
 
 			// take care of missing normals
-			// these may not be truly acurate but it is the 
-			// best they get for not compiling a mesh with normals	
+			// the face normal of the whole polygon (Newell's method),
+			// facing the side its vertices wind counter clockwise on
 			if (noNormal)
 			{
-				Vector3 A = oVerts[0].Position - oVerts[1].Position;
-				Vector3 B = oVerts[2].Position - oVerts[1].Position;
-
-				Vector3 normal = math::CrossV3(A, B);
+				Vector3 normal;
+				if (FlatNormalsWhenMissing)
+				{
+					for (int i = 0; i < int(oVerts.size()); i++)
+					{
+						// relative to the first vertex, far from the origin the products lose the precision otherwise
+						Vector3 a = oVerts[i].Position - oVerts[0].Position;
+						Vector3 b = oVerts[(i + 1) % oVerts.size()].Position - oVerts[0].Position;
+						normal = normal + math::CrossV3(a, b);
+					}
+					float length = math::MagnitudeV3(normal);
+					normal = length > 0 ? normal / length : Vector3();
+				}
 
 				for (int i = 0; i < int(oVerts.size()); i++)
 				{
@@ -0,0 +1,184 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "OBJ_Loader.h"
+#include "MeshAsset.h"
+
+// Materials of an OBJ scene. Every group or usemtl split of the file is one mesh of the asset, the MTL
+// materials they use are collected into a compact table in first use order and each mesh gets the index
+// of its entry. Meshes without a material, or with one the MTL file does not define, share the default
+// material, which has an empty name. Texture maps are relative to the OBJ file, the table stores them
+// with its directory in front so the renderer can open them as they are.
+
+const uint32_t NoMaterialTexture = 0xffffffff;
+
+// directory part of path including the trailing separator, empty for a file in the working directory
+inline std::string ObjDirectory(const std::string& path)
+{
+    size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+}
+
+inline std::string ObjTexturePath(const std::string& directory, const std::string& map)
+{
+    if (map.empty())
+    {
+        return map;
+    }
+    // absolute paths and drive letters are kept
+    bool absolute = map[0] == '/' || map[0] == '\\' || (map.size() > 1 && map[1] == ':');
+    return absolute ? map : directory + map;
+}
+
+inline MeshAssetMaterial ConvertObjMaterial(const objl::Material& source, const std::string& directory)
+{
+    MeshAssetMaterial material;
+    material.name = source.name;
+    material.diffuse[0] = source.Kd.X;
+    material.diffuse[1] = source.Kd.Y;
+    material.diffuse[2] = source.Kd.Z;
+    material.specular[0] = source.Ks.X;
+    material.specular[1] = source.Ks.Y;
+    material.specular[2] = source.Ks.Z;
+    // Ns 0 would turn every highlight into a flat specular color
+    material.specularPower = source.Ns > 0.0f ? source.Ns : material.specularPower;
+    material.diffuseMap = ObjTexturePath(directory, source.map_Kd);
+    material.bumpMap = ObjTexturePath(directory, source.map_bump);
+    return material;
+}
+
+// meshMaterials gets the table index of every mesh by the material name it was read with, names the
+// loader has no material for and empty ones go to defaultMaterial
+inline void BuildObjMaterialTable(const objl::Loader& loader, const std::vector<std::string>& meshMaterialNames, const std::string& directory,
+    const MeshAssetMaterial& defaultMaterial, std::vector<MeshAssetMaterial>& materials, std::vector<uint32_t>& meshMaterials)
+{
+    materials.clear();
+    meshMaterials.clear();
+    meshMaterials.reserve(meshMaterialNames.size());
+
+    std::unordered_map<std::string, size_t> loaded = loader.MaterialIndices();
+    std::unordered_map<std::string, uint32_t> indices;
+    for (size_t i = 0; i < meshMaterialNames.size(); ++i)
+    {
+        auto source = loaded.find(meshMaterialNames[i]);
+        // every undefined name is the default material
+        const std::string& name = source != loaded.end() ? meshMaterialNames[i] : std::string();
+        auto found = indices.find(name);
+        if (found == indices.end())
+        {
+            found = indices.insert(std::make_pair(name, uint32_t(materials.size()))).first;
+            if (name.empty())
+            {
+                materials.push_back(defaultMaterial);
+                materials.back().name.clear();
+            }
+            else
+            {
+                materials.push_back(ConvertObjMaterial(loader.LoadedMaterials[source->second], directory));
+            }
+        }
+        meshMaterials.push_back(found->second);
+    }
+}
+
+// the same for the meshes objl::Loader::LoadFile(Path) kept
+inline void BuildObjMaterialTable(const objl::Loader& loader, const std::string& directory, const MeshAssetMaterial& defaultMaterial,
+    std::vector<MeshAssetMaterial>& materials, std::vector<uint32_t>& meshMaterials)
+{
+    std::vector<std::string> names;
+    names.reserve(loader.LoadedMeshes.size());
+    for (size_t i = 0; i < loader.LoadedMeshes.size(); ++i)
+    {
+        names.push_back(loader.LoadedMeshes[i].MeshMaterial.name);
+    }
+    BuildObjMaterialTable(loader, names, directory, defaultMaterial, materials, meshMaterials);
+}
+
+// Collects the meshes of objl::Loader::LoadFile(Path, sink) in the caller's vertex layout while the file is
+// read. ConvertVertex builds a VertexType from a loader vertex, the loader itself keeps nothing.
+template <typename VertexType>
+class ObjMeshCollector : public objl::MeshSink
+{
+public:
+    typedef VertexType (*ConvertVertex)(const objl::Vertex&);
+
+    struct Mesh
+    {
+        std::string name;
+        std::string materialName;
+        std::vector<VertexType> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    explicit ObjMeshCollector(ConvertVertex convertVertex) : convert(convertVertex) {}
+
+    void AddFace(const std::vector<objl::Vertex>& faceVertices, const std::vector<unsigned int>& faceIndices) override
+    {
+        for (size_t i = 0; i < faceVertices.size(); ++i)
+        {
+            current.vertices.push_back(convert(faceVertices[i]));
+        }
+        current.indices.insert(current.indices.end(), faceIndices.begin(), faceIndices.end());
+    }
+
+    void EndMesh(const std::string& name, const std::string& materialName) override
+    {
+        current.name = name;
+        current.materialName = materialName;
+        meshes.push_back(std::move(current));
+        current = Mesh();
+    }
+
+    std::vector<std::string> MaterialNames() const
+    {
+        std::vector<std::string> names;
+        names.reserve(meshes.size());
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            names.push_back(meshes[i].materialName);
+        }
+        return names;
+    }
+
+    std::vector<Mesh> meshes;
+
+private:
+    ConvertVertex convert;
+    Mesh current;
+};
+
+// The distinct texture files of materials, each one listed once however many materials use it.
+// diffuseTextures and bumpTextures get the index into textures per material, NoMaterialTexture for none.
+inline void BuildMaterialTextureList(const std::vector<MeshAssetMaterial>& materials, std::vector<std::string>& textures,
+    std::vector<uint32_t>& diffuseTextures, std::vector<uint32_t>& bumpTextures)
+{
+    textures.clear();
+    diffuseTextures.assign(materials.size(), NoMaterialTexture);
+    bumpTextures.assign(materials.size(), NoMaterialTexture);
+
+    std::unordered_map<std::string, uint32_t> indices;
+    auto textureIndex = [&](const std::string& path)
+    {
+        if (path.empty())
+        {
+            return NoMaterialTexture;
+        }
+        auto found = indices.find(path);
+        if (found != indices.end())
+        {
+            return found->second;
+        }
+        uint32_t index = uint32_t(textures.size());
+        indices.insert(std::make_pair(path, index));
+        textures.push_back(path);
+        return index;
+    };
+
+    for (size_t i = 0; i < materials.size(); ++i)
+    {
+        diffuseTextures[i] = textureIndex(materials[i].diffuseMap);
+        bumpTextures[i] = textureIndex(materials[i].bumpMap);
+    }
+}
@@ -0,0 +1,782 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+// Out of core OBJ conversion for scans and scenes larger than the memory the converter may use. The file is
+// read three times, never held:
+//  1. the v, vt and vn lines go to three temporary attribute files, the faces, fan triangulated and with
+//     their indices resolved, to a fourth, and the position bounds are taken on the way
+//  2. the faces are read back in order, their corners looked up through a small cache of attribute blocks,
+//     and every triangle goes to the cell of a grid over the bounds its centroid is in. Each cell is a
+//     chunk, the triangles wait in memory per chunk and the largest chunks are written to a spill file as
+//     blocks whenever the waiting triangles exceed their share of the budget
+//  3. chunks with more triangles than fit the budget are split in two at the mean centroid along their
+//     longest side, streaming their blocks back from the spill file, until every chunk fits
+// ForEachChunk then hands the chunks over one at a time, so the consumer only ever holds one of them.
+//
+// The chunks replace the groups of the file: a chunk has the triangles of every material in its cell and
+// each triangle carries the index of its usemtl name. Triangles are independent, vertices on chunk borders
+// are duplicated and anything that welds or smooths only sees the chunk it runs on. Corners without a
+// texture coordinate get (0, 0), corners without a normal a zero normal for GenerateSmoothNormals to fill.
+
+struct ObjStreamCorner
+{
+    float pos[3];
+    float texCoord[2];
+    float normal[3];
+};
+
+struct ObjStreamTriangle
+{
+    ObjStreamCorner corners[3];
+    uint32_t material;  // index into ObjChunkStream::MaterialNames
+};
+
+struct ObjStreamSettings
+{
+    uint64_t memoryBudget = 256ull << 20;   // bytes the conversion may hold at once, the consumer's share included
+    size_t consumerBytesPerTriangle = 640;  // what ForEachChunk's callback needs per triangle on top of the chunk
+};
+
+struct ObjStreamStatistics
+{
+    uint64_t positions;
+    uint64_t texCoords;
+    uint64_t normals;
+    uint64_t triangles;
+    uint64_t skippedFaces;      // faces with fewer than three corners or indices outside the file
+    uint64_t gridCells;
+    uint64_t chunks;            // chunks with triangles once the splitting is done
+    uint64_t splitChunks;
+    uint64_t maxChunkTriangles; // the most triangles ForEachChunk hands over at once
+    uint64_t spilledBytes;      // written to the spill file, splits included
+    uint64_t attributeReads;
+    uint64_t attributeMisses;   // attribute blocks read from disk
+};
+
+namespace objstream
+{
+    // appends fixed size records to a file through one buffer
+    class RecordWriter
+    {
+    public:
+        bool Open(const std::string& path, size_t bufferBytes)
+        {
+            file.open(path, std::ios::binary | std::ios::trunc);
+            buffer.reserve(bufferBytes);
+            return file.good();
+        }
+
+        void Append(const void* data, size_t size)
+        {
+            if (buffer.size() + size > buffer.capacity())
+            {
+                Flush();
+            }
+            const char* bytes = static_cast<const char*>(data);
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+
+        bool Close()
+        {
+            Flush();
+            file.close();
+            std::vector<char>().swap(buffer);
+            return !file.fail();
+        }
+
+    private:
+        void Flush()
+        {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+
+        std::ofstream file;
+        std::vector<char> buffer;
+    };
+
+    // random reads of float records through a direct mapped cache of blocks
+    class RecordCache
+    {
+    public:
+        bool Open(const std::string& path, uint64_t recordCount, size_t recordFloats, size_t cacheBytes)
+        {
+            floats = recordFloats;
+            count = recordCount;
+            blockRecords = 4096;
+            size_t blockBytes = blockRecords * floats * sizeof(float);
+            size_t slots = std::max<size_t>(cacheBytes / blockBytes, 1);
+            data.assign(slots * blockRecords * floats, 0.0f);
+            tags.assign(slots, ~0ull);
+            file.open(path, std::ios::binary);
+            return file.good();
+        }
+
+        const float* Get(uint64_t index, ObjStreamStatistics& stats)
+        {
+            uint64_t block = index / blockRecords;
+            size_t slot = size_t(block % tags.size());
+            float* slotData = &data[slot * blockRecords * floats];
+            stats.attributeReads++;
+            if (tags[slot] != block)
+            {
+                uint64_t first = block * blockRecords;
+                size_t records = size_t(std::min<uint64_t>(blockRecords, count - first));
+                file.clear();
+                file.seekg(std::streamoff(first * floats * sizeof(float)));
+                file.read(reinterpret_cast<char*>(slotData), records * floats * sizeof(float));
+                tags[slot] = block;
+                stats.attributeMisses++;
+            }
+            return slotData + size_t(index - block * blockRecords) * floats;
+        }
+
+        bool Failed() const { return file.bad(); }
+
+        void Close()
+        {
+            file.close();
+            std::vector<float>().swap(data);
+            std::vector<uint64_t>().swap(tags);
+        }
+
+    private:
+        std::ifstream file;
+        std::vector<float> data;
+        std::vector<uint64_t> tags;
+        uint64_t count = 0;
+        size_t floats = 0;
+        size_t blockRecords = 0;
+    };
+
+    // a face corner as the file wrote it, attribute indices are 0 based once resolved and None when missing
+    struct FaceRecord
+    {
+        uint32_t position[3];
+        uint32_t texCoord[3];
+        uint32_t normal[3];
+        uint32_t material;
+    };
+    const uint32_t None = 0xffffffff;
+
+    inline const char* SkipSpaces(const char* c)
+    {
+        while (*c == ' ' || *c == '\t')
+        {
+            c++;
+        }
+        return c;
+    }
+
+    // the rest of the line without surrounding white space
+    inline std::string Argument(const char* c)
+    {
+        c = SkipSpaces(c);
+        const char* end = c + strlen(c);
+        while (end > c && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        {
+            end--;
+        }
+        return std::string(c, end);
+    }
+
+    inline int ParseFloats(const char* c, float* values, int maxCount)
+    {
+        int parsed = 0;
+        while (parsed < maxCount)
+        {
+            char* end;
+            float value = strtof(c, &end);
+            if (end == c)
+            {
+                break;
+            }
+            values[parsed++] = value;
+            c = end;
+        }
+        return parsed;
+    }
+
+    // OBJ index to 0 based, relative ones count back from the end, None when missing or outside the file
+    inline uint32_t ResolveIndex(long long index, uint64_t count)
+    {
+        if (index > 0 && uint64_t(index) <= count)
+        {
+            return uint32_t(index - 1);
+        }
+        if (index < 0 && uint64_t(-index) <= count)
+        {
+            return uint32_t(count - uint64_t(-index));
+        }
+        return None;
+    }
+
+    struct Bounds
+    {
+        float min[3];
+        float max[3];
+
+        void Reset()
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                min[k] = INFINITY;
+                max[k] = -INFINITY;
+            }
+        }
+
+        void Add(const float* p)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                min[k] = std::min(min[k], p[k]);
+                max[k] = std::max(max[k], p[k]);
+            }
+        }
+    };
+
+    inline void Centroid(const ObjStreamTriangle& triangle, float* centroid)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            centroid[k] = (triangle.corners[0].pos[k] + triangle.corners[1].pos[k] + triangle.corners[2].pos[k]) * (1.0f / 3.0f);
+        }
+    }
+}
+
+class ObjChunkStream
+{
+public:
+    explicit ObjChunkStream(const ObjStreamSettings& streamSettings) : settings(streamSettings) {}
+
+    ~ObjChunkStream()
+    {
+        spill.close();
+        if (!tempPath.empty())
+        {
+            std::remove((tempPath + ".spill").c_str());
+        }
+    }
+
+    // reads the OBJ and leaves its triangles partitioned in the spill file, tempPath is the prefix of the
+    // temporary files, which need about 2.5 times the size of the OBJ while they exist
+    bool Open(const std::string& objPath, const std::string& temporaryPath)
+    {
+        tempPath = temporaryPath;
+        stats = {};
+        bool ok = ReadObj(objPath) && Distribute() && Partition();
+        for (const char* suffix : { ".v", ".vt", ".vn", ".faces" })
+        {
+            std::remove((tempPath + suffix).c_str());
+        }
+        return ok;
+    }
+
+    // calls chunk with the triangles of every chunk in turn, never more than Statistics().maxChunkTriangles
+    // at once, so chunks that could not be split are handed over in pieces. Stops at the first false.
+    // Can run again, the partition stays until the stream is destroyed.
+    bool ForEachChunk(const std::function<bool(std::vector<ObjStreamTriangle>&)>& chunk)
+    {
+        std::vector<ObjStreamTriangle> triangles;
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            if (!chunks[c].leaf || chunks[c].triangleCount == 0)
+            {
+                continue;
+            }
+            for (const Block& block : chunks[c].blocks)
+            {
+                uint64_t read = 0;
+                while (read < block.count)
+                {
+                    size_t piece = size_t(std::min<uint64_t>(block.count - read, maxChunkTriangles - triangles.size()));
+                    size_t first = triangles.size();
+                    triangles.resize(first + piece);
+                    if (!ReadSpill(block.offset + read * sizeof(ObjStreamTriangle), &triangles[first], piece))
+                    {
+                        return false;
+                    }
+                    read += piece;
+                    if (triangles.size() == maxChunkTriangles && !EmitChunk(chunk, triangles))
+                    {
+                        return false;
+                    }
+                }
+            }
+            if (!triangles.empty() && !EmitChunk(chunk, triangles))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // usemtl names in first use order, entry 0 is the empty name of triangles before any usemtl
+    const std::vector<std::string>& MaterialNames() const { return materialNames; }
+    const std::vector<std::string>& MaterialLibraries() const { return materialLibraries; }
+    // bounds of the corners the triangles have, positions no face uses do not widen them, so they are the
+    // union of the bounds of the meshes converted from the chunks
+    const float* BoundsMin() const { return cornerBounds.min; }
+    const float* BoundsMax() const { return cornerBounds.max; }
+    const ObjStreamStatistics& Statistics() const { return stats; }
+    const std::string& Error() const { return error; }
+
+private:
+    struct Block
+    {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    struct Chunk
+    {
+        objstream::Bounds centroids;
+        double centroidSum[3] = { 0.0, 0.0, 0.0 };
+        std::vector<ObjStreamTriangle> pending;
+        std::vector<Block> blocks;
+        uint64_t triangleCount = 0;
+        uint32_t depth = 0;
+        bool leaf = true;
+    };
+
+    // the budget split between the attribute caches, the triangles waiting for the spill file and the chunk
+    // handed to the consumer with everything it builds from it
+    uint64_t CacheBytes() const { return settings.memoryBudget / 8; }
+    uint64_t PendingBytes() const { return settings.memoryBudget / 4; }
+
+    bool Fail(const std::string& message)
+    {
+        error = message;
+        return false;
+    }
+
+    // **Pass 1**
+    bool ReadObj(const std::string& objPath)
+    {
+        using namespace objstream;
+
+        std::ifstream file(objPath, std::ios::binary);
+        if (!file)
+        {
+            return Fail("cannot open " + objPath);
+        }
+        RecordWriter positions, texCoords, normals, faces;
+        size_t bufferBytes = size_t(std::min<uint64_t>(CacheBytes() / 4, 4 << 20));
+        if (!positions.Open(tempPath + ".v", bufferBytes) || !texCoords.Open(tempPath + ".vt", bufferBytes) ||
+            !normals.Open(tempPath + ".vn", bufferBytes) || !faces.Open(tempPath + ".faces", bufferBytes))
+        {
+            return Fail("cannot create the temporary files at " + tempPath);
+        }
+
+        materialNames.assign(1, std::string());
+        materialLibraries.clear();
+        std::unordered_map<std::string, uint32_t> materialIndices;
+        materialIndices[std::string()] = 0;
+        uint32_t material = 0;
+        bounds.Reset();
+
+        std::string line;
+        std::vector<long long> corners;
+        std::vector<uint32_t> resolved;
+        while (std::getline(file, line))
+        {
+            const char* c = SkipSpaces(line.c_str());
+            if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t'))
+            {
+                float p[3] = { 0.0f, 0.0f, 0.0f };
+                ParseFloats(c + 2, p, 3);
+                positions.Append(p, sizeof(p));
+                bounds.Add(p);
+                stats.positions++;
+            }
+            else if (c[0] == 'v' && c[1] == 't')
+            {
+                float t[2] = { 0.0f, 0.0f };
+                ParseFloats(c + 2, t, 2);
+                texCoords.Append(t, sizeof(t));
+                stats.texCoords++;
+            }
+            else if (c[0] == 'v' && c[1] == 'n')
+            {
+                float n[3] = { 0.0f, 0.0f, 0.0f };
+                ParseFloats(c + 2, n, 3);
+                normals.Append(n, sizeof(n));
+                stats.normals++;
+            }
+            else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t'))
+            {
+                // v, v/vt, v//vn or v/vt/vn per corner, 0 for a missing attribute
+                corners.clear();
+                c += 2;
+                while (*(c = SkipSpaces(c)) != 0 && *c != '\r')
+                {
+                    long long index[3] = { 0, 0, 0 };
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        char* end;
+                        index[k] = strtoll(c, &end, 10);
+                        c = end;
+                        if (*c != '/')
+                        {
+                            break;
+                        }
+                        c++;
+                    }
+                    while (*c != 0 && *c != ' ' && *c != '\t' && *c != '\r')
+                    {
+                        c++;
+                    }
+                    corners.insert(corners.end(), index, index + 3);
+                }
+
+                size_t cornerCount = corners.size() / 3;
+                FaceRecord face;
+                face.material = material;
+                bool valid = cornerCount >= 3;
+                resolved.resize(corners.size());
+                for (size_t i = 0; i < cornerCount && valid; ++i)
+                {
+                    resolved[i * 3] = ResolveIndex(corners[i * 3], stats.positions);
+                    resolved[i * 3 + 1] = ResolveIndex(corners[i * 3 + 1], stats.texCoords);
+                    resolved[i * 3 + 2] = ResolveIndex(corners[i * 3 + 2], stats.normals);
+                    valid = resolved[i * 3] != None &&
+                        (corners[i * 3 + 1] == 0 || resolved[i * 3 + 1] != None) &&
+                        (corners[i * 3 + 2] == 0 || resolved[i * 3 + 2] != None);
+                }
+                if (!valid)
+                {
+                    stats.skippedFaces++;
+                    continue;
+                }
+                // polygons become fans around their first corner
+                for (size_t i = 1; i + 1 < cornerCount; ++i)
+                {
+                    size_t fan[3] = { 0, i, i + 1 };
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        face.position[k] = resolved[fan[k] * 3];
+                        face.texCoord[k] = resolved[fan[k] * 3 + 1];
+                        face.normal[k] = resolved[fan[k] * 3 + 2];
+                    }
+                    faces.Append(&face, sizeof(face));
+                    stats.triangles++;
+                }
+            }
+            else if (strncmp(c, "usemtl", 6) == 0)
+            {
+                std::string name = Argument(c + 6);
+                auto found = materialIndices.find(name);
+                if (found == materialIndices.end())
+                {
+                    found = materialIndices.insert(std::make_pair(name, uint32_t(materialNames.size()))).first;
+                    materialNames.push_back(name);
+                }
+                material = found->second;
+            }
+            else if (strncmp(c, "mtllib", 6) == 0)
+            {
+                materialLibraries.push_back(Argument(c + 6));
+            }
+        }
+
+        bool written = positions.Close() & texCoords.Close() & normals.Close() & faces.Close();
+        if (!written)
+        {
+            return Fail("cannot write the temporary files at " + tempPath);
+        }
+        if (stats.triangles == 0)
+        {
+            return Fail(objPath + " has no faces");
+        }
+        return true;
+    }
+
+    // **Pass 2**
+    bool Distribute()
+    {
+        using namespace objstream;
+
+        uint64_t chunkBytes = settings.memoryBudget - CacheBytes() - PendingBytes();
+        maxChunkTriangles = size_t(std::max<uint64_t>(chunkBytes / (settings.consumerBytesPerTriangle + sizeof(ObjStreamTriangle)), 1024));
+        stats.maxChunkTriangles = maxChunkTriangles;
+
+        // a cell per chunk the triangles need, surfaces leave part of the cells empty and the rest below
+        // the chunk size, Partition splits the ones that end up too full
+        uint64_t cellTarget = std::min<uint64_t>((stats.triangles + maxChunkTriangles - 1) / maxChunkTriangles, 4096);
+        float extent[3];
+        float diagonal = 0.0f;
+        for (int k = 0; k < 3; ++k)
+        {
+            extent[k] = bounds.max[k] - bounds.min[k];
+            diagonal += extent[k] * extent[k];
+        }
+        diagonal = std::sqrt(diagonal);
+        // flat scenes get cells over their plane, not one thin slab
+        float volume = 1.0f;
+        for (int k = 0; k < 3; ++k)
+        {
+            volume *= std::max(extent[k], diagonal * 1e-3f);
+        }
+        float cellSize = std::cbrt(volume / float(cellTarget));
+        for (int k = 0; k < 3; ++k)
+        {
+            gridSize[k] = cellSize > 0.0f ? std::max(1, std::min(4096, int(std::ceil(extent[k] / cellSize)))) : 1;
+            cellScale[k] = extent[k] > 0.0f ? float(gridSize[k]) / extent[k] : 0.0f;
+        }
+        stats.gridCells = uint64_t(gridSize[0]) * gridSize[1] * gridSize[2];
+        chunks.assign(size_t(stats.gridCells), Chunk());
+        for (Chunk& chunk : chunks)
+        {
+            chunk.centroids.Reset();
+        }
+
+        spill.open(tempPath + ".spill", std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        spillEnd = 0;
+        pendingTriangles = 0;
+        if (!spill)
+        {
+            return Fail("cannot create " + tempPath + ".spill");
+        }
+
+        RecordCache positions, texCoords, normals;
+        uint64_t cacheBytes = CacheBytes() / 2;
+        if (!positions.Open(tempPath + ".v", stats.positions, 3, size_t(cacheBytes / 2)) ||
+            !texCoords.Open(tempPath + ".vt", stats.texCoords, 2, size_t(cacheBytes / 4)) ||
+            !normals.Open(tempPath + ".vn", stats.normals, 3, size_t(cacheBytes / 4)))
+        {
+            return Fail("cannot reopen the attribute files at " + tempPath);
+        }
+
+        std::ifstream faces(tempPath + ".faces", std::ios::binary);
+        cornerBounds.Reset();
+        std::vector<FaceRecord> batch(size_t(std::max<uint64_t>(CacheBytes() / 2 / sizeof(FaceRecord), 1)));
+        uint64_t remaining = stats.triangles;
+        while (remaining > 0)
+        {
+            size_t count = size_t(std::min<uint64_t>(remaining, batch.size()));
+            if (!faces.read(reinterpret_cast<char*>(batch.data()), count * sizeof(FaceRecord)))
+            {
+                return Fail("cannot read " + tempPath + ".faces");
+            }
+            remaining -= count;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const FaceRecord& face = batch[i];
+                ObjStreamTriangle triangle;
+                triangle.material = face.material;
+                for (int k = 0; k < 3; ++k)
+                {
+                    ObjStreamCorner& corner = triangle.corners[k];
+                    memcpy(corner.pos, positions.Get(face.position[k], stats), sizeof(corner.pos));
+                    cornerBounds.Add(corner.pos);
+                    if (face.texCoord[k] != None)
+                    {
+                        memcpy(corner.texCoord, texCoords.Get(face.texCoord[k], stats), sizeof(corner.texCoord));
+                    }
+                    else
+                    {
+                        corner.texCoord[0] = corner.texCoord[1] = 0.0f;
+                    }
+                    if (face.normal[k] != None)
+                    {
+                        memcpy(corner.normal, normals.Get(face.normal[k], stats), sizeof(corner.normal));
+                    }
+                    else
+                    {
+                        corner.normal[0] = corner.normal[1] = corner.normal[2] = 0.0f;
+                    }
+                }
+
+                float centroid[3];
+                Centroid(triangle, centroid);
+                size_t cell = 0;
+                for (int k = 2; k >= 0; --k)
+                {
+                    int coordinate = int((centroid[k] - bounds.min[k]) * cellScale[k]);
+                    cell = cell * size_t(gridSize[k]) + size_t(std::max(0, std::min(gridSize[k] - 1, coordinate)));
+                }
+                if (!AddToChunk(cell, triangle, centroid))
+                {
+                    return false;
+                }
+            }
+        }
+
+        bool failed = positions.Failed() || texCoords.Failed() || normals.Failed();
+        positions.Close();
+        texCoords.Close();
+        normals.Close();
+        if (failed)
+        {
+            return Fail("cannot read the attribute files at " + tempPath);
+        }
+        return FlushPending(0);
+    }
+
+    bool AddToChunk(size_t chunkIndex, const ObjStreamTriangle& triangle, const float* centroid)
+    {
+        Chunk& chunk = chunks[chunkIndex];
+        chunk.pending.push_back(triangle);
+        chunk.centroids.Add(centroid);
+        for (int k = 0; k < 3; ++k)
+        {
+            chunk.centroidSum[k] += centroid[k];
+        }
+        chunk.triangleCount++;
+        pendingTriangles++;
+        if (pendingTriangles * sizeof(ObjStreamTriangle) > PendingBytes())
+        {
+            // the largest chunks go first so the blocks stay large
+            return FlushPending(PendingBytes() / 2 / sizeof(ObjStreamTriangle));
+        }
+        return true;
+    }
+
+    // writes the waiting triangles of the largest chunks to the spill file until at most keep triangles wait
+    bool FlushPending(uint64_t keep)
+    {
+        std::vector<size_t> order;
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            if (!chunks[c].pending.empty())
+            {
+                order.push_back(c);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return chunks[a].pending.size() > chunks[b].pending.size(); });
+
+        for (size_t i = 0; i < order.size() && pendingTriangles > keep; ++i)
+        {
+            Chunk& chunk = chunks[order[i]];
+            Block block = { spillEnd, chunk.pending.size() };
+            spill.seekp(std::streamoff(spillEnd));
+            spill.write(reinterpret_cast<const char*>(chunk.pending.data()), chunk.pending.size() * sizeof(ObjStreamTriangle));
+            if (!spill)
+            {
+                return Fail("cannot write " + tempPath + ".spill");
+            }
+            spillEnd += block.count * sizeof(ObjStreamTriangle);
+            stats.spilledBytes += block.count * sizeof(ObjStreamTriangle);
+            pendingTriangles -= block.count;
+            chunk.blocks.push_back(block);
+            std::vector<ObjStreamTriangle>().swap(chunk.pending);
+        }
+        return true;
+    }
+
+    bool ReadSpill(uint64_t offset, ObjStreamTriangle* triangles, size_t count)
+    {
+        spill.seekg(std::streamoff(offset));
+        if (!spill.read(reinterpret_cast<char*>(triangles), count * sizeof(ObjStreamTriangle)))
+        {
+            return Fail("cannot read " + tempPath + ".spill");
+        }
+        return true;
+    }
+
+    // **Pass 3**
+    bool Partition()
+    {
+        const uint32_t MaxDepth = 64;
+        std::vector<ObjStreamTriangle> piece(size_t(std::max<uint64_t>(PendingBytes() / 4 / sizeof(ObjStreamTriangle), 1)));
+
+        // children are appended, the loop reaches them as well
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            // the mean keeps both halves about equal where the grid cell cut the surface unevenly
+            objstream::Bounds centroids = chunks[c].centroids;
+            int axis = 0;
+            for (int k = 1; k < 3; ++k)
+            {
+                axis = centroids.max[k] - centroids.min[k] > centroids.max[axis] - centroids.min[axis] ? k : axis;
+            }
+            float split = float(chunks[c].centroidSum[axis] / double(std::max<uint64_t>(chunks[c].triangleCount, 1)));
+            if (!(split > centroids.min[axis] && split <= centroids.max[axis]))
+            {
+                split = (centroids.min[axis] + centroids.max[axis]) * 0.5f;
+            }
+            bool separable = centroids.min[axis] < split;
+            if (chunks[c].triangleCount <= maxChunkTriangles || chunks[c].depth >= MaxDepth || !separable)
+            {
+                continue;
+            }
+
+            size_t firstChild = chunks.size();
+            chunks.resize(firstChild + 2);
+            for (size_t i = 0; i < 2; ++i)
+            {
+                chunks[firstChild + i].centroids.Reset();
+                chunks[firstChild + i].depth = chunks[c].depth + 1;
+            }
+            chunks[c].leaf = false;
+            stats.splitChunks++;
+
+            std::vector<Block> blocks;
+            blocks.swap(chunks[c].blocks);
+            for (const Block& block : blocks)
+            {
+                for (uint64_t read = 0; read < block.count; read += piece.size())
+                {
+                    size_t count = size_t(std::min<uint64_t>(block.count - read, piece.size()));
+                    if (!ReadSpill(block.offset + read * sizeof(ObjStreamTriangle), piece.data(), count))
+                    {
+                        return false;
+                    }
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        float centroid[3];
+                        objstream::Centroid(piece[i], centroid);
+                        if (!AddToChunk(firstChild + (centroid[axis] >= split ? 1 : 0), piece[i], centroid))
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+            if (!FlushPending(0))
+            {
+                return false;
+            }
+        }
+
+        for (const Chunk& chunk : chunks)
+        {
+            stats.chunks += chunk.leaf && chunk.triangleCount > 0 ? 1 : 0;
+        }
+        return true;
+    }
+
+    bool EmitChunk(const std::function<bool(std::vector<ObjStreamTriangle>&)>& chunk, std::vector<ObjStreamTriangle>& triangles)
+    {
+        bool ok = chunk(triangles);
+        triangles.clear();
+        return ok;
+    }
+
+    ObjStreamSettings settings;
+    ObjStreamStatistics stats = {};
+    std::string tempPath;
+    std::string error;
+    std::vector<std::string> materialNames;
+    std::vector<std::string> materialLibraries;
+    objstream::Bounds bounds;
+    objstream::Bounds cornerBounds;
+    int gridSize[3] = { 1, 1, 1 };
+    float cellScale[3] = { 0.0f, 0.0f, 0.0f };
+    std::vector<Chunk> chunks;
+    std::fstream spill;
+    uint64_t spillEnd = 0;
+    uint64_t pendingTriangles = 0;
+    size_t maxChunkTriangles = 0;
+};
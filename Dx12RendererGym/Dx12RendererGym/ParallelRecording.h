@@ -0,0 +1,198 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+#include "JobSystem.h"
+
+// Parallel command recording. Every command list has its own allocator and every frame in flight has its
+// own pool of list/allocator pairs, so two threads never record into the same allocator and a pool is only
+// reset once the caller waited for the fence of its frame. Lists are submitted in the order they were
+// acquired, independent of which worker finished first, so the GPU sees the same command stream as a
+// single threaded recording. The ranges are recorded as jobs on the JobSystem.
+//
+// Traits adapts the graphics API (and lets a mock stand in for it):
+//   typedef ... Allocator;
+//   typedef ... CommandList;
+//   static bool Create(Allocator*& allocator, CommandList*& list);  a new list in the closed state
+//   static bool Reset(Allocator* allocator, CommandList* list);     reset both, the list is open afterwards
+//   static bool Close(CommandList* list);
+//   static void Destroy(Allocator* allocator, CommandList* list);
+
+// a contiguous range of draws recorded into one command list
+struct DrawRange
+{
+    size_t first;
+    size_t count;
+};
+
+// Split drawCount draws into at most maxRanges contiguous ranges of at least minDrawsPerRange draws,
+// a list per handful of draws costs more in setup than it saves. Ranges are in draw order.
+inline void PartitionDraws(size_t drawCount, size_t maxRanges, size_t minDrawsPerRange, std::vector<DrawRange>& ranges)
+{
+    ranges.clear();
+    if (drawCount == 0)
+    {
+        return;
+    }
+
+    size_t rangeCount = drawCount / std::max<size_t>(minDrawsPerRange, 1);
+    rangeCount = std::max<size_t>(1, std::min(rangeCount, maxRanges));
+
+    size_t first = 0;
+    for (size_t i = 0; i < rangeCount; ++i)
+    {
+        DrawRange range = { first, drawCount / rangeCount + (i < drawCount % rangeCount ? 1 : 0) };
+        ranges.push_back(range);
+        first += range.count;
+    }
+}
+
+template <typename Traits>
+class ParallelCommandRecorder
+{
+public:
+    typedef typename Traits::Allocator Allocator;
+    typedef typename Traits::CommandList CommandList;
+    typedef std::function<void(CommandList*, const DrawRange&)> RecordFunction;
+
+    bool Init(size_t frameCount, size_t maxWorkers, JobSystem& scheduler)
+    {
+        frames.resize(frameCount);
+        workerCount = std::max<size_t>(maxWorkers, 1);
+        jobSystem = &scheduler;
+        return true;
+    }
+
+    void Destroy()
+    {
+        for (size_t f = 0; f < frames.size(); ++f)
+        {
+            for (size_t i = 0; i < frames[f].size(); ++i)
+            {
+                Traits::Destroy(frames[f][i].allocator, frames[f][i].list);
+            }
+        }
+        frames.clear();
+    }
+
+    // start recording frameIndex, the GPU must be done with the previous frame that used this index
+    void BeginFrame(size_t index)
+    {
+        frameIndex = index;
+        used = 0;
+        failed = false;
+    }
+
+    // next list in submission order, open for recording on the calling thread
+    CommandList* Acquire()
+    {
+        std::vector<Entry>& pool = frames[frameIndex];
+        if (used == pool.size())
+        {
+            Entry entry = {};
+            if (!Traits::Create(entry.allocator, entry.list))
+            {
+                failed = true;
+                return nullptr;
+            }
+            pool.push_back(entry);
+        }
+
+        Entry& entry = pool[used++];
+        // recycle the allocator, its commands from frameCount frames ago have executed
+        if (!Traits::Reset(entry.allocator, entry.list))
+        {
+            failed = true;
+            return nullptr;
+        }
+        entry.open = true;
+        return entry.list;
+    }
+
+    // Record drawCount draws split into ranges, one list per range, as jobs the calling thread helps with.
+    // The lists are queued in range order and closed.
+    bool RecordParallel(size_t drawCount, size_t minDrawsPerList, const RecordFunction& record)
+    {
+        PartitionDraws(drawCount, workerCount, minDrawsPerList, ranges);
+        if (ranges.empty())
+        {
+            return !failed;
+        }
+
+        // acquire on this thread so the submission order is fixed before any worker starts
+        size_t firstEntry = used;
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            if (Acquire() == nullptr)
+            {
+                return false;
+            }
+        }
+
+        std::vector<Entry>& pool = frames[frameIndex];
+        closed.assign(ranges.size(), 0);
+        jobSystem->ParallelFor(ranges.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                Entry& entry = pool[firstEntry + i];
+                record(entry.list, ranges[i]);
+                entry.open = false;
+                closed[i] = Traits::Close(entry.list) ? 1 : 0;
+            }
+        });
+
+        bool succeeded = std::find(closed.begin(), closed.end(), 0) == closed.end();
+        failed = failed || !succeeded;
+        return succeeded;
+    }
+
+    // Close the lists still open and pass every list of the frame, in acquisition order, to
+    // submit(CommandList* const* lists, size_t count) in a single call.
+    template <typename SubmitFunction>
+    bool Submit(SubmitFunction submit)
+    {
+        std::vector<Entry>& pool = frames[frameIndex];
+        submission.clear();
+        for (size_t i = 0; i < used; ++i)
+        {
+            if (pool[i].open)
+            {
+                pool[i].open = false;
+                failed = !Traits::Close(pool[i].list) || failed;
+            }
+            submission.push_back(pool[i].list);
+        }
+        if (failed)
+        {
+            return false;
+        }
+        if (!submission.empty())
+        {
+            submit(submission.data(), submission.size());
+        }
+        return true;
+    }
+
+    // number of list/allocator pairs created for a frame, stays at the peak number of lists per frame
+    size_t PoolSize(size_t index) const { return frames[index].size(); }
+
+private:
+    struct Entry
+    {
+        Allocator* allocator;
+        CommandList* list;
+        bool open;
+    };
+
+    std::vector<std::vector<Entry>> frames;
+    std::vector<DrawRange> ranges;
+    std::vector<CommandList*> submission;
+    std::vector<char> closed;
+    JobSystem* jobSystem = nullptr;
+    size_t workerCount = 1;
+    size_t frameIndex = 0;
+    size_t used = 0;
+    bool failed = false;
+};
@@ -0,0 +1,365 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include "JobSystem.h"
+
+// Pipeline state cache. Pipelines are keyed by a stable 64 bit hash of everything that defines them (shader
+// bytecode, input layout, fixed function state, formats), so the key is the same from run to run and can
+// name the pipeline in the on-disk library the driver fills with its compiled code. A pipeline is loaded
+// from the library when the key is in it, created and added to it otherwise, and the library is written
+// back when it grew. Requests run as jobs, the render thread picks the pipeline up once it exists.
+//
+// Traits adapts the graphics API:
+//   typedef ... Desc;
+//   typedef ... Pipeline;
+//   static Pipeline* Load(uint64_t key, const Desc& desc);    from the library, nullptr when it is not in it
+//   static Pipeline* Create(const Desc& desc);                nullptr on failure
+//   static bool Store(uint64_t key, Pipeline* pipeline);      add to the library
+//   static void Release(Pipeline* pipeline);
+
+// FNV-1a over the bytes that define a pipeline, pointers must never be hashed, only what they point to
+class PipelineHasher
+{
+public:
+    PipelineHasher() : hash(14695981039346656037ull) {}
+
+    void Add(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    template <typename T>
+    void AddValue(const T& value)
+    {
+        Add(&value, sizeof(value));
+    }
+
+    // null and empty strings hash differently, the length keeps "ab","c" apart from "a","bc"
+    void AddString(const char* text)
+    {
+        uint32_t length = text ? uint32_t(strlen(text)) : 0xffffffff;
+        AddValue(length);
+        if (text)
+        {
+            Add(text, length);
+        }
+    }
+
+    uint64_t Hash() const { return hash; }
+
+private:
+    uint64_t hash;
+};
+
+// Cache file: PipelineCacheFileHeader, keyCount 64 bit keys of the pipelines in the library, then
+// librarySize bytes of library blob. The library only loads on the adapter and driver that wrote it.
+const uint32_t PipelineCacheMagic = 0x43535044; // "DPSC"
+const uint32_t PipelineCacheVersion = 1;
+
+struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t adapterId;      // adapter and driver version, from the caller
+    uint32_t keyCount;
+    uint32_t reserved;
+    uint64_t librarySize;
+    uint64_t libraryHash;    // PipelineHasher of the blob, catches truncated or corrupt files
+};
+
+inline bool WritePipelineCacheFile(const std::string& path, uint64_t adapterId, const std::vector<uint64_t>& keys,
+    const void* library, size_t librarySize)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    PipelineHasher hasher;
+    hasher.Add(library, librarySize);
+
+    PipelineCacheFileHeader header = {};
+    header.magic = PipelineCacheMagic;
+    header.version = PipelineCacheVersion;
+    header.adapterId = adapterId;
+    header.keyCount = uint32_t(keys.size());
+    header.librarySize = librarySize;
+    header.libraryHash = hasher.Hash();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(uint64_t));
+    file.write(static_cast<const char*>(library), librarySize);
+    return file.good();
+}
+
+// fails if the file is missing, corrupt, from another version or written on another adapter or driver
+inline bool ReadPipelineCacheFile(const std::string& path, uint64_t adapterId, std::vector<uint64_t>& keys,
+    std::vector<unsigned char>& library)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    PipelineCacheFileHeader header = {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != PipelineCacheMagic || header.version != PipelineCacheVersion || header.adapterId != adapterId)
+    {
+        return false;
+    }
+
+    // a corrupt size must not turn into a huge allocation
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = uint64_t(file.tellg());
+    if (fileSize != sizeof(header) + uint64_t(header.keyCount) * sizeof(uint64_t) + header.librarySize)
+    {
+        return false;
+    }
+    file.seekg(sizeof(header), std::ios::beg);
+
+    keys.resize(header.keyCount);
+    file.read(reinterpret_cast<char*>(keys.data()), keys.size() * sizeof(uint64_t));
+    library.resize(size_t(header.librarySize));
+    file.read(reinterpret_cast<char*>(library.data()), library.size());
+    if (!file)
+    {
+        return false;
+    }
+
+    PipelineHasher hasher;
+    hasher.Add(library.data(), library.size());
+    return hasher.Hash() == header.libraryHash;
+}
+
+struct PipelineCacheStatistics
+{
+    unsigned int loaded;     // found in the library
+    unsigned int created;    // compiled by the driver and added to the library
+    unsigned int failed;
+    double createMs;         // summed over all threads
+    double loadMs;
+};
+
+template <typename Traits>
+class PipelineStateCache
+{
+public:
+    typedef typename Traits::Desc Desc;
+    typedef typename Traits::Pipeline Pipeline;
+
+    ~PipelineStateCache() { Destroy(); }
+
+    // jobs == nullptr creates every pipeline on the calling thread
+    void Init(JobSystem* jobs, const std::vector<uint64_t>& libraryKeys)
+    {
+        jobSystem = jobs;
+        std::lock_guard<std::mutex> lock(mutex);
+        storedKeys = libraryKeys;
+        stored = false;
+    }
+
+    // waits for the requests in flight and releases every pipeline
+    void Destroy()
+    {
+        if (jobSystem)
+        {
+            jobSystem->Wait(requests);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (typename EntryMap::iterator it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (it->second->pipeline)
+            {
+                Traits::Release(it->second->pipeline);
+            }
+        }
+        entries.clear();
+    }
+
+    // Start loading or creating the pipeline for desc, everything desc points to has to stay alive until
+    // the pipeline is ready. key identifies desc, usually a hash built with PipelineHasher.
+    void Request(uint64_t key, const Desc& desc)
+    {
+        Entry* entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unique_ptr<Entry>& slot = entries[key];
+            if (slot)
+            {
+                return;
+            }
+            slot.reset(new Entry());
+            entry = slot.get();
+        }
+
+        if (jobSystem)
+        {
+            jobSystem->Run([this, key, desc, entry]() { Build(key, desc, *entry); }, &requests);
+        }
+        else
+        {
+            Build(key, desc, *entry);
+        }
+    }
+
+    // the pipeline once it is ready, nullptr while it is built or when it failed
+    Pipeline* Find(uint64_t key) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        typename EntryMap::const_iterator it = entries.find(key);
+        if (it == entries.end() || !it->second->ready.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return it->second->pipeline;
+    }
+
+    // the request finished, Find tells whether it failed
+    bool Done(uint64_t key) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        typename EntryMap::const_iterator it = entries.find(key);
+        return it != entries.end() && it->second->ready.load(std::memory_order_acquire);
+    }
+
+    // request and wait, helping with other jobs meanwhile
+    Pipeline* Get(uint64_t key, const Desc& desc)
+    {
+        Request(key, desc);
+        return Wait(key);
+    }
+
+    // wait for an earlier request, nullptr if there was none or it failed
+    Pipeline* Wait(uint64_t key)
+    {
+        Entry* entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            typename EntryMap::iterator it = entries.find(key);
+            if (it == entries.end())
+            {
+                return nullptr;
+            }
+            entry = it->second.get();
+        }
+        while (!entry->ready.load(std::memory_order_acquire))
+        {
+            jobSystem->Wait(requests);
+        }
+        return entry->pipeline;
+    }
+
+    // wait for every request made so far
+    void WaitAll()
+    {
+        if (jobSystem)
+        {
+            jobSystem->Wait(requests);
+        }
+    }
+
+    // pipelines were added to the library since Init, it should be written back
+    bool LibraryChanged() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stored;
+    }
+
+    std::vector<uint64_t> LibraryKeys() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return storedKeys;
+    }
+
+    PipelineCacheStatistics Statistics() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return statistics;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        Entry() : pipeline(nullptr), ready(false) {}
+        Pipeline* pipeline;
+        std::atomic<bool> ready;
+    };
+    typedef std::unordered_map<uint64_t, std::unique_ptr<Entry>> EntryMap;
+
+    void Build(uint64_t key, const Desc& desc, Entry& entry)
+    {
+        bool inLibrary;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inLibrary = std::find(storedKeys.begin(), storedKeys.end(), key) != storedKeys.end();
+        }
+
+        Clock::time_point start = Clock::now();
+        Pipeline* pipeline = inLibrary ? Traits::Load(key, desc) : nullptr;
+        double loadMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        bool loaded = pipeline != nullptr;
+        bool added = false;
+        double createMs = 0.0;
+        if (!pipeline)
+        {
+            start = Clock::now();
+            pipeline = Traits::Create(desc);
+            createMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            if (pipeline)
+            {
+                // the library does not allow storing a name twice, keep the stores apart
+                std::lock_guard<std::mutex> lock(storeMutex);
+                added = !inLibrary && Traits::Store(key, pipeline);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        entry.pipeline = pipeline;
+        entry.ready.store(true, std::memory_order_release);
+        statistics.loadMs += loadMs;
+        statistics.createMs += createMs;
+        if (loaded)
+        {
+            statistics.loaded++;
+        }
+        else if (pipeline)
+        {
+            statistics.created++;
+        }
+        else
+        {
+            statistics.failed++;
+        }
+        if (added)
+        {
+            storedKeys.push_back(key);
+            stored = true;
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::mutex storeMutex;
+    EntryMap entries;
+    std::vector<uint64_t> storedKeys;
+    bool stored = false;
+    PipelineCacheStatistics statistics = {};
+    JobSystem* jobSystem = nullptr;
+    JobCounter requests;
+};
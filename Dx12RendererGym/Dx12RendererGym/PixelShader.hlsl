@@ -1,12 +1,47 @@
-Texture2D t1 : register(t0);
+// Permutation features, ShaderList.txt lists the combinations that are built and ShaderPermutations.h
+// mirrors them on the CPU. The defaults are the full shader.
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 3   // lights to shade, the CPU packs the enabled ones to the front
+#endif
+#ifndef USE_TEXTURE
+#define USE_TEXTURE 1
+#endif
+#ifndef USE_SPECULAR
+#define USE_SPECULAR 1
+#endif
+#ifndef USE_NORMAL_MAP
+#define USE_NORMAL_MAP 1
+#endif
+
+// the bindless heap, the material picks its textures by index
+Texture2D textures[] : register(t0, space1);
 SamplerState s1 : register(s0);
 
+// GpuMaterial in stdafx.h
+struct MaterialData
+{
+    float3 diffuseColor;
+    uint diffuseTexture;    // the white texture when untextured
+    float3 specularColor;
+    float specularPower;
+    uint normalTexture;     // the flat normal texture without a normal map
+    uint3 padding;
+};
+
+StructuredBuffer<MaterialData> materials : register(t0);
+
+cbuffer DrawConstants : register(b2)
+{
+    uint materialIndex;
+};
+
 struct VS_OUTPUT
 {
     float4 pos : SV_POSITION;
     float3 worldPos : POSITION;
     float2 texCoord : TEXCOORD;
     float3 normalWorld : NORMAL;
+    float4 tangentWorld : TANGENT;
 };
 
 
@@ -16,6 +51,8 @@ cbuffer ConstantBuffer : register(b0)
     float4x4 wMat;
     float4x4 wvpMat;
     float3 cameraPos;
+    float3 positionDequantScale;
+    float3 positionDequantOffset;
 };
 
 struct PointLightData
@@ -23,10 +60,10 @@ struct PointLightData
     float3 diffuseColor;
     float3 specularColor;
     float3 position;
-    float specularPower;
+    float specularPower;    // unused, the material exponent shapes the highlight
     float innerRadius;
     float outerRadius;
-    bool enabled;
+    bool enabled;   // packed on the CPU, the first LIGHT_COUNT lights are the enabled ones
 };
 
 cbuffer LIGHTING : register(b1)
@@ -38,21 +75,30 @@ cbuffer LIGHTING : register(b1)
 float4 main(VS_OUTPUT input) : SV_TARGET
 {
     //return float4(1.f, 1.f, 1.f, 1.f);
-    float4 color = t1.Sample(s1, input.texCoord);
+    MaterialData material = materials[materialIndex];
+#if USE_TEXTURE
+    float4 color = textures[material.diffuseTexture].Sample(s1, input.texCoord);
+#else
+    float4 color = float4(1.f, 1.f, 1.f, 1.f);
+#endif
     
     float3 phong = ambientLight;
+    float3 specular = float3(0, 0, 0);
     
+#if USE_NORMAL_MAP
+    // MikkTSpace: the interpolated frame is used unnormalized, the bitangent is rebuilt with the sign
+    float3 tangentNormal = textures[material.normalTexture].Sample(s1, input.texCoord).xyz * 2.0f - 1.0f;
+    float3 bitangent = input.tangentWorld.w * cross(input.normalWorld, input.tangentWorld.xyz);
+    float3 N = normalize(tangentNormal.x * input.tangentWorld.xyz + tangentNormal.y * bitangent + tangentNormal.z * input.normalWorld);
+#else
     float3 N = normalize(input.normalWorld);
+#endif
     float3 V = cameraPos - input.worldPos;
     V = normalize(V);
     
-    for (int i = 0; i < 3; i++)
+    [unroll]
+    for (int i = 0; i < LIGHT_COUNT; i++)
     {
-        if (!pointLights[i].enabled)
-        {
-            continue;
-        }
-
         float3 L = pointLights[i].position - input.worldPos;
         L = normalize(L);
         float NdotL = dot(N, L);
@@ -67,15 +113,16 @@ float4 main(VS_OUTPUT input) : SV_TARGET
             float3 diffuseColor = lerp(pointLights[i].diffuseColor, float3(0, 0, 0), sstep);
             phong += (diffuseColor * NdotL);
 
-            
-            
+#if USE_SPECULAR
             float RdotV = dot(R, V);
-            phong += pointLights[i].specularColor * pow(max(0, RdotV), pointLights[i].specularPower);
+            specular += pointLights[i].specularColor * pow(max(0, RdotV), material.specularPower);
+#endif
 
         }
 
     }
-    float4 finalPhong = float4(phong, 0);
+    // the material tints the light, Kd the ambient and diffuse part and Ks the highlights
+    float4 finalPhong = float4(phong * material.diffuseColor + specular * material.specularColor, 0);
     
     return color * saturate(finalPhong);
     
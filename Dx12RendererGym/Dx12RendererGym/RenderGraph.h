@@ -0,0 +1,642 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <functional>
+#include <queue>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Render graph. Passes declare which resources they read and write and in which state, Compile then
+//  - culls passes whose results never reach an imported resource or a pass with side effects,
+//  - orders the remaining passes so every producer runs before its consumers, keeping declaration order
+//    where the dependencies allow it,
+//  - computes the resource barriers before every pass, one batch per pass, skipping redundant ones and
+//    merging consecutive reads into a single transition,
+//  - places transient textures in one heap, resources whose lifetimes do not overlap share memory.
+// The graph knows nothing about the graphics API, states are bits the renderer maps to its own, transient
+// sizes come from the renderer and Execute hands the barriers back to it.
+
+typedef uint32_t RenderGraphResourceHandle;
+typedef uint32_t RenderGraphPassHandle;
+
+const uint32_t RenderGraphInvalidHandle = UINT32_MAX;
+
+const uint32_t RenderGraphStateCommon = 0x0;
+const uint32_t RenderGraphStateRenderTarget = 0x1;
+const uint32_t RenderGraphStateDepthWrite = 0x2;
+const uint32_t RenderGraphStateDepthRead = 0x4;
+const uint32_t RenderGraphStateShaderResource = 0x8;
+const uint32_t RenderGraphStateUnorderedAccess = 0x10;
+const uint32_t RenderGraphStateCopySource = 0x20;
+const uint32_t RenderGraphStateCopyDest = 0x40;
+const uint32_t RenderGraphStatePresent = 0x80;
+
+// states that write, a resource can be in several read states at once but only in one write state
+const uint32_t RenderGraphWriteStates = RenderGraphStateRenderTarget | RenderGraphStateDepthWrite |
+    RenderGraphStateUnorderedAccess | RenderGraphStateCopyDest;
+
+struct RenderGraphTextureDesc
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;    // API format, only passed through
+    uint64_t size;      // bytes in the transient heap, from the API
+    uint64_t alignment;
+};
+
+struct RenderGraphBarrier
+{
+    enum Type
+    {
+        Transition,
+        Aliasing,       // resource takes over memory last used by before (RenderGraphInvalidHandle if unknown)
+        UnorderedAccess // write after write in the unordered access state
+    };
+
+    Type type;
+    RenderGraphResourceHandle resource;
+    RenderGraphResourceHandle before;
+    uint32_t stateBefore;
+    uint32_t stateAfter;
+};
+
+struct RenderGraphStatistics
+{
+    unsigned int declaredPasses;
+    unsigned int culledPasses;
+    unsigned int barriers;
+    unsigned int transientResources;
+    uint64_t transientHeapSize;     // with aliasing
+    uint64_t transientUnaliasedSize; // every transient in its own memory
+};
+
+class RenderGraph
+{
+public:
+    // a resource that lives outside of the graph, e.g. the back buffer, in initialState when the graph starts
+    // and left in finalState when it ends
+    RenderGraphResourceHandle ImportResource(const std::string& name, uint32_t initialState, uint32_t finalState)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.imported = true;
+        resource.initialState = initialState;
+        resource.finalState = finalState;
+        resources.push_back(resource);
+        compiled = false;
+        return RenderGraphResourceHandle(resources.size() - 1);
+    }
+
+    // a texture only used within the graph, its memory is shared with transients used at other times
+    RenderGraphResourceHandle CreateTexture(const std::string& name, const RenderGraphTextureDesc& desc)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.desc = desc;
+        resources.push_back(resource);
+        compiled = false;
+        return RenderGraphResourceHandle(resources.size() - 1);
+    }
+
+    // sideEffect keeps a pass that writes nothing the graph can see (readback, present)
+    RenderGraphPassHandle AddPass(const std::string& name, std::function<void()> execute, bool sideEffect = false)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.execute = std::move(execute);
+        pass.sideEffect = sideEffect;
+        passes.push_back(pass);
+        compiled = false;
+        return RenderGraphPassHandle(passes.size() - 1);
+    }
+
+    void Read(RenderGraphPassHandle pass, RenderGraphResourceHandle resource, uint32_t state)
+    {
+        Access access = { resource, state };
+        passes[pass].accesses.push_back(access);
+        compiled = false;
+    }
+
+    void Write(RenderGraphPassHandle pass, RenderGraphResourceHandle resource, uint32_t state)
+    {
+        Access access = { resource, state };
+        passes[pass].accesses.push_back(access);
+        compiled = false;
+    }
+
+    // API object of a resource, set by the renderer (e.g. the back buffer of the current frame)
+    void SetResourceData(RenderGraphResourceHandle resource, void* data) { resources[resource].data = data; }
+    void* ResourceData(RenderGraphResourceHandle resource) const { return resources[resource].data; }
+
+    const std::string& ResourceName(RenderGraphResourceHandle resource) const { return resources[resource].name; }
+    const std::string& PassName(RenderGraphPassHandle pass) const { return passes[pass].name; }
+    size_t ResourceCount() const { return resources.size(); }
+    bool IsTransient(RenderGraphResourceHandle resource) const { return !resources[resource].imported; }
+    bool IsUsed(RenderGraphResourceHandle resource) const { return resources[resource].firstUse != UINT32_MAX; }
+    const RenderGraphTextureDesc& TextureDesc(RenderGraphResourceHandle resource) const { return resources[resource].desc; }
+
+    // offset of a transient texture in the transient heap
+    uint64_t TransientOffset(RenderGraphResourceHandle resource) const { return resources[resource].heapOffset; }
+    uint64_t TransientHeapSize() const { return heapSize; }
+    // state a transient has to be created in, the state it is left in at the end of the graph
+    uint32_t TransientCreationState(RenderGraphResourceHandle resource) const { return resources[resource].lastState; }
+
+    const std::vector<RenderGraphPassHandle>& ExecutionOrder() const { return order; }
+    const std::vector<RenderGraphBarrier>& PassBarriers(size_t orderIndex) const { return passBarriers[orderIndex]; }
+    const std::vector<RenderGraphBarrier>& FinalBarriers() const { return finalBarriers; }
+    const RenderGraphStatistics& Statistics() const { return statistics; }
+    bool Compiled() const { return compiled; }
+
+    // false if the dependencies have a cycle or a pass uses a resource in a write and another state at once
+    bool Compile()
+    {
+        compiled = false;
+        statistics = {};
+        statistics.declaredPasses = unsigned(passes.size());
+
+        if (!MergeAccesses())
+        {
+            return false;
+        }
+        BuildDependencies();
+        CullPasses();
+        if (!SortPasses())
+        {
+            return false;
+        }
+        ComputeLifetimes();
+        PlaceTransients();
+        ComputeBarriers();
+
+        compiled = true;
+        return true;
+    }
+
+    // barriers(const RenderGraphBarrier* barriers, size_t count) is called before every pass that needs
+    // barriers and at the end for the final transitions, then the pass itself runs
+    template <typename BarrierFunction>
+    void Execute(BarrierFunction barriers) const
+    {
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            if (!passBarriers[i].empty())
+            {
+                barriers(passBarriers[i].data(), passBarriers[i].size());
+            }
+            const Pass& pass = passes[order[i]];
+            if (pass.execute)
+            {
+                pass.execute();
+            }
+        }
+        if (!finalBarriers.empty())
+        {
+            barriers(finalBarriers.data(), finalBarriers.size());
+        }
+    }
+
+private:
+    struct Access
+    {
+        RenderGraphResourceHandle resource;
+        uint32_t state;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::function<void()> execute;
+        bool sideEffect = false;
+        std::vector<Access> accesses;   // one per resource after MergeAccesses
+        std::vector<uint32_t> producers; // passes this one has to run after
+        bool culled = false;
+    };
+
+    struct Resource
+    {
+        std::string name;
+        bool imported = false;
+        uint32_t initialState = RenderGraphStateCommon;
+        uint32_t finalState = RenderGraphStateCommon;
+        RenderGraphTextureDesc desc = {};
+        void* data = nullptr;
+
+        // in execution order indices
+        uint32_t firstUse = UINT32_MAX;
+        uint32_t lastUse = 0;
+        uint32_t lastState = RenderGraphStateCommon;
+        uint64_t heapOffset = 0;
+        RenderGraphResourceHandle aliasedFrom = RenderGraphInvalidHandle;
+    };
+
+    static bool IsWrite(uint32_t state) { return (state & RenderGraphWriteStates) != 0; }
+
+    bool MergeAccesses()
+    {
+        for (size_t p = 0; p < passes.size(); ++p)
+        {
+            std::vector<Access>& accesses = passes[p].accesses;
+            std::sort(accesses.begin(), accesses.end(),
+                [](const Access& a, const Access& b) { return a.resource < b.resource; });
+            size_t write = 0;
+            for (size_t i = 0; i < accesses.size(); ++i)
+            {
+                if (write > 0 && accesses[write - 1].resource == accesses[i].resource)
+                {
+                    accesses[write - 1].state |= accesses[i].state;
+                }
+                else
+                {
+                    accesses[write++] = accesses[i];
+                }
+            }
+            accesses.resize(write);
+
+            for (size_t i = 0; i < accesses.size(); ++i)
+            {
+                uint32_t state = accesses[i].state;
+                uint32_t writeState = state & RenderGraphWriteStates;
+                // a write state excludes every other state, except depth write which may be read as depth
+                if (writeState != 0 && (writeState & (writeState - 1)) != 0)
+                {
+                    return false;
+                }
+                if (writeState != 0 && (state & ~writeState & ~(writeState == RenderGraphStateDepthWrite ? RenderGraphStateDepthRead : 0)) != 0)
+                {
+                    return false;
+                }
+                if (writeState == RenderGraphStateDepthWrite)
+                {
+                    accesses[i].state = RenderGraphStateDepthWrite;
+                }
+            }
+        }
+        return true;
+    }
+
+    // read after write, write after write and write after read dependencies in declaration order
+    void BuildDependencies()
+    {
+        std::vector<uint32_t> lastWriter(resources.size(), UINT32_MAX);
+        std::vector<std::vector<uint32_t>> readers(resources.size());
+        for (uint32_t p = 0; p < uint32_t(passes.size()); ++p)
+        {
+            Pass& pass = passes[p];
+            pass.producers.clear();
+            pass.culled = false;
+            for (size_t i = 0; i < pass.accesses.size(); ++i)
+            {
+                RenderGraphResourceHandle r = pass.accesses[i].resource;
+                if (lastWriter[r] != UINT32_MAX)
+                {
+                    pass.producers.push_back(lastWriter[r]);
+                }
+                if (IsWrite(pass.accesses[i].state))
+                {
+                    pass.producers.insert(pass.producers.end(), readers[r].begin(), readers[r].end());
+                    readers[r].clear();
+                    lastWriter[r] = p;
+                }
+                else
+                {
+                    readers[r].push_back(p);
+                }
+            }
+            std::sort(pass.producers.begin(), pass.producers.end());
+            pass.producers.erase(std::unique(pass.producers.begin(), pass.producers.end()), pass.producers.end());
+            pass.producers.erase(std::remove(pass.producers.begin(), pass.producers.end(), p), pass.producers.end());
+        }
+    }
+
+    // keep passes with side effects, passes writing imported resources and everything they depend on
+    void CullPasses()
+    {
+        std::vector<uint32_t> stack;
+        std::vector<bool> needed(passes.size(), false);
+        for (uint32_t p = 0; p < uint32_t(passes.size()); ++p)
+        {
+            bool root = passes[p].sideEffect;
+            for (size_t i = 0; i < passes[p].accesses.size() && !root; ++i)
+            {
+                root = IsWrite(passes[p].accesses[i].state) && resources[passes[p].accesses[i].resource].imported;
+            }
+            if (root)
+            {
+                needed[p] = true;
+                stack.push_back(p);
+            }
+        }
+        while (!stack.empty())
+        {
+            uint32_t p = stack.back();
+            stack.pop_back();
+            for (size_t i = 0; i < passes[p].producers.size(); ++i)
+            {
+                uint32_t producer = passes[p].producers[i];
+                // a pass that only read what p overwrites is not needed for p's result
+                if (!needed[producer] && WritesAnyReadOrWrittenBy(producer, p))
+                {
+                    needed[producer] = true;
+                    stack.push_back(producer);
+                }
+            }
+        }
+        for (size_t p = 0; p < passes.size(); ++p)
+        {
+            passes[p].culled = !needed[p];
+            if (passes[p].culled)
+            {
+                statistics.culledPasses++;
+            }
+        }
+    }
+
+    bool WritesAnyReadOrWrittenBy(uint32_t producer, uint32_t consumer) const
+    {
+        const std::vector<Access>& a = passes[producer].accesses;
+        const std::vector<Access>& b = passes[consumer].accesses;
+        size_t i = 0, j = 0;
+        while (i < a.size() && j < b.size())
+        {
+            if (a[i].resource < b[j].resource)
+            {
+                i++;
+            }
+            else if (b[j].resource < a[i].resource)
+            {
+                j++;
+            }
+            else
+            {
+                if (IsWrite(a[i].state))
+                {
+                    return true;
+                }
+                i++;
+                j++;
+            }
+        }
+        return false;
+    }
+
+    // Kahn's algorithm, the ready pass declared first goes first
+    bool SortPasses()
+    {
+        order.clear();
+        std::vector<uint32_t> pendingProducers(passes.size(), 0);
+        std::vector<std::vector<uint32_t>> consumers(passes.size());
+        size_t alive = 0;
+        for (uint32_t p = 0; p < uint32_t(passes.size()); ++p)
+        {
+            if (passes[p].culled)
+            {
+                continue;
+            }
+            alive++;
+            for (size_t i = 0; i < passes[p].producers.size(); ++i)
+            {
+                uint32_t producer = passes[p].producers[i];
+                if (!passes[producer].culled)
+                {
+                    consumers[producer].push_back(p);
+                    pendingProducers[p]++;
+                }
+            }
+        }
+
+        std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+        for (uint32_t p = 0; p < uint32_t(passes.size()); ++p)
+        {
+            if (!passes[p].culled && pendingProducers[p] == 0)
+            {
+                ready.push(p);
+            }
+        }
+        while (!ready.empty())
+        {
+            uint32_t p = ready.top();
+            ready.pop();
+            order.push_back(p);
+            for (size_t i = 0; i < consumers[p].size(); ++i)
+            {
+                if (--pendingProducers[consumers[p][i]] == 0)
+                {
+                    ready.push(consumers[p][i]);
+                }
+            }
+        }
+        return order.size() == alive;
+    }
+
+    void ComputeLifetimes()
+    {
+        for (size_t r = 0; r < resources.size(); ++r)
+        {
+            resources[r].firstUse = UINT32_MAX;
+            resources[r].lastUse = 0;
+            resources[r].aliasedFrom = RenderGraphInvalidHandle;
+            resources[r].heapOffset = 0;
+        }
+        for (uint32_t i = 0; i < uint32_t(order.size()); ++i)
+        {
+            const Pass& pass = passes[order[i]];
+            for (size_t a = 0; a < pass.accesses.size(); ++a)
+            {
+                Resource& resource = resources[pass.accesses[a].resource];
+                resource.firstUse = std::min(resource.firstUse, i);
+                resource.lastUse = std::max(resource.lastUse, i);
+            }
+        }
+    }
+
+    // Greedy interval packing: biggest transients first, each at the lowest aligned offset that does not
+    // collide with an already placed transient whose lifetime overlaps.
+    void PlaceTransients()
+    {
+        heapSize = 0;
+        std::vector<RenderGraphResourceHandle> transients;
+        for (RenderGraphResourceHandle r = 0; r < RenderGraphResourceHandle(resources.size()); ++r)
+        {
+            if (!resources[r].imported && resources[r].firstUse != UINT32_MAX)
+            {
+                transients.push_back(r);
+                statistics.transientUnaliasedSize += resources[r].desc.size;
+            }
+        }
+        statistics.transientResources = unsigned(transients.size());
+        std::sort(transients.begin(), transients.end(), [this](RenderGraphResourceHandle a, RenderGraphResourceHandle b)
+        {
+            return resources[a].desc.size != resources[b].desc.size ? resources[a].desc.size > resources[b].desc.size : a < b;
+        });
+
+        std::vector<RenderGraphResourceHandle> placed;
+        std::vector<std::pair<uint64_t, uint64_t>> occupied;
+        for (size_t t = 0; t < transients.size(); ++t)
+        {
+            Resource& resource = resources[transients[t]];
+            occupied.clear();
+            for (size_t i = 0; i < placed.size(); ++i)
+            {
+                const Resource& other = resources[placed[i]];
+                if (other.firstUse <= resource.lastUse && resource.firstUse <= other.lastUse)
+                {
+                    occupied.push_back(std::make_pair(other.heapOffset, other.heapOffset + other.desc.size));
+                }
+            }
+            std::sort(occupied.begin(), occupied.end());
+
+            uint64_t alignment = std::max<uint64_t>(resource.desc.alignment, 1);
+            uint64_t offset = 0;
+            for (size_t i = 0; i < occupied.size(); ++i)
+            {
+                if (offset + resource.desc.size <= occupied[i].first)
+                {
+                    break;
+                }
+                offset = std::max(offset, (occupied[i].second + alignment - 1) / alignment * alignment);
+            }
+            resource.heapOffset = offset;
+            heapSize = std::max(heapSize, offset + resource.desc.size);
+            placed.push_back(transients[t]);
+        }
+        statistics.transientHeapSize = heapSize;
+
+        // the transient that used the memory last before this one starts, for the aliasing barrier
+        for (size_t t = 0; t < transients.size(); ++t)
+        {
+            Resource& resource = resources[transients[t]];
+            uint32_t latestUse = 0;
+            for (size_t i = 0; i < transients.size(); ++i)
+            {
+                const Resource& other = resources[transients[i]];
+                bool memoryOverlaps = other.heapOffset < resource.heapOffset + resource.desc.size &&
+                    resource.heapOffset < other.heapOffset + other.desc.size;
+                if (i != t && memoryOverlaps && other.lastUse < resource.firstUse && other.lastUse >= latestUse)
+                {
+                    latestUse = other.lastUse;
+                    resource.aliasedFrom = transients[i];
+                }
+            }
+        }
+    }
+
+    void ComputeBarriers()
+    {
+        passBarriers.assign(order.size(), std::vector<RenderGraphBarrier>());
+        finalBarriers.clear();
+
+        // Transients start the graph in the state the previous execution left them in: the last write, or
+        // every read state after it since consecutive reads share one transition.
+        std::vector<uint32_t> current(resources.size());
+        std::vector<uint32_t> endState(resources.size(), RenderGraphStateCommon);
+        for (size_t r = 0; r < resources.size(); ++r)
+        {
+            current[r] = resources[r].initialState;
+        }
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            const Pass& pass = passes[order[i]];
+            for (size_t a = 0; a < pass.accesses.size(); ++a)
+            {
+                uint32_t state = pass.accesses[a].state;
+                uint32_t& end = endState[pass.accesses[a].resource];
+                end = IsWrite(state) || IsWrite(end) ? state : end | state;
+            }
+        }
+        for (size_t r = 0; r < resources.size(); ++r)
+        {
+            if (!resources[r].imported)
+            {
+                current[r] = endState[r];
+                resources[r].lastState = endState[r];
+            }
+        }
+
+        for (uint32_t i = 0; i < uint32_t(order.size()); ++i)
+        {
+            const Pass& pass = passes[order[i]];
+            std::vector<RenderGraphBarrier>& barriers = passBarriers[i];
+            for (size_t a = 0; a < pass.accesses.size(); ++a)
+            {
+                RenderGraphResourceHandle r = pass.accesses[a].resource;
+                uint32_t state = pass.accesses[a].state;
+                const Resource& resource = resources[r];
+
+                if (!resource.imported && resource.firstUse == i && resource.aliasedFrom != RenderGraphInvalidHandle)
+                {
+                    RenderGraphBarrier barrier = { RenderGraphBarrier::Aliasing, r, resource.aliasedFrom, 0, 0 };
+                    barriers.push_back(barrier);
+                }
+
+                if (IsWrite(state))
+                {
+                    if (current[r] != state)
+                    {
+                        RenderGraphBarrier barrier = { RenderGraphBarrier::Transition, r, RenderGraphInvalidHandle, current[r], state };
+                        barriers.push_back(barrier);
+                        current[r] = state;
+                    }
+                    else if (state == RenderGraphStateUnorderedAccess && i > resource.firstUse)
+                    {
+                        RenderGraphBarrier barrier = { RenderGraphBarrier::UnorderedAccess, r, RenderGraphInvalidHandle, state, state };
+                        barriers.push_back(barrier);
+                    }
+                }
+                else if ((current[r] & state) != state || IsWrite(current[r]))
+                {
+                    // go straight to every read state used until the next write, later readers need no barrier
+                    uint32_t readState = state;
+                    for (uint32_t j = i + 1; j < uint32_t(order.size()); ++j)
+                    {
+                        uint32_t next = StateIn(order[j], r);
+                        if (IsWrite(next))
+                        {
+                            break;
+                        }
+                        readState |= next;
+                    }
+                    if (current[r] != readState)
+                    {
+                        RenderGraphBarrier barrier = { RenderGraphBarrier::Transition, r, RenderGraphInvalidHandle, current[r], readState };
+                        barriers.push_back(barrier);
+                        current[r] = readState;
+                    }
+                }
+            }
+            statistics.barriers += unsigned(barriers.size());
+        }
+
+        for (RenderGraphResourceHandle r = 0; r < RenderGraphResourceHandle(resources.size()); ++r)
+        {
+            if (resources[r].imported && current[r] != resources[r].finalState)
+            {
+                RenderGraphBarrier barrier = { RenderGraphBarrier::Transition, r, RenderGraphInvalidHandle, current[r], resources[r].finalState };
+                finalBarriers.push_back(barrier);
+            }
+            else if (!resources[r].imported)
+            {
+                resources[r].lastState = current[r];
+            }
+        }
+        statistics.barriers += unsigned(finalBarriers.size());
+    }
+
+    // state pass uses resource in, 0 if it does not use it
+    uint32_t StateIn(uint32_t pass, RenderGraphResourceHandle resource) const
+    {
+        const std::vector<Access>& accesses = passes[pass].accesses;
+        std::vector<Access>::const_iterator it = std::lower_bound(accesses.begin(), accesses.end(), resource,
+            [](const Access& access, RenderGraphResourceHandle r) { return access.resource < r; });
+        return it != accesses.end() && it->resource == resource ? it->state : 0;
+    }
+
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    std::vector<RenderGraphPassHandle> order;
+    std::vector<std::vector<RenderGraphBarrier>> passBarriers;
+    std::vector<RenderGraphBarrier> finalBarriers;
+    uint64_t heapSize = 0;
+    RenderGraphStatistics statistics = {};
+    bool compiled = false;
+};
@@ -0,0 +1,213 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Hand off between the game thread, which produces a render packet per frame, and the render thread, which
+// consumes it. Packets travel through two bounded lock free single producer single consumer rings: filled
+// packets to the render thread and consumed packets back to the game thread, so neither side ever allocates
+// or takes a lock and the game thread can run at most pipelineDepth frames ahead of the render thread.
+
+// bounded single producer single consumer ring, Capacity must be a power of two
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // producer only
+    bool Push(const T& item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        items[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool Pop(T& item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = items[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // producer and consumer indices on their own cache lines
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    T items[Capacity];
+};
+
+struct RenderPipelineStatistics
+{
+    uint64_t framesProduced;
+    uint64_t framesConsumed;
+    double averageLatencyMs;   // packet written by the game thread -> render thread done with it
+    double maxLatencyMs;
+    double gameWaitMs;         // total time the game thread waited for a free packet
+    double renderWaitMs;       // total time the render thread waited for a packet
+    double framesPerSecond;    // consumed packets per second since Init
+};
+
+template <typename Packet>
+class RenderPacketPipeline
+{
+public:
+    static const size_t MaxPackets = 4;
+
+    RenderPacketPipeline() : closed(false), framesProduced(0), framesConsumed(0), latencySumNs(0), latencyMaxNs(0),
+        gameWaitNs(0), renderWaitNs(0)
+    {
+    }
+
+    // pipelineDepth is how many frames the game thread may be ahead, 0 runs the threads in lock step and
+    // 1 double buffers the packets
+    void Init(size_t pipelineDepth)
+    {
+        packetCount = std::min(pipelineDepth + 1, MaxPackets);
+        Packet* packet;
+        while (freePackets.Pop(packet)) {}
+        while (readyPackets.Pop(packet)) {}
+        for (size_t i = 0; i < packetCount; ++i)
+        {
+            freePackets.Push(&packets[i]);
+        }
+        closed = false;
+        startTime = Clock::now();
+        framesProduced = framesConsumed = 0;
+        latencySumNs = latencyMaxNs = gameWaitNs = renderWaitNs = 0;
+    }
+
+    // game thread, the packet to fill for the next frame or nullptr once the pipeline is closed
+    Packet* BeginWrite()
+    {
+        Clock::time_point start = Clock::now();
+        Packet* packet = nullptr;
+        unsigned int attempt = 0;
+        while (!freePackets.Pop(packet))
+        {
+            if (closed.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+            Backoff(attempt);
+        }
+        gameWaitNs.fetch_add(Nanoseconds(start), std::memory_order_relaxed);
+        return packet;
+    }
+
+    // game thread, hand a filled packet to the render thread
+    void EndWrite(Packet* packet)
+    {
+        writeTimes[packet - packets] = Clock::now();
+        framesProduced.fetch_add(1, std::memory_order_relaxed);
+        readyPackets.Push(packet);
+    }
+
+    // render thread, the oldest filled packet or nullptr once the pipeline is closed and drained
+    Packet* BeginRead()
+    {
+        Clock::time_point start = Clock::now();
+        Packet* packet = nullptr;
+        unsigned int attempt = 0;
+        while (!readyPackets.Pop(packet))
+        {
+            if (closed.load(std::memory_order_acquire))
+            {
+                // a packet handed over right before Close is still drained
+                if (!readyPackets.Pop(packet))
+                {
+                    return nullptr;
+                }
+                break;
+            }
+            Backoff(attempt);
+        }
+        renderWaitNs.fetch_add(Nanoseconds(start), std::memory_order_relaxed);
+        return packet;
+    }
+
+    // render thread, the packet is rendered and may be reused by the game thread
+    void EndRead(Packet* packet)
+    {
+        uint64_t latency = Nanoseconds(writeTimes[packet - packets]);
+        latencySumNs.fetch_add(latency, std::memory_order_relaxed);
+        if (latency > latencyMaxNs.load(std::memory_order_relaxed))
+        {
+            latencyMaxNs.store(latency, std::memory_order_relaxed);
+        }
+        framesConsumed.fetch_add(1, std::memory_order_relaxed);
+        freePackets.Push(packet);
+    }
+
+    // either thread, wakes up the other side, Begin* return nullptr from now on
+    void Close()
+    {
+        closed.store(true, std::memory_order_release);
+    }
+
+    bool Closed() const { return closed.load(std::memory_order_acquire); }
+
+    RenderPipelineStatistics Statistics() const
+    {
+        RenderPipelineStatistics stats = {};
+        stats.framesProduced = framesProduced.load(std::memory_order_relaxed);
+        stats.framesConsumed = framesConsumed.load(std::memory_order_relaxed);
+        stats.averageLatencyMs = stats.framesConsumed == 0 ? 0.0 : latencySumNs.load(std::memory_order_relaxed) / 1e6 / stats.framesConsumed;
+        stats.maxLatencyMs = latencyMaxNs.load(std::memory_order_relaxed) / 1e6;
+        stats.gameWaitMs = gameWaitNs.load(std::memory_order_relaxed) / 1e6;
+        stats.renderWaitMs = renderWaitNs.load(std::memory_order_relaxed) / 1e6;
+        double seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+        stats.framesPerSecond = seconds > 0 ? stats.framesConsumed / seconds : 0.0;
+        return stats;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static uint64_t Nanoseconds(Clock::time_point since)
+    {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count());
+    }
+
+    // the other side usually needs a good part of a frame, yield first and then sleep in small steps
+    static void Backoff(unsigned int& attempt)
+    {
+        if (attempt++ < 256)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    Packet packets[MaxPackets];
+    Clock::time_point writeTimes[MaxPackets];
+    size_t packetCount = 0;
+    SpscQueue<Packet*, MaxPackets> freePackets;
+    SpscQueue<Packet*, MaxPackets> readyPackets;
+    std::atomic<bool> closed;
+
+    Clock::time_point startTime;
+    std::atomic<uint64_t> framesProduced;
+    std::atomic<uint64_t> framesConsumed;
+    std::atomic<uint64_t> latencySumNs;
+    std::atomic<uint64_t> latencyMaxNs;
+    std::atomic<uint64_t> gameWaitNs;
+    std::atomic<uint64_t> renderWaitNs;
+};
@@ -0,0 +1,265 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Residency. Tracked objects (heaps) are kept resident while they fit into the budget, when they do not the
+// least recently used ones are evicted and an evicted object is made resident again before a frame that
+// uses it executes. Objects a frame in flight may still read are never evicted, when everything else is
+// evicted and the budget is still exceeded the frame is only counted as over budget.
+//
+// Resident objects sit in a list ordered by last use, a use moves an object to the back so eviction takes
+// from the front. Nothing here talks to the graphics API: the caller makes the objects EndFrame returns
+// resident or evicts them.
+
+struct ResidencyFrameTelemetry
+{
+    uint64_t frame;
+    uint64_t budget;            // what the tracked objects may use this frame
+    uint64_t residentBytes;     // after this frame's evictions
+    uint64_t evictedBytes;      // tracked, not resident
+    uint64_t usedBytes;         // referenced by this frame
+    uint32_t madeResident;      // this frame
+    uint64_t madeResidentBytes;
+    uint32_t evicted;           // this frame
+    uint64_t evictedThisFrameBytes;
+    bool overBudget;
+};
+
+struct ResidencyStatistics
+{
+    uint64_t frames;
+    uint64_t overBudgetFrames;
+    uint64_t madeResident;
+    uint64_t madeResidentBytes;
+    uint64_t evicted;
+    uint64_t evictedBytes;
+    uint64_t peakResidentBytes;
+    uint32_t trackedObjects;
+    uint64_t trackedBytes;
+};
+
+template <typename Object>
+class ResidencyManager
+{
+public:
+    static const uint32_t InvalidHandle = 0xffffffff;
+
+    // any thread, the object is resident when it is created and counts as used by the current frame
+    uint32_t Track(Object* object, uint64_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry entry = { object, size, frame, true, false, InvalidHandle, InvalidHandle };
+        uint32_t handle;
+        if (!unusedEntries.empty())
+        {
+            handle = unusedEntries.back();
+            unusedEntries.pop_back();
+            entries[handle] = entry;
+        }
+        else
+        {
+            entries.push_back(entry);
+            handle = uint32_t(entries.size() - 1);
+        }
+        PushBack(handle);
+        residentBytes += size;
+        trackedBytes += size;
+        trackedObjects++;
+        statistics.peakResidentBytes = std::max(statistics.peakResidentBytes, residentBytes);
+        return handle;
+    }
+
+    // any thread, before the object is destroyed
+    void Untrack(uint32_t handle)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = entries[handle];
+        if (entry.resident)
+        {
+            Unlink(handle);
+            residentBytes -= entry.size;
+        }
+        trackedBytes -= entry.size;
+        trackedObjects--;
+        // a pending restore of it is dropped in EndFrame
+        entry.object = nullptr;
+        entry.restorePending = false;
+        unusedEntries.push_back(handle);
+    }
+
+    // start frame, every frame up to completedFrame finished on the GPU
+    void BeginFrame(uint64_t frameValue, uint64_t completedFrameValue, uint64_t budgetBytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frame = frameValue;
+        completedFrame = completedFrameValue;
+        budget = budgetBytes;
+        usedBytes = 0;
+        restores.clear();
+    }
+
+    // the frame being recorded reads the object
+    void Use(uint32_t handle)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = entries[handle];
+        if (entry.usedFrame == frame && (entry.resident || entry.restorePending))
+        {
+            return;
+        }
+        entry.usedFrame = frame;
+        usedBytes += entry.size;
+        if (entry.resident)
+        {
+            Unlink(handle);
+            PushBack(handle);
+        }
+        else if (!entry.restorePending)
+        {
+            entry.restorePending = true;
+            restores.push_back(handle);
+        }
+    }
+
+    // The frame's uses are in: makeResident gets the evicted objects it uses, evict the least recently used
+    // objects the GPU is done with until the resident ones fit the budget. Both go to the API before the
+    // frame executes.
+    ResidencyFrameTelemetry EndFrame(std::vector<Object*>& makeResident, std::vector<Object*>& evict)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ResidencyFrameTelemetry telemetry = {};
+        telemetry.frame = frame;
+        telemetry.budget = budget;
+        telemetry.usedBytes = usedBytes;
+
+        for (size_t i = 0; i < restores.size(); ++i)
+        {
+            Entry& entry = entries[restores[i]];
+            if (!entry.restorePending)
+            {
+                continue;
+            }
+            entry.restorePending = false;
+            entry.resident = true;
+            PushBack(restores[i]);
+            residentBytes += entry.size;
+            makeResident.push_back(entry.object);
+            telemetry.madeResident++;
+            telemetry.madeResidentBytes += entry.size;
+        }
+        restores.clear();
+
+        while (residentBytes > budget && lruFront != InvalidHandle && entries[lruFront].usedFrame <= completedFrame)
+        {
+            uint32_t handle = lruFront;
+            Entry& entry = entries[handle];
+            Unlink(handle);
+            entry.resident = false;
+            residentBytes -= entry.size;
+            evict.push_back(entry.object);
+            telemetry.evicted++;
+            telemetry.evictedThisFrameBytes += entry.size;
+        }
+
+        telemetry.residentBytes = residentBytes;
+        telemetry.evictedBytes = trackedBytes - residentBytes;
+        telemetry.overBudget = residentBytes > budget;
+
+        statistics.frames++;
+        statistics.overBudgetFrames += telemetry.overBudget ? 1 : 0;
+        statistics.madeResident += telemetry.madeResident;
+        statistics.madeResidentBytes += telemetry.madeResidentBytes;
+        statistics.evicted += telemetry.evicted;
+        statistics.evictedBytes += telemetry.evictedThisFrameBytes;
+        statistics.peakResidentBytes = std::max(statistics.peakResidentBytes, residentBytes);
+        return telemetry;
+    }
+
+    uint64_t ResidentBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return residentBytes;
+    }
+
+    bool IsResident(uint32_t handle) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries[handle].resident;
+    }
+
+    ResidencyStatistics Statistics() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ResidencyStatistics result = statistics;
+        result.trackedObjects = trackedObjects;
+        result.trackedBytes = trackedBytes;
+        return result;
+    }
+
+private:
+    struct Entry
+    {
+        Object* object;
+        uint64_t size;
+        uint64_t usedFrame;
+        bool resident;
+        bool restorePending;
+        uint32_t previous;      // resident list
+        uint32_t next;
+    };
+
+    void PushBack(uint32_t handle)
+    {
+        entries[handle].previous = lruBack;
+        entries[handle].next = InvalidHandle;
+        if (lruBack != InvalidHandle)
+        {
+            entries[lruBack].next = handle;
+        }
+        else
+        {
+            lruFront = handle;
+        }
+        lruBack = handle;
+    }
+
+    void Unlink(uint32_t handle)
+    {
+        Entry& entry = entries[handle];
+        if (entry.previous != InvalidHandle)
+        {
+            entries[entry.previous].next = entry.next;
+        }
+        else
+        {
+            lruFront = entry.next;
+        }
+        if (entry.next != InvalidHandle)
+        {
+            entries[entry.next].previous = entry.previous;
+        }
+        else
+        {
+            lruBack = entry.previous;
+        }
+        entry.previous = entry.next = InvalidHandle;
+    }
+
+    mutable std::mutex mutex;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> unusedEntries;
+    std::vector<uint32_t> restores;
+    uint32_t lruFront = InvalidHandle;
+    uint32_t lruBack = InvalidHandle;
+    uint64_t frame = 0;
+    uint64_t completedFrame = 0;
+    uint64_t budget = UINT64_MAX;
+    uint64_t residentBytes = 0;
+    uint64_t trackedBytes = 0;
+    uint32_t trackedObjects = 0;
+    uint64_t usedBytes = 0;
+    ResidencyStatistics statistics = {};
+};
@@ -0,0 +1,354 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Resource state tracking. Every command list gets a ResourceStateTracker that knows the state each
+// resource (or subresource) is in after the barriers recorded so far. Transitions to the state a resource
+// is already in are dropped, transitions queued before the next flush are merged (A->B, B->C becomes
+// A->C) and a flush records all of them with one call. The first time a list touches a resource it cannot
+// know the state, lists are recorded in parallel and submitted later, so that transition stays pending.
+// At submission ResourceStateTable resolves the pending transitions against the global state of every
+// resource, they are recorded into a list that executes right before, and stores the final states of the
+// list as the new global states.
+//
+// States are API bit masks, readOnlyStates tells which of the bits only read, a resource in a combination
+// of read states needs no barrier to be used in a subset of them.
+
+const uint32_t AllSubresources = 0xffffffff;
+
+// state of a resource a command list has not used yet
+const uint32_t UnknownResourceState = 0xffffffff;
+
+template <typename Resource>
+struct ResourceBarrierRecord
+{
+    enum Type
+    {
+        Transition,
+        UnorderedAccess,
+        Aliasing
+    };
+
+    Type type;
+    Resource* resource;
+    Resource* before;       // Aliasing only
+    uint32_t subresource;
+    uint32_t stateBefore;
+    uint32_t stateAfter;
+};
+
+// state of a resource, subresources that were transitioned on their own override the whole resource state
+struct TrackedResourceState
+{
+    uint32_t state = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> subresources;
+
+    uint32_t Get(uint32_t subresource) const
+    {
+        for (size_t i = 0; i < subresources.size(); ++i)
+        {
+            if (subresources[i].first == subresource)
+            {
+                return subresources[i].second;
+            }
+        }
+        return state;
+    }
+
+    void Set(uint32_t subresource, uint32_t newState)
+    {
+        if (subresource == AllSubresources)
+        {
+            state = newState;
+            subresources.clear();
+            return;
+        }
+        for (size_t i = 0; i < subresources.size(); ++i)
+        {
+            if (subresources[i].first == subresource)
+            {
+                subresources[i].second = newState;
+                return;
+            }
+        }
+        subresources.push_back(std::make_pair(subresource, newState));
+    }
+};
+
+namespace resourcestates
+{
+    // a resource in before can be used in after without a barrier
+    inline bool Covers(uint32_t before, uint32_t after, uint32_t readOnlyStates)
+    {
+        if (before == after)
+        {
+            return true;
+        }
+        bool readOnly = after != 0 && (after & ~readOnlyStates) == 0 && (before & ~readOnlyStates) == 0;
+        return readOnly && (before & after) == after;
+    }
+
+    // barriers that take a resource from current to after, whole or one subresource
+    template <typename Resource>
+    void AppendTransitions(Resource* resource, const TrackedResourceState& current, uint32_t subresource, uint32_t after,
+        uint32_t readOnlyStates, std::vector<ResourceBarrierRecord<Resource>>& barriers)
+    {
+        typedef ResourceBarrierRecord<Resource> Barrier;
+        if (subresource != AllSubresources || current.subresources.empty())
+        {
+            uint32_t before = current.Get(subresource);
+            if (!Covers(before, after, readOnlyStates))
+            {
+                Barrier barrier = { Barrier::Transition, resource, nullptr, subresource, before, after };
+                barriers.push_back(barrier);
+            }
+            return;
+        }
+
+        // A whole resource transition needs every subresource in the same state: bring the ones that went
+        // their own way to the target, or back to the resource state when that has to move as well.
+        uint32_t common = current.state == after ? after : current.state;
+        for (size_t i = 0; i < current.subresources.size(); ++i)
+        {
+            if (current.subresources[i].second != common)
+            {
+                Barrier barrier = { Barrier::Transition, resource, nullptr, current.subresources[i].first,
+                    current.subresources[i].second, common };
+                barriers.push_back(barrier);
+            }
+        }
+        if (current.state != after)
+        {
+            Barrier barrier = { Barrier::Transition, resource, nullptr, AllSubresources, current.state, after };
+            barriers.push_back(barrier);
+        }
+    }
+}
+
+template <typename Resource>
+class ResourceStateTable;
+
+template <typename Resource>
+class ResourceStateTracker
+{
+public:
+    typedef ResourceBarrierRecord<Resource> Barrier;
+
+    explicit ResourceStateTracker(uint32_t readOnlyStates = 0) : readOnlyStates(readOnlyStates) {}
+
+    // forget everything, for a list that starts recording again
+    void Reset()
+    {
+        states.clear();
+        barriers.clear();
+        pending.clear();
+    }
+
+    void TransitionResource(Resource* resource, uint32_t state, uint32_t subresource = AllSubresources)
+    {
+        typename std::unordered_map<Resource*, TrackedResourceState>::iterator known = states.find(resource);
+        if (known == states.end())
+        {
+            TrackedResourceState unknown;
+            unknown.state = UnknownResourceState;
+            known = states.insert(std::make_pair(resource, unknown)).first;
+        }
+        TrackedResourceState& current = known->second;
+
+        // first use of the resource (or this subresource) in the list, the state before is only known at
+        // submission, subresources this list already moved keep their own barriers
+        if (current.Get(subresource) == UnknownResourceState)
+        {
+            Barrier barrier = { Barrier::Transition, resource, nullptr, subresource, UnknownResourceState, state };
+            pending.push_back(barrier);
+            if (subresource == AllSubresources)
+            {
+                for (size_t i = 0; i < current.subresources.size(); ++i)
+                {
+                    if (current.subresources[i].second != state)
+                    {
+                        QueueTransition(resource, current.subresources[i].first, current.subresources[i].second, state);
+                    }
+                }
+            }
+            current.Set(subresource, state);
+            return;
+        }
+
+        std::vector<Barrier> transitions;
+        resourcestates::AppendTransitions(resource, current, subresource, state, readOnlyStates, transitions);
+        for (size_t i = 0; i < transitions.size(); ++i)
+        {
+            QueueTransition(resource, transitions[i].subresource, transitions[i].stateBefore, transitions[i].stateAfter);
+        }
+        if (!transitions.empty())
+        {
+            current.Set(subresource, state);
+        }
+    }
+
+    // order unordered access writes to resource (nullptr: to any resource)
+    void UAVBarrier(Resource* resource)
+    {
+        Barrier barrier = { Barrier::UnorderedAccess, resource, nullptr, AllSubresources, 0, 0 };
+        barriers.push_back(barrier);
+    }
+
+    // after takes over the memory of before (nullptr: of any resource) in a placed heap
+    void AliasBarrier(Resource* before, Resource* after)
+    {
+        Barrier barrier = { Barrier::Aliasing, after, before, AllSubresources, 0, 0 };
+        barriers.push_back(barrier);
+    }
+
+    // record(const Barrier* barriers, size_t count) once with everything queued since the last flush,
+    // call before recording commands that rely on the new states
+    template <typename RecordFunction>
+    size_t FlushBarriers(RecordFunction record)
+    {
+        size_t count = barriers.size();
+        if (count > 0)
+        {
+            record(barriers.data(), count);
+            barriers.clear();
+        }
+        return count;
+    }
+
+    size_t QueuedBarrierCount() const { return barriers.size(); }
+    const std::vector<Barrier>& PendingBarriers() const { return pending; }
+
+    // state of resource once every recorded barrier executed, UnknownResourceState for subresources the
+    // list never touched
+    uint32_t State(Resource* resource, uint32_t subresource = AllSubresources) const
+    {
+        typename std::unordered_map<Resource*, TrackedResourceState>::const_iterator it = states.find(resource);
+        return it == states.end() ? UnknownResourceState : it->second.Get(subresource);
+    }
+
+private:
+    friend class ResourceStateTable<Resource>;
+
+    // queue before -> after, folded into a queued transition of the subresource that ends in before
+    void QueueTransition(Resource* resource, uint32_t subresource, uint32_t before, uint32_t after)
+    {
+        for (size_t i = barriers.size(); i-- > 0; )
+        {
+            Barrier& queued = barriers[i];
+            if (queued.resource != resource)
+            {
+                continue;
+            }
+            if (queued.type == Barrier::Transition && queued.subresource == subresource && queued.stateAfter == before)
+            {
+                queued.stateAfter = after;
+                if (queued.stateBefore == after)
+                {
+                    barriers.erase(barriers.begin() + i);
+                }
+                return;
+            }
+            break;
+        }
+        Barrier barrier = { Barrier::Transition, resource, nullptr, subresource, before, after };
+        barriers.push_back(barrier);
+    }
+
+    uint32_t readOnlyStates;
+    std::unordered_map<Resource*, TrackedResourceState> states;
+    std::vector<Barrier> barriers;
+    std::vector<Barrier> pending;
+};
+
+// global state of every resource between command lists, shared by all threads
+template <typename Resource>
+class ResourceStateTable
+{
+public:
+    typedef ResourceBarrierRecord<Resource> Barrier;
+
+    ResourceStateTable() {}
+
+    // a new resource and the state it was created in
+    void Register(Resource* resource, uint32_t state)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        states[resource].Set(AllSubresources, state);
+    }
+
+    void Unregister(Resource* resource)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        states.erase(resource);
+    }
+
+    uint32_t State(Resource* resource, uint32_t subresource = AllSubresources) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        typename std::unordered_map<Resource*, TrackedResourceState>::const_iterator it = states.find(resource);
+        return it == states.end() ? UnknownResourceState : it->second.Get(subresource);
+    }
+
+    // Call for the lists of a submission in submission order. Appends the barriers the pending transitions
+    // of tracker need to resolved, they have to execute right before the list, and makes the final states
+    // of the list the global ones. The tracker is reset. false if the list used a resource the table does
+    // not know, it is taken to be in the state the list expected.
+    bool Resolve(ResourceStateTracker<Resource>& tracker, std::vector<Barrier>& resolved)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool known = true;
+
+        // whole resource transitions first, a subresource the list moved on its own before is brought to
+        // the state the list expects it in afterwards
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (size_t i = 0; i < tracker.pending.size(); ++i)
+            {
+                const Barrier& barrier = tracker.pending[i];
+                if ((barrier.subresource == AllSubresources) != (pass == 0))
+                {
+                    continue;
+                }
+                typename std::unordered_map<Resource*, TrackedResourceState>::iterator it = states.find(barrier.resource);
+                if (it == states.end())
+                {
+                    known = false;
+                    continue;
+                }
+                // the list recorded its barriers from exactly this state, a covering read state is not enough
+                size_t first = resolved.size();
+                resourcestates::AppendTransitions(barrier.resource, it->second, barrier.subresource, barrier.stateAfter,
+                    0, resolved);
+                if (resolved.size() > first)
+                {
+                    it->second.Set(barrier.subresource, barrier.stateAfter);
+                }
+            }
+        }
+
+        typename std::unordered_map<Resource*, TrackedResourceState>::const_iterator final = tracker.states.begin();
+        for (; final != tracker.states.end(); ++final)
+        {
+            TrackedResourceState& global = states[final->first];
+            if (final->second.state != UnknownResourceState)
+            {
+                global = final->second;
+                continue;
+            }
+            for (size_t s = 0; s < final->second.subresources.size(); ++s)
+            {
+                global.Set(final->second.subresources[s].first, final->second.subresources[s].second);
+            }
+        }
+        tracker.Reset();
+        return known;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<Resource*, TrackedResourceState> states;
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <utility>
+#include <cstdio>
+#include <cstdint>
+#include "PipelineCache.h"
+
+// Precompiled shaders. BuildShaders.py compiles every permutation listed in ShaderList.txt with DXC into
+// ShaderCache/<key>.cso, the key being a hash of the source, every file it includes, the entry point,
+// profile, defines and compiler arguments, so unchanged shaders are never compiled twice and a stale blob
+// can never be picked up. ShaderCache/manifest.txt maps permutation names to keys for the runtime.
+// The key is computed the same way here and in BuildShaders.py, change both together.
+
+// passed to DXC by BuildShaders.py, which reads them from this line
+const char* const ShaderCompilerArguments = "-O3 -Qstrip_debug -Qstrip_reflect";
+const char* const ShaderCacheDirectory = "ShaderCache";
+
+struct ShaderPermutation
+{
+    std::string source;
+    std::string entry;
+    std::string profile;
+    std::vector<std::pair<std::string, std::string>> defines;
+};
+
+// "source|entry|profile|NAME=VALUE;NAME=VALUE" with the defines sorted by name
+inline std::string ShaderPermutationName(const ShaderPermutation& permutation)
+{
+    std::vector<std::pair<std::string, std::string>> defines = permutation.defines;
+    std::sort(defines.begin(), defines.end());
+    std::string name = permutation.source + "|" + permutation.entry + "|" + permutation.profile + "|";
+    for (size_t i = 0; i < defines.size(); ++i)
+    {
+        name += (i > 0 ? ";" : "") + defines[i].first + "=" + defines[i].second;
+    }
+    return name;
+}
+
+inline bool ReadShaderFile(const std::string& path, std::string& text)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    text = stream.str();
+    return true;
+}
+
+inline std::string ShaderDirectoryOf(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// #include "file" directives of text in order, system includes are not followed
+inline void FindShaderIncludes(const std::string& text, std::vector<std::string>& includes)
+{
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+        {
+            continue;
+        }
+        size_t open = line.find('"', start + 8);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close != std::string::npos)
+        {
+            includes.push_back(line.substr(open + 1, close - open - 1));
+        }
+    }
+}
+
+// source and every file it includes, depth first in include order, each file once
+inline bool CollectShaderFiles(const std::string& path, std::vector<std::string>& files)
+{
+    if (std::find(files.begin(), files.end(), path) != files.end())
+    {
+        return true;
+    }
+    std::string text;
+    if (!ReadShaderFile(path, text))
+    {
+        return false;
+    }
+    files.push_back(path);
+
+    std::vector<std::string> includes;
+    FindShaderIncludes(text, includes);
+    for (size_t i = 0; i < includes.size(); ++i)
+    {
+        if (!CollectShaderFiles(ShaderDirectoryOf(path) + includes[i], files))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// content key of a permutation, sources are looked up relative to directory
+inline bool ComputeShaderKey(const std::string& directory, const ShaderPermutation& permutation, uint64_t& key)
+{
+    std::vector<std::string> files;
+    if (!CollectShaderFiles(directory + permutation.source, files))
+    {
+        return false;
+    }
+
+    PipelineHasher hasher;
+    std::string header = ShaderPermutationName(permutation) + "\n" + ShaderCompilerArguments + "\n";
+    hasher.Add(header.data(), header.size());
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        std::string text;
+        ReadShaderFile(files[i], text);
+        std::string name = files[i].substr(directory.size()) + "\n";
+        hasher.Add(name.data(), name.size());
+        hasher.Add(text.data(), text.size());
+    }
+    key = hasher.Hash();
+    return true;
+}
+
+inline std::string ShaderBlobPath(const std::string& directory, uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.cso", (unsigned long long)key);
+    return directory + ShaderCacheDirectory + "/" + name;
+}
+
+// manifest.txt: "name key" per line, key in hex
+inline bool ReadShaderManifest(const std::string& directory, std::vector<std::pair<std::string, uint64_t>>& entries)
+{
+    std::ifstream file(directory + ShaderCacheDirectory + "/manifest.txt");
+    if (!file.is_open())
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t space = line.find_last_of(' ');
+        if (line.empty() || line[0] == '#' || space == std::string::npos)
+        {
+            continue;
+        }
+        entries.push_back(std::make_pair(line.substr(0, space), std::stoull(line.substr(space + 1), nullptr, 16)));
+    }
+    return true;
+}
+
+inline bool ReadShaderBlob(const std::string& path, std::vector<unsigned char>& blob)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    blob.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !blob.empty();
+}
+
+// Precompiled bytecode of permutation. checkSources hashes the sources on disk and only accepts a blob
+// built from exactly them (development), otherwise the manifest written by the last build decides
+// (shipping, the sources need not be there).
+inline bool LoadPrecompiledShader(const std::string& directory, const ShaderPermutation& permutation, bool checkSources,
+    std::vector<unsigned char>& blob)
+{
+    uint64_t key = 0;
+    if (checkSources)
+    {
+        if (!ComputeShaderKey(directory, permutation, key))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        std::vector<std::pair<std::string, uint64_t>> manifest;
+        if (!ReadShaderManifest(directory, manifest))
+        {
+            return false;
+        }
+        std::string name = ShaderPermutationName(permutation);
+        size_t i = 0;
+        while (i < manifest.size() && manifest[i].first != name)
+        {
+            i++;
+        }
+        if (i == manifest.size())
+        {
+            return false;
+        }
+        key = manifest[i].second;
+    }
+    return ReadShaderBlob(ShaderBlobPath(directory, key), blob);
+}
@@ -0,0 +1,479 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include "ShaderCache.h"
+
+// Shader hot reload for development builds. ShaderFileWatcher reports the files written in the watched
+// directories, ShaderDependencyGraph knows which permutations read a file (the source and everything it
+// includes) and ShaderHotReloader ties both together on a background thread: it waits for changes, lets
+// editors finish saving, recompiles the permutations that depend on the changed files and queues the new
+// bytecode. The render thread takes it at a frame boundary and swaps the pipelines once they are built, a
+// shader that fails to compile keeps the old one running.
+
+// files written in a set of directories, inotify on Linux, ReadDirectoryChangesW on Windows
+class ShaderFileWatcher
+{
+public:
+    ShaderFileWatcher() {}
+    ~ShaderFileWatcher() { Close(); }
+
+    ShaderFileWatcher(const ShaderFileWatcher&) = delete;
+    ShaderFileWatcher& operator=(const ShaderFileWatcher&) = delete;
+
+    // directory ends in a slash, "" is the working directory, changes are reported as directory + name
+    bool Watch(const std::string& directory)
+    {
+        for (size_t i = 0; i < directories.size(); ++i)
+        {
+            if (directories[i]->path == directory)
+            {
+                return true;
+            }
+        }
+        std::unique_ptr<Directory> watched(new Directory());
+        watched->path = directory;
+        std::string native = directory.empty() ? std::string(".") : directory;
+#ifdef _WIN32
+        watched->handle = CreateFileA(native.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (watched->handle == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        watched->overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        if (watched->overlapped.hEvent == nullptr || !Arm(*watched))
+        {
+            Release(*watched);
+            return false;
+        }
+#else
+        if (notify < 0)
+        {
+            notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (notify < 0)
+            {
+                return false;
+            }
+        }
+        // editors either write the file in place or write another one and rename it over
+        watched->descriptor = inotify_add_watch(notify, native.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watched->descriptor < 0)
+        {
+            return false;
+        }
+#endif
+        directories.push_back(std::move(watched));
+        return true;
+    }
+
+    // Wait up to timeoutMs for changes and append the changed files, a file can be reported more than once.
+    // false when nothing changed.
+    bool Wait(unsigned int timeoutMs, std::vector<std::string>& changed)
+    {
+        size_t first = changed.size();
+#ifdef _WIN32
+        if (directories.empty())
+        {
+            Sleep(timeoutMs);
+            return false;
+        }
+        std::vector<HANDLE> events;
+        for (size_t i = 0; i < directories.size() && i < MAXIMUM_WAIT_OBJECTS; ++i)
+        {
+            events.push_back(directories[i]->overlapped.hEvent);
+        }
+        DWORD result = WaitForMultipleObjects(DWORD(events.size()), events.data(), FALSE, timeoutMs);
+        if (result >= WAIT_OBJECT_0 + events.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < directories.size(); ++i)
+        {
+            Directory& directory = *directories[i];
+            DWORD bytes = 0;
+            if (!GetOverlappedResult(directory.handle, &directory.overlapped, &bytes, FALSE))
+            {
+                continue;
+            }
+            // bytes == 0: the buffer overflowed, the changes are lost, nothing to report
+            const unsigned char* entry = reinterpret_cast<const unsigned char*>(directory.buffer);
+            while (bytes > 0)
+            {
+                const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(entry);
+                if (info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+                {
+                    int length = int(info->FileNameLength / sizeof(WCHAR));
+                    int size = WideCharToMultiByte(CP_UTF8, 0, info->FileName, length, nullptr, 0, nullptr, nullptr);
+                    std::string name(size_t(size), '\0');
+                    WideCharToMultiByte(CP_UTF8, 0, info->FileName, length, &name[0], size, nullptr, nullptr);
+                    std::replace(name.begin(), name.end(), '\\', '/');
+                    changed.push_back(directory.path + name);
+                }
+                if (info->NextEntryOffset == 0)
+                {
+                    break;
+                }
+                entry += info->NextEntryOffset;
+            }
+            ResetEvent(directory.overlapped.hEvent);
+            Arm(directory);
+        }
+#else
+        if (notify < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+            return false;
+        }
+        pollfd descriptor = { notify, POLLIN, 0 };
+        if (poll(&descriptor, 1, int(timeoutMs)) <= 0)
+        {
+            return false;
+        }
+        alignas(inotify_event) char buffer[4096];
+        ssize_t bytes;
+        while ((bytes = read(notify, buffer, sizeof(buffer))) > 0)
+        {
+            for (ssize_t offset = 0; offset < bytes; )
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->len == 0)
+                {
+                    continue;
+                }
+                for (size_t i = 0; i < directories.size(); ++i)
+                {
+                    if (directories[i]->descriptor == event->wd)
+                    {
+                        changed.push_back(directories[i]->path + event->name);
+                        break;
+                    }
+                }
+            }
+        }
+#endif
+        return changed.size() > first;
+    }
+
+    void Close()
+    {
+        for (size_t i = 0; i < directories.size(); ++i)
+        {
+            Release(*directories[i]);
+        }
+        directories.clear();
+#ifndef _WIN32
+        if (notify >= 0)
+        {
+            close(notify);
+            notify = -1;
+        }
+#endif
+    }
+
+private:
+    struct Directory
+    {
+        std::string path;
+#ifdef _WIN32
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped = {};
+        DWORD buffer[4096];
+#else
+        int descriptor = -1;
+#endif
+    };
+
+#ifdef _WIN32
+    bool Arm(Directory& directory)
+    {
+        return ReadDirectoryChangesW(directory.handle, directory.buffer, sizeof(directory.buffer), FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, &directory.overlapped, nullptr) != FALSE;
+    }
+
+    void Release(Directory& directory)
+    {
+        if (directory.handle != INVALID_HANDLE_VALUE)
+        {
+            // the read in flight writes into the buffer until it is cancelled
+            DWORD bytes;
+            if (CancelIoEx(directory.handle, &directory.overlapped) || GetLastError() != ERROR_NOT_FOUND)
+            {
+                GetOverlappedResult(directory.handle, &directory.overlapped, &bytes, TRUE);
+            }
+            CloseHandle(directory.handle);
+            directory.handle = INVALID_HANDLE_VALUE;
+        }
+        if (directory.overlapped.hEvent != nullptr)
+        {
+            CloseHandle(directory.overlapped.hEvent);
+            directory.overlapped.hEvent = nullptr;
+        }
+    }
+#else
+    void Release(Directory& directory)
+    {
+        if (directory.descriptor >= 0 && notify >= 0)
+        {
+            inotify_rm_watch(notify, directory.descriptor);
+        }
+        directory.descriptor = -1;
+    }
+
+    int notify = -1;
+#endif
+
+    // the overlapped reads point into the entries, they must not move
+    std::vector<std::unique_ptr<Directory>> directories;
+};
+
+// which permutations read which files
+class ShaderDependencyGraph
+{
+public:
+    // (re)collect the files of permutation, after it compiled its includes may have changed
+    bool Update(const std::string& directory, const ShaderPermutation& permutation)
+    {
+        std::vector<std::string> files;
+        if (!CollectShaderFiles(directory + permutation.source, files))
+        {
+            return false;
+        }
+        filesOf[ShaderPermutationName(permutation)] = files;
+        return true;
+    }
+
+    // names of the permutations that read file
+    void Dependents(const std::string& file, std::vector<std::string>& names) const
+    {
+        for (FileMap::const_iterator it = filesOf.begin(); it != filesOf.end(); ++it)
+        {
+            if (std::find(it->second.begin(), it->second.end(), file) != it->second.end() &&
+                std::find(names.begin(), names.end(), it->first) == names.end())
+            {
+                names.push_back(it->first);
+            }
+        }
+    }
+
+    // every directory a permutation reads from
+    std::vector<std::string> Directories() const
+    {
+        std::vector<std::string> directories;
+        for (FileMap::const_iterator it = filesOf.begin(); it != filesOf.end(); ++it)
+        {
+            for (size_t i = 0; i < it->second.size(); ++i)
+            {
+                std::string directory = ShaderDirectoryOf(it->second[i]);
+                if (std::find(directories.begin(), directories.end(), directory) == directories.end())
+                {
+                    directories.push_back(directory);
+                }
+            }
+        }
+        return directories;
+    }
+
+private:
+    typedef std::unordered_map<std::string, std::vector<std::string>> FileMap;
+    FileMap filesOf;
+};
+
+struct ReloadedShader
+{
+    ShaderPermutation permutation;
+    std::vector<unsigned char> bytecode;
+};
+
+struct ShaderReloadStatistics
+{
+    unsigned int changes;      // batches of file changes
+    unsigned int compiled;
+    unsigned int failed;
+    double lastCompileMs;      // the last batch
+};
+
+class ShaderHotReloader
+{
+public:
+    // bytecode of permutation, false when it does not compile, called on the reload thread
+    typedef std::function<bool(const ShaderPermutation&, std::vector<unsigned char>&)> CompileFunction;
+
+    ShaderHotReloader() {}
+    ~ShaderHotReloader() { Stop(); }
+
+    // Watch the sources of permutations, found relative to directory. Changes in a quick succession are
+    // taken together, the batch is compiled debounceMs after the last one.
+    bool Start(const std::string& sourceDirectory, const std::vector<ShaderPermutation>& permutations,
+        CompileFunction compileFunction, unsigned int debounceMs = 100)
+    {
+        Stop();
+        directory = sourceDirectory;
+        compile = compileFunction;
+        debounce = debounceMs;
+        watched = permutations;
+        for (size_t i = 0; i < watched.size(); ++i)
+        {
+            dependencies.Update(directory, watched[i]);
+        }
+        if (!WatchDirectories())
+        {
+            watcher.Close();
+            return false;
+        }
+        stop = false;
+        thread = std::thread([this]() { Run(); });
+        return true;
+    }
+
+    void Stop()
+    {
+        stop = true;
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+        watcher.Close();
+    }
+
+    // compile permutations on the next round without waiting for a change, by name
+    void Recompile(const std::vector<std::string>& names)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requested.insert(requested.end(), names.begin(), names.end());
+    }
+
+    // the shaders compiled since the last call, call at a frame boundary
+    bool TakeReloaded(std::vector<ReloadedShader>& shaders)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (reloaded.empty())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < reloaded.size(); ++i)
+        {
+            shaders.push_back(std::move(reloaded[i]));
+        }
+        reloaded.clear();
+        return true;
+    }
+
+    ShaderReloadStatistics Statistics() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return statistics;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    bool WatchDirectories()
+    {
+        std::vector<std::string> directories = dependencies.Directories();
+        bool watching = !directories.empty();
+        for (size_t i = 0; i < directories.size(); ++i)
+        {
+            watching = watcher.Watch(directories[i]) && watching;
+        }
+        return watching;
+    }
+
+    void Run()
+    {
+        // the poll timeout bounds how long Stop and Recompile wait
+        const unsigned int PollMs = 50;
+        while (!stop)
+        {
+            std::vector<std::string> changed;
+            bool changes = watcher.Wait(PollMs, changed);
+            // an editor saving writes more than once, wait until it is done
+            while (changes && !stop && watcher.Wait(debounce, changed))
+            {
+            }
+
+            std::vector<std::string> names;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                names.swap(requested);
+            }
+            for (size_t i = 0; i < changed.size(); ++i)
+            {
+                dependencies.Dependents(changed[i], names);
+            }
+            if (names.empty() || stop)
+            {
+                continue;
+            }
+            Compile(names, changes);
+        }
+    }
+
+    void Compile(const std::vector<std::string>& names, bool changes)
+    {
+        Clock::time_point start = Clock::now();
+        std::vector<ReloadedShader> shaders;
+        unsigned int failed = 0;
+        for (size_t i = 0; i < watched.size(); ++i)
+        {
+            if (std::find(names.begin(), names.end(), ShaderPermutationName(watched[i])) == names.end())
+            {
+                continue;
+            }
+            ReloadedShader shader;
+            shader.permutation = watched[i];
+            if (!compile(watched[i], shader.bytecode))
+            {
+                failed++;
+                continue;
+            }
+            // a new include may live in a directory nobody watched so far
+            dependencies.Update(directory, watched[i]);
+            shaders.push_back(std::move(shader));
+        }
+        WatchDirectories();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < shaders.size(); ++i)
+        {
+            reloaded.push_back(std::move(shaders[i]));
+        }
+        statistics.changes += changes ? 1 : 0;
+        statistics.compiled += static_cast<unsigned int>(shaders.size());
+        statistics.failed += failed;
+        statistics.lastCompileMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // reload thread only after Start
+    std::string directory;
+    CompileFunction compile;
+    unsigned int debounce = 100;
+    std::vector<ShaderPermutation> watched;
+    ShaderDependencyGraph dependencies;
+    ShaderFileWatcher watcher;
+
+    std::thread thread;
+    std::atomic<bool> stop{ true };
+
+    mutable std::mutex mutex;
+    std::vector<std::string> requested;
+    std::vector<ReloadedShader> reloaded;
+    ShaderReloadStatistics statistics = {};
+};
@@ -0,0 +1,197 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include "ShaderCache.h"
+
+// Pixel shader permutations. PixelShader.hlsl is specialized on the features below through defines,
+// ShaderList.txt lists every combination for the build and the renderer picks the pipeline of a material
+// and light count. Lights are packed to the front of the light buffer on the CPU, so LIGHT_COUNT replaces
+// the per light enabled branch with a loop the compiler unrolls.
+//
+// The templates below mirror the shader on the CPU with the features as template parameters, the same
+// specialization the defines do on the GPU, as a reference to check the permutations against.
+
+const uint32_t MaxPointLights = 3;
+
+struct PixelShaderFeatures
+{
+    uint32_t lightCount;
+    bool texture;
+    bool specular;
+    bool normalMap;
+};
+
+constexpr uint32_t PixelPermutationCount = (MaxPointLights + 1) * 2 * 2 * 2;
+
+constexpr uint32_t PixelPermutationIndex(uint32_t lightCount, bool texture, bool specular, bool normalMap)
+{
+    return ((lightCount * 2 + (texture ? 1 : 0)) * 2 + (specular ? 1 : 0)) * 2 + (normalMap ? 1 : 0);
+}
+
+inline uint32_t PixelPermutationIndex(const PixelShaderFeatures& features)
+{
+    return PixelPermutationIndex(features.lightCount, features.texture, features.specular, features.normalMap);
+}
+
+static_assert(PixelPermutationIndex(MaxPointLights, true, true, true) == PixelPermutationCount - 1, "permutation index out of range");
+
+inline PixelShaderFeatures PixelPermutationFeatures(uint32_t index)
+{
+    PixelShaderFeatures features = { index / 8, (index / 4) % 2 != 0, (index / 2) % 2 != 0, index % 2 != 0 };
+    return features;
+}
+
+inline ShaderPermutation PixelShaderPermutation(const PixelShaderFeatures& features)
+{
+    ShaderPermutation permutation = { "PixelShader.hlsl", "main", "ps_6_0", {} };
+    permutation.defines.push_back(std::make_pair(std::string("LIGHT_COUNT"), std::to_string(features.lightCount)));
+    permutation.defines.push_back(std::make_pair(std::string("USE_TEXTURE"), features.texture ? "1" : "0"));
+    permutation.defines.push_back(std::make_pair(std::string("USE_SPECULAR"), features.specular ? "1" : "0"));
+    permutation.defines.push_back(std::make_pair(std::string("USE_NORMAL_MAP"), features.normalMap ? "1" : "0"));
+    return permutation;
+}
+
+// inputs of the CPU reference, laid out like the HLSL values they stand for
+struct ReferencePointLight
+{
+    float diffuseColor[3];
+    float specularColor[3];
+    float position[3];
+    float specularPower;
+    float innerRadius;
+    float outerRadius;
+};
+
+struct ReferenceLighting
+{
+    float ambientLight[3];
+    float cameraPos[3];
+    ReferencePointLight pointLights[MaxPointLights];
+};
+
+struct ReferencePixel
+{
+    float worldPos[3];
+    float normalWorld[3];
+    float tangentWorld[4];
+    float texel[4];    // textures[material.diffuseTexture].Sample result
+    float normalTexel[3];    // textures[material.normalTexture].Sample result
+};
+
+// MaterialData of the draw
+struct ReferenceMaterial
+{
+    float diffuseColor[3];
+    float specularColor[3];
+    float specularPower;
+};
+
+namespace reference
+{
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    inline Float3 Load(const float v[3]) { Float3 r = { v[0], v[1], v[2] }; return r; }
+    inline Float3 operator+(Float3 a, Float3 b) { Float3 r = { a.x + b.x, a.y + b.y, a.z + b.z }; return r; }
+    inline Float3 operator-(Float3 a, Float3 b) { Float3 r = { a.x - b.x, a.y - b.y, a.z - b.z }; return r; }
+    inline Float3 operator*(Float3 a, float s) { Float3 r = { a.x * s, a.y * s, a.z * s }; return r; }
+    inline float Dot(Float3 a, Float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Float3 Cross(Float3 a, Float3 b) { Float3 r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; return r; }
+    inline Float3 Normalize(Float3 a) { return a * (1.0f / std::sqrt(Dot(a, a))); }
+    inline Float3 Reflect(Float3 i, Float3 n) { return i - n * (2.0f * Dot(i, n)); }
+    inline float Saturate(float v) { return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v); }
+    inline float Smoothstep(float a, float b, float x)
+    {
+        float t = Saturate((x - a) / (b - a));
+        return t * t * (3.0f - 2.0f * t);
+    }
+}
+
+// PixelShader.hlsl main with LIGHT_COUNT, USE_TEXTURE, USE_SPECULAR and USE_NORMAL_MAP fixed at compile time
+template <uint32_t LightCount, bool UseTexture, bool UseSpecular, bool UseNormalMap>
+void ShadePixelReference(const ReferencePixel& pixel, const ReferenceMaterial& material, const ReferenceLighting& lighting, float color[4])
+{
+    using namespace reference;
+    static_assert(LightCount <= MaxPointLights, "more lights than the light buffer holds");
+
+    float texel[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    if (UseTexture)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            texel[k] = pixel.texel[k];
+        }
+    }
+
+    Float3 phong = Load(lighting.ambientLight);
+    Float3 specular = { 0.0f, 0.0f, 0.0f };
+    Float3 worldPos = Load(pixel.worldPos);
+    Float3 N = Normalize(Load(pixel.normalWorld));
+    if (UseNormalMap)
+    {
+        Float3 tangent = Load(pixel.tangentWorld);
+        Float3 normal = Load(pixel.normalWorld);
+        Float3 bitangent = Cross(normal, tangent) * pixel.tangentWorld[3];
+        Float3 tangentNormal = Load(pixel.normalTexel) * 2.0f - Float3{ 1.0f, 1.0f, 1.0f };
+        N = Normalize(tangent * tangentNormal.x + bitangent * tangentNormal.y + normal * tangentNormal.z);
+    }
+    Float3 V = Normalize(Load(lighting.cameraPos) - worldPos);
+
+    for (uint32_t i = 0; i < LightCount; ++i)
+    {
+        const ReferencePointLight& light = lighting.pointLights[i];
+        Float3 toLight = Load(light.position) - worldPos;
+        Float3 L = Normalize(toLight);
+        float NdotL = Dot(N, L);
+        Float3 R = Reflect(L * -1.0f, N);
+        if (NdotL > 0)
+        {
+            float dist = std::sqrt(Dot(toLight, toLight));
+            float sstep = Smoothstep(light.innerRadius, light.outerRadius, dist);
+            Float3 diffuseColor = Load(light.diffuseColor) * (1.0f - sstep);
+            phong = phong + diffuseColor * NdotL;
+            if (UseSpecular)
+            {
+                float RdotV = Dot(R, V);
+                specular = specular + Load(light.specularColor) * std::pow(RdotV > 0.0f ? RdotV : 0.0f, material.specularPower);
+            }
+        }
+    }
+
+    // color * saturate(float4(phong * Kd + specular * Ks, 0))
+    Float3 kd = Load(material.diffuseColor);
+    Float3 ks = Load(material.specularColor);
+    color[0] = texel[0] * Saturate(phong.x * kd.x + specular.x * ks.x);
+    color[1] = texel[1] * Saturate(phong.y * kd.y + specular.y * ks.y);
+    color[2] = texel[2] * Saturate(phong.z * kd.z + specular.z * ks.z);
+    color[3] = 0.0f;
+}
+
+typedef void (*ReferencePixelShader)(const ReferencePixel&, const ReferenceMaterial&, const ReferenceLighting&, float[4]);
+
+namespace reference
+{
+    template <uint32_t Index>
+    void ShadeIndexed(const ReferencePixel& pixel, const ReferenceMaterial& material, const ReferenceLighting& lighting, float color[4])
+    {
+        ShadePixelReference<Index / 8, (Index / 4) % 2 != 0, (Index / 2) % 2 != 0, Index % 2 != 0>(pixel, material, lighting, color);
+    }
+
+    template <size_t... Indices>
+    const ReferencePixelShader* ShaderTable(std::index_sequence<Indices...>)
+    {
+        static const ReferencePixelShader table[] = { &ShadeIndexed<uint32_t(Indices)>... };
+        return table;
+    }
+}
+
+// the specialized reference shader for features, one instantiation per permutation
+inline ReferencePixelShader SelectReferencePixelShader(const PixelShaderFeatures& features)
+{
+    return reference::ShaderTable(std::make_index_sequence<PixelPermutationCount>())[PixelPermutationIndex(features)];
+}
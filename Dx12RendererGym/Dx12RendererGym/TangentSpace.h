@@ -0,0 +1,242 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include "JobSystem.h"
+
+// Per vertex tangent frames for tangent space normal maps, built the way MikkTSpace builds them so maps baked
+// against it (Blender, Substance, xNormal) shade without seams. Every triangle contributes the direction of
+// increasing u, projected into the tangent plane of the corner normal and weighted by the corner angle, and
+// a vertex gets the normalized sum of its corners. Corners are grouped by the UV orientation of their
+// triangle: a vertex shared by mirrored and unmirrored triangles is split, the copy takes the mirrored
+// corners, so the handedness in tangent.w holds for every triangle of a vertex. UV seams need nothing else,
+// the welded vertices already differ in their texture coordinates there. Triangles without UV area only
+// keep their vertices from being left without a tangent.
+//
+// The shader rebuilds the bitangent as tangent.w * cross(normal, tangent.xyz), like MikkTSpace expects.
+// VertexType needs pos, texCoord, normal and a four component tangent with x, y, z, w members (Vertex in
+// stdafx.h). Run it on welded vertices, before the cache and fetch optimizations reorder them.
+
+namespace tangent
+{
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    template <typename T>
+    inline Float3 Load(const T& v) { Float3 r = { v.x, v.y, v.z }; return r; }
+    inline Float3 operator+(Float3 a, Float3 b) { Float3 r = { a.x + b.x, a.y + b.y, a.z + b.z }; return r; }
+    inline Float3 operator-(Float3 a, Float3 b) { Float3 r = { a.x - b.x, a.y - b.y, a.z - b.z }; return r; }
+    inline Float3 operator*(Float3 a, float s) { Float3 r = { a.x * s, a.y * s, a.z * s }; return r; }
+    inline float Dot(Float3 a, Float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    // a normalized, 0 when a has no length
+    inline Float3 NormalizeOrZero(Float3 a)
+    {
+        float length = std::sqrt(Dot(a, a));
+        return length > 1e-20f ? a * (1.0f / length) : a * 0.0f;
+    }
+
+    // a without its part along the unit vector n
+    inline Float3 Reject(Float3 a, Float3 n)
+    {
+        return a - n * Dot(a, n);
+    }
+
+    // the unit tangent of a vertex from the sum of its corners, any vector of the tangent plane when the
+    // corners cancel out or had no UV area
+    inline Float3 FinishTangent(Float3 sum, Float3 normal)
+    {
+        Float3 n = NormalizeOrZero(normal);
+        Float3 t = NormalizeOrZero(Reject(sum, n));
+        if (Dot(t, t) > 0.0f)
+        {
+            return t;
+        }
+        // the axis least aligned with the normal
+        float ax = std::fabs(n.x), ay = std::fabs(n.y), az = std::fabs(n.z);
+        Float3 axis = ax <= ay && ax <= az ? Float3{ 1.0f, 0.0f, 0.0f } : (ay <= az ? Float3{ 0.0f, 1.0f, 0.0f } : Float3{ 0.0f, 0.0f, 1.0f });
+        t = NormalizeOrZero(Reject(axis, n));
+        return Dot(t, t) > 0.0f ? t : axis;
+    }
+
+    inline void ParallelRange(JobSystem* jobs, size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+    {
+        if (jobs && count > grainSize)
+        {
+            jobs->ParallelFor(count, grainSize, body);
+        }
+        else if (count > 0)
+        {
+            body(0, count);
+        }
+    }
+}
+
+struct TangentStatistics
+{
+    size_t triangleCount;
+    size_t degenerateTriangles;  // no UV area, their corners add nothing
+    size_t splitVertices;        // copies for the mirrored side of a vertex, appended to the vertices
+};
+
+// Writes the tangent of every vertex and splits the vertices mirrored UVs share, the indices of the mirrored
+// corners are moved to the copies. jobs spreads the triangles and vertices over the workers, nullptr runs
+// everything on the calling thread; the result is the same either way.
+template <typename VertexType, typename IndexType>
+TangentStatistics GenerateTangents(std::vector<VertexType>& vertices, std::vector<IndexType>& indices, JobSystem* jobs = nullptr)
+{
+    using namespace tangent;
+
+    const size_t TriangleGrain = 4096;
+    const size_t VertexGrain = 4096;
+
+    TangentStatistics stats = {};
+    size_t vertexCount = vertices.size();
+    size_t triangleCount = indices.size() / 3;
+    stats.triangleCount = triangleCount;
+
+    // **Corners**
+    // the angle weighted tangent every corner contributes and the UV orientation of every triangle,
+    // +1, -1 for mirrored and 0 without UV area
+    std::vector<Float3> cornerTangents(triangleCount * 3);
+    std::vector<int8_t> orientations(triangleCount);
+    ParallelRange(jobs, triangleCount, TriangleGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t t = begin; t < end; ++t)
+        {
+            const VertexType* corner[3];
+            Float3 p[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                corner[k] = &vertices[size_t(indices[t * 3 + k])];
+                p[k] = Load(corner[k]->pos);
+            }
+            Float3 d1 = p[1] - p[0];
+            Float3 d2 = p[2] - p[0];
+            float s1 = corner[1]->texCoord.x - corner[0]->texCoord.x;
+            float t1 = corner[1]->texCoord.y - corner[0]->texCoord.y;
+            float s2 = corner[2]->texCoord.x - corner[0]->texCoord.x;
+            float t2 = corner[2]->texCoord.y - corner[0]->texCoord.y;
+            float signedArea = s1 * t2 - s2 * t1;
+
+            if (!(std::fabs(signedArea) > 1e-30f))
+            {
+                orientations[t] = 0;
+                for (int k = 0; k < 3; ++k)
+                {
+                    cornerTangents[t * 3 + k] = Float3{ 0.0f, 0.0f, 0.0f };
+                }
+                continue;
+            }
+            orientations[t] = signedArea > 0.0f ? 1 : -1;
+            // dP/du up to the scale, the sign keeps it pointing along +u on mirrored triangles
+            Float3 uDirection = (d1 * t2 - d2 * t1) * (signedArea > 0.0f ? 1.0f : -1.0f);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                Float3 n = NormalizeOrZero(Load(corner[k]->normal));
+                Float3 tangent = NormalizeOrZero(Reject(uDirection, n));
+                // the corner angle in the tangent plane, like MikkTSpace weights it
+                Float3 edge1 = NormalizeOrZero(Reject(p[(k + 1) % 3] - p[k], n));
+                Float3 edge2 = NormalizeOrZero(Reject(p[(k + 2) % 3] - p[k], n));
+                float angle = std::acos(std::max(-1.0f, std::min(1.0f, Dot(edge1, edge2))));
+                cornerTangents[t * 3 + k] = tangent * angle;
+            }
+        }
+    });
+
+    // **Vertex corners**
+    // the corners of every vertex, counting sort by vertex so the vertices below are summed without atomics
+    std::vector<uint32_t> firstCorner(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        firstCorner[size_t(indices[i]) + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        firstCorner[v + 1] += firstCorner[v];
+    }
+    std::vector<uint32_t> vertexCorners(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(firstCorner.begin(), firstCorner.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+        {
+            vertexCorners[fill[size_t(indices[i])]++] = uint32_t(i);
+        }
+    }
+
+    // **Vertices**
+    // the vertex keeps the unmirrored corners, or the mirrored ones when it has no others, mirrored tangents
+    // of vertices with both wait in mirroredTangents for their copy
+    std::vector<Float3> mirroredTangents(vertexCount);
+    std::vector<uint8_t> split(vertexCount, 0);
+    ParallelRange(jobs, vertexCount, VertexGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t v = begin; v < end; ++v)
+        {
+            Float3 sum[2] = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+            bool used[2] = { false, false };
+            for (uint32_t c = firstCorner[v]; c < firstCorner[v + 1]; ++c)
+            {
+                uint32_t cornerIndex = vertexCorners[c];
+                int8_t orientation = orientations[cornerIndex / 3];
+                if (orientation != 0)
+                {
+                    int side = orientation > 0 ? 0 : 1;
+                    sum[side] = sum[side] + cornerTangents[cornerIndex];
+                    used[side] = true;
+                }
+            }
+
+            Float3 normal = Load(vertices[v].normal);
+            int side = used[0] || !used[1] ? 0 : 1;
+            Float3 t = FinishTangent(sum[side], normal);
+            vertices[v].tangent.x = t.x;
+            vertices[v].tangent.y = t.y;
+            vertices[v].tangent.z = t.z;
+            vertices[v].tangent.w = side == 0 ? 1.0f : -1.0f;
+
+            if (used[0] && used[1])
+            {
+                split[v] = 1;
+                mirroredTangents[v] = FinishTangent(sum[1], normal);
+            }
+        }
+    });
+
+    // **Mirrored copies**
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        if (!split[v])
+        {
+            continue;
+        }
+        IndexType copy = IndexType(vertices.size());
+        VertexType mirrored = vertices[v];
+        mirrored.tangent.x = mirroredTangents[v].x;
+        mirrored.tangent.y = mirroredTangents[v].y;
+        mirrored.tangent.z = mirroredTangents[v].z;
+        mirrored.tangent.w = -1.0f;
+        vertices.push_back(mirrored);
+        for (uint32_t c = firstCorner[v]; c < firstCorner[v + 1]; ++c)
+        {
+            uint32_t cornerIndex = vertexCorners[c];
+            if (orientations[cornerIndex / 3] < 0)
+            {
+                indices[cornerIndex] = copy;
+            }
+        }
+        stats.splitVertices++;
+    }
+
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        stats.degenerateTriangles += orientations[t] == 0 ? 1 : 0;
+    }
+    return stats;
+}
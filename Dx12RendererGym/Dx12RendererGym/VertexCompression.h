@@ -0,0 +1,296 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// 20 byte vertex layout used when the asset pipeline decides a mesh can be compressed.
+// Must match the COMPRESSED_VERTEX input layout in InitPSO and VS_INPUT in VertexShader.hlsl.
+struct CompressedVertex
+{
+    uint16_t pos[4];      // unorm16 position relative to the mesh bounds, w the bitangent sign (0 for -1, 1 for +1)
+    uint16_t texCoord[2]; // half float
+    int16_t normal[2];    // octahedral encoded unit normal, snorm16
+    int16_t tangent[2];   // octahedral encoded unit tangent, snorm16
+};
+
+// largest error the asset pipeline accepts before it keeps the full precision layout
+struct VertexCompressionTolerance
+{
+    float position = 1e-4f;  // relative to the bounds diagonal
+    float texCoord = 1.0f / 2048.0f;
+    float normalDegrees = 0.5f;
+    float tangentDegrees = 0.5f;
+};
+
+struct VertexCompressionError
+{
+    float maxPosition;        // relative to the bounds diagonal
+    float avgPosition;
+    float maxTexCoord;
+    float avgTexCoord;
+    float maxNormalDegrees;
+    float avgNormalDegrees;
+    float maxTangentDegrees;
+    float avgTangentDegrees;
+};
+
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = int32_t((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+    {
+        // inf / nan
+        return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31)
+    {
+        return uint16_t(sign | 0x7c00);
+    }
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return uint16_t(sign);
+        }
+        // denormal, round to nearest
+        mantissa |= 0x800000;
+        uint32_t shift = uint32_t(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+        {
+            half++;
+        }
+        return uint16_t(sign | half);
+    }
+
+    uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+    // round to nearest, a carry into the exponent is still the correct result
+    if (mantissa & 0x1000)
+    {
+        half++;
+    }
+    return uint16_t(half);
+}
+
+inline float HalfToFloat(uint16_t value)
+{
+    uint32_t sign = uint32_t(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // normalize the denormal
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400) == 0)
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3ff;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+inline int16_t FloatToSnorm16(float value)
+{
+    value = std::max(-1.0f, std::min(1.0f, value));
+    return int16_t(roundf(value * 32767.0f));
+}
+
+inline float Snorm16ToFloat(int16_t value)
+{
+    return std::max(-1.0f, float(value) / 32767.0f);
+}
+
+// octahedral normal encoding, same mapping as OctDecode in VertexShader.hlsl
+inline void OctEncode(const float* n, int16_t* encoded)
+{
+    float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = l1 > 0 ? n[0] / l1 : 0.0f;
+    float y = l1 > 0 ? n[1] / l1 : 0.0f;
+    if (n[2] < 0)
+    {
+        float foldedX = (1.0f - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = FloatToSnorm16(x);
+    encoded[1] = FloatToSnorm16(y);
+}
+
+inline void OctDecode(const int16_t* encoded, float* n)
+{
+    float x = Snorm16ToFloat(encoded[0]);
+    float y = Snorm16ToFloat(encoded[1]);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0 ? -t : t;
+    y += y >= 0 ? -t : t;
+    float length = sqrtf(x * x + y * y + z * z);
+    n[0] = x / length;
+    n[1] = y / length;
+    n[2] = z / length;
+}
+
+// unit length copy of v, +z for a zero vector
+inline void NormalizeForEncoding(const float* v, float* unit)
+{
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    unit[0] = 0;
+    unit[1] = 0;
+    unit[2] = 1;
+    if (length > 0)
+    {
+        unit[0] = v[0] / length;
+        unit[1] = v[1] / length;
+        unit[2] = v[2] / length;
+    }
+}
+
+// octahedral round trip of a unit vector, returns the error in degrees
+inline float OctEncodeWithError(const float* unit, int16_t* encoded)
+{
+    OctEncode(unit, encoded);
+    float decoded[3];
+    OctDecode(encoded, decoded);
+    float cosAngle = unit[0] * decoded[0] + unit[1] * decoded[1] + unit[2] * decoded[2];
+    return acosf(std::max(-1.0f, std::min(1.0f, cosAngle))) * (180.0f / 3.14159265f);
+}
+
+// Compress full precision vertices laid out as float3 pos, float2 texCoord, float3 normal and float4 tangent
+// at the given offsets. boundsMin/boundsMax must enclose every position, the shader reconstructs
+// pos = quantized * (boundsMax - boundsMin) + boundsMin.
+inline void CompressVertices(const unsigned char* vertices, size_t vertexCount, size_t stride,
+    size_t posOffset, size_t texCoordOffset, size_t normalOffset, size_t tangentOffset,
+    const float* boundsMin, const float* boundsMax,
+    std::vector<CompressedVertex>& output, VertexCompressionError& error)
+{
+    output.resize(vertexCount);
+    error = {};
+
+    float extent[3];
+    float diagonal = 0;
+    for (int k = 0; k < 3; ++k)
+    {
+        extent[k] = boundsMax[k] - boundsMin[k];
+        diagonal += extent[k] * extent[k];
+    }
+    diagonal = sqrtf(diagonal);
+
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const unsigned char* vertex = vertices + i * stride;
+        const float* pos = reinterpret_cast<const float*>(vertex + posOffset);
+        const float* texCoord = reinterpret_cast<const float*>(vertex + texCoordOffset);
+        const float* normal = reinterpret_cast<const float*>(vertex + normalOffset);
+        const float* tangent = reinterpret_cast<const float*>(vertex + tangentOffset);
+        CompressedVertex& packed = output[i];
+
+        float positionError = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            float t = extent[k] > 0 ? (pos[k] - boundsMin[k]) / extent[k] : 0.0f;
+            t = std::max(0.0f, std::min(1.0f, t));
+            packed.pos[k] = uint16_t(t * 65535.0f + 0.5f);
+            float decoded = float(packed.pos[k]) / 65535.0f * extent[k] + boundsMin[k];
+            positionError += (decoded - pos[k]) * (decoded - pos[k]);
+        }
+        packed.pos[3] = tangent[3] < 0 ? 0 : 65535;
+        positionError = diagonal > 0 ? sqrtf(positionError) / diagonal : 0.0f;
+
+        float texCoordError = 0;
+        for (int k = 0; k < 2; ++k)
+        {
+            packed.texCoord[k] = FloatToHalf(texCoord[k]);
+            texCoordError = std::max(texCoordError, fabsf(HalfToFloat(packed.texCoord[k]) - texCoord[k]));
+        }
+
+        float unitNormal[3];
+        NormalizeForEncoding(normal, unitNormal);
+        float normalError = OctEncodeWithError(unitNormal, packed.normal);
+
+        float unitTangent[3];
+        NormalizeForEncoding(tangent, unitTangent);
+        float tangentError = OctEncodeWithError(unitTangent, packed.tangent);
+
+        error.maxPosition = std::max(error.maxPosition, positionError);
+        error.avgPosition += positionError;
+        error.maxTexCoord = std::max(error.maxTexCoord, texCoordError);
+        error.avgTexCoord += texCoordError;
+        error.maxNormalDegrees = std::max(error.maxNormalDegrees, normalError);
+        error.avgNormalDegrees += normalError;
+        error.maxTangentDegrees = std::max(error.maxTangentDegrees, tangentError);
+        error.avgTangentDegrees += tangentError;
+    }
+
+    if (vertexCount > 0)
+    {
+        error.avgPosition /= float(vertexCount);
+        error.avgTexCoord /= float(vertexCount);
+        error.avgNormalDegrees /= float(vertexCount);
+        error.avgTangentDegrees /= float(vertexCount);
+    }
+}
+
+// Inverse of CompressVertices with the same bounds, what VertexShader.hlsl reconstructs, for scenes whose
+// meshes do not all share the compressed layout
+inline void DecompressVertices(const CompressedVertex* input, size_t vertexCount, const float* boundsMin, const float* boundsMax,
+    unsigned char* vertices, size_t stride, size_t posOffset, size_t texCoordOffset, size_t normalOffset, size_t tangentOffset)
+{
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const CompressedVertex& packed = input[i];
+        unsigned char* vertex = vertices + i * stride;
+        float* pos = reinterpret_cast<float*>(vertex + posOffset);
+        float* texCoord = reinterpret_cast<float*>(vertex + texCoordOffset);
+        float* normal = reinterpret_cast<float*>(vertex + normalOffset);
+        float* tangent = reinterpret_cast<float*>(vertex + tangentOffset);
+        for (int k = 0; k < 3; ++k)
+        {
+            pos[k] = float(packed.pos[k]) / 65535.0f * (boundsMax[k] - boundsMin[k]) + boundsMin[k];
+        }
+        texCoord[0] = HalfToFloat(packed.texCoord[0]);
+        texCoord[1] = HalfToFloat(packed.texCoord[1]);
+        OctDecode(packed.normal, normal);
+        OctDecode(packed.tangent, tangent);
+        tangent[3] = packed.pos[3] == 0 ? -1.0f : 1.0f;
+    }
+}
+
+inline bool IsVertexCompressionAcceptable(const VertexCompressionError& error, const VertexCompressionTolerance& tolerance)
+{
+    return error.maxPosition <= tolerance.position &&
+        error.maxTexCoord <= tolerance.texCoord &&
+        error.maxNormalDegrees <= tolerance.normalDegrees &&
+        error.maxTangentDegrees <= tolerance.tangentDegrees;
+}
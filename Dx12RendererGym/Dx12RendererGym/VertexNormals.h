@@ -0,0 +1,382 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <cmath>
+#include "JobSystem.h"
+
+// Smooth vertex normals for triangles the OBJ file gave none. Those arrive with zero normals (the loader's
+// FlatNormalsWhenMissing off) and, after welding, share the vertices of equal position and texture coordinate.
+// Corners at the same position are found with a spatial hash, positions closer than a millionth of the bounds
+// diagonal count as one. A corner gets the sum of the face normals around its position, each weighted by the
+// angle of its face at that corner, so a vertex is not pulled towards the side that happens to be cut into
+// more triangles. Faces whose normals differ by more than the crease angle from the corner's face are left
+// out, which keeps hard edges; a vertex whose corners end up with different normals is split.
+//
+// VertexType needs pos and normal with x, y, z members (Vertex in stdafx.h). Triangles that already have
+// normals are left as they are and take no part. Faces point along (p1 - p0) x (p2 - p0), the OBJ winding.
+
+namespace normals
+{
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    template <typename T>
+    inline Float3 Load(const T& v) { Float3 r = { v.x, v.y, v.z }; return r; }
+    inline Float3 operator+(Float3 a, Float3 b) { Float3 r = { a.x + b.x, a.y + b.y, a.z + b.z }; return r; }
+    inline Float3 operator-(Float3 a, Float3 b) { Float3 r = { a.x - b.x, a.y - b.y, a.z - b.z }; return r; }
+    inline Float3 operator*(Float3 a, float s) { Float3 r = { a.x * s, a.y * s, a.z * s }; return r; }
+    inline float Dot(Float3 a, Float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Float3 Cross(Float3 a, Float3 b) { Float3 r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; return r; }
+
+    // a normalized, 0 when a has no length
+    inline Float3 NormalizeOrZero(Float3 a)
+    {
+        float length = std::sqrt(Dot(a, a));
+        return length > 1e-20f ? a * (1.0f / length) : a * 0.0f;
+    }
+
+    inline bool IsZero(Float3 a)
+    {
+        return a.x == 0.0f && a.y == 0.0f && a.z == 0.0f;
+    }
+
+    inline bool Equal(Float3 a, Float3 b)
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+
+    // grid cell of a position in the spatial hash
+    struct Cell
+    {
+        int32_t x, y, z;
+
+        bool operator==(const Cell& other) const { return x == other.x && y == other.y && z == other.z; }
+    };
+
+    inline uint32_t HashCell(const Cell& cell)
+    {
+        // the primes of Teschner et al., "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+        return (uint32_t(cell.x) * 73856093u) ^ (uint32_t(cell.y) * 19349663u) ^ (uint32_t(cell.z) * 83492791u);
+    }
+
+    inline void ParallelRange(JobSystem* jobs, size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+    {
+        if (jobs && count > grainSize)
+        {
+            jobs->ParallelFor(count, grainSize, body);
+        }
+        else if (count > 0)
+        {
+            body(0, count);
+        }
+    }
+
+    // counting sort of the items into buckets, first (bucketCount + 1 entries) indexes items by bucket
+    inline void SortIntoBuckets(const std::vector<uint32_t>& itemBuckets, size_t bucketCount,
+        std::vector<uint32_t>& first, std::vector<uint32_t>& items)
+    {
+        first.assign(bucketCount + 1, 0);
+        for (size_t i = 0; i < itemBuckets.size(); ++i)
+        {
+            first[itemBuckets[i] + 1]++;
+        }
+        for (size_t b = 0; b < bucketCount; ++b)
+        {
+            first[b + 1] += first[b];
+        }
+        items.resize(itemBuckets.size());
+        std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+        for (size_t i = 0; i < itemBuckets.size(); ++i)
+        {
+            items[fill[itemBuckets[i]]++] = uint32_t(i);
+        }
+    }
+}
+
+struct NormalStatistics
+{
+    size_t smoothedTriangles;   // triangles that had no normals
+    size_t positions;           // distinct positions of their corners
+    size_t splitVertices;       // copies for corners on the other side of a crease, appended to the vertices
+};
+
+// Writes smooth normals for every triangle whose corners all have zero normals. Faces around a position
+// further apart than creaseAngleDegrees do not smooth into each other. jobs spreads the work over the
+// workers, nullptr runs everything on the calling thread; the result is the same either way.
+template <typename VertexType, typename IndexType>
+NormalStatistics GenerateSmoothNormals(std::vector<VertexType>& vertices, std::vector<IndexType>& indices, float creaseAngleDegrees,
+    JobSystem* jobs = nullptr)
+{
+    using namespace normals;
+
+    const size_t TriangleGrain = 4096;
+    const size_t VertexGrain = 4096;
+
+    NormalStatistics stats = {};
+    size_t vertexCount = vertices.size();
+    size_t triangleCount = indices.size() / 3;
+
+    // **Faces**
+    // unit face normal and corner angles of every triangle without normals, the others stay out
+    std::vector<Float3> faceNormals(triangleCount);
+    std::vector<float> cornerAngles(triangleCount * 3);
+    std::vector<uint8_t> smoothed(triangleCount, 0);
+    ParallelRange(jobs, triangleCount, TriangleGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t t = begin; t < end; ++t)
+        {
+            Float3 p[3];
+            bool missing = true;
+            for (int k = 0; k < 3; ++k)
+            {
+                const VertexType& vertex = vertices[size_t(indices[t * 3 + k])];
+                p[k] = Load(vertex.pos);
+                missing = missing && IsZero(Load(vertex.normal));
+            }
+            if (!missing)
+            {
+                continue;
+            }
+            smoothed[t] = 1;
+            faceNormals[t] = NormalizeOrZero(Cross(p[1] - p[0], p[2] - p[0]));
+            for (int k = 0; k < 3; ++k)
+            {
+                Float3 edge1 = NormalizeOrZero(p[(k + 1) % 3] - p[k]);
+                Float3 edge2 = NormalizeOrZero(p[(k + 2) % 3] - p[k]);
+                cornerAngles[t * 3 + k] = std::acos(std::max(-1.0f, std::min(1.0f, Dot(edge1, edge2))));
+            }
+        }
+    });
+
+    std::vector<uint32_t> corners;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        if (smoothed[t])
+        {
+            corners.push_back(uint32_t(t * 3));
+            corners.push_back(uint32_t(t * 3 + 1));
+            corners.push_back(uint32_t(t * 3 + 2));
+        }
+    }
+    stats.smoothedTriangles = corners.size() / 3;
+    if (corners.empty())
+    {
+        return stats;
+    }
+
+    // **Spatial hash**
+    // the cell of every vertex, vertices closer than the tolerance are one position
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        const float position[3] = { vertices[v].pos.x, vertices[v].pos.y, vertices[v].pos.z };
+        for (int k = 0; k < 3; ++k)
+        {
+            boundsMin[k] = std::min(boundsMin[k], position[k]);
+            boundsMax[k] = std::max(boundsMax[k], position[k]);
+        }
+    }
+    Float3 extent = { boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] };
+    float tolerance = std::max(std::sqrt(Dot(extent, extent)) * 1e-6f, FLT_MIN);
+    // cells larger than the tolerance, most vertices are far enough from the cell border to look at their own only
+    float cellSize = tolerance * 4.0f;
+
+    size_t bucketCount = 1;
+    while (bucketCount < vertexCount)
+    {
+        bucketCount *= 2;
+    }
+    std::vector<Cell> cells(vertexCount);
+    std::vector<uint32_t> vertexBuckets(vertexCount);
+    ParallelRange(jobs, vertexCount, VertexGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t v = begin; v < end; ++v)
+        {
+            // relative to the bounds, at most a quarter million cells per axis
+            Cell cell = { int32_t(std::floor((vertices[v].pos.x - boundsMin[0]) / cellSize)),
+                int32_t(std::floor((vertices[v].pos.y - boundsMin[1]) / cellSize)),
+                int32_t(std::floor((vertices[v].pos.z - boundsMin[2]) / cellSize)) };
+            cells[v] = cell;
+            vertexBuckets[v] = HashCell(cell) & uint32_t(bucketCount - 1);
+        }
+    });
+    std::vector<uint32_t> firstInBucket;
+    std::vector<uint32_t> bucketVertices;
+    SortIntoBuckets(vertexBuckets, bucketCount, firstInBucket, bucketVertices);
+
+    // every vertex links to the lowest numbered vertex within the tolerance of it, in its own cell or the
+    // neighbouring ones it is that close to, so positions on either side of a cell border still meet
+    std::vector<uint32_t> positions(vertexCount);
+    float tolerance2 = tolerance * tolerance;
+    ParallelRange(jobs, vertexCount, VertexGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t v = begin; v < end; ++v)
+        {
+            uint32_t lowest = uint32_t(v);
+            Float3 p = Load(vertices[v].pos);
+            // per axis the neighbour cells within reach, -1, +1 or none
+            int low[3];
+            int high[3];
+            const float coordinates[3] = { p.x - boundsMin[0], p.y - boundsMin[1], p.z - boundsMin[2] };
+            const int32_t cell[3] = { cells[v].x, cells[v].y, cells[v].z };
+            for (int k = 0; k < 3; ++k)
+            {
+                float inCell = coordinates[k] - float(cell[k]) * cellSize;
+                low[k] = inCell < tolerance ? -1 : 0;
+                high[k] = inCell > cellSize - tolerance ? 1 : 0;
+            }
+            for (int dz = low[2]; dz <= high[2]; ++dz)
+            {
+                for (int dy = low[1]; dy <= high[1]; ++dy)
+                {
+                    for (int dx = low[0]; dx <= high[0]; ++dx)
+                    {
+                        Cell neighbour = { cells[v].x + dx, cells[v].y + dy, cells[v].z + dz };
+                        uint32_t bucket = HashCell(neighbour) & uint32_t(bucketCount - 1);
+                        // sorted by vertex, nothing past lowest can win
+                        for (uint32_t i = firstInBucket[bucket]; i < firstInBucket[bucket + 1] && bucketVertices[i] < lowest; ++i)
+                        {
+                            uint32_t other = bucketVertices[i];
+                            Float3 d = Load(vertices[other].pos) - p;
+                            if (cells[other] == neighbour && Dot(d, d) <= tolerance2)
+                            {
+                                lowest = other;
+                            }
+                        }
+                    }
+                }
+            }
+            positions[v] = lowest;
+        }
+    });
+    // follow the links down to the lowest vertex of the chain, the link of a vertex is always resolved first
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        positions[v] = positions[positions[v]];
+    }
+
+    // **Corner normals**
+    // the corners around every position, each sums the faces within the crease angle of its own
+    std::vector<uint32_t> cornerPositions(corners.size());
+    for (size_t c = 0; c < corners.size(); ++c)
+    {
+        cornerPositions[c] = positions[size_t(indices[corners[c]])];
+    }
+    std::vector<uint32_t> firstAtPosition;
+    std::vector<uint32_t> positionCorners;
+    SortIntoBuckets(cornerPositions, vertexCount, firstAtPosition, positionCorners);
+
+    float creaseCos = std::cos(creaseAngleDegrees * (3.14159265f / 180.0f));
+    std::vector<Float3> cornerNormals(corners.size());
+    ParallelRange(jobs, vertexCount, VertexGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t position = begin; position < end; ++position)
+        {
+            for (uint32_t i = firstAtPosition[position]; i < firstAtPosition[position + 1]; ++i)
+            {
+                uint32_t corner = corners[positionCorners[i]];
+                Float3 face = faceNormals[corner / 3];
+                Float3 sum = { 0.0f, 0.0f, 0.0f };
+                for (uint32_t j = firstAtPosition[position]; j < firstAtPosition[position + 1]; ++j)
+                {
+                    uint32_t other = corners[positionCorners[j]];
+                    Float3 otherFace = faceNormals[other / 3];
+                    // a degenerate face has no side of the crease, it takes the normal of the whole position
+                    if (IsZero(face) || Dot(face, otherFace) >= creaseCos)
+                    {
+                        sum = sum + otherFace * cornerAngles[other];
+                    }
+                }
+                Float3 normal = NormalizeOrZero(sum);
+                // only degenerate triangles at the position
+                if (IsZero(normal))
+                {
+                    normal = Float3{ 0.0f, 0.0f, 1.0f };
+                }
+                cornerNormals[positionCorners[i]] = normal;
+            }
+        }
+    });
+
+    for (size_t position = 0; position < vertexCount; ++position)
+    {
+        stats.positions += firstAtPosition[position + 1] > firstAtPosition[position] ? 1 : 0;
+    }
+
+    // **Vertices**
+    // the vertex takes the normal of its first corner, corners that got another one move to copies
+    std::vector<uint32_t> cornerVertices(corners.size());
+    for (size_t c = 0; c < corners.size(); ++c)
+    {
+        cornerVertices[c] = uint32_t(indices[corners[c]]);
+    }
+    std::vector<uint32_t> firstOfVertex;
+    std::vector<uint32_t> vertexCorners;
+    SortIntoBuckets(cornerVertices, vertexCount, firstOfVertex, vertexCorners);
+
+    std::vector<uint8_t> split(vertexCount, 0);
+    ParallelRange(jobs, vertexCount, VertexGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t v = begin; v < end; ++v)
+        {
+            if (firstOfVertex[v] == firstOfVertex[v + 1])
+            {
+                continue;
+            }
+            Float3 normal = cornerNormals[vertexCorners[firstOfVertex[v]]];
+            vertices[v].normal.x = normal.x;
+            vertices[v].normal.y = normal.y;
+            vertices[v].normal.z = normal.z;
+            for (uint32_t i = firstOfVertex[v] + 1; i < firstOfVertex[v + 1]; ++i)
+            {
+                split[v] |= Equal(cornerNormals[vertexCorners[i]], normal) ? 0 : 1;
+            }
+        }
+    });
+
+    std::vector<std::pair<Float3, IndexType>> copies;
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        if (!split[v])
+        {
+            continue;
+        }
+        copies.clear();
+        Float3 normal = Load(vertices[v].normal);
+        for (uint32_t i = firstOfVertex[v] + 1; i < firstOfVertex[v + 1]; ++i)
+        {
+            Float3 cornerNormal = cornerNormals[vertexCorners[i]];
+            if (Equal(cornerNormal, normal))
+            {
+                continue;
+            }
+            // corners on one side of a crease share their copy
+            size_t k = 0;
+            while (k < copies.size() && !Equal(copies[k].first, cornerNormal))
+            {
+                ++k;
+            }
+            if (k == copies.size())
+            {
+                VertexType copy = vertices[v];
+                copy.normal.x = cornerNormal.x;
+                copy.normal.y = cornerNormal.y;
+                copy.normal.z = cornerNormal.z;
+                copies.push_back(std::make_pair(cornerNormal, IndexType(vertices.size())));
+                vertices.push_back(copy);
+                stats.splitVertices++;
+            }
+            indices[corners[vertexCorners[i]]] = copies[k].second;
+        }
+    }
+
+    return stats;
+}
@@ -1,9 +1,21 @@
+#ifdef COMPRESSED_VERTEX
+// CompressedVertex, see VertexCompression.h
+struct VS_INPUT
+{
+    float4 pos : POSITION; // unorm16 relative to the mesh bounds
+    float2 texCoord : TEXCOORD; // half float
+    float2 normalOct : NORMAL; // octahedral snorm16
+    float2 tangentOct : TANGENT; // octahedral snorm16, the sign is in pos.w
+};
+#else
 struct VS_INPUT
 {
     float3 pos : POSITION;
     float2 texCoord : TEXCOORD;
     float3 normalLocal : NORMAL;
+    float4 tangentLocal : TANGENT; // w is the bitangent sign
 };
+#endif
 
 struct VS_OUTPUT
 {
@@ -11,6 +23,7 @@ struct VS_OUTPUT
     float3 worldPos : POSITION;
     float2 texCoord : TEXCOORD;
     float3 normalWorld : NORMAL;
+    float4 tangentWorld : TANGENT;
 };
 
 cbuffer ConstantBuffer : register(b0)
@@ -18,15 +31,36 @@ cbuffer ConstantBuffer : register(b0)
     float4x4 wMat;
     float4x4 wvpMat;
     float3 cameraPos;
+    float3 positionDequantScale;
+    float3 positionDequantOffset;
 };
 
+#ifdef COMPRESSED_VERTEX
+float3 OctDecode(float2 e)
+{
+    float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+#endif
 
 VS_OUTPUT main(VS_INPUT input)
 {
     VS_OUTPUT output;
-    output.pos = mul(float4(input.pos, 1.0f), wvpMat);
-    output.worldPos = mul(float4(input.pos, 1.0f), wMat).xyz;
-    output.normalWorld = mul(input.normalLocal, (float3x3)wMat);
+#ifdef COMPRESSED_VERTEX
+    float3 pos = input.pos.xyz * positionDequantScale + positionDequantOffset;
+    float3 normalLocal = OctDecode(input.normalOct);
+    float4 tangentLocal = float4(OctDecode(input.tangentOct), input.pos.w * 2.0f - 1.0f);
+#else
+    float3 pos = input.pos;
+    float3 normalLocal = input.normalLocal;
+    float4 tangentLocal = input.tangentLocal;
+#endif
+    output.pos = mul(float4(pos, 1.0f), wvpMat);
+    output.worldPos = mul(float4(pos, 1.0f), wMat).xyz;
+    output.normalWorld = mul(normalLocal, (float3x3)wMat);
+    output.tangentWorld = float4(mul(tangentLocal.xyz, (float3x3)wMat), tangentLocal.w);
     output.texCoord = input.texCoord;
     return output;
 }
\ No newline at end of file
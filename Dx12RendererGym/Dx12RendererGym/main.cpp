@@ -15,6 +15,8 @@ int WINAPI WinMain(HINSTANCE hInstance,
         MessageBox(0, L"Window Init Failed!", L"Error", MB_OK);
         return 0;
     }
+    jobSystem.Init(JobWorkerCount);
+
     // init d3d
     if (!InitD3D())
     {
@@ -24,6 +26,9 @@ int WINAPI WinMain(HINSTANCE hInstance,
         return 1;
     }
 
+    // cleared by the render thread when a frame fails
+    Running = true;
+
     mainloop();
 
     // wait for gpu to finish executing the command list before starting releasing everything
@@ -105,6 +110,10 @@ void mainloop() {
     MSG msg;
     ZeroMemory(&msg, sizeof(MSG));
 
+    StartRenderThread();
+    // loading is not simulation time
+    gameClock.Tick();
+
     while (true)
     {
         if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
@@ -115,12 +124,18 @@ void mainloop() {
             DispatchMessage(&msg);
 
         }
+        else if (renderPipeline.Closed())
+        {
+            // the render thread stopped after a failed frame, Update would only return right away
+            DestroyWindow(hwnd);
+        }
         else
         {
             Update();
-            Render();
         }
     }
+
+    StopRenderThread();
 }
 
 LRESULT CALLBACK WndProc(HWND hwnd,
@@ -136,6 +151,43 @@ LRESULT CALLBACK WndProc(HWND hwnd,
                 L"Really?", MB_YESNO | MB_ICONQUESTION) == IDYES)
                 DestroyWindow(hwnd);
         }
+        // bit 30 is set for auto repeat
+        if (wParam == VK_TAB && !(lParam & (1 << 30)))
+        {
+            camera.SetMode(camera.Mode() == CameraMode::FreeFly ? CameraMode::Orbit : CameraMode::FreeFly);
+        }
+        keysDown[wParam & 0xff] = true;
+        return 0;
+    case WM_KEYUP:
+        keysDown[wParam & 0xff] = false;
+        return 0;
+    case WM_KILLFOCUS:
+        // the key up messages go to the other window
+        memset(keysDown, 0, sizeof(keysDown));
+        mouseLook = false;
+        return 0;
+    case WM_RBUTTONDOWN:
+        mouseLook = true;
+        lastMousePosition.x = short(LOWORD(lParam));
+        lastMousePosition.y = short(HIWORD(lParam));
+        SetCapture(hwnd);
+        return 0;
+    case WM_RBUTTONUP:
+        mouseLook = false;
+        ReleaseCapture();
+        return 0;
+    case WM_MOUSEMOVE:
+        if (mouseLook)
+        {
+            // adds up until the next simulation step uses it
+            POINT position = { short(LOWORD(lParam)), short(HIWORD(lParam)) };
+            cameraInput.lookYaw += float(position.x - lastMousePosition.x) * CameraMouseRadiansPerPixel;
+            cameraInput.lookPitch -= float(position.y - lastMousePosition.y) * CameraMouseRadiansPerPixel;
+            lastMousePosition = position;
+        }
+        return 0;
+    case WM_MOUSEWHEEL:
+        cameraInput.zoom += float(GET_WHEEL_DELTA_WPARAM(wParam)) / float(WHEEL_DELTA);
         return 0;
     case WM_DESTROY:
         PostQuitMessage(0);
@@ -179,6 +231,17 @@ bool InitD3DDevice()
         if (SUCCEEDED(hr))
         {
             adapterFound = true;
+
+            // pipeline libraries only load on the adapter and driver that wrote them
+            LARGE_INTEGER driverVersion = {};
+            adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+            PipelineHasher adapterHasher;
+            adapterHasher.AddValue(desc.VendorId);
+            adapterHasher.AddValue(desc.DeviceId);
+            adapterHasher.AddValue(desc.SubSysId);
+            adapterHasher.AddValue(desc.Revision);
+            adapterHasher.AddValue(driverVersion.QuadPart);
+            pipelineAdapterId = adapterHasher.Hash();
             break;
         }
 
@@ -200,6 +263,13 @@ bool InitD3DDevice()
         return false;
     }
 
+    // the budget query needs DXGI 1.4, without it nothing is evicted
+    hr = adapter->QueryInterface(IID_PPV_ARGS(&dxgiAdapter));
+    if (FAILED(hr))
+    {
+        dxgiAdapter = nullptr;
+    }
+
     return true;
 }
 
@@ -244,7 +314,9 @@ bool InitCommandList()
     {
         return false;
     }
-    return true;
+
+    // the frame lists, commandList stays for the resource uploads during init
+    return commandRecorder.Init(frameBufferCount, RecordingWorkerCount, jobSystem);
 }
 
 bool InitSwapChain()
@@ -312,9 +384,18 @@ bool InitDescriptorHeaps()
     {
         return false;
     }
-    //Cerate descriptor heap refer to SRV
+    // bindless CBV/SRV/UAV heap, persistent descriptors and a dynamic slice per frame, the unbounded
+    // table over it needs resource binding tier 2
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    hr = device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options));
+    if (FAILED(hr) || options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_2)
+    {
+        OutputDebugStringA("Bindless descriptors need resource binding tier 2\n");
+        return false;
+    }
+    bindlessDescriptors.Init(BindlessPersistentDescriptors, frameBufferCount, BindlessDynamicDescriptorsPerFrame);
     D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
-    heapDesc.NumDescriptors = 1;
+    heapDesc.NumDescriptors = bindlessDescriptors.Capacity();
     heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     hr = device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mainDescriptorHeap));
@@ -322,10 +403,37 @@ bool InitDescriptorHeaps()
     {
         return false;
     }
+    mainDescriptorHeap->SetName(L"Bindless Descriptor Heap");
+    bindlessDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
     return true;
 }
 
+D3D12_CPU_DESCRIPTOR_HANDLE BindlessCPUHandle(uint32_t index)
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mainDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), index, bindlessDescriptorSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE BindlessGPUHandle(uint32_t index)
+{
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(mainDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), index, bindlessDescriptorSize);
+}
+
+void FreeBindlessDescriptor(uint32_t index)
+{
+    bindlessDescriptors.FreePersistent(index, frameSerial);
+}
+
+uint32_t StageFrameDescriptors(D3D12_CPU_DESCRIPTOR_HANDLE source, uint32_t count)
+{
+    uint32_t first = bindlessDescriptors.AllocateDynamic(count);
+    if (first != InvalidDescriptorIndex)
+    {
+        device->CopyDescriptorsSimple(count, BindlessCPUHandle(first), source, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    }
+    return first;
+}
+
 bool InitFenceAndEvent()
 {
     HRESULT hr;
@@ -363,13 +471,13 @@ bool InitRootSignature()
     rootLightCBVDescriptor.RegisterSpace = 0;
     rootLightCBVDescriptor.ShaderRegister = 1;
 
-    // descriptor range
+    // descriptor range, the whole bindless heap as Texture2D textures[] in space1
     D3D12_DESCRIPTOR_RANGE descriptorTableRanges[1];
     descriptorTableRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-    descriptorTableRanges[0].NumDescriptors = 1;
+    descriptorTableRanges[0].NumDescriptors = UINT_MAX;
     descriptorTableRanges[0].BaseShaderRegister = 0;
-    descriptorTableRanges[0].RegisterSpace = 0;
-    descriptorTableRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+    descriptorTableRanges[0].RegisterSpace = 1;
+    descriptorTableRanges[0].OffsetInDescriptorsFromTableStart = 0;
 
     // create a descriptor table
     D3D12_ROOT_DESCRIPTOR_TABLE descriptorTable;
@@ -377,7 +485,7 @@ bool InitRootSignature()
     descriptorTable.pDescriptorRanges = &descriptorTableRanges[0];
 
     // create a root parameter and fill it out
-    D3D12_ROOT_PARAMETER rootParameters[3];
+    D3D12_ROOT_PARAMETER rootParameters[5];
     rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
     rootParameters[0].Descriptor = rootCBVDescriptor;
     rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
@@ -391,6 +499,19 @@ bool InitRootSignature()
     rootParameters[2].Descriptor = rootLightCBVDescriptor;
     rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
+    // material of the draw, indexes the material table
+    rootParameters[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    rootParameters[3].Constants.ShaderRegister = 2;
+    rootParameters[3].Constants.RegisterSpace = 0;
+    rootParameters[3].Constants.Num32BitValues = 1;
+    rootParameters[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+    // the material table, StructuredBuffer<MaterialData> materials at t0
+    rootParameters[4].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParameters[4].Descriptor.ShaderRegister = 0;
+    rootParameters[4].Descriptor.RegisterSpace = 0;
+    rootParameters[4].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
     // create a static sampler
     D3D12_STATIC_SAMPLER_DESC sampler = {};
     sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
@@ -430,388 +551,1507 @@ bool InitRootSignature()
         return false;
     }
 
+    PipelineHasher signatureHasher;
+    signatureHasher.Add(signature->GetBufferPointer(), signature->GetBufferSize());
+    rootSignatureHash = signatureHasher.Hash();
+
     return true;
 }
 
-bool InitResources()
+uint64_t D3D12HeapTraits::Granularity(uint32_t category)
 {
-    HRESULT hr;
+    // constant buffers are the smallest upload ranges, everything in a default heap is placed on 64 KB
+    return category == GpuMemoryUpload ? D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+}
 
-    std::vector<Vertex> vList;
-    std::vector<DWORD> iList;
+D3D12MemoryBlock* D3D12HeapTraits::CreateHeap(uint32_t category, uint64_t size)
+{
+    HRESULT hr;
 
-    if (!loadMesh("teapot.obj", vList, iList))
+    // resource heap tier 1 keeps buffers, textures and render targets in heaps of their own
+    static const D3D12_HEAP_FLAGS categoryFlags[GpuMemoryCategoryCount] = {
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+    };
+    D3D12_HEAP_DESC heapDesc = {};
+    // multisampled render targets are placed on 4 MB
+    heapDesc.Alignment = category == GpuMemoryRenderTargets ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    heapDesc.SizeInBytes = (size + heapDesc.Alignment - 1) / heapDesc.Alignment * heapDesc.Alignment;
+    heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(category == GpuMemoryUpload ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT);
+    heapDesc.Flags = categoryFlags[category];
+
+    D3D12MemoryBlock* block = new D3D12MemoryBlock();
+    hr = device->CreateHeap(&heapDesc, IID_PPV_ARGS(&block->heap));
+    if (FAILED(hr))
     {
-        return false;
+        delete block;
+        return nullptr;
     }
+    block->residencyHandle = ResidencyManager<ID3D12Pageable>::InvalidHandle;
 
-    // **Vertex Buffer**
-    vBufferSize = vList.size() * sizeof(Vertex);
-    CD3DX12_HEAP_PROPERTIES vertextHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    CD3DX12_RESOURCE_DESC vertexHeapResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(vBufferSize);
-    device->CreateCommittedResource(
-        &vertextHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &vertexHeapResourceDesc,
-        D3D12_RESOURCE_STATE_COPY_DEST,
-        nullptr,
-        IID_PPV_ARGS(&vertexBuffer));
-    vertexBuffer->SetName(L"Vertex Buffer Resource Heap");
-
-    CD3DX12_HEAP_PROPERTIES uploadVHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD); // upload heap
-    CD3DX12_RESOURCE_DESC uploadVHeapResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(vBufferSize);
-    ID3D12Resource* vBufferUploadHeap;
-    device->CreateCommittedResource(
-        &uploadVHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &uploadVHeapResourceDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&vBufferUploadHeap));
-    vBufferUploadHeap->SetName(L"Vertex Buffer Upload Resource Heap");
-
-    D3D12_SUBRESOURCE_DATA vertexData = {};
-    vertexData.pData = reinterpret_cast<BYTE*>(vList.data());
-    vertexData.RowPitch = vBufferSize;
-    vertexData.SlicePitch = vBufferSize;
-
-    UpdateSubresources(commandList, vertexBuffer, vBufferUploadHeap, 0, 0, 1, &vertexData);
-
-    CD3DX12_RESOURCE_BARRIER vBufferBarrier =
-        CD3DX12_RESOURCE_BARRIER::Transition(vertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
-    commandList->ResourceBarrier(1, &vBufferBarrier);
-
-    // **Index Buffer**
-    numOfIndices = iList.size();
-    iBufferSize = iList.size() * sizeof(DWORD);
-    
-    CD3DX12_HEAP_PROPERTIES indexHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    CD3DX12_RESOURCE_DESC indexHeapResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(iBufferSize);
-    device->CreateCommittedResource(
-        &indexHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &indexHeapResourceDesc,
-        D3D12_RESOURCE_STATE_COPY_DEST,
-        nullptr,
-        IID_PPV_ARGS(&indexBuffer));
-    indexBuffer->SetName(L"Index Buffer Resource Heap");
-
-    ID3D12Resource* iBufferUploadHeap;
-    CD3DX12_HEAP_PROPERTIES uploadIHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    CD3DX12_RESOURCE_DESC uploadIHeapResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(iBufferSize);
-    device->CreateCommittedResource(
-        &uploadIHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &uploadIHeapResourceDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&iBufferUploadHeap));
-    iBufferUploadHeap->SetName(L"Index Buffer Upload Resource Heap");
-
-    D3D12_SUBRESOURCE_DATA indexData = {};
-    indexData.pData = reinterpret_cast<BYTE*>(iList.data());
-    indexData.RowPitch = iBufferSize;
-    indexData.SlicePitch = iBufferSize;
-
-    UpdateSubresources(commandList, indexBuffer, iBufferUploadHeap, 0, 0, 1, &indexData);
-
-    CD3DX12_RESOURCE_BARRIER iBufferBarrier =
-        CD3DX12_RESOURCE_BARRIER::Transition(indexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER);
-    commandList->ResourceBarrier(1, &iBufferBarrier);
-
-    // **Depth Buffer**
-    depthStencilDesc = {};
-    depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
-    depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-    depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
-
-    D3D12_CLEAR_VALUE depthOptimizedClearValue = {};
-    depthOptimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-    depthOptimizedClearValue.DepthStencil.Depth = 1.0f;
-    depthOptimizedClearValue.DepthStencil.Stencil = 0;
-
-    CD3DX12_HEAP_PROPERTIES depthStencilHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    CD3DX12_RESOURCE_DESC depthStencilHeapResourceDesc
-        = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, Width, Height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
-    device->CreateCommittedResource(
-        &depthStencilHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &depthStencilHeapResourceDesc,
-        D3D12_RESOURCE_STATE_DEPTH_WRITE,
-        &depthOptimizedClearValue,
-        IID_PPV_ARGS(&depthStencilBuffer)
-    );
-
-    // **Constant Buffer**
-    for (int i = 0; i < frameBufferCount; ++i)
+    if (category == GpuMemoryUpload)
     {
-        CD3DX12_HEAP_PROPERTIES constantBufferUploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-        CD3DX12_RESOURCE_DESC constantBufferUploadHeapResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(1024 * 64);
-        hr = device->CreateCommittedResource(
-            &constantBufferUploadHeapProperties,
-            D3D12_HEAP_FLAG_NONE,
-            &constantBufferUploadHeapResourceDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&constantBufferUploadHeaps[i]));
-        constantBufferUploadHeaps[i]->SetName(L"Constant buffer Upload Resource Haep");
-
-        ZeroMemory(&cbPerObject, sizeof(cbPerObject));
+        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(heapDesc.SizeInBytes);
+        hr = device->CreatePlacedResource(block->heap, 0, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&block->buffer));
+        if (FAILED(hr))
+        {
+            DestroyHeap(block);
+            return nullptr;
+        }
+        block->buffer->SetName(L"Upload Memory Block");
 
+        // upload memory stays mapped, the CPU only writes it
         CD3DX12_RANGE readRange(0, 0);
+        hr = block->buffer->Map(0, &readRange, reinterpret_cast<void**>(&block->mapped));
+        if (FAILED(hr))
+        {
+            DestroyHeap(block);
+            return nullptr;
+        }
+    }
+    else if (category != GpuMemoryRenderTargets)
+    {
+        block->residencyHandle = residency.Track(block->heap, heapDesc.SizeInBytes);
+    }
+    return block;
+}
 
-        hr = constantBufferUploadHeaps[i]->Map(0, &readRange, reinterpret_cast<void**>(&cbvGPUAddress[i]));
-
-        memcpy(cbvGPUAddress[i], &cbPerObject, sizeof(cbPerObject));
-
-        // Light data
-       hr = device->CreateCommittedResource(
-            &constantBufferUploadHeapProperties,
-            D3D12_HEAP_FLAG_NONE,
-            &constantBufferUploadHeapResourceDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&lightConstantBufferUploadHeaps[i]));
-        lightConstantBufferUploadHeaps[i]->SetName(L"Light Constant buffer Upload Resource Haep");
-
-        ZeroMemory(&lightConstant, sizeof(lightConstant));
-        lightConstant.ambientLight = XMFLOAT3(0.7f, 0.7f, 0.7f);
-    
-        lightConstant.pointLights[0].diffuseColor = XMFLOAT3(0.5f, 0.5f, 0);
-        lightConstant.pointLights[0].innerRadius = 50000.0f;
-        lightConstant.pointLights[0].outerRadius = 100000.0f;
-        lightConstant.pointLights[0].specularColor = XMFLOAT3(0.5f, 0.5f, 0.5f);
-        lightConstant.pointLights[0].specularPower = 50.f;
-        lightConstant.pointLights[0].position = XMFLOAT3(30.f, 30.f, -30.f);
-        lightConstant.pointLights[0].enable = true;
-        lightConstant.pointLights[1].enable = false;
-        lightConstant.pointLights[2].enable = false;
-
-
-        readRange = CD3DX12_RANGE(0, 0);
-
-        hr = lightConstantBufferUploadHeaps[i]->Map(0, &readRange, reinterpret_cast<void**>(&lightCBVGPUAddress[i]));
-
-        memcpy(lightCBVGPUAddress[i], &lightConstant, sizeof(lightConstant));
-
+void D3D12HeapTraits::DestroyHeap(D3D12MemoryBlock* block)
+{
+    if (block->residencyHandle != ResidencyManager<ID3D12Pageable>::InvalidHandle)
+    {
+        residency.Untrack(block->residencyHandle);
+    }
+    if (block->mapped)
+    {
+        block->buffer->Unmap(0, nullptr);
     }
+    SAFE_RELEASE(block->buffer);
+    SAFE_RELEASE(block->heap);
+    delete block;
+}
 
-    // **Texture buffer**
-    // Load image from file
-    int imageBytesPerRow;
-    BYTE* imageData;
-    int imageSize = LoadImageDataFromFile(&imageData, textureDesc, L"img.jpg", imageBytesPerRow);
-    if (imageSize <= 0)
+bool CreateGpuResource(uint32_t category, const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES state,
+    const D3D12_CLEAR_VALUE* clearValue, ID3D12Resource** resource, GpuAllocation& memory)
+{
+    D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = device->GetResourceAllocationInfo(0, 1, &desc);
+    if (allocationInfo.SizeInBytes == UINT64_MAX)
     {
-        Running = false;
         return false;
     }
-    // create a heap for texture
-    CD3DX12_HEAP_PROPERTIES textureBufferHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    hr = device->CreateCommittedResource(
-        &textureBufferHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &textureDesc,
-        D3D12_RESOURCE_STATE_COPY_DEST,
-        nullptr,
-        IID_PPV_ARGS(&textureBuffer));
-    if (FAILED(hr))
+    if (!gpuMemory.Allocate(category, allocationInfo.SizeInBytes, allocationInfo.Alignment, memory))
     {
-        Running = false;
         return false;
     }
-    textureBuffer->SetName(L"Texture Buffer Resource Heap");
 
-    // create a heap for upload texture
-    UINT64 textureUploadBufferSize;
-    device->GetCopyableFootprints(&textureDesc, 0, 1, 0, nullptr, nullptr, nullptr, &textureUploadBufferSize);
-
-    CD3DX12_HEAP_PROPERTIES textureBufferUploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    CD3DX12_RESOURCE_DESC textureBufferUploadResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(textureUploadBufferSize);
-    hr = device->CreateCommittedResource(
-        &textureBufferUploadHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &textureBufferUploadResourceDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&textureBufferUploadHeap));
+    HRESULT hr = device->CreatePlacedResource(gpuMemory.HeapOf(memory)->heap, memory.offset, &desc, state, clearValue, IID_PPV_ARGS(resource));
     if (FAILED(hr))
     {
-        Running = false;
+        gpuMemory.Free(memory);
         return false;
     }
-    textureBufferUploadHeap->SetName(L"Texture Buffer Upload Resource Heap");
-
-    // upload texture
-    D3D12_SUBRESOURCE_DATA textureData = {};
-    textureData.pData = &imageData[0];
-    textureData.RowPitch = imageBytesPerRow;
-    textureData.SlicePitch = imageBytesPerRow * textureDesc.Height;
+    return true;
+}
 
-    UpdateSubresources(commandList, textureBuffer, textureBufferUploadHeap, 0, 0, 1, &textureData);
+bool AllocateUpload(UINT64 size, UINT64 alignment, UploadRange& range)
+{
+    if (!gpuMemory.Allocate(GpuMemoryUpload, size, alignment, range.allocation))
+    {
+        return false;
+    }
+    D3D12MemoryBlock* block = gpuMemory.HeapOf(range.allocation);
+    range.buffer = block->buffer;
+    range.offset = range.allocation.offset;
+    range.cpuAddress = block->mapped + range.offset;
+    range.gpuAddress = block->buffer->GetGPUVirtualAddress() + range.offset;
+    return true;
+}
 
-    CD3DX12_RESOURCE_BARRIER textureBufferBarrier = CD3DX12_RESOURCE_BARRIER::Transition(textureBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    commandList->ResourceBarrier(1, &textureBufferBarrier);
-    delete imageData;
+void FreeUpload(UploadRange& range)
+{
+    gpuMemory.Free(range.allocation);
+    range.buffer = nullptr;
+    range.cpuAddress = nullptr;
+    range.gpuAddress = 0;
+}
 
+void ReportGpuMemory()
+{
+    static const char* categoryNames[GpuMemoryCategoryCount] = { "buffers", "textures", "render targets", "upload" };
+    char message[256];
+    UINT64 reserved = 0;
+    UINT64 used = 0;
+    for (uint32_t category = 0; category < GpuMemoryCategoryCount; ++category)
+    {
+        GpuMemoryStatistics stats = gpuMemory.Statistics(category);
+        snprintf(message, sizeof(message), "GPU memory %s: %u heaps, %.1f of %.1f MB used by %u allocations, largest free %.1f MB, %.0f%% fragmented\n",
+            categoryNames[category], stats.blocks, stats.used / (1024.0 * 1024.0), stats.reserved / (1024.0 * 1024.0), stats.allocations,
+            stats.largestFree / (1024.0 * 1024.0), stats.fragmentation * 100.0);
+        OutputDebugStringA(message);
+        reserved += stats.reserved;
+        used += stats.used;
+    }
+    snprintf(message, sizeof(message), "GPU memory: %.1f MB reserved, %.1f MB used\n", reserved / (1024.0 * 1024.0), used / (1024.0 * 1024.0));
+    OutputDebugStringA(message);
+}
 
-    return true;
+// the frame being recorded reads memory
+static void UseGpuMemory(const GpuAllocation& memory)
+{
+    if (memory.handle == InvalidAllocation)
+    {
+        return;
+    }
+    uint32_t residencyHandle = gpuMemory.HeapOf(memory)->residencyHandle;
+    if (residencyHandle != ResidencyManager<ID3D12Pageable>::InvalidHandle)
+    {
+        residency.Use(residencyHandle);
+    }
 }
 
-bool InitViews()
+bool UpdateResidency()
 {
     HRESULT hr;
 
-    // ** RTV **
-    // The length of RTV descriptor size, this may vary from device to device
-    rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-    // Get the CPU handle of the first descriptor in the descriptro heap
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-    // Create RTV for each buffer
-    for (int i = 0; i < frameBufferCount; ++i)
+    // the budget left for the tracked heaps is the adapter's minus what everything else uses
+    UINT64 budget = UINT64_MAX;
+    if (dxgiAdapter)
     {
-        hr = swapChain->GetBuffer(i, IID_PPV_ARGS(&renderTargets[i]));
-        if (FAILED(hr))
+        DXGI_QUERY_VIDEO_MEMORY_INFO memoryInfo = {};
+        hr = dxgiAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memoryInfo);
+        if (SUCCEEDED(hr))
         {
-            return false;
+            UINT64 tracked = residency.ResidentBytes();
+            UINT64 untracked = memoryInfo.CurrentUsage > tracked ? memoryInfo.CurrentUsage - tracked : 0;
+            budget = memoryInfo.Budget > untracked ? memoryInfo.Budget - untracked : 0;
         }
-
-        device->CreateRenderTargetView(renderTargets[i], nullptr, rtvHandle);
-
-        rtvHandle.Offset(1, rtvDescriptorSize);
+    }
+    if (ResidencyBudgetLimit > 0)
+    {
+        budget = std::min(budget, ResidencyBudgetLimit);
     }
 
-    // ** DSV **
-    device->CreateDepthStencilView(depthStencilBuffer, &depthStencilDesc, dsDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-    // ** SRV **
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Format = textureDesc.Format;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = 1;
-    device->CreateShaderResourceView(textureBuffer, &srvDesc, mainDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+    residency.BeginFrame(frameSerial, completedFrameSerial, budget);
+    UseGpuMemory(vertexBufferMemory);
+    UseGpuMemory(indexBufferMemory);
+    UseGpuMemory(materialTableMemory);
+    UseGpuMemory(whiteTexture.memory);
+    UseGpuMemory(flatNormalTexture.memory);
+    // the megabuffers a compaction in this frame copies from
+    for (size_t i = 0; i < retiredGpuResources.size(); ++i)
+    {
+        if (retiredGpuResources[i].frameValue == frameSerial)
+        {
+            UseGpuMemory(retiredGpuResources[i].memory);
+        }
+    }
+    // shaders reach textures through the material of the draw only, the textures of materials nothing
+    // draws this frame stay at the front of the LRU list and are the first to go
+    uint32_t usedMaterial = UINT32_MAX;
+    for (size_t i = 0; i < frameDraws.size(); ++i)
+    {
+        // draws are grouped by material
+        if (frameDraws[i].material == usedMaterial)
+        {
+            continue;
+        }
+        usedMaterial = frameDraws[i].material;
+        const Material& material = sceneMaterials[usedMaterial];
+        if (material.diffuseTexture != NoMaterialTexture)
+        {
+            UseGpuMemory(sceneTextures[material.diffuseTexture].memory);
+        }
+        if (material.normalTexture != NoMaterialTexture)
+        {
+            UseGpuMemory(sceneTextures[material.normalTexture].memory);
+        }
+    }
 
-    // vertex buffer view
-    vertexBufferView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
-    vertexBufferView.StrideInBytes = sizeof(Vertex);
-    vertexBufferView.SizeInBytes = vBufferSize;
-    // index buffer view
-    indexBufferView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
-    indexBufferView.Format = DXGI_FORMAT_R32_UINT;
-    indexBufferView.SizeInBytes = iBufferSize;
+    std::vector<ID3D12Pageable*> makeResident;
+    std::vector<ID3D12Pageable*> evict;
+    residencyTelemetry = residency.EndFrame(makeResident, evict);
+    if (!evict.empty())
+    {
+        device->Evict(UINT(evict.size()), evict.data());
+    }
+    if (!makeResident.empty())
+    {
+        // blocks until the heaps are back, the frame cannot execute without them
+        hr = device->MakeResident(UINT(makeResident.size()), makeResident.data());
+        if (FAILED(hr))
+        {
+            OutputDebugStringA("Residency: heaps used by the frame could not be made resident\n");
+            return false;
+        }
+    }
 
+    if (residencyTelemetry.madeResident > 0 || residencyTelemetry.evicted > 0)
+    {
+        char message[256];
+        snprintf(message, sizeof(message),
+            "Residency frame %llu: %u heaps evicted (%.1f MB), %u made resident (%.1f MB), %.1f of %.1f MB resident%s\n",
+            (unsigned long long)residencyTelemetry.frame, residencyTelemetry.evicted, residencyTelemetry.evictedThisFrameBytes / (1024.0 * 1024.0),
+            residencyTelemetry.madeResident, residencyTelemetry.madeResidentBytes / (1024.0 * 1024.0),
+            residencyTelemetry.residentBytes / (1024.0 * 1024.0), residencyTelemetry.budget / (1024.0 * 1024.0),
+            residencyTelemetry.overBudget ? ", over budget" : "");
+        OutputDebugStringA(message);
+    }
     return true;
 }
 
-bool InitVSPS()
+void ReportResidency()
 {
-    HRESULT hr;
-    // vertx shader
-    ID3DBlob* vertexShader;
-    ID3DBlob* errorBuff;
-    hr = D3DCompileFromFile(L"VertexShader.hlsl", nullptr, nullptr, "main", "vs_5_0",
-        D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &vertexShader, &errorBuff);
-    if (FAILED(hr))
+    ResidencyStatistics stats = residency.Statistics();
+    char message[320];
+    snprintf(message, sizeof(message),
+        "Residency: %u heaps, %.1f MB tracked, %.1f MB resident (peak %.1f MB), last frame used %.1f MB of a %.1f MB budget, "
+        "%llu evictions (%.1f MB), %llu restores (%.1f MB), %llu of %llu frames over budget\n",
+        stats.trackedObjects, stats.trackedBytes / (1024.0 * 1024.0), residencyTelemetry.residentBytes / (1024.0 * 1024.0),
+        stats.peakResidentBytes / (1024.0 * 1024.0), residencyTelemetry.usedBytes / (1024.0 * 1024.0),
+        residencyTelemetry.budget == UINT64_MAX ? 0.0 : residencyTelemetry.budget / (1024.0 * 1024.0),
+        (unsigned long long)stats.evicted, stats.evictedBytes / (1024.0 * 1024.0), (unsigned long long)stats.madeResident,
+        stats.madeResidentBytes / (1024.0 * 1024.0), (unsigned long long)stats.overBudgetFrames, (unsigned long long)stats.frames);
+    OutputDebugStringA(message);
+}
+
+bool InitGeometryPool(UINT vertexCapacity, UINT stride, UINT indexCapacity, DXGI_FORMAT format)
+{
+    geometryPool.Init(vertexCapacity, stride, indexCapacity, format == DXGI_FORMAT_R16_UINT ? sizeof(WORD) : sizeof(DWORD));
+    indexFormat = format;
+    vBufferSize = int(geometryPool.VertexBufferSize());
+    iBufferSize = int(geometryPool.IndexBufferSize());
+
+    CD3DX12_RESOURCE_DESC vertexHeapResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(vBufferSize);
+    if (!CreateGpuResource(GpuMemoryBuffers, vertexHeapResourceDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, &vertexBuffer, vertexBufferMemory))
     {
-        OutputDebugStringA((char*)errorBuff->GetBufferPointer());
         return false;
     }
-    vertexShaderBytecode = {};
-    vertexShaderBytecode.BytecodeLength = vertexShader->GetBufferSize();
-    vertexShaderBytecode.pShaderBytecode = vertexShader->GetBufferPointer();
+    vertexBuffer->SetName(L"Vertex Megabuffer");
+    resourceStates.Register(vertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
 
-    // pixel shader
-    ID3DBlob* pixelShader;
-    hr = D3DCompileFromFile(L"PixelShader.hlsl", nullptr, nullptr, "main", "ps_5_0",
-        D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &pixelShader, &errorBuff);
-    if (FAILED(hr))
+    CD3DX12_RESOURCE_DESC indexHeapResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(iBufferSize);
+    if (!CreateGpuResource(GpuMemoryBuffers, indexHeapResourceDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, &indexBuffer, indexBufferMemory))
     {
-        OutputDebugStringA((char*)errorBuff->GetBufferPointer());
         return false;
     }
-    pixelShaderBytecode = {};
-    pixelShaderBytecode.BytecodeLength = pixelShader->GetBufferSize();
-    pixelShaderBytecode.pShaderBytecode = pixelShader->GetBufferPointer();
-
+    indexBuffer->SetName(L"Index Megabuffer");
+    resourceStates.Register(indexBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
     return true;
 }
 
-bool InitPSO()
+bool UploadMeshGeometry(uint32_t mesh, const void* vertices, const void* indices)
 {
-    HRESULT hr;
-
-    // Input Layout
-    D3D12_INPUT_ELEMENT_DESC inputLayout[] =
-    {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
-    };
-
-    D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = {};
-
-    inputLayoutDesc.NumElements = sizeof(inputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
-    inputLayoutDesc.pInputElementDescs = inputLayout;
-
-    // PSO Desc
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-    psoDesc.InputLayout = inputLayoutDesc;
-    psoDesc.pRootSignature = rootSignature;
-    psoDesc.VS = vertexShaderBytecode;
-    psoDesc.PS = pixelShaderBytecode;
-    psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-    psoDesc.SampleDesc = sampleDesc; // must be the same as the swapchain and depth/stencil buffer
-    psoDesc.SampleMask = 0xffffffff;
-    psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-    psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-    psoDesc.NumRenderTargets = 1;
-    psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+    GeometryRange range = geometryPool.Range(mesh);
+    UINT64 vertexBytes = UINT64(range.vertexCount) * geometryPool.VertexStride();
+    UINT64 indexBytes = UINT64(range.indexCount) * geometryPool.IndexSize();
 
-    // create the pso
-    hr = device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineStateObject));
-    if (FAILED(hr))
+    // vertices and indices share one staging range
+    UploadRange staging;
+    if (!AllocateUpload(vertexBytes + indexBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, staging))
     {
         return false;
     }
-
+    initUploads.push_back(staging);
+    memcpy(staging.cpuAddress, vertices, vertexBytes);
+    memcpy(staging.cpuAddress + vertexBytes, indices, indexBytes);
+
+    uploadStates.TransitionResource(vertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    uploadStates.TransitionResource(indexBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    commandList->CopyBufferRegion(vertexBuffer, geometryPool.VertexOffset(mesh), staging.buffer, staging.offset, vertexBytes);
+    commandList->CopyBufferRegion(indexBuffer, geometryPool.IndexOffset(mesh), staging.buffer, staging.offset + vertexBytes, indexBytes);
+    uploadStates.TransitionResource(vertexBuffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    uploadStates.TransitionResource(indexBuffer, D3D12_RESOURCE_STATE_INDEX_BUFFER);
     return true;
 }
 
-bool InitD3D()
+void UpdateGeometryViews()
 {
-    HRESULT hr;
+    vertexBufferView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
+    vertexBufferView.StrideInBytes = geometryPool.VertexStride();
+    vertexBufferView.SizeInBytes = vBufferSize;
+    indexBufferView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
+    indexBufferView.Format = indexFormat;
+    indexBufferView.SizeInBytes = iBufferSize;
+}
 
-    if (!InitD3DDevice())
+bool CompactGeometry()
+{
+    ID3D12GraphicsCommandList* list = GraphCommandList();
+    if (list == nullptr)
     {
-        Running = false;
         return false;
     }
-    if (!InitCommandQueue())
+
+    ID3D12Resource* oldVertexBuffer = vertexBuffer;
+    ID3D12Resource* oldIndexBuffer = indexBuffer;
+    GpuAllocation oldVertexMemory = vertexBufferMemory;
+    GpuAllocation oldIndexMemory = indexBufferMemory;
+
+    CD3DX12_RESOURCE_DESC vertexHeapResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(vBufferSize);
+    CD3DX12_RESOURCE_DESC indexHeapResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(iBufferSize);
+    ID3D12Resource* newVertexBuffer = nullptr;
+    ID3D12Resource* newIndexBuffer = nullptr;
+    GpuAllocation newVertexMemory;
+    GpuAllocation newIndexMemory;
+    if (!CreateGpuResource(GpuMemoryBuffers, vertexHeapResourceDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, &newVertexBuffer, newVertexMemory))
     {
-        Running = false;
         return false;
     }
-    if (!InitCommandAllocators())
+    if (!CreateGpuResource(GpuMemoryBuffers, indexHeapResourceDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, &newIndexBuffer, newIndexMemory))
     {
-        Running = false;
+        SAFE_RELEASE(newVertexBuffer);
+        gpuMemory.Free(newVertexMemory);
         return false;
     }
-    if (!InitCommandList())
+    newVertexBuffer->SetName(L"Vertex Megabuffer");
+    newIndexBuffer->SetName(L"Index Megabuffer");
+    resourceStates.Register(newVertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    resourceStates.Register(newIndexBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    GeometryPoolStatistics before = geometryPool.Statistics();
+    std::vector<GeometryCopy> vertexCopies;
+    std::vector<GeometryCopy> indexCopies;
+    geometryPool.Compact(vertexCopies, indexCopies);
+
+    graphStates.TransitionResource(oldVertexBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    graphStates.TransitionResource(oldIndexBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    graphStates.TransitionResource(newVertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    graphStates.TransitionResource(newIndexBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    FlushResourceBarriers(graphStates, list);
+    for (size_t i = 0; i < vertexCopies.size(); ++i)
     {
-        Running = false;
-        return false;
+        list->CopyBufferRegion(newVertexBuffer, vertexCopies[i].destinationOffset, oldVertexBuffer, vertexCopies[i].sourceOffset, vertexCopies[i].size);
     }
-    if (!InitSwapChain())
+    for (size_t i = 0; i < indexCopies.size(); ++i)
     {
-        Running = false;
-        return false;
+        list->CopyBufferRegion(newIndexBuffer, indexCopies[i].destinationOffset, oldIndexBuffer, indexCopies[i].sourceOffset, indexCopies[i].size);
     }
-    if (!InitDescriptorHeaps())
+    graphStates.TransitionResource(newVertexBuffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    graphStates.TransitionResource(newIndexBuffer, D3D12_RESOURCE_STATE_INDEX_BUFFER);
+    FlushResourceBarriers(graphStates, list);
+
+    // frames in flight still draw from the old megabuffers
+    RetiredGpuResource retiredVertices = { oldVertexBuffer, oldVertexMemory, frameSerial };
+    RetiredGpuResource retiredIndices = { oldIndexBuffer, oldIndexMemory, frameSerial };
+    retiredGpuResources.push_back(retiredVertices);
+    retiredGpuResources.push_back(retiredIndices);
+    vertexBuffer = newVertexBuffer;
+    indexBuffer = newIndexBuffer;
+    vertexBufferMemory = newVertexMemory;
+    indexBufferMemory = newIndexMemory;
+    UpdateGeometryViews();
+
+    char message[256];
+    snprintf(message, sizeof(message), "Geometry compacted: %u meshes, %.0f%% fragmented before, %zu vertex and %zu index copies\n",
+        before.meshes, before.fragmentation * 100.0, vertexCopies.size(), indexCopies.size());
+    OutputDebugStringA(message);
+    return true;
+}
+
+void ReleaseRetiredGpuResources()
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < retiredGpuResources.size(); ++i)
     {
-        Running = false;
-        return false;
+        RetiredGpuResource& retired = retiredGpuResources[i];
+        if (retired.frameValue <= completedFrameSerial)
+        {
+            resourceStates.Unregister(retired.resource);
+            SAFE_RELEASE(retired.resource);
+            gpuMemory.Free(retired.memory);
+        }
+        else
+        {
+            retiredGpuResources[kept++] = retired;
+        }
+    }
+    retiredGpuResources.resize(kept);
+}
+
+bool CreateSceneTexture(const D3D12_RESOURCE_DESC& desc, const BYTE* data, int bytesPerRow, const wchar_t* name, SceneTexture& texture)
+{
+    // place the texture
+    if (!CreateGpuResource(GpuMemoryTextures, desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, &texture.resource, texture.memory))
+    {
+        return false;
+    }
+    texture.resource->SetName(name);
+    resourceStates.Register(texture.resource, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    // upload memory for the texture
+    UINT64 textureUploadBufferSize;
+    device->GetCopyableFootprints(&desc, 0, 1, 0, nullptr, nullptr, nullptr, &textureUploadBufferSize);
+
+    UploadRange textureUpload;
+    if (!AllocateUpload(textureUploadBufferSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, textureUpload))
+    {
+        return false;
+    }
+    initUploads.push_back(textureUpload);
+
+    // upload texture
+    D3D12_SUBRESOURCE_DATA textureData = {};
+    textureData.pData = data;
+    textureData.RowPitch = bytesPerRow;
+    textureData.SlicePitch = bytesPerRow * desc.Height;
+
+    uploadStates.TransitionResource(texture.resource, D3D12_RESOURCE_STATE_COPY_DEST);
+    UpdateSubresources(commandList, texture.resource, textureUpload.buffer, textureUpload.offset, 0, 1, &textureData);
+    uploadStates.TransitionResource(texture.resource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+    // ** SRV **
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Format = desc.Format;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MipLevels = 1;
+    texture.descriptor = bindlessDescriptors.AllocatePersistent();
+    if (texture.descriptor == InvalidDescriptorIndex)
+    {
+        return false;
+    }
+    device->CreateShaderResourceView(texture.resource, &srvDesc, BindlessCPUHandle(texture.descriptor));
+    return true;
+}
+
+bool InitSceneMaterials(const std::vector<MeshAssetMaterial>& materials)
+{
+    // **White texture**
+    const UINT32 white = 0xffffffff;
+    D3D12_RESOURCE_DESC whiteDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1);
+    if (!CreateSceneTexture(whiteDesc, reinterpret_cast<const BYTE*>(&white), sizeof(white), L"White Texture", whiteTexture))
+    {
+        return false;
+    }
+    // **Flat normal texture**
+    // rgba (128, 128, 255, 255), the tangent space +z
+    const UINT32 flatNormal = 0xffff8080;
+    if (!CreateSceneTexture(whiteDesc, reinterpret_cast<const BYTE*>(&flatNormal), sizeof(flatNormal), L"Flat Normal Texture", flatNormalTexture))
+    {
+        return false;
+    }
+
+    // **Textures**
+    // every file once, the materials share them
+    std::vector<std::string> texturePaths;
+    std::vector<uint32_t> diffuseTextures;
+    std::vector<uint32_t> bumpTextures;
+    BuildMaterialTextureList(materials, texturePaths, diffuseTextures, bumpTextures);
+
+    SceneTexture missing = { nullptr, GpuAllocation(), InvalidDescriptorIndex };
+    sceneTextures.assign(texturePaths.size(), missing);
+    for (size_t i = 0; i < texturePaths.size(); ++i)
+    {
+        std::wstring path(texturePaths[i].begin(), texturePaths[i].end());
+        int imageBytesPerRow;
+        BYTE* imageData;
+        D3D12_RESOURCE_DESC textureDesc;
+        int imageSize = LoadImageDataFromFile(&imageData, textureDesc, path.c_str(), imageBytesPerRow);
+        if (imageSize <= 0)
+        {
+            // a missing map only costs the material its texture
+            char message[512];
+            snprintf(message, sizeof(message), "Texture %s could not be loaded, drawing without it\n", texturePaths[i].c_str());
+            OutputDebugStringA(message);
+            continue;
+        }
+        bool created = CreateSceneTexture(textureDesc, imageData, imageBytesPerRow, path.c_str(), sceneTextures[i]);
+        free(imageData);
+        if (!created)
+        {
+            return false;
+        }
+    }
+
+    // **Material table**
+    std::vector<GpuMaterial> table(materials.size());
+    sceneMaterials.resize(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i)
+    {
+        const MeshAssetMaterial& source = materials[i];
+        bool textured = diffuseTextures[i] != NoMaterialTexture && sceneTextures[diffuseTextures[i]].resource != nullptr;
+        bool specular = source.specular[0] > 0.0f || source.specular[1] > 0.0f || source.specular[2] > 0.0f;
+        // map_bump is taken as a tangent space normal map
+        bool normalMapped = bumpTextures[i] != NoMaterialTexture && sceneTextures[bumpTextures[i]].resource != nullptr;
+        Material material = { textured, specular, normalMapped, textured ? diffuseTextures[i] : NoMaterialTexture,
+            normalMapped ? bumpTextures[i] : NoMaterialTexture };
+        sceneMaterials[i] = material;
+
+        GpuMaterial& entry = table[i];
+        entry = {};
+        entry.diffuseColor = XMFLOAT3(source.diffuse[0], source.diffuse[1], source.diffuse[2]);
+        entry.diffuseTexture = textured ? sceneTextures[diffuseTextures[i]].descriptor : whiteTexture.descriptor;
+        entry.specularColor = XMFLOAT3(source.specular[0], source.specular[1], source.specular[2]);
+        entry.specularPower = source.specularPower;
+        entry.normalTexture = normalMapped ? sceneTextures[bumpTextures[i]].descriptor : flatNormalTexture.descriptor;
+    }
+
+    UINT64 tableSize = std::max(UINT64(table.size() * sizeof(GpuMaterial)), UINT64(sizeof(GpuMaterial)));
+    CD3DX12_RESOURCE_DESC tableDesc = CD3DX12_RESOURCE_DESC::Buffer(tableSize);
+    if (!CreateGpuResource(GpuMemoryBuffers, tableDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, &materialTable, materialTableMemory))
+    {
+        return false;
+    }
+    materialTable->SetName(L"Material Table");
+    resourceStates.Register(materialTable, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    UploadRange staging;
+    if (!AllocateUpload(tableSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, staging))
+    {
+        return false;
+    }
+    initUploads.push_back(staging);
+    memcpy(staging.cpuAddress, table.data(), table.size() * sizeof(GpuMaterial));
+
+    uploadStates.TransitionResource(materialTable, D3D12_RESOURCE_STATE_COPY_DEST);
+    commandList->CopyBufferRegion(materialTable, 0, staging.buffer, staging.offset, table.size() * sizeof(GpuMaterial));
+    uploadStates.TransitionResource(materialTable, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    return true;
+}
+
+bool InitResources()
+{
+    gpuMemory.Init(GpuMemoryBlockSize);
+
+    std::vector<MeshAsset> meshes;
+    std::vector<MeshAssetMaterial> materials;
+
+    if (!loadScene("teapot.obj", meshes, materials))
+    {
+        return false;
+    }
+
+    // the asset pipeline picks the vertex layout per scene, the shaders and input layout follow it
+    useCompressedVertices = (meshes[0].flags & MeshAssetFlagCompressedVertices) != 0;
+    vertexStride = meshes[0].vertexStride;
+    if (useCompressedVertices)
+    {
+        float boundsMin[3], boundsMax[3];
+        MeshAssetSceneBounds(meshes, boundsMin, boundsMax);
+        positionDequantScale = XMFLOAT3(boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2]);
+        positionDequantOffset = XMFLOAT3(boundsMin[0], boundsMin[1], boundsMin[2]);
+    }
+    else
+    {
+        positionDequantScale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+        positionDequantOffset = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    }
+
+    // decode the indices on worker threads while the materials are set up
+    size_t meshCount = meshes.size();
+    std::vector<std::vector<uint16_t>> indices16(meshCount);
+    std::vector<std::vector<Submesh>> submeshes(meshCount);
+    std::vector<std::vector<MeshLodDraw>> lodDraws(meshCount);
+    std::vector<unsigned char> indicesReady(meshCount, 0);
+    JobCounter indexLoad;
+    jobSystem.Run([&]()
+    {
+        jobSystem.ParallelFor(meshCount, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                indicesReady[i] = PrepareMeshIndices(meshes[i], indices16[i], submeshes[i], lodDraws[i]);
+            }
+        });
+    }, &indexLoad);
+
+    // **Materials**
+    if (!InitSceneMaterials(materials))
+    {
+        jobSystem.Wait(indexLoad);
+        return false;
+    }
+
+    // **Geometry**
+    jobSystem.Wait(indexLoad);
+    bool all16Bit = true;
+    for (size_t i = 0; i < meshCount; ++i)
+    {
+        if (!indicesReady[i])
+        {
+            return false;
+        }
+        all16Bit = all16Bit && !indices16[i].empty();
+    }
+
+    // the megabuffers take one index format, a single mesh that needs 32 bit indices decides it for all
+    if (!all16Bit)
+    {
+        for (size_t i = 0; i < meshCount; ++i)
+        {
+            if (!indices16[i].empty())
+            {
+                PrepareMeshIndices(meshes[i], indices16[i], submeshes[i], lodDraws[i], false);
+            }
+        }
+    }
+    indexFormat = all16Bit ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    UINT indexSize = all16Bit ? sizeof(WORD) : sizeof(DWORD);
+
+    UINT vertexCount = 0;
+    UINT indexCount = 0;
+    for (size_t i = 0; i < meshCount; ++i)
+    {
+        vertexCount += meshes[i].VertexCount();
+        indexCount += UINT(all16Bit ? indices16[i].size() : meshes[i].indices.size());
+    }
+    if (!InitGeometryPool(std::max(UINT(GeometryVertexBufferBytes / vertexStride), vertexCount), vertexStride,
+        std::max(UINT(GeometryIndexBufferBytes / indexSize), indexCount), indexFormat))
+    {
+        return false;
+    }
+
+    sceneMeshes.clear();
+    meshSubmeshes.clear();
+    meshLods.clear();
+    for (size_t i = 0; i < meshCount; ++i)
+    {
+        const MeshAsset& mesh = meshes[i];
+        const void* indexBufferData = all16Bit ? (const void*)indices16[i].data() : (const void*)mesh.indices.data();
+        UINT meshIndexCount = UINT(all16Bit ? indices16[i].size() : mesh.indices.size());
+
+        SceneMesh sceneMesh = {};
+        sceneMesh.geometry = geometryPool.Allocate(mesh.VertexCount(), meshIndexCount);
+        if (sceneMesh.geometry == InvalidAllocation || !UploadMeshGeometry(sceneMesh.geometry, mesh.vertexData.data(), indexBufferData))
+        {
+            return false;
+        }
+        sceneMesh.firstLod = UINT(meshLods.size());
+        sceneMesh.lodCount = UINT(lodDraws[i].size());
+        sceneMesh.material = mesh.material;
+        sceneMesh.boundsCenter = XMFLOAT3((mesh.boundsMin[0] + mesh.boundsMax[0]) * 0.5f, (mesh.boundsMin[1] + mesh.boundsMax[1]) * 0.5f,
+            (mesh.boundsMin[2] + mesh.boundsMax[2]) * 0.5f);
+        XMStoreFloat(&sceneMesh.boundsRadius, XMVector3Length(XMVectorSubtract(XMLoadFloat3(&sceneMesh.boundsCenter),
+            XMVectorSet(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2], 0.0f))));
+        sceneMeshes.push_back(sceneMesh);
+
+        // the LOD and submesh lists of all meshes back to back
+        for (size_t l = 0; l < lodDraws[i].size(); ++l)
+        {
+            MeshLodDraw lod = lodDraws[i][l];
+            lod.firstSubmesh += UINT(meshSubmeshes.size());
+            meshLods.push_back(lod);
+        }
+        meshSubmeshes.insert(meshSubmeshes.end(), submeshes[i].begin(), submeshes[i].end());
+    }
+
+    // the meshes of a material next to each other, UpdateFrameConstants draws them material by material
+    std::stable_sort(sceneMeshes.begin(), sceneMeshes.end(), [](const SceneMesh& a, const SceneMesh& b) { return a.material < b.material; });
+    materialFirstMesh.assign(materials.size() + 1, 0);
+    for (size_t i = 0; i < sceneMeshes.size(); ++i)
+    {
+        materialFirstMesh[sceneMeshes[i].material + 1]++;
+    }
+    for (size_t m = 0; m < materials.size(); ++m)
+    {
+        materialFirstMesh[m + 1] += materialFirstMesh[m];
+    }
+
+    char message[256];
+    snprintf(message, sizeof(message), "Scene: %u meshes, %u materials, %u textures, %u vertices, %u %s bit indices\n",
+        UINT(meshCount), UINT(materials.size()), UINT(sceneTextures.size()), vertexCount, indexCount, all16Bit ? "16" : "32");
+    OutputDebugStringA(message);
+
+    // **Depth Buffer**
+    depthStencilDesc = {};
+    depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
+    depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+    depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
+
+    // the depth buffer is a transient of the frame graph, placed in the graph's heap
+    if (!InitRenderGraph())
+    {
+        return false;
+    }
+
+    // **Constant Buffer**
+    // ranges of the mapped upload memory
+    for (int i = 0; i < frameBufferCount; ++i)
+    {
+        if (!AllocateUpload(1024 * 64, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, constantBufferMemory[i]))
+        {
+            return false;
+        }
+        cbvGPUAddress[i] = constantBufferMemory[i].cpuAddress;
+
+        ZeroMemory(&cbPerObject, sizeof(cbPerObject));
+
+        memcpy(cbvGPUAddress[i], &cbPerObject, sizeof(cbPerObject));
+
+        // Light data
+        if (!AllocateUpload(1024 * 64, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, lightConstantBufferMemory[i]))
+        {
+            return false;
+        }
+
+        ZeroMemory(&lightConstant, sizeof(lightConstant));
+        lightConstant.ambientLight = XMFLOAT3(0.7f, 0.7f, 0.7f);
+    
+        lightConstant.pointLights[0].diffuseColor = XMFLOAT3(0.5f, 0.5f, 0);
+        lightConstant.pointLights[0].innerRadius = 50000.0f;
+        lightConstant.pointLights[0].outerRadius = 100000.0f;
+        lightConstant.pointLights[0].specularColor = XMFLOAT3(0.5f, 0.5f, 0.5f);
+        lightConstant.pointLights[0].specularPower = 50.f;
+        lightConstant.pointLights[0].position = XMFLOAT3(30.f, 30.f, -30.f);
+        lightConstant.pointLights[0].enable = true;
+        lightConstant.pointLights[1].enable = false;
+        lightConstant.pointLights[2].enable = false;
+
+
+        lightCBVGPUAddress[i] = lightConstantBufferMemory[i].cpuAddress;
+
+        memcpy(lightCBVGPUAddress[i], &lightConstant, sizeof(lightConstant));
+
+    }
+
+    // the copies are recorded, move all uploaded resources to their read states at once
+    FlushResourceBarriers(uploadStates, commandList);
+
+    ReportGpuMemory();
+
+    return true;
+}
+
+bool InitViews()
+{
+    HRESULT hr;
+
+    // ** RTV **
+    // The length of RTV descriptor size, this may vary from device to device
+    rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+    // Get the CPU handle of the first descriptor in the descriptro heap
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+    // Create RTV for each buffer
+    for (int i = 0; i < frameBufferCount; ++i)
+    {
+        hr = swapChain->GetBuffer(i, IID_PPV_ARGS(&renderTargets[i]));
+        if (FAILED(hr))
+        {
+            return false;
+        }
+
+        device->CreateRenderTargetView(renderTargets[i], nullptr, rtvHandle);
+        resourceStates.Register(renderTargets[i], D3D12_RESOURCE_STATE_PRESENT);
+
+        rtvHandle.Offset(1, rtvDescriptorSize);
+    }
+
+    // ** DSV **
+    device->CreateDepthStencilView(depthStencilBuffer, &depthStencilDesc, dsDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+
+    // the texture SRVs are created with the textures in InitSceneMaterials
+    UpdateGeometryViews();
+
+    return true;
+}
+
+// development fallback and hot reload, DXBC with the defines of permutation
+static bool CompileShaderAtRuntime(const ShaderPermutation& permutation, std::vector<unsigned char>& blob)
+{
+    // FXC stops at shader model 5.1, the first with unbounded descriptor arrays
+    std::string target = permutation.profile.substr(0, 3) + "5_1";
+
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (size_t i = 0; i < permutation.defines.size(); ++i)
+    {
+        D3D_SHADER_MACRO macro = { permutation.defines[i].first.c_str(), permutation.defines[i].second.c_str() };
+        macros.push_back(macro);
+    }
+    D3D_SHADER_MACRO end = { nullptr, nullptr };
+    macros.push_back(end);
+
+    std::wstring source(permutation.source.begin(), permutation.source.end());
+    ID3DBlob* shader;
+    ID3DBlob* errorBuff = nullptr;
+    HRESULT hr = D3DCompileFromFile(source.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, permutation.entry.c_str(), target.c_str(),
+        D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &shader, &errorBuff);
+    if (FAILED(hr))
+    {
+        if (errorBuff)
+        {
+            OutputDebugStringA((char*)errorBuff->GetBufferPointer());
+            errorBuff->Release();
+        }
+        return false;
+    }
+    const unsigned char* bytes = static_cast<const unsigned char*>(shader->GetBufferPointer());
+    blob.assign(bytes, bytes + shader->GetBufferSize());
+    shader->Release();
+    return true;
+}
+
+bool InitVSPS()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    vertexPermutation = { "VertexShader.hlsl", "main", "vs_6_0", {} };
+    if (useCompressedVertices)
+    {
+        vertexPermutation.defines.push_back(std::make_pair(std::string("COMPRESSED_VERTEX"), std::string("1")));
+    }
+
+    // the features of every scene material with every light count, each frame picks the one for the lights
+    // enabled, and the full permutation every draw falls back to
+    std::vector<bool> wanted(PixelPermutationCount, false);
+    wanted[FullPixelPermutation()] = true;
+    for (size_t m = 0; m < sceneMaterials.size(); ++m)
+    {
+        for (UINT lights = 0; lights <= MaxPointLights; ++lights)
+        {
+            wanted[PixelPermutationIndex(lights, sceneMaterials[m].textured, sceneMaterials[m].specular, sceneMaterials[m].normalMapped)] = true;
+        }
+    }
+    std::vector<uint32_t> pixelPermutations;
+    for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+    {
+        if (wanted[i])
+        {
+            pixelPermutations.push_back(i);
+        }
+    }
+
+    // DXIL from the shader cache and DXBC from the runtime compiler cannot be mixed in one pipeline,
+    // either every stage is precompiled or all of them are compiled here
+    const char* origin = "precompiled";
+    shadersPrecompiled = true;
+    bool precompiled = LoadPrecompiledShader("", vertexPermutation, ShaderDevMode, vertexShaderBlob);
+    for (size_t i = 0; i < pixelPermutations.size() && precompiled; ++i)
+    {
+        ShaderPermutation pixelPermutation = PixelShaderPermutation(PixelPermutationFeatures(pixelPermutations[i]));
+        precompiled = LoadPrecompiledShader("", pixelPermutation, ShaderDevMode, pixelShaderBlobs[pixelPermutations[i]]);
+    }
+    if (!precompiled && !ShaderDevMode)
+    {
+        OutputDebugStringA("Precompiled shaders are missing, run BuildShaders.py\n");
+        return false;
+    }
+    if (!precompiled)
+    {
+        origin = "compiled at runtime";
+        shadersPrecompiled = false;
+        if (!CompileShaderAtRuntime(vertexPermutation, vertexShaderBlob))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < pixelPermutations.size(); ++i)
+        {
+            ShaderPermutation pixelPermutation = PixelShaderPermutation(PixelPermutationFeatures(pixelPermutations[i]));
+            if (!CompileShaderAtRuntime(pixelPermutation, pixelShaderBlobs[pixelPermutations[i]]))
+            {
+                return false;
+            }
+        }
+    }
+
+    vertexShaderBytecode = {};
+    vertexShaderBytecode.BytecodeLength = vertexShaderBlob.size();
+    vertexShaderBytecode.pShaderBytecode = vertexShaderBlob.data();
+    for (size_t i = 0; i < pixelPermutations.size(); ++i)
+    {
+        std::vector<unsigned char>& blob = pixelShaderBlobs[pixelPermutations[i]];
+        pixelShaderBytecode[pixelPermutations[i]].BytecodeLength = blob.size();
+        pixelShaderBytecode[pixelPermutations[i]].pShaderBytecode = blob.data();
+    }
+
+    char message[256];
+    snprintf(message, sizeof(message), "Shaders %s in %.2f ms, %u of %u pixel shader permutations\n", origin,
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+        UINT(pixelPermutations.size()), PixelPermutationCount);
+    OutputDebugStringA(message);
+
+    return true;
+}
+
+// everything of the mesh pipelines but the pixel shader
+static D3D12_GRAPHICS_PIPELINE_STATE_DESC MeshPipelineDesc(const D3D12_SHADER_BYTECODE& vertexShader)
+{
+    // Input Layout
+    // static, the pipelines are created on workers after the desc was handed out
+    static D3D12_INPUT_ELEMENT_DESC inputLayout[] =
+    {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
+    };
+    // CompressedVertex
+    static D3D12_INPUT_ELEMENT_DESC compressedInputLayout[] =
+    {
+        {"POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
+    };
+
+    D3D12_INPUT_LAYOUT_DESC inputLayoutDesc = {};
+
+    if (useCompressedVertices)
+    {
+        inputLayoutDesc.NumElements = sizeof(compressedInputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
+        inputLayoutDesc.pInputElementDescs = compressedInputLayout;
+    }
+    else
+    {
+        inputLayoutDesc.NumElements = sizeof(inputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
+        inputLayoutDesc.pInputElementDescs = inputLayout;
+    }
+
+    // PSO Desc
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+    psoDesc.InputLayout = inputLayoutDesc;
+    psoDesc.pRootSignature = rootSignature;
+    psoDesc.VS = vertexShader;
+    psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    psoDesc.SampleDesc = sampleDesc; // must be the same as the swapchain and depth/stencil buffer
+    psoDesc.SampleMask = 0xffffffff;
+    psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+    psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+    psoDesc.NumRenderTargets = 1;
+    psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+    return psoDesc;
+}
+
+// every light and feature, draws any material: untextured ones sample the white texture, materials
+// without specular have a black specular color and those without a normal map sample the flat one
+static uint32_t FullPixelPermutation()
+{
+    return PixelPermutationIndex(MaxPointLights, true, true, true);
+}
+
+// Request the pipeline of every pixel shader in pixelShaders with vertexShader, keys by permutation. They
+// are loaded from the pipeline library when an earlier run created them, compiled otherwise, on workers.
+static void RequestMeshPipelines(const D3D12_SHADER_BYTECODE& vertexShader, const D3D12_SHADER_BYTECODE* pixelShaders, uint64_t* keys)
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = MeshPipelineDesc(vertexShader);
+
+    // the full permutation first, the others are picked up by the frames once they are ready
+    uint32_t full = FullPixelPermutation();
+    psoDesc.PS = pixelShaders[full];
+    keys[full] = HashGraphicsPipelineDesc(psoDesc);
+    pipelineCache.Request(keys[full], psoDesc);
+    for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+    {
+        if (i == full || pixelShaders[i].pShaderBytecode == nullptr)
+        {
+            continue;
+        }
+        psoDesc.PS = pixelShaders[i];
+        keys[i] = HashGraphicsPipelineDesc(psoDesc);
+        pipelineCache.Request(keys[i], psoDesc);
+    }
+}
+
+bool InitPSO()
+{
+    // built while the rest of the init runs, InitD3D waits for the full permutation at the end
+    RequestMeshPipelines(vertexShaderBytecode, pixelShaderBytecode, pixelPipelineKeys);
+    mainPipelineKey = pixelPipelineKeys[FullPixelPermutation()];
+
+    return true;
+}
+
+bool StartShaderHotReload()
+{
+    std::vector<ShaderPermutation> permutations(1, vertexPermutation);
+    for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+    {
+        if (!pixelShaderBlobs[i].empty())
+        {
+            permutations.push_back(PixelShaderPermutation(PixelPermutationFeatures(i)));
+        }
+    }
+    if (!shaderReloader.Start("", permutations, CompileShaderAtRuntime))
+    {
+        OutputDebugStringA("Shader hot reload: cannot watch the shader sources\n");
+        return false;
+    }
+    return true;
+}
+
+static D3D12_SHADER_BYTECODE ShaderBytecode(const std::vector<unsigned char>& blob)
+{
+    D3D12_SHADER_BYTECODE bytecode = {};
+    bytecode.BytecodeLength = blob.size();
+    bytecode.pShaderBytecode = blob.empty() ? nullptr : blob.data();
+    return bytecode;
+}
+
+void ApplyShaderReloads()
+{
+    std::vector<ReloadedShader> shaders;
+    if (shaderReloader.TakeReloaded(shaders))
+    {
+        std::string vertexName = ShaderPermutationName(vertexPermutation);
+        for (size_t s = 0; s < shaders.size(); ++s)
+        {
+            std::string name = ShaderPermutationName(shaders[s].permutation);
+            std::vector<unsigned char>* staged = nullptr;
+            if (name == vertexName)
+            {
+                staged = &reloadVertexBlob;
+            }
+            for (uint32_t i = 0; i < PixelPermutationCount && staged == nullptr; ++i)
+            {
+                if (!pixelShaderBlobs[i].empty() && name == ShaderPermutationName(PixelShaderPermutation(PixelPermutationFeatures(i))))
+                {
+                    staged = &reloadPixelBlobs[i];
+                }
+            }
+            if (staged == nullptr)
+            {
+                continue;
+            }
+            // a pipeline request of an older reload may still read the bytecode it replaces
+            if (!staged->empty())
+            {
+                retiredShaderBlobs.push_back(std::move(*staged));
+            }
+            *staged = std::move(shaders[s].bytecode);
+        }
+
+        // the reloads are DXBC, they cannot be mixed with the DXIL the other stages run, compile those once
+        if (shadersPrecompiled)
+        {
+            std::vector<std::string> missing;
+            if (reloadVertexBlob.empty())
+            {
+                missing.push_back(vertexName);
+            }
+            for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+            {
+                if (!pixelShaderBlobs[i].empty() && reloadPixelBlobs[i].empty())
+                {
+                    missing.push_back(ShaderPermutationName(PixelShaderPermutation(PixelPermutationFeatures(i))));
+                }
+            }
+            if (!missing.empty())
+            {
+                shaderReloader.Recompile(missing);
+                return;
+            }
+        }
+
+        // pipelines of an older reload still being built are superseded, they stay in the cache
+        D3D12_SHADER_BYTECODE vertexShader = reloadVertexBlob.empty() ? vertexShaderBytecode : ShaderBytecode(reloadVertexBlob);
+        for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+        {
+            reloadPixelBytecode[i] = reloadPixelBlobs[i].empty() ? pixelShaderBytecode[i] : ShaderBytecode(reloadPixelBlobs[i]);
+        }
+        RequestMeshPipelines(vertexShader, reloadPixelBytecode, reloadPipelineKeys);
+        reloadRequested = true;
+    }
+    if (!reloadRequested)
+    {
+        return;
+    }
+
+    // swap once every pipeline is there, frames keep drawing with the old ones meanwhile
+    bool failed = false;
+    for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+    {
+        if (pixelShaderBlobs[i].empty())
+        {
+            continue;
+        }
+        if (!pipelineCache.Done(reloadPipelineKeys[i]))
+        {
+            return;
+        }
+        failed = failed || pipelineCache.Find(reloadPipelineKeys[i]) == nullptr;
+    }
+    reloadRequested = false;
+    if (failed)
+    {
+        OutputDebugStringA("Shader hot reload: a pipeline failed to build, the old shaders stay\n");
+        return;
+    }
+
+    // the old pipelines stay in the cache, frames in flight may still use them
+    if (!reloadVertexBlob.empty())
+    {
+        vertexShaderBlob.swap(reloadVertexBlob);
+        vertexShaderBytecode = ShaderBytecode(vertexShaderBlob);
+        reloadVertexBlob.clear();
+    }
+    for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+    {
+        if (!reloadPixelBlobs[i].empty())
+        {
+            pixelShaderBlobs[i].swap(reloadPixelBlobs[i]);
+            pixelShaderBytecode[i] = ShaderBytecode(pixelShaderBlobs[i]);
+            reloadPixelBlobs[i].clear();
+        }
+        pixelPipelineKeys[i] = pixelShaderBlobs[i].empty() ? 0 : reloadPipelineKeys[i];
+    }
+    shadersPrecompiled = false;
+    mainPipelineKey = pixelPipelineKeys[FullPixelPermutation()];
+    pipelineStateObject = pipelineCache.Find(mainPipelineKey);
+
+    ShaderReloadStatistics stats = shaderReloader.Statistics();
+    char message[256];
+    snprintf(message, sizeof(message), "Shaders reloaded: %u compiled, %u failed so far, last batch %.2f ms\n",
+        stats.compiled, stats.failed, stats.lastCompileMs);
+    OutputDebugStringA(message);
+}
+
+ID3D12PipelineState* SelectPipeline(const Material& material, UINT lightCount)
+{
+    uint32_t permutation = PixelPermutationIndex(std::min(lightCount, MaxPointLights), material.textured, material.specular, material.normalMapped);
+    ID3D12PipelineState* pipeline = pixelPipelineKeys[permutation] != 0 ? pipelineCache.Find(pixelPipelineKeys[permutation]) : nullptr;
+    // the lights past lightCount are packed to nothing, the full permutation draws the same picture
+    return pipeline ? pipeline : pipelineStateObject;
+}
+
+UINT PackLights(const LightConstant& lights, LightConstant& packed)
+{
+    packed = lights;
+    UINT count = 0;
+    for (UINT i = 0; i < MaxPointLights; ++i)
+    {
+        if (lights.pointLights[i].enable)
+        {
+            packed.pointLights[count++] = lights.pointLights[i];
+        }
+    }
+    for (UINT i = count; i < MaxPointLights; ++i)
+    {
+        // black, with radii smoothstep can divide by
+        ZeroMemory(&packed.pointLights[i], sizeof(PointLightData));
+        packed.pointLights[i].outerRadius = 1.0f;
+    }
+    return count;
+}
+
+uint64_t HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    // field by field, the structs have padding and pointers that differ from run to run
+    PipelineHasher hasher;
+    hasher.AddValue(rootSignatureHash);
+
+    const D3D12_SHADER_BYTECODE* shaders[] = { &desc.VS, &desc.PS, &desc.DS, &desc.HS, &desc.GS };
+    for (size_t i = 0; i < _countof(shaders); ++i)
+    {
+        hasher.AddValue(uint64_t(shaders[i]->BytecodeLength));
+        hasher.Add(shaders[i]->pShaderBytecode, shaders[i]->BytecodeLength);
+    }
+
+    hasher.AddValue(desc.StreamOutput.NumEntries);
+    for (UINT i = 0; i < desc.StreamOutput.NumEntries; ++i)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& entry = desc.StreamOutput.pSODeclaration[i];
+        hasher.AddValue(entry.Stream);
+        hasher.AddString(entry.SemanticName);
+        hasher.AddValue(entry.SemanticIndex);
+        hasher.AddValue(entry.StartComponent);
+        hasher.AddValue(entry.ComponentCount);
+        hasher.AddValue(entry.OutputSlot);
+    }
+    hasher.AddValue(desc.StreamOutput.NumStrides);
+    hasher.Add(desc.StreamOutput.pBufferStrides, desc.StreamOutput.NumStrides * sizeof(UINT));
+    hasher.AddValue(desc.StreamOutput.RasterizedStream);
+
+    hasher.AddValue(desc.BlendState.AlphaToCoverageEnable);
+    hasher.AddValue(desc.BlendState.IndependentBlendEnable);
+    for (size_t i = 0; i < _countof(desc.BlendState.RenderTarget); ++i)
+    {
+        const D3D12_RENDER_TARGET_BLEND_DESC& blend = desc.BlendState.RenderTarget[i];
+        hasher.AddValue(blend.BlendEnable);
+        hasher.AddValue(blend.LogicOpEnable);
+        hasher.AddValue(blend.SrcBlend);
+        hasher.AddValue(blend.DestBlend);
+        hasher.AddValue(blend.BlendOp);
+        hasher.AddValue(blend.SrcBlendAlpha);
+        hasher.AddValue(blend.DestBlendAlpha);
+        hasher.AddValue(blend.BlendOpAlpha);
+        hasher.AddValue(blend.LogicOp);
+        hasher.AddValue(blend.RenderTargetWriteMask);
+    }
+    hasher.AddValue(desc.SampleMask);
+    // only 4 byte members, no padding
+    hasher.AddValue(desc.RasterizerState);
+
+    const D3D12_DEPTH_STENCIL_DESC& depth = desc.DepthStencilState;
+    hasher.AddValue(depth.DepthEnable);
+    hasher.AddValue(depth.DepthWriteMask);
+    hasher.AddValue(depth.DepthFunc);
+    hasher.AddValue(depth.StencilEnable);
+    hasher.AddValue(depth.StencilReadMask);
+    hasher.AddValue(depth.StencilWriteMask);
+    hasher.AddValue(depth.FrontFace);
+    hasher.AddValue(depth.BackFace);
+
+    hasher.AddValue(desc.InputLayout.NumElements);
+    for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+        hasher.AddString(element.SemanticName);
+        hasher.AddValue(element.SemanticIndex);
+        hasher.AddValue(element.Format);
+        hasher.AddValue(element.InputSlot);
+        hasher.AddValue(element.AlignedByteOffset);
+        hasher.AddValue(element.InputSlotClass);
+        hasher.AddValue(element.InstanceDataStepRate);
+    }
+
+    hasher.AddValue(desc.IBStripCutValue);
+    hasher.AddValue(desc.PrimitiveTopologyType);
+    hasher.AddValue(desc.NumRenderTargets);
+    hasher.Add(desc.RTVFormats, sizeof(desc.RTVFormats));
+    hasher.AddValue(desc.DSVFormat);
+    hasher.AddValue(desc.SampleDesc);
+    hasher.AddValue(desc.NodeMask);
+    hasher.AddValue(desc.Flags);
+    return hasher.Hash();
+}
+
+bool InitPipelineCache()
+{
+    HRESULT hr;
+
+    pipelineCache.Init(&jobSystem, std::vector<uint64_t>());
+
+    // pipeline libraries need ID3D12Device1, without it every pipeline is created from scratch
+    ID3D12Device1* device1 = nullptr;
+    hr = device->QueryInterface(IID_PPV_ARGS(&device1));
+    if (FAILED(hr))
+    {
+        return true;
+    }
+
+    std::vector<uint64_t> keys;
+    if (ReadPipelineCacheFile(PipelineCachePath, pipelineAdapterId, keys, pipelineLibraryData))
+    {
+        hr = device1->CreatePipelineLibrary(pipelineLibraryData.data(), pipelineLibraryData.size(), IID_PPV_ARGS(&pipelineLibrary));
+    }
+    if (pipelineLibrary == nullptr)
+    {
+        // missing, or the driver rejected it (D3D12_ERROR_DRIVER_VERSION_MISMATCH), start over
+        keys.clear();
+        pipelineLibraryData.clear();
+        hr = device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&pipelineLibrary));
+    }
+    SAFE_RELEASE(device1);
+    if (FAILED(hr))
+    {
+        pipelineLibrary = nullptr;
+        return true;
+    }
+
+    pipelineCache.Init(&jobSystem, keys);
+    return true;
+}
+
+void SavePipelineCache()
+{
+    if (pipelineLibrary == nullptr || !pipelineCache.LibraryChanged())
+    {
+        return;
+    }
+
+    std::vector<unsigned char> data(pipelineLibrary->GetSerializedSize());
+    if (FAILED(pipelineLibrary->Serialize(data.data(), data.size())))
+    {
+        return;
+    }
+    if (!WritePipelineCacheFile(PipelineCachePath, pipelineAdapterId, pipelineCache.LibraryKeys(), data.data(), data.size()))
+    {
+        OutputDebugStringA("Pipeline cache could not be written\n");
+    }
+}
+
+// library names are the keys in hex
+static void PipelineName(uint64_t key, wchar_t (&name)[17])
+{
+    swprintf(name, 17, L"%016llx", (unsigned long long)key);
+}
+
+ID3D12PipelineState* D3D12PipelineTraits::Load(uint64_t key, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    if (pipelineLibrary == nullptr)
+    {
+        return nullptr;
+    }
+    wchar_t name[17];
+    PipelineName(key, name);
+    ID3D12PipelineState* pipeline = nullptr;
+    HRESULT hr = pipelineLibrary->LoadGraphicsPipeline(name, &desc, IID_PPV_ARGS(&pipeline));
+    return SUCCEEDED(hr) ? pipeline : nullptr;
+}
+
+ID3D12PipelineState* D3D12PipelineTraits::Create(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    ID3D12PipelineState* pipeline = nullptr;
+    HRESULT hr = device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipeline));
+    return SUCCEEDED(hr) ? pipeline : nullptr;
+}
+
+bool D3D12PipelineTraits::Store(uint64_t key, ID3D12PipelineState* pipeline)
+{
+    if (pipelineLibrary == nullptr)
+    {
+        return false;
+    }
+    wchar_t name[17];
+    PipelineName(key, name);
+    return SUCCEEDED(pipelineLibrary->StorePipeline(name, pipeline));
+}
+
+void D3D12PipelineTraits::Release(ID3D12PipelineState* pipeline)
+{
+    pipeline->Release();
+}
+
+bool InitRenderGraph()
+{
+    HRESULT hr;
+
+    renderGraph = RenderGraph();
+    backBufferResource = renderGraph.ImportResource("BackBuffer", RenderGraphStatePresent, RenderGraphStatePresent);
+
+    // transients with the API description the graph does not know about
+    struct TransientTexture {
+        RenderGraphResourceHandle handle;
+        D3D12_RESOURCE_DESC desc;
+        D3D12_CLEAR_VALUE clearValue;
+    };
+    std::vector<TransientTexture> transientTextures;
+
+    TransientTexture depth = {};
+    depth.desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, Width, Height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+    depth.clearValue.Format = DXGI_FORMAT_D32_FLOAT;
+    depth.clearValue.DepthStencil.Depth = 1.0f;
+    depth.clearValue.DepthStencil.Stencil = 0;
+    D3D12_RESOURCE_ALLOCATION_INFO depthAllocation = device->GetResourceAllocationInfo(0, 1, &depth.desc);
+    RenderGraphTextureDesc depthDesc = { UINT(Width), UINT(Height), DXGI_FORMAT_D32_FLOAT, depthAllocation.SizeInBytes, depthAllocation.Alignment };
+    depth.handle = depthResource = renderGraph.CreateTexture("Depth", depthDesc);
+    transientTextures.push_back(depth);
+
+    // clear and draw the meshes, the draws are recorded in parallel into lists of their own
+    RenderGraphPassHandle forwardPass = renderGraph.AddPass("Forward", []()
+    {
+        ID3D12GraphicsCommandList* list = GraphCommandList();
+        if (list == nullptr)
+        {
+            return;
+        }
+
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), frameIndex, rtvDescriptorSize);
+
+        const float clearColor[] = {0.0f, 0.2f, 0.4f, 1.0f};
+        list->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+        list->ClearDepthStencilView(dsDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+
+        // Render mesh
+        // split over the workers once there are enough draws
+        if (!commandRecorder.RecordParallel(frameDraws.size(), MinDrawsPerCommandList, RecordMeshDraws))
+        {
+            Running = false;
+        }
+
+        // whatever follows the draws needs a list after them
+        graphCommandList = nullptr;
+    });
+    renderGraph.Write(forwardPass, backBufferResource, RenderGraphStateRenderTarget);
+    renderGraph.Write(forwardPass, depthResource, RenderGraphStateDepthWrite);
+
+    if (!renderGraph.Compile())
+    {
+        OutputDebugStringA("Render graph has a cycle or conflicting resource states\n");
+        return false;
+    }
+
+    // one range for every transient, textures whose lifetimes do not overlap share memory
+    UINT64 heapAlignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    for (size_t i = 0; i < transientTextures.size(); ++i)
+    {
+        heapAlignment = std::max<UINT64>(heapAlignment, renderGraph.TextureDesc(transientTextures[i].handle).alignment);
+    }
+    // the graph transients are render targets and depth buffers, which resource heap tier 1 keeps apart
+    if (!gpuMemory.Allocate(GpuMemoryRenderTargets, renderGraph.TransientHeapSize(), heapAlignment, transientMemory))
+    {
+        return false;
+    }
+    ID3D12Heap* transientHeap = gpuMemory.HeapOf(transientMemory)->heap;
+
+    for (size_t i = 0; i < transientTextures.size(); ++i)
+    {
+        const TransientTexture& texture = transientTextures[i];
+        if (!renderGraph.IsUsed(texture.handle))
+        {
+            continue;
+        }
+
+        ID3D12Resource* resource = nullptr;
+        hr = device->CreatePlacedResource(
+            transientHeap,
+            transientMemory.offset + renderGraph.TransientOffset(texture.handle),
+            &texture.desc,
+            ToD3D12States(renderGraph.TransientCreationState(texture.handle)),
+            &texture.clearValue,
+            IID_PPV_ARGS(&resource)
+        );
+        if (FAILED(hr))
+        {
+            return false;
+        }
+        transientResources.push_back(resource);
+        resourceStates.Register(resource, ToD3D12States(renderGraph.TransientCreationState(texture.handle)));
+        renderGraph.SetResourceData(texture.handle, resource);
+    }
+    depthStencilBuffer = (ID3D12Resource*)renderGraph.ResourceData(depthResource);
+
+    const RenderGraphStatistics& stats = renderGraph.Statistics();
+    char message[256];
+    snprintf(message, sizeof(message),
+        "Render graph: %u of %u passes, %u barriers, %u transients in %.1f MB (%.1f MB without aliasing)\n",
+        stats.declaredPasses - stats.culledPasses, stats.declaredPasses, stats.barriers, stats.transientResources,
+        stats.transientHeapSize / (1024.0 * 1024.0), stats.transientUnaliasedSize / (1024.0 * 1024.0));
+    OutputDebugStringA(message);
+
+    return true;
+}
+
+bool InitD3D()
+{
+    HRESULT hr;
+
+    if (!InitD3DDevice())
+    {
+        Running = false;
+        return false;
+    }
+    if (!InitPipelineCache())
+    {
+        Running = false;
+        return false;
+    }
+    if (!InitCommandQueue())
+    {
+        Running = false;
+        return false;
+    }
+    if (!InitCommandAllocators())
+    {
+        Running = false;
+        return false;
+    }
+    if (!InitCommandList())
+    {
+        Running = false;
+        return false;
+    }
+    if (!InitSwapChain())
+    {
+        Running = false;
+        return false;
+    }
+    if (!InitDescriptorHeaps())
+    {
+        Running = false;
+        return false;
     }
     if (!InitFenceAndEvent())
     {
@@ -839,10 +2079,29 @@ bool InitD3D()
         return false;
     }
 
+    // the first uses in the upload list resolve against the states the resources were created in, those
+    // barriers go to a list of the recorder that executes before it
+    commandRecorder.BeginFrame(frameIndex);
+    ID3D12GraphicsCommandList* resolveList = commandRecorder.Acquire();
+    if (resolveList == nullptr || !ResolveResourceStates(uploadStates, resolveList))
+    {
+        Running = false;
+        return false;
+    }
+
     // Close Command List 
     commandList->Close();
-    ID3D12CommandList* ppCommandLists[] = { commandList };
-    commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    bool submitted = commandRecorder.Submit([](ID3D12GraphicsCommandList* const* lists, size_t count)
+    {
+        std::vector<ID3D12CommandList*> ppCommandLists(lists, lists + count);
+        ppCommandLists.push_back(commandList);
+        commandQueue->ExecuteCommandLists(UINT(ppCommandLists.size()), ppCommandLists.data());
+    });
+    if (!submitted)
+    {
+        Running = false;
+        return false;
+    }
 
     fenceValue[frameIndex]++;
     hr = commandQueue->Signal(fence[frameIndex], fenceValue[frameIndex]);
@@ -857,6 +2116,24 @@ bool InitD3D()
         Running = false;
         return false;
     }
+
+    pipelineStateObject = pipelineCache.Wait(mainPipelineKey);
+    if (pipelineStateObject == nullptr)
+    {
+        Running = false;
+        return false;
+    }
+    PipelineCacheStatistics pipelineStats = pipelineCache.Statistics();
+    char message[256];
+    snprintf(message, sizeof(message), "Pipelines: %u loaded from the library (%.2f ms), %u created (%.2f ms), %u failed\n",
+        pipelineStats.loaded, pipelineStats.loadMs, pipelineStats.created, pipelineStats.createMs, pipelineStats.failed);
+    OutputDebugStringA(message);
+
+    // not fatal, the shaders just stay what they are
+    if (ShaderDevMode)
+    {
+        StartShaderHotReload();
+    }
     
 
 
@@ -886,6 +2163,7 @@ bool InitD3D()
     XMVECTOR cUp = XMLoadFloat4(&cameraUp);
     tmpMat = XMMatrixLookAtLH(cPos, cTarg, cUp);
     XMStoreFloat4x4(&cameraViewMat, tmpMat);
+    camera.SetLookAt(&cameraPosition.x, &cameraTarget.x);
 
     // Mesh
     meshPosition = XMFLOAT4(0.0f, -7.0f, 0.0f, 0.0f);
@@ -901,12 +2179,46 @@ bool InitD3D()
 
 void Update()
 {
-    //XMMATRIX rotXMat = XMMatrixRotationX(0.003f);
-    XMMATRIX rotYMat = XMMatrixRotationY(0.003f);
-    //XMMATRIX rotZMat = XMMatrixRotationZ(0.003f);
+    // waits here when the render thread is RenderPipelineDepth frames behind
+    RenderPacket* packet = renderPipeline.BeginWrite();
+    if (packet == nullptr)
+    {
+        return;
+    }
 
-    XMMATRIX rotMat = XMLoadFloat4x4(&meshRotMat) * rotYMat;
-    XMStoreFloat4x4(&meshRotMat, rotMat);
+    // **Simulation**
+    // as many fixed steps as the time since the last frame holds, the rest carries over to the next frame
+    uint32_t steps = simulationStep.Advance(gameClock.Tick());
+    float stepSeconds = simulationStep.StepSeconds();
+    UpdateCameraInput();
+    for (uint32_t i = 0; i < steps; ++i)
+    {
+        previousMeshSpinAngle = meshSpinAngle;
+        meshSpinAngle += MeshSpinRadiansPerSecond * stepSeconds;
+        if (meshSpinAngle > XM_2PI)
+        {
+            // both together so the frames in between still blend the right way
+            meshSpinAngle -= XM_2PI;
+            previousMeshSpinAngle -= XM_2PI;
+        }
+        camera.Step(cameraInput, stepSeconds);
+    }
+
+    // **Interpolation**
+    // the frame shows the state alpha of the way through the next step
+    float alpha = simulationStep.Alpha();
+    float meshSpin = previousMeshSpinAngle + (meshSpinAngle - previousMeshSpinAngle) * alpha;
+    XMMATRIX rotMat = XMLoadFloat4x4(&meshRotMat) * XMMatrixRotationY(meshSpin);
+
+    // the view matrix is only rebuilt while the camera moves
+    CameraPose pose;
+    if (camera.Interpolate(alpha, pose))
+    {
+        cameraPosition = XMFLOAT4(pose.eye[0], pose.eye[1], pose.eye[2], 0.0f);
+        cameraTarget = XMFLOAT4(pose.target[0], pose.target[1], pose.target[2], 0.0f);
+        XMMATRIX viewMat = XMMatrixLookAtLH(XMLoadFloat4(&cameraPosition), XMLoadFloat4(&cameraTarget), XMLoadFloat4(&cameraUp));
+        XMStoreFloat4x4(&cameraViewMat, viewMat);
+    }
 
     XMMATRIX translationMat = XMMatrixTranslationFromVector(XMLoadFloat4(&meshPosition));
 
@@ -914,98 +2226,364 @@ void Update()
 
     XMStoreFloat4x4(&meshWorldMat, worldMat);
 
-    XMMATRIX viewMat = XMLoadFloat4x4(&cameraViewMat);
-    XMMATRIX projMat = XMLoadFloat4x4(&cameraProjMat);
-    XMMATRIX wvpMat = XMLoadFloat4x4(&meshWorldMat) * viewMat * projMat;
-    XMMATRIX wMat = XMLoadFloat4x4(&meshWorldMat);
-    XMMATRIX transposed = XMMatrixTranspose(wvpMat);
-    XMMATRIX wTransposed = XMMatrixTranspose(wMat);
-    XMStoreFloat4x4(&cbPerObject.wMat, wTransposed);
-    XMStoreFloat4x4(&cbPerObject.wvpMat, transposed);
-    XMFLOAT3 cameraPos = XMFLOAT3(cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    XMStoreFloat3(&cbPerObject.cameraPos, XMLoadFloat3(&cameraPos));
-    memcpy(cbvGPUAddress[frameIndex], &cbPerObject, sizeof(cbPerObject));
+    // everything the render thread needs, it never reads the game state directly
+    packet->frame = gameFrame++;
+    packet->viewMat = cameraViewMat;
+    packet->projMat = cameraProjMat;
+    packet->cameraPosition = cameraPosition;
+    packet->instances.resize(1);
+    packet->instances[0].worldMat = meshWorldMat;
+    packet->lightCount = PackLights(lightConstant, packet->lights);
+
+    renderPipeline.EndWrite(packet);
+}
+
+void UpdateCameraInput()
+{
+    auto axis = [](int negative, int positive) { return (keysDown[positive] ? 1.0f : 0.0f) - (keysDown[negative] ? 1.0f : 0.0f); };
+    cameraInput.move[0] = axis('A', 'D');
+    cameraInput.move[1] = axis('Q', 'E');
+    cameraInput.move[2] = axis('S', 'W');
+    cameraInput.fast = keysDown[VK_SHIFT];
+}
+
+void StartRenderThread()
+{
+    renderPipeline.Init(RenderPipelineDepth);
+    renderThread = std::thread(RenderThreadMain);
+}
+
+void StopRenderThread()
+{
+    renderPipeline.Close();
+    if (renderThread.joinable())
+    {
+        renderThread.join();
+    }
+    ReportRenderPipeline();
+}
+
+void RenderThreadMain()
+{
+    while (RenderPacket* packet = renderPipeline.BeginRead())
+    {
+        Render(*packet);
+        renderPipeline.EndRead(packet);
+
+        if (!Running)
+        {
+            // let the game thread stop waiting for packets
+            renderPipeline.Close();
+            break;
+        }
+        if (packet->frame % 600 == 599)
+        {
+            ReportRenderPipeline();
+            ReportResidency();
+        }
+    }
+}
+
+void ReportRenderPipeline()
+{
+    RenderPipelineStatistics stats = renderPipeline.Statistics();
+    char message[256];
+    snprintf(message, sizeof(message),
+        "Render pipeline: %llu frames produced, %llu rendered, %.1f fps, latency avg %.2f ms max %.2f ms, "
+        "game thread waited %.1f ms, render thread waited %.1f ms\n",
+        (unsigned long long)stats.framesProduced, (unsigned long long)stats.framesConsumed, stats.framesPerSecond,
+        stats.averageLatencyMs, stats.maxLatencyMs, stats.gameWaitMs, stats.renderWaitMs);
+    OutputDebugStringA(message);
+}
+
+void UpdateFrameConstants(const RenderPacket& packet)
+{
+    XMMATRIX viewMat = XMLoadFloat4x4(&packet.viewMat);
+    XMMATRIX projMat = XMLoadFloat4x4(&packet.projMat);
+
+    // one constant buffer slot per instance in this frame's upload heap
+    size_t instanceCount = std::min(packet.instances.size(), size_t(1024 * 64 / ConstantBufferPerObjectAlignedSize));
+    for (size_t i = 0; i < instanceCount; ++i)
+    {
+        XMMATRIX wMat = XMLoadFloat4x4(&packet.instances[i].worldMat);
+        XMMATRIX wvpMat = wMat * viewMat * projMat;
+        XMStoreFloat4x4(&cbPerObject.wMat, XMMatrixTranspose(wMat));
+        XMStoreFloat4x4(&cbPerObject.wvpMat, XMMatrixTranspose(wvpMat));
+        cbPerObject.cameraPos = XMFLOAT3(packet.cameraPosition.x, packet.cameraPosition.y, packet.cameraPosition.z);
+        cbPerObject.positionDequantScale = positionDequantScale;
+        cbPerObject.positionDequantOffset = positionDequantOffset;
+        memcpy(cbvGPUAddress[frameIndex] + i * ConstantBufferPerObjectAlignedSize, &cbPerObject, sizeof(cbPerObject));
+    }
+
+    // Draws grouped by pipeline and material so the recording lists change state as rarely as possible.
+    // The materials are ordered by pipeline and sceneMeshes is sorted by material, walking the meshes of
+    // each material in that order groups the draws without sorting them.
+    std::vector<ID3D12PipelineState*> materialPipelines(sceneMaterials.size());
+    std::vector<uint32_t> materialOrder(sceneMaterials.size());
+    for (uint32_t m = 0; m < sceneMaterials.size(); ++m)
+    {
+        materialPipelines[m] = SelectPipeline(sceneMaterials[m], packet.lightCount);
+        materialOrder[m] = m;
+    }
+    std::sort(materialOrder.begin(), materialOrder.end(), [&materialPipelines](uint32_t a, uint32_t b)
+    {
+        return materialPipelines[a] != materialPipelines[b] ? std::less<ID3D12PipelineState*>()(materialPipelines[a], materialPipelines[b]) : a < b;
+    });
+
+    frameDraws.clear();
+    for (size_t o = 0; o < materialOrder.size(); ++o)
+    {
+        uint32_t material = materialOrder[o];
+        for (uint32_t m = materialFirstMesh[material]; m < materialFirstMesh[material + 1]; ++m)
+        {
+            const SceneMesh& mesh = sceneMeshes[m];
+            GeometryRange geometry = geometryPool.Range(mesh.geometry);
+            for (size_t i = 0; i < instanceCount; ++i)
+            {
+                const MeshLodDraw& lod = meshLods[mesh.firstLod + SelectMeshLod(packet, packet.instances[i].worldMat, mesh)];
+                for (uint32_t s = lod.firstSubmesh; s < lod.firstSubmesh + lod.submeshCount; ++s)
+                {
+                    FrameDraw draw = { meshSubmeshes[s], uint32_t(i), materialPipelines[material], material };
+                    draw.submesh.startIndex += geometry.firstIndex;
+                    draw.submesh.baseVertex += int32_t(geometry.firstVertex);
+                    frameDraws.push_back(draw);
+                }
+            }
+        }
+    }
+
+    memcpy(lightCBVGPUAddress[frameIndex], &packet.lights, sizeof(packet.lights));
+}
+
+void UpdatePipeline(const RenderPacket& packet)
+{
+    WaitForPreviousFrame();
+
+    // frame boundary, nothing is recording, the pipelines of edited shaders can be swapped in
+    ApplyShaderReloads();
+
+    // the fence of this frame index signalled, its allocators can be recycled
+    commandRecorder.BeginFrame(frameIndex);
+    graphCommandList = nullptr;
+
+    // first in submission order, gets the transitions of the frame's first resource uses
+    ID3D12GraphicsCommandList* resolveList = commandRecorder.Acquire();
+    if (resolveList == nullptr)
+    {
+        Running = false;
+        return;
+    }
+
+    // before the draws are built, they take the mesh ranges after the move
+    if (geometryPool.Statistics().fragmentation > GeometryCompactionThreshold && !CompactGeometry())
+    {
+        Running = false;
+        return;
+    }
+
+    // the GPU is done with this frame's constant buffers
+    UpdateFrameConstants(packet);
+
+    // what the frame reads has to be resident before it executes
+    if (!UpdateResidency())
+    {
+        Running = false;
+        return;
+    }
+
+    // the graph was compiled at init, only the back buffer changes from frame to frame
+    renderGraph.SetResourceData(backBufferResource, renderTargets[frameIndex]);
+    renderGraph.Execute(RecordGraphBarriers);
+
+    if (!ResolveResourceStates(graphStates, resolveList))
+    {
+        Running = false;
+    }
+}
+
+ID3D12GraphicsCommandList* GraphCommandList()
+{
+    if (graphCommandList == nullptr)
+    {
+        graphCommandList = commandRecorder.Acquire();
+        if (graphCommandList == nullptr)
+        {
+            Running = false;
+        }
+    }
+    return graphCommandList;
+}
+
+D3D12_RESOURCE_STATES ToD3D12States(uint32_t states)
+{
+    D3D12_RESOURCE_STATES result = D3D12_RESOURCE_STATE_COMMON;
+    if (states & RenderGraphStateRenderTarget) result |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+    if (states & RenderGraphStateDepthWrite) result |= D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    if (states & RenderGraphStateDepthRead) result |= D3D12_RESOURCE_STATE_DEPTH_READ;
+    if (states & RenderGraphStateShaderResource) result |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+    if (states & RenderGraphStateUnorderedAccess) result |= D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+    if (states & RenderGraphStateCopySource) result |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+    if (states & RenderGraphStateCopyDest) result |= D3D12_RESOURCE_STATE_COPY_DEST;
+    // present is the common state
+    return result;
+}
+
+void RecordGraphBarriers(const RenderGraphBarrier* barriers, size_t count)
+{
+    ID3D12GraphicsCommandList* list = GraphCommandList();
+    if (list == nullptr)
+    {
+        return;
+    }
 
+    // the graph decides the states, the tracker drops what the resources are already in and resolves
+    // the back buffer of the frame against its global state
+    for (size_t i = 0; i < count; ++i)
+    {
+        ID3D12Resource* resource = (ID3D12Resource*)renderGraph.ResourceData(barriers[i].resource);
+        switch (barriers[i].type)
+        {
+        case RenderGraphBarrier::Transition:
+            graphStates.TransitionResource(resource, ToD3D12States(barriers[i].stateAfter));
+            break;
+        case RenderGraphBarrier::Aliasing:
+            graphStates.AliasBarrier(barriers[i].before == RenderGraphInvalidHandle ? nullptr :
+                (ID3D12Resource*)renderGraph.ResourceData(barriers[i].before), resource);
+            break;
+        case RenderGraphBarrier::UnorderedAccess:
+            graphStates.UAVBarrier(resource);
+            break;
+        }
+    }
+    FlushResourceBarriers(graphStates, list);
 }
 
-void UpdatePipeline()
+void FlushResourceBarriers(D3D12StateTracker& tracker, ID3D12GraphicsCommandList* list)
 {
-    HRESULT hr;
-
-    WaitForPreviousFrame();
+    tracker.FlushBarriers([list](const D3D12StateTracker::Barrier* barriers, size_t count)
+    {
+        RecordResourceBarriers(list, barriers, count);
+    });
+}
 
-    hr = commandAllocator[frameIndex]->Reset();
-    if (FAILED(hr))
+bool ResolveResourceStates(D3D12StateTracker& tracker, ID3D12GraphicsCommandList* list)
+{
+    std::vector<D3D12StateTracker::Barrier> resolved;
+    bool known = resourceStates.Resolve(tracker, resolved);
+    if (!resolved.empty())
     {
-        Running = false;
+        RecordResourceBarriers(list, resolved.data(), resolved.size());
     }
-
-    hr = commandList->Reset(commandAllocator[frameIndex], pipelineStateObject);
-    if (FALSE(hr))
+    if (!known)
     {
-        Running = false;
+        OutputDebugStringA("Resource state tracking: a list used a resource that was never registered\n");
     }
+    return known;
+}
 
+void RecordResourceBarriers(ID3D12GraphicsCommandList* list, const D3D12StateTracker::Barrier* barriers, size_t count)
+{
+    std::vector<D3D12_RESOURCE_BARRIER> batch(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        switch (barriers[i].type)
+        {
+        case D3D12StateTracker::Barrier::Transition:
+            batch[i] = CD3DX12_RESOURCE_BARRIER::Transition(barriers[i].resource, D3D12_RESOURCE_STATES(barriers[i].stateBefore),
+                D3D12_RESOURCE_STATES(barriers[i].stateAfter), barriers[i].subresource);
+            break;
+        case D3D12StateTracker::Barrier::Aliasing:
+            batch[i] = CD3DX12_RESOURCE_BARRIER::Aliasing(barriers[i].before, barriers[i].resource);
+            break;
+        case D3D12StateTracker::Barrier::UnorderedAccess:
+            batch[i] = CD3DX12_RESOURCE_BARRIER::UAV(barriers[i].resource);
+            break;
+        }
+    }
+    list->ResourceBarrier(UINT(count), batch.data());
+}
 
-    D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[frameIndex], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    commandList->ResourceBarrier(1, &barrier);
-    
+void RecordMeshDraws(ID3D12GraphicsCommandList* list, const DrawRange& range)
+{
+    // every list starts without state, set up everything the draws need
     CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), frameIndex, rtvDescriptorSize);
     // Get a handle to the depth/stencil buffer
     CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(dsDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 
-    commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+    list->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
 
-    const float clearColor[] = {0.0f, 0.2f, 0.4f, 1.0f};
-    commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-    commandList->ClearDepthStencilView(dsDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-    
-    commandList->SetGraphicsRootSignature(rootSignature);
+    list->SetGraphicsRootSignature(rootSignature);
   
     ID3D12DescriptorHeap* descriptorHeaps[] = { mainDescriptorHeap };
-    commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+    list->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-    commandList->SetGraphicsRootDescriptorTable(1, mainDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+    list->SetGraphicsRootDescriptorTable(1, mainDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
 
-    commandList->RSSetViewports(1, &viewport);
-    commandList->RSSetScissorRects(1, &scissorRect);
-    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
-    commandList->IASetIndexBuffer(&indexBufferView);
-    
-    // Render mesh
-    // Transrform
-    commandList->SetGraphicsRootConstantBufferView(0, constantBufferUploadHeaps[frameIndex]->GetGPUVirtualAddress());
-    // Light
-    commandList->SetGraphicsRootConstantBufferView(2, lightConstantBufferUploadHeaps[frameIndex]->GetGPUVirtualAddress());
-    commandList->DrawIndexedInstanced(numOfIndices, 1, 0, 0, 0);
+    list->RSSetViewports(1, &viewport);
+    list->RSSetScissorRects(1, &scissorRect);
+    list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    list->IASetVertexBuffers(0, 1, &vertexBufferView);
+    list->IASetIndexBuffer(&indexBufferView);
 
- 
-    barrier = CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[frameIndex], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-    commandList->ResourceBarrier(1, &barrier);
-
-    hr = commandList->Close();
-    if (FAILED(hr))
+    // Light
+    list->SetGraphicsRootConstantBufferView(2, lightConstantBufferMemory[frameIndex].gpuAddress);
+    list->SetGraphicsRootShaderResourceView(4, materialTable->GetGPUVirtualAddress());
+    uint32_t boundInstance = UINT32_MAX;
+    ID3D12PipelineState* boundPipeline = nullptr;
+    uint32_t boundMaterial = UINT32_MAX;
+    for (size_t i = range.first; i < range.first + range.count; ++i)
     {
-        Running = false;
+        const FrameDraw& draw = frameDraws[i];
+        if (draw.pipeline != boundPipeline)
+        {
+            list->SetPipelineState(draw.pipeline);
+            boundPipeline = draw.pipeline;
+        }
+        if (draw.material != boundMaterial)
+        {
+            list->SetGraphicsRoot32BitConstant(3, draw.material, 0);
+            boundMaterial = draw.material;
+        }
+        if (draw.instance != boundInstance)
+        {
+            // Transrform
+            list->SetGraphicsRootConstantBufferView(0, constantBufferMemory[frameIndex].gpuAddress +
+                draw.instance * ConstantBufferPerObjectAlignedSize);
+            boundInstance = draw.instance;
+        }
+        list->DrawIndexedInstanced(draw.submesh.indexCount, 1, draw.submesh.startIndex, draw.submesh.baseVertex, 0);
     }
 }
 
-void Render()
+void Render(const RenderPacket& packet)
 {
     HRESULT hr;
 
-    UpdatePipeline();
+    UpdatePipeline(packet);
 
-    ID3D12CommandList* ppCommandLists[] = {commandList};
-
-    commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    // one submission with the lists in recording order
+    if (Running && !commandRecorder.Submit([](ID3D12GraphicsCommandList* const* lists, size_t count)
+    {
+        std::vector<ID3D12CommandList*> ppCommandLists(lists, lists + count);
+        commandQueue->ExecuteCommandLists(UINT(ppCommandLists.size()), ppCommandLists.data());
+    }))
+    {
+        Running = false;
+    }
 
+    // WaitForPreviousFrame already took the next fence value of this slot and the shutdown path waits for
+    // it, so it is signalled even when the frame failed
     hr = commandQueue->Signal(fence[frameIndex], fenceValue[frameIndex]);
     if (FAILED(hr))
     {
+        // nothing will ever reach the value, give it back so the next wait does not block forever
+        fenceValue[frameIndex]--;
         Running = false;
     }
+    if (!Running)
+    {
+        return;
+    }
 
     hr = swapChain->Present(1, 0);
     if (FAILED(hr))
@@ -1014,6 +2592,41 @@ void Render()
     }
 }
 
+bool D3D12RecordingTraits::Create(ID3D12CommandAllocator*& allocator, ID3D12GraphicsCommandList*& list)
+{
+    HRESULT hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator));
+    if (FAILED(hr))
+    {
+        return false;
+    }
+    hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, pipelineStateObject, IID_PPV_ARGS(&list));
+    if (FAILED(hr))
+    {
+        SAFE_RELEASE(allocator);
+        return false;
+    }
+    list->SetName(L"Frame Command List");
+    // lists are created open, the recorder expects them closed until Reset
+    hr = list->Close();
+    return SUCCEEDED(hr);
+}
+
+bool D3D12RecordingTraits::Reset(ID3D12CommandAllocator* allocator, ID3D12GraphicsCommandList* list)
+{
+    return SUCCEEDED(allocator->Reset()) && SUCCEEDED(list->Reset(allocator, pipelineStateObject));
+}
+
+bool D3D12RecordingTraits::Close(ID3D12GraphicsCommandList* list)
+{
+    return SUCCEEDED(list->Close());
+}
+
+void D3D12RecordingTraits::Destroy(ID3D12CommandAllocator* allocator, ID3D12GraphicsCommandList* list)
+{
+    SAFE_RELEASE(list);
+    SAFE_RELEASE(allocator);
+}
+
 void Cleanup()
 {
     for (int i = 0; i < frameBufferCount; ++i)
@@ -1026,9 +2639,18 @@ void Cleanup()
     if (swapChain->GetFullscreenState(&fs, NULL))
         swapChain->SetFullscreenState(false, NULL);
 
+    // the cache owns pipelineStateObject
+    shaderReloader.Stop();
+    SavePipelineCache();
+    pipelineCache.Destroy();
+    pipelineStateObject = nullptr;
+    SAFE_RELEASE(pipelineLibrary);
+
     SAFE_RELEASE(device);
     SAFE_RELEASE(swapChain);
     SAFE_RELEASE(commandQueue);
+    commandRecorder.Destroy();
+    jobSystem.Shutdown();
     SAFE_RELEASE(rtvDescriptorHeap);
     SAFE_RELEASE(commandList);
     SAFE_RELEASE(dxgiFactory)
@@ -1039,17 +2661,48 @@ void Cleanup()
         SAFE_RELEASE(fence[i]);
     }
 
-    SAFE_RELEASE(pipelineStateObject);
     SAFE_RELEASE(rootSignature);
     SAFE_RELEASE(vertexBuffer);
     SAFE_RELEASE(indexBuffer);
-    SAFE_RELEASE(depthStencilBuffer);
+    // the depth buffer is one of the graph transients
+    for (size_t i = 0; i < transientResources.size(); ++i)
+    {
+        SAFE_RELEASE(transientResources[i]);
+    }
+    transientResources.clear();
+    depthStencilBuffer = nullptr;
+    gpuMemory.Free(transientMemory);
     SAFE_RELEASE(dsDescriptorHeap);
+    gpuMemory.Free(vertexBufferMemory);
+    gpuMemory.Free(indexBufferMemory);
+    SAFE_RELEASE(materialTable);
+    gpuMemory.Free(materialTableMemory);
+    for (size_t i = 0; i < sceneTextures.size(); ++i)
+    {
+        SAFE_RELEASE(sceneTextures[i].resource);
+        gpuMemory.Free(sceneTextures[i].memory);
+    }
+    sceneTextures.clear();
+    SAFE_RELEASE(whiteTexture.resource);
+    gpuMemory.Free(whiteTexture.memory);
+    SAFE_RELEASE(flatNormalTexture.resource);
+    gpuMemory.Free(flatNormalTexture.memory);
     for (int i = 0; i < frameBufferCount; ++i)
     {
-        SAFE_RELEASE(constantBufferUploadHeaps[i]);
-        SAFE_RELEASE(lightConstantBufferUploadHeaps[i]);
+        FreeUpload(constantBufferMemory[i]);
+        FreeUpload(lightConstantBufferMemory[i]);
     }
+    for (size_t i = 0; i < initUploads.size(); ++i)
+    {
+        FreeUpload(initUploads[i]);
+    }
+    initUploads.clear();
+    // every frame finished above
+    completedFrameSerial = frameSerial;
+    ReleaseRetiredGpuResources();
+    // the heaps go after every resource placed in them
+    gpuMemory.Destroy();
+    SAFE_RELEASE(dxgiAdapter);
 }
 
 void WaitForPreviousFrame()
@@ -1070,6 +2723,12 @@ void WaitForPreviousFrame()
     }
 
     fenceValue[frameIndex]++;
+
+    // the frame that last used this slot is done and so is everything before it, one queue runs in order
+    completedFrameSerial = frameSlotSerial[frameIndex];
+    ReleaseRetiredGpuResources();
+    bindlessDescriptors.BeginFrame(frameIndex, frameSlotSerial[frameIndex]);
+    frameSlotSerial[frameIndex] = ++frameSerial;
 }
 
 int  LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescription, LPCWSTR filename, int& bytesPerRow)
@@ -1172,30 +2831,596 @@ int  LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescri
     return imageSize;
 }
 
-bool loadMesh(std::string objfileName, std::vector<Vertex>& vertexList, std::vector<DWORD>& indexList)
+bool loadScene(std::string objfileName, std::vector<MeshAsset>& meshes, std::vector<MeshAssetMaterial>& materials)
+{
+    std::string assetFileName = objfileName.substr(0, objfileName.size() - 4) + ".mesh";
+    uint64_t sourceTimestamp = GetFileTimestamp(objfileName);
+
+    bool assetUsable = ReadMeshAsset(assetFileName, sourceTimestamp, meshes, materials) && !meshes.empty();
+    // every mesh has to have a vertex layout this build reads, out of core assets may mix both
+    for (size_t i = 0; i < meshes.size() && assetUsable; ++i)
+    {
+        bool compressed = (meshes[i].flags & MeshAssetFlagCompressedVertices) != 0;
+        assetUsable = compressed ? (AllowCompressedVertices && meshes[i].vertexStride == sizeof(CompressedVertex))
+            : meshes[i].vertexStride == sizeof(Vertex);
+    }
+    if (!assetUsable && GetFileSizeBytes(objfileName) >= OutOfCoreObjBytes)
+    {
+        // the converter never holds the whole file, it writes the asset and the renderer reads it back
+        if (!ConvertObjToMeshAssetOutOfCore(objfileName, assetFileName, sourceTimestamp) ||
+            !ReadMeshAsset(assetFileName, sourceTimestamp, meshes, materials) || meshes.empty())
+        {
+            return false;
+        }
+    }
+    else if (!assetUsable)
+    {
+        if (!ConvertObjToMeshAsset(objfileName, meshes, materials))
+        {
+            return false;
+        }
+        // a failed write only means we convert again next time
+        WriteMeshAsset(assetFileName, sourceTimestamp, meshes, materials);
+    }
+
+    UnifyVertexLayout(meshes);
+    return true;
+}
+
+bool ConvertObjToMeshAsset(std::string objfileName, std::vector<MeshAsset>& meshes, std::vector<MeshAssetMaterial>& materials)
 {
+    // the loader streams the faces into the Vertex lists the converter works on, it keeps no copy of them
     objl::Loader loader;
-    bool loadout = loader.LoadFile(objfileName);
+    // faces without normals are smoothed after welding, see OptimizeMesh
+    loader.FlatNormalsWhenMissing = false;
+    ObjMeshCollector<Vertex> collector(ObjVertexToVertex);
+    bool loadout = loader.LoadFile(objfileName, collector);
 
-    if (!loadout || loader.LoadedMeshes.size() == 0)
+    if (!loadout || collector.meshes.size() == 0)
     {
         return false;
     }
-    objl::Mesh mesh = loader.LoadedMeshes[0];
-        
-    for (int i = 0; i < mesh.Vertices.size(); ++i)
+
+    // meshes without a material keep the look of the single mesh renderer
+    MeshAssetMaterial defaultMaterial;
+    defaultMaterial.diffuseMap = DefaultMaterialTexture;
+    std::vector<uint32_t> meshMaterials;
+    BuildObjMaterialTable(loader, collector.MaterialNames(), ObjDirectory(objfileName), defaultMaterial, materials, meshMaterials);
+
+    // the meshes are converted on the workers, each on its own
+    size_t meshCount = collector.meshes.size();
+    std::vector<std::vector<Vertex>> vertexLists(meshCount);
+    meshes.clear();
+    meshes.resize(meshCount);
+    jobSystem.ParallelFor(meshCount, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            vertexLists[i].swap(collector.meshes[i].vertices);
+            ConvertObjMesh(vertexLists[i], collector.meshes[i].indices, meshes[i]);
+            meshes[i].material = meshMaterials[i];
+        }
+    });
+
+    // one quantization grid for the scene so all meshes share the dequantization constants, and one
+    // vertex layout: when a single mesh loses too much precision every mesh stays uncompressed
+    float boundsMin[3], boundsMax[3];
+    MeshAssetSceneBounds(meshes, boundsMin, boundsMax);
+    std::vector<unsigned char> compressed(meshCount, 0);
+    jobSystem.ParallelFor(meshCount, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            compressed[i] = CompressMeshVertices(vertexLists[i], boundsMin, boundsMax, meshes[i]);
+        }
+    });
+    bool allCompressed = std::find(compressed.begin(), compressed.end(), 0) == compressed.end();
+    for (size_t i = 0; i < meshCount; ++i)
+    {
+        if (!allCompressed)
+        {
+            meshes[i].flags &= ~MeshAssetFlagCompressedVertices;
+            meshes[i].vertexStride = sizeof(Vertex);
+            const unsigned char* vertexBytes = reinterpret_cast<const unsigned char*>(vertexLists[i].data());
+            meshes[i].vertexData.assign(vertexBytes, vertexBytes + vertexLists[i].size() * sizeof(Vertex));
+        }
+        // the asset owns the vertices now, free each list as soon as it is done with
+        std::vector<Vertex>().swap(vertexLists[i]);
+    }
+
+    char message[256];
+    snprintf(message, sizeof(message), "Obj conversion: %u meshes, %u materials, vertices %s\n",
+        unsigned(meshCount), unsigned(materials.size()), allCompressed ? "compressed" : "uncompressed");
+    OutputDebugStringA(message);
+
+    return true;
+}
+
+bool ConvertObjToMeshAssetOutOfCore(std::string objfileName, std::string assetFileName, uint64_t sourceTimestamp)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+    char message[512];
+
+    ObjStreamSettings settings;
+    settings.memoryBudget = ObjConversionMemoryBudget;
+    ObjChunkStream stream(settings);
+    if (!stream.Open(objfileName, assetFileName + ".tmp"))
+    {
+        snprintf(message, sizeof(message), "Out of core obj conversion failed: %s\n", stream.Error().c_str());
+        OutputDebugStringA(message);
+        return false;
+    }
+
+    // the stream parses the obj itself, the loader only reads the material libraries
+    objl::Loader loader;
+    std::string directory = ObjDirectory(objfileName);
+    for (size_t i = 0; i < stream.MaterialLibraries().size(); ++i)
+    {
+        loader.LoadMaterialFile(ObjTexturePath(directory, stream.MaterialLibraries()[i]));
+    }
+    MeshAssetMaterial defaultMaterial;
+    defaultMaterial.diffuseMap = DefaultMaterialTexture;
+    std::vector<MeshAssetMaterial> materials;
+    std::vector<uint32_t> streamMaterials;
+    BuildObjMaterialTable(loader, stream.MaterialNames(), directory, defaultMaterial, materials, streamMaterials);
+
+    // the scene bounds are known before the first chunk, so every chunk quantizes against them right away.
+    // A chunk that loses too much precision keeps its full precision vertices, the others stay compressed
+    MeshAssetWriter writer;
+    if (!writer.Open(assetFileName, sourceTimestamp))
+    {
+        return false;
+    }
+    uint32_t compressedMeshes = 0;
+    bool converted = stream.ForEachChunk([&](std::vector<ObjStreamTriangle>& triangles)
+    {
+        // one mesh per material of the chunk
+        std::vector<uint32_t> order(triangles.size());
+        for (uint32_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return triangles[a].material < triangles[b].material; });
+
+        for (size_t first = 0; first < order.size();)
+        {
+            uint32_t material = triangles[order[first]].material;
+            size_t last = first;
+            while (last < order.size() && triangles[order[last]].material == material)
+            {
+                last++;
+            }
+
+            std::vector<Vertex> vertexList;
+            std::vector<uint32_t> indexList;
+            vertexList.reserve((last - first) * 3);
+            indexList.reserve((last - first) * 3);
+            for (size_t i = first; i < last; ++i)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    const ObjStreamCorner& corner = triangles[order[i]].corners[k];
+                    indexList.push_back(uint32_t(vertexList.size()));
+                    vertexList.push_back(Vertex(corner.pos[0], corner.pos[1], corner.pos[2], corner.texCoord[0], corner.texCoord[1],
+                        corner.normal[0], corner.normal[1], corner.normal[2]));
+                }
+            }
+            first = last;
+
+            MeshAsset mesh;
+            ConvertObjMesh(vertexList, indexList, mesh);
+            mesh.material = streamMaterials[material];
+            if (CompressMeshVertices(vertexList, stream.BoundsMin(), stream.BoundsMax(), mesh))
+            {
+                compressedMeshes++;
+            }
+            else
+            {
+                mesh.vertexStride = sizeof(Vertex);
+                const unsigned char* vertexBytes = reinterpret_cast<const unsigned char*>(vertexList.data());
+                mesh.vertexData.assign(vertexBytes, vertexBytes + vertexList.size() * sizeof(Vertex));
+            }
+            writer.AddMesh(mesh);
+        }
+        return true;
+    });
+
+    if (!converted || !writer.Finish(materials))
+    {
+        snprintf(message, sizeof(message), "Out of core obj conversion failed: %s\n",
+            stream.Error().empty() ? "cannot write the mesh asset" : stream.Error().c_str());
+        OutputDebugStringA(message);
+        return false;
+    }
+
+    const ObjStreamStatistics& stats = stream.Statistics();
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+    snprintf(message, sizeof(message),
+        "Out of core obj conversion: %llu triangles in %llu chunks (%llu grid cells, %llu split), %u meshes (%u with compressed vertices), "
+        "%u materials, %.1f MB spilled, attribute cache %.1f%% hits, %.1f s\n",
+        (unsigned long long)stats.triangles, (unsigned long long)stats.chunks, (unsigned long long)stats.gridCells,
+        (unsigned long long)stats.splitChunks, writer.MeshCount(), compressedMeshes, unsigned(materials.size()),
+        double(stats.spilledBytes) / (1024.0 * 1024.0),
+        stats.attributeReads ? 100.0 * double(stats.attributeReads - stats.attributeMisses) / double(stats.attributeReads) : 100.0, seconds);
+    OutputDebugStringA(message);
+    return true;
+}
+
+Vertex ObjVertexToVertex(const objl::Vertex& vertex)
+{
+    return Vertex(vertex.Position.X, vertex.Position.Y, vertex.Position.Z, vertex.TextureCoordinate.X, vertex.TextureCoordinate.Y,
+        vertex.Normal.X, vertex.Normal.Y, vertex.Normal.Z);
+}
+
+void ConvertObjMesh(std::vector<Vertex>& vertexList, std::vector<uint32_t>& indexList, MeshAsset& asset)
+{
+    OptimizeMesh(vertexList, indexList);
+
+    MeshLod fullDetail = { 0, uint32_t(indexList.size()), 0.0f };
+    asset.lods.push_back(fullDetail);
+    GenerateMeshLods(vertexList, indexList, asset.lods);
+    BuildMeshAssetMeshlets(vertexList, indexList, asset);
+
+    asset.indexCount = indexList.size();
+    CompressMeshIndices(indexList, vertexList.size(), asset);
+
+    for (int k = 0; k < 3; ++k)
+    {
+        asset.boundsMin[k] = FLT_MAX;
+        asset.boundsMax[k] = -FLT_MAX;
+    }
+    for (int i = 0; i < vertexList.size(); ++i)
+    {
+        const float* pos = &vertexList[i].pos.x;
+        for (int k = 0; k < 3; ++k)
+        {
+            asset.boundsMin[k] = std::min(asset.boundsMin[k], pos[k]);
+            asset.boundsMax[k] = std::max(asset.boundsMax[k], pos[k]);
+        }
+    }
+
+    asset.indices.swap(indexList);
+}
+
+bool CompressMeshVertices(const std::vector<Vertex>& vertexList, const float boundsMin[3], const float boundsMax[3], MeshAsset& asset)
+{
+    if (!AllowCompressedVertices || vertexList.empty())
+    {
+        return false;
+    }
+
+    std::vector<CompressedVertex> compressed;
+    VertexCompressionError error;
+    CompressVertices(reinterpret_cast<const unsigned char*>(vertexList.data()), vertexList.size(), sizeof(Vertex),
+        offsetof(Vertex, pos), offsetof(Vertex, texCoord), offsetof(Vertex, normal), offsetof(Vertex, tangent),
+        boundsMin, boundsMax, compressed, error);
+
+    bool accepted = IsVertexCompressionAcceptable(error, VertexCompressionTolerance());
+
+    char message[512];
+    snprintf(message, sizeof(message),
+        "Vertex compression %s: position error max %.2e avg %.2e (of bounds diagonal), texcoord error max %.2e avg %.2e, "
+        "normal error max %.3f avg %.3f deg, tangent error max %.3f avg %.3f deg, vertex buffer %u -> %u bytes (%u -> %u bytes per vertex fetch)\n",
+        accepted ? "accepted" : "rejected",
+        error.maxPosition, error.avgPosition, error.maxTexCoord, error.avgTexCoord, error.maxNormalDegrees, error.avgNormalDegrees,
+        error.maxTangentDegrees, error.avgTangentDegrees,
+        unsigned(vertexList.size() * sizeof(Vertex)), unsigned(compressed.size() * sizeof(CompressedVertex)),
+        unsigned(sizeof(Vertex)), unsigned(sizeof(CompressedVertex)));
+    OutputDebugStringA(message);
+
+    if (!accepted)
+    {
+        return false;
+    }
+
+    asset.flags |= MeshAssetFlagCompressedVertices;
+    asset.vertexStride = sizeof(CompressedVertex);
+    const unsigned char* vertexBytes = reinterpret_cast<const unsigned char*>(compressed.data());
+    asset.vertexData.assign(vertexBytes, vertexBytes + compressed.size() * sizeof(CompressedVertex));
+
+    return true;
+}
+
+void UnifyVertexLayout(std::vector<MeshAsset>& meshes)
+{
+    size_t compressedCount = 0;
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        compressedCount += (meshes[i].flags & MeshAssetFlagCompressedVertices) != 0 ? 1 : 0;
+    }
+    if (compressedCount == 0 || compressedCount == meshes.size())
+    {
+        return;
+    }
+
+    // the bounds the renderer would dequantize with, the ones the converter quantized against
+    float boundsMin[3], boundsMax[3];
+    MeshAssetSceneBounds(meshes, boundsMin, boundsMax);
+    jobSystem.ParallelFor(meshes.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            MeshAsset& mesh = meshes[i];
+            if ((mesh.flags & MeshAssetFlagCompressedVertices) == 0)
+            {
+                continue;
+            }
+            uint32_t vertexCount = mesh.VertexCount();
+            std::vector<unsigned char> vertexData(size_t(vertexCount) * sizeof(Vertex));
+            DecompressVertices(reinterpret_cast<const CompressedVertex*>(mesh.vertexData.data()), vertexCount, boundsMin, boundsMax,
+                vertexData.data(), sizeof(Vertex), offsetof(Vertex, pos), offsetof(Vertex, texCoord), offsetof(Vertex, normal),
+                offsetof(Vertex, tangent));
+            mesh.vertexData.swap(vertexData);
+            mesh.vertexStride = sizeof(Vertex);
+            mesh.flags &= ~MeshAssetFlagCompressedVertices;
+        }
+    });
+
+    char message[256];
+    snprintf(message, sizeof(message), "Mesh asset: %u of %u meshes have compressed vertices, decoded them for one vertex layout\n",
+        unsigned(compressedCount), unsigned(meshes.size()));
+    OutputDebugStringA(message);
+}
+
+void CompressMeshIndices(const std::vector<uint32_t>& indexList, size_t vertexCount, MeshAsset& asset)
+{
+    EncodeIndexBuffer(indexList, asset.compressedIndices);
+    asset.flags |= MeshAssetFlagCompressedIndices;
+
+    char message[256];
+    snprintf(message, sizeof(message),
+        "Index compression: %u indices, 32 bit %u bytes, 16 bit %u bytes%s, compressed %u bytes (%.2f bits per index)\n",
+        unsigned(indexList.size()), unsigned(indexList.size() * sizeof(uint32_t)), unsigned(indexList.size() * sizeof(uint16_t)),
+        vertexCount <= 0x10000 ? "" : " if split into submeshes",
+        unsigned(asset.compressedIndices.size()), indexList.empty() ? 0.0 : asset.compressedIndices.size() * 8.0 / indexList.size());
+    OutputDebugStringA(message);
+}
+
+bool PrepareMeshIndices(MeshAsset& mesh, std::vector<uint16_t>& indices16, std::vector<Submesh>& submeshes, std::vector<MeshLodDraw>& lodDraws,
+    bool allow16Bit)
+{
+    if (mesh.indices.empty() && mesh.indexCount > 0)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!DecodeIndexBuffer(mesh.compressedIndices.data(), mesh.compressedIndices.size(), mesh.indexCount, mesh.indices))
+        {
+            OutputDebugStringA("Index decode failed, the mesh asset is corrupt\n");
+            return false;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        char message[256];
+        snprintf(message, sizeof(message), "Index decode: %u indices from %u bytes in %.3f ms (%.1f M indices/s)\n",
+            mesh.indexCount, unsigned(mesh.compressedIndices.size()), seconds * 1000.0,
+            seconds > 0 ? mesh.indexCount / seconds / 1000000.0 : 0.0);
+        OutputDebugStringA(message);
+    }
+
+    std::vector<MeshLod> lods = mesh.lods;
+    if (lods.empty())
     {
-        Vertex v = {mesh.Vertices[i].Position.X, mesh.Vertices[i].Position.Y, mesh.Vertices[i].Position.Z, 
-            mesh.Vertices[i].TextureCoordinate.X, mesh.Vertices[i].TextureCoordinate.Y,
-            mesh.Vertices[i].Normal.X, mesh.Vertices[i].Normal.Y, mesh.Vertices[i].Normal.Z};
-        vertexList.push_back(v);
+        MeshLod whole = { 0, uint32_t(mesh.indices.size()), 0.0f };
+        lods.push_back(whole);
+    }
+    for (size_t l = 0; l < lods.size(); ++l)
+    {
+        if (size_t(lods[l].indexOffset) + lods[l].indexCount > mesh.indices.size())
+        {
+            OutputDebugStringA("Mesh LOD outside of the index buffer, the mesh asset is corrupt\n");
+            return false;
+        }
     }
 
-    for (int i = 0; i < mesh.Indices.size(); ++i)
+    // 16 bit indices whenever every LOD, or a few submeshes of it, can address its vertices with them
+    indices16.clear();
+    submeshes.clear();
+    lodDraws.clear();
+    bool use16Bit = allow16Bit;
+    std::vector<uint32_t> lodIndices;
+    std::vector<uint16_t> lodIndices16;
+    std::vector<Submesh> lodSubmeshes;
+    for (size_t l = 0; l < lods.size() && use16Bit; ++l)
     {
-        indexList.push_back(mesh.Indices[i]);
+        lodIndices.assign(mesh.indices.begin() + lods[l].indexOffset, mesh.indices.begin() + lods[l].indexOffset + lods[l].indexCount);
+        use16Bit = ConvertTo16BitIndices(lodIndices, MaxIndexSubmeshes, lodIndices16, lodSubmeshes);
+
+        MeshLodDraw draw = { uint32_t(submeshes.size()), uint32_t(lodSubmeshes.size()), lods[l].error };
+        lodDraws.push_back(draw);
+        for (size_t i = 0; i < lodSubmeshes.size(); ++i)
+        {
+            lodSubmeshes[i].startIndex += uint32_t(indices16.size());
+            submeshes.push_back(lodSubmeshes[i]);
+        }
+        indices16.insert(indices16.end(), lodIndices16.begin(), lodIndices16.end());
     }
 
+    if (!use16Bit)
+    {
+        indices16.clear();
+        submeshes.clear();
+        lodDraws.clear();
+        for (size_t l = 0; l < lods.size(); ++l)
+        {
+            Submesh whole = { lods[l].indexOffset, lods[l].indexCount, 0 };
+            MeshLodDraw draw = { uint32_t(submeshes.size()), 1, lods[l].error };
+            submeshes.push_back(whole);
+            lodDraws.push_back(draw);
+        }
+    }
 
     return true;
-}
\ No newline at end of file
+}
+
+void GenerateMeshLods(const std::vector<Vertex>& vertexList, std::vector<uint32_t>& indexList, std::vector<MeshLod>& lods)
+{
+    if (indexList.empty())
+    {
+        return;
+    }
+
+    size_t fullIndexCount = indexList.size();
+    std::vector<uint32_t> previous(indexList);
+    std::vector<uint32_t> simplified;
+    float error = 0.0f;
+
+    for (size_t i = 0; i < _countof(LodTriangleRatios); ++i)
+    {
+        size_t targetIndexCount = size_t(fullIndexCount / 3 * LodTriangleRatios[i]) * 3;
+
+        // every level starts from the previous one, so the errors add up
+        float levelError = SimplifyMesh(previous, &vertexList[0].pos.x, vertexList.size(), sizeof(Vertex),
+            targetIndexCount, FLT_MAX, simplified);
+
+        // a level that barely removes anything is not worth a draw, seams and borders stop the simplifier eventually
+        if (simplified.empty() || simplified.size() > previous.size() * 95 / 100)
+        {
+            break;
+        }
+        error += levelError;
+
+        OptimizeVertexCache(simplified, vertexList.size());
+
+        MeshLod lod = { uint32_t(indexList.size()), uint32_t(simplified.size()), error };
+        lods.push_back(lod);
+        indexList.insert(indexList.end(), simplified.begin(), simplified.end());
+        previous.swap(simplified);
+
+        char message[256];
+        snprintf(message, sizeof(message), "Mesh LOD %u: %u triangles (%.1f%% of LOD 0), error %f\n",
+            unsigned(lods.size() - 1), unsigned(lod.indexCount / 3), lod.indexCount * 100.0 / fullIndexCount, lod.error);
+        OutputDebugStringA(message);
+    }
+}
+
+void BuildMeshAssetMeshlets(const std::vector<Vertex>& vertexList, const std::vector<uint32_t>& indexList, MeshAsset& asset)
+{
+    if (indexList.empty())
+    {
+        return;
+    }
+
+    size_t indexCount = asset.lods.empty() ? indexList.size() : asset.lods[0].indexCount;
+    BuildMeshlets(indexList.data(), indexCount, &vertexList[0].pos.x, vertexList.size(), sizeof(Vertex),
+        asset.meshlets, asset.meshletVertices, asset.meshletTriangles);
+
+    char message[256];
+    snprintf(message, sizeof(message), "Meshlets: %u meshlets, %.1f vertices and %.1f triangles on average\n",
+        unsigned(asset.meshlets.size()), double(asset.meshletVertices.size()) / asset.meshlets.size(),
+        double(asset.meshletTriangles.size()) / 3.0 / asset.meshlets.size());
+    OutputDebugStringA(message);
+
+    ReportMeshletCulling(asset);
+}
+
+void ReportMeshletCulling(const MeshAsset& asset)
+{
+    if (asset.meshlets.empty())
+    {
+        return;
+    }
+
+    // views around the mesh at the default camera distance, and two close ups where the frustum cuts it
+    XMVECTOR center = XMVectorSet((asset.boundsMin[0] + asset.boundsMax[0]) * 0.5f, (asset.boundsMin[1] + asset.boundsMax[1]) * 0.5f,
+        (asset.boundsMin[2] + asset.boundsMax[2]) * 0.5f, 1.0f);
+    XMMATRIX projMat = XMMatrixPerspectiveFovLH(3.14f * (45.f / 180.f), (float)Width / float(Height), 0.1f, 1000.f);
+    const int viewCount = 10;
+    MeshletCullingStatistics viewStats[viewCount];
+    jobSystem.ParallelFor(viewCount, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            bool closeUp = i >= 8;
+            float angle = i * XM_PIDIV4;
+            float distance = closeUp ? 12.0f : 41.0f;
+            float height = closeUp ? 3.0f : 9.0f;
+            XMVECTOR eye = XMVectorAdd(center, XMVectorSet(distance * sinf(angle), height, -distance * cosf(angle), 0.0f));
+            XMMATRIX viewProjMat = XMMatrixLookAtLH(eye, center, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * projMat;
+
+            XMFLOAT4X4 viewProj;
+            XMStoreFloat4x4(&viewProj, viewProjMat);
+            float planes[6][4];
+            ExtractFrustumPlanes(&viewProj.m[0][0], planes);
+            XMFLOAT3 cameraPos;
+            XMStoreFloat3(&cameraPos, eye);
+
+            viewStats[i] = CullMeshlets(asset.meshlets, planes, &cameraPos.x);
+        }
+    });
+
+    for (int i = 0; i < viewCount; ++i)
+    {
+        const MeshletCullingStatistics& stats = viewStats[i];
+        char message[256];
+        snprintf(message, sizeof(message),
+            "Meshlet culling view %d (%s, %.0f deg): %u frustum + %u backface of %u meshlets, %.1f%% of triangles rejected\n",
+            i, i >= 8 ? "close up" : "orbit", i * 45.0f, stats.frustumCulledMeshlets, stats.backfaceCulledMeshlets,
+            stats.meshletCount, stats.triangleCount == 0 ? 0.0 : stats.culledTriangles * 100.0 / stats.triangleCount);
+        OutputDebugStringA(message);
+    }
+}
+
+size_t SelectMeshLod(const RenderPacket& packet, const XMFLOAT4X4& worldMat, const SceneMesh& mesh)
+{
+    if (mesh.lodCount == 0)
+    {
+        return 0;
+    }
+
+    // distance from the camera to the bounding sphere, the mesh has no scale so object space errors are world space
+    XMVECTOR center = XMVector3Transform(XMLoadFloat3(&mesh.boundsCenter), XMLoadFloat4x4(&worldMat));
+    float distance;
+    XMStoreFloat(&distance, XMVector3Length(XMVectorSubtract(center, XMLoadFloat4(&packet.cameraPosition))));
+    distance = std::max(distance - mesh.boundsRadius, 0.1f);
+
+    // pixels covered by one unit at that distance
+    float pixelsPerUnit = packet.projMat._22 * float(Height) * 0.5f / distance;
+
+    size_t lod = 0;
+    for (size_t i = 1; i < mesh.lodCount; ++i)
+    {
+        if (meshLods[mesh.firstLod + i].error * pixelsPerUnit > LodErrorThresholdPixels)
+        {
+            break;
+        }
+        lod = i;
+    }
+    return lod;
+}
+
+void OptimizeMesh(std::vector<Vertex>& vertexList, std::vector<uint32_t>& indexList)
+{
+    if (indexList.empty())
+    {
+        return;
+    }
+
+    VertexCacheStatistics before = AnalyzeVertexCache(indexList, vertexList.size());
+
+    // the loader emits one vertex per face corner, share them first so the cache has something to reuse
+    WeldVertices(vertexList, indexList);
+    // faces the file gave no normals, the tangents need them
+    auto normalStart = std::chrono::high_resolution_clock::now();
+    NormalStatistics normals = GenerateSmoothNormals(vertexList, indexList, NormalCreaseAngleDegrees, &jobSystem);
+    double normalMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - normalStart).count();
+    // on the shared vertices, the copies it makes for mirrored UVs are then ordered like the rest
+    auto tangentStart = std::chrono::high_resolution_clock::now();
+    TangentStatistics tangents = GenerateTangents(vertexList, indexList, &jobSystem);
+    double tangentMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tangentStart).count();
+    OptimizeVertexCache(indexList, vertexList.size());
+    if (OptimizeMeshOverdraw)
+    {
+        OptimizeOverdraw(indexList, &vertexList[0].pos.x, vertexList.size(), sizeof(Vertex));
+    }
+    OptimizeVertexFetch(vertexList, indexList);
+
+    VertexCacheStatistics after = AnalyzeVertexCache(indexList, vertexList.size());
+
+    char message[384];
+    snprintf(message, sizeof(message),
+        "Mesh optimization: vertices %u -> %u, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, smooth normals for %u triangles in %.2f ms "
+        "(%u vertices split at creases), tangents in %.2f ms (%u vertices split for mirrored UVs, %u triangles without UV area)\n",
+        before.vertexCount, after.vertexCount, before.acmr, after.acmr, before.atvr, after.atvr,
+        unsigned(normals.smoothedTriangles), normalMs, unsigned(normals.splitVertices),
+        tangentMs, unsigned(tangents.splitVertices), unsigned(tangents.degenerateTriangles));
+    OutputDebugStringA(message);
+}
@@ -4,15 +4,48 @@
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
 #endif
 
+#ifndef NOMINMAX
+#define NOMINMAX                        // Keep std::min/std::max usable in the mesh headers.
+#endif
+
 #include <windows.h>
 #include <d3d12.h>
 #include <dxgi1_4.h>
 #include <D3Dcompiler.h>
 #include <DirectXMath.h>
 #include <vector>
+#include <cfloat>
+#include <chrono>
+#include <thread>
 #include "d3dx12.h"
 #include "ImageUtil.h"
 #include "OBJ_Loader.h"
+#include "MeshOptimizer.h"
+#include "MeshAsset.h"
+#include "VertexCompression.h"
+#include "IndexCompression.h"
+#include "IndexFormat.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "TangentSpace.h"
+#include "VertexNormals.h"
+#include "GameTime.h"
+#include "CameraController.h"
+#include "JobSystem.h"
+#include "ParallelRecording.h"
+#include "RenderQueue.h"
+#include "RenderGraph.h"
+#include "ResourceStateTracker.h"
+#include "PipelineCache.h"
+#include "ShaderCache.h"
+#include "ShaderPermutations.h"
+#include "ShaderHotReload.h"
+#include "BindlessDescriptors.h"
+#include "GpuMemoryAllocator.h"
+#include "ResidencyManager.h"
+#include "GeometryPool.h"
+#include "ObjScene.h"
+#include "ObjStreaming.h"
 
 
 #define SAFE_RELEASE(p) { if ( (p) ) {(p)->Release(); (p) = 0; } }
@@ -21,10 +54,11 @@ using namespace DirectX;
 struct Vertex
 {
 	Vertex(float x, float y, float z, float u, float v, float nx, float ny, float nz) :
-		pos(x, y, z), texCoord(u, v), normal(nx, ny, nz) {}
+		pos(x, y, z), texCoord(u, v), normal(nx, ny, nz), tangent(0.0f, 0.0f, 0.0f, 0.0f) {}
 	XMFLOAT3 pos;
 	XMFLOAT2 texCoord;
 	XMFLOAT3 normal;
+	XMFLOAT4 tangent;	// along +u, w the bitangent sign, written by GenerateTangents after welding
 };
 
 // Handle to the window
@@ -44,6 +78,12 @@ bool FullScreen = false;
 
 bool Running = false;
 
+// engine wide job scheduler, the main thread is thread 0
+JobSystem jobSystem;
+
+// worker threads besides the main thread, 0 for one per remaining hardware thread
+size_t JobWorkerCount = 0;
+
 //create window
 bool InitializeWindow(HINSTANCE hInstance,
 	int ShowWnd,
@@ -77,6 +117,21 @@ ID3D12CommandAllocator* commandAllocator[frameBufferCount];
 
 ID3D12GraphicsCommandList* commandList;
 
+// per frame list/allocator pools, the frame is recorded into several lists and submitted at once
+struct D3D12RecordingTraits {
+	typedef ID3D12CommandAllocator Allocator;
+	typedef ID3D12GraphicsCommandList CommandList;
+	static bool Create(ID3D12CommandAllocator*& allocator, ID3D12GraphicsCommandList*& list);
+	static bool Reset(ID3D12CommandAllocator* allocator, ID3D12GraphicsCommandList* list);
+	static bool Close(ID3D12GraphicsCommandList* list);
+	static void Destroy(ID3D12CommandAllocator* allocator, ID3D12GraphicsCommandList* list);
+};
+ParallelCommandRecorder<D3D12RecordingTraits> commandRecorder;
+
+// most lists the draws of a frame are split into, and the fewest draws worth a list of their own
+size_t RecordingWorkerCount = 4;
+size_t MinDrawsPerCommandList = 64;
+
 DXGI_SAMPLE_DESC sampleDesc;
 
 ID3D12Fence* fence[frameBufferCount];
@@ -90,32 +145,193 @@ int frameIndex;
 int rtvDescriptorSize;
 
 D3D12_SHADER_BYTECODE vertexShaderBytecode;
-D3D12_SHADER_BYTECODE pixelShaderBytecode;
+// pixel shader permutations by PixelPermutationIndex, only the ones the materials need are loaded
+D3D12_SHADER_BYTECODE pixelShaderBytecode[PixelPermutationCount];
+// bytecode the shader bytecode points into
+std::vector<unsigned char> vertexShaderBlob;
+std::vector<unsigned char> pixelShaderBlobs[PixelPermutationCount];
+
+// development builds only take precompiled shaders built from the current sources and compile the shaders
+// at runtime when there are none, shipping builds only load what BuildShaders.py listed in the manifest
+#ifdef _DEBUG
+bool ShaderDevMode = true;
+#else
+bool ShaderDevMode = false;
+#endif
+// permutation of the vertex shader in use
+ShaderPermutation vertexPermutation;
+// the shaders in use are DXIL from the shader cache, not DXBC from the runtime compiler
+bool shadersPrecompiled;
+
+// development builds recompile edited shaders and swap their pipelines in at a frame boundary
+ShaderHotReloader shaderReloader;
+// recompiled shaders waiting for their pipelines, empty when the stage did not change
+std::vector<unsigned char> reloadVertexBlob;
+std::vector<unsigned char> reloadPixelBlobs[PixelPermutationCount];
+D3D12_SHADER_BYTECODE reloadPixelBytecode[PixelPermutationCount];
+uint64_t reloadPipelineKeys[PixelPermutationCount];
+bool reloadRequested;
+// bytecode a superseded reload handed to the pipeline cache, kept until exit
+std::vector<std::vector<unsigned char>> retiredShaderBlobs;
 
 ID3D12PipelineState* pipelineStateObject;
 
+// graphics pipelines by a hash of their desc, backed by a driver pipeline library stored in PipelineCachePath
+struct D3D12PipelineTraits {
+	typedef D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc;
+	typedef ID3D12PipelineState Pipeline;
+	static ID3D12PipelineState* Load(uint64_t key, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+	static ID3D12PipelineState* Create(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+	static bool Store(uint64_t key, ID3D12PipelineState* pipeline);
+	static void Release(ID3D12PipelineState* pipeline);
+};
+PipelineStateCache<D3D12PipelineTraits> pipelineCache;
+ID3D12PipelineLibrary* pipelineLibrary;
+// the library reads from this memory as long as it lives
+std::vector<unsigned char> pipelineLibraryData;
+// adapter and driver the library was built for
+uint64_t pipelineAdapterId;
+// stands for the root signature in pipeline hashes
+uint64_t rootSignatureHash;
+// the full permutation of the mesh material, stands in while a specialized pipeline is being built
+uint64_t mainPipelineKey;
+// pipelines of the loaded pixel shader permutations by PixelPermutationIndex
+uint64_t pixelPipelineKeys[PixelPermutationCount];
+const char* PipelineCachePath = "pipelines.cache";
+
 ID3D12RootSignature* rootSignature;
 
 D3D12_VIEWPORT viewport;
 
 D3D12_RECT scissorRect;
 
+// GPU memory, resources are placed into heaps of GpuMemoryBlockSize, see GpuMemoryAllocator.h
+struct D3D12MemoryBlock {
+	ID3D12Heap* heap;
+	// upload blocks only, one buffer over the whole heap mapped for good, upload allocations are ranges of it
+	ID3D12Resource* buffer;
+	UINT8* mapped;
+	// buffer and texture blocks only, the others are used every frame
+	uint32_t residencyHandle;
+};
+struct D3D12HeapTraits {
+	typedef D3D12MemoryBlock Heap;
+	static uint64_t Granularity(uint32_t category);
+	static D3D12MemoryBlock* CreateHeap(uint32_t category, uint64_t size);
+	static void DestroyHeap(D3D12MemoryBlock* block);
+};
+GpuMemoryAllocator<D3D12HeapTraits> gpuMemory;
+const UINT64 GpuMemoryBlockSize = 32 * 1024 * 1024;
+// buffer and texture heaps are evicted least recently used first when the adapter budget runs out,
+// see ResidencyManager.h
+IDXGIAdapter3* dxgiAdapter;
+ResidencyManager<ID3D12Pageable> residency;
+// bytes the tracked heaps may use, 0: what the adapter budget leaves them
+UINT64 ResidencyBudgetLimit = 0;
+ResidencyFrameTelemetry residencyTelemetry;
+// a mapped range of an upload block
+struct UploadRange {
+	ID3D12Resource* buffer;
+	UINT64 offset;
+	UINT8* cpuAddress;
+	D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+	GpuAllocation allocation;
+};
+
+// the vertex and index megabuffers of geometryPool, every static mesh has a range in them
+GeometryPool geometryPool;
+const UINT64 GeometryVertexBufferBytes = 64 * 1024 * 1024;
+const UINT64 GeometryIndexBufferBytes = 32 * 1024 * 1024;
+// compact the megabuffers at a frame boundary once their free space is split up this much
+const double GeometryCompactionThreshold = 0.5;
+
 ID3D12Resource* vertexBuffer;
+GpuAllocation vertexBufferMemory;
 D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
 int vBufferSize;
 
 ID3D12Resource* indexBuffer;
+GpuAllocation indexBufferMemory;
 D3D12_INDEX_BUFFER_VIEW indexBufferView;
 int iBufferSize;
+DXGI_FORMAT indexFormat;
+
+// resources replaced while frames in flight may still read them, released once frameValue completed
+struct RetiredGpuResource {
+	ID3D12Resource* resource;
+	GpuAllocation memory;
+	uint64_t frameValue;
+};
+std::vector<RetiredGpuResource> retiredGpuResources;
+
+// draws of the scene meshes relative to their geometry ranges, more than one per LOD when 16 bit indices needed a split
+std::vector<Submesh> meshSubmeshes;
+
+// submeshes of one LOD of a scene mesh
+struct MeshLodDraw {
+	uint32_t firstSubmesh;
+	uint32_t submeshCount;
+	float error;
+};
+// the LODs of every scene mesh back to back
+std::vector<MeshLodDraw> meshLods;
+
+// a mesh of the loaded scene, every instance draws all of them
+struct SceneMesh {
+	uint32_t geometry;
+	uint32_t firstLod;
+	uint32_t lodCount;
+	uint32_t material;
+	XMFLOAT3 boundsCenter;
+	float boundsRadius;
+};
+std::vector<SceneMesh> sceneMeshes;
+// sceneMeshes is sorted by material, the meshes of material m are [materialFirstMesh[m], materialFirstMesh[m + 1])
+std::vector<uint32_t> materialFirstMesh;
+
+// draws recorded this frame, instance selects the per object constant buffer slot
+struct FrameDraw {
+	Submesh submesh;
+	uint32_t instance;
+	ID3D12PipelineState* pipeline;
+	uint32_t material;
+};
+std::vector<FrameDraw> frameDraws;
 
 D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc;
 ID3D12Resource* depthStencilBuffer;
 ID3D12DescriptorHeap* dsDescriptorHeap;
 
+// passes of a frame, compiled once at init, the back buffer of the frame is bound before every execution
+RenderGraph renderGraph;
+RenderGraphResourceHandle backBufferResource;
+RenderGraphResourceHandle depthResource;
+// placed resources of the graph transients, aliased inside transientMemory
+GpuAllocation transientMemory;
+std::vector<ID3D12Resource*> transientResources;
+// list the serial commands and barriers of the graph go to, nullptr once parallel recording took over
+ID3D12GraphicsCommandList* graphCommandList;
+
+// state of every resource between submissions, lists track their own transitions and resolve the
+// first use of a resource against this table when they are submitted
+typedef ResourceStateTracker<ID3D12Resource> D3D12StateTracker;
+const uint32_t D3D12ReadOnlyStates = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_INDEX_BUFFER |
+	D3D12_RESOURCE_STATE_DEPTH_READ | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE |
+	D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT | D3D12_RESOURCE_STATE_COPY_SOURCE;
+ResourceStateTable<ID3D12Resource> resourceStates;
+// transitions of the init upload list and of the serial graph lists of a frame
+D3D12StateTracker uploadStates(D3D12ReadOnlyStates);
+D3D12StateTracker graphStates(D3D12ReadOnlyStates);
+
 struct ConstantBufferPerObject {
 	XMFLOAT4X4 wMat;
 	XMFLOAT4X4 wvpMat;
 	XMFLOAT3 cameraPos;
+	float pad0;
+	// only used by the compressed vertex layout, pos = quantized * scale + offset
+	XMFLOAT3 positionDequantScale;
+	float pad1;
+	XMFLOAT3 positionDequantOffset;
 };
 struct PointLightData {
 	XMFLOAT3 diffuseColor;
@@ -123,10 +339,11 @@ struct PointLightData {
 	XMFLOAT3 specularColor;
 	float y;
 	XMFLOAT3 position;
-	float specularPower;
+	float specularPower;	// the shader takes the exponent from the material
 	float innerRadius;
 	float outerRadius;
 	bool enable;
+	float z; // HLSL array elements start on 16 bytes
 };
 struct LightConstant {
 	XMFLOAT3 ambientLight;
@@ -140,8 +357,8 @@ int ConstantBufferPerObjectAlignedSize = (sizeof(ConstantBufferPerObject) + 255)
 ConstantBufferPerObject cbPerObject;
 LightConstant lightConstant;
 
-ID3D12Resource* constantBufferUploadHeaps[frameBufferCount];
-ID3D12Resource* lightConstantBufferUploadHeaps[frameBufferCount];
+UploadRange constantBufferMemory[frameBufferCount];
+UploadRange lightConstantBufferMemory[frameBufferCount];
 
 UINT8* cbvGPUAddress[frameBufferCount];
 UINT8* lightCBVGPUAddress[frameBufferCount];
@@ -153,21 +370,180 @@ XMFLOAT4 cameraPosition;
 XMFLOAT4 cameraTarget;
 XMFLOAT4 cameraUp;
 
+// free fly camera, Tab switches to orbiting the target. WASD moves, Q and E go down and up, Shift is faster,
+// the right mouse button looks around and the wheel zooms the orbit
+CameraController camera;
+CameraInput cameraInput = {};
+bool keysDown[256] = {};
+bool mouseLook = false;
+POINT lastMousePosition;
+float CameraMouseRadiansPerPixel = 0.005f;
+
+// length of one simulation step, the game thread runs as many of them per frame as the frame took
+int64_t SimulationStepNanoseconds = 1000000000 / 120;
+GameClock gameClock;
+FixedTimestep simulationStep(SimulationStepNanoseconds);
+
+// the mesh spin before and after the last simulation step, frames draw it in between
+float MeshSpinRadiansPerSecond = 0.18f;
+float meshSpinAngle = 0.0f;
+float previousMeshSpinAngle = 0.0f;
+
 XMFLOAT4X4 meshWorldMat;
 XMFLOAT4X4 meshRotMat;
 XMFLOAT4 meshPosition;
 
-int numOfIndices;
+// everything the render thread needs for one frame, filled by the game thread in Update
+struct RenderInstance {
+	XMFLOAT4X4 worldMat;
+};
+struct RenderPacket {
+	uint64_t frame;
+	XMFLOAT4X4 viewMat;
+	XMFLOAT4X4 projMat;
+	XMFLOAT4 cameraPosition;
+	std::vector<RenderInstance> instances;
+	// enabled lights packed to the front
+	LightConstant lights;
+	UINT lightCount;
+};
 
-ID3D12Resource* textureBuffer;
-D3D12_RESOURCE_DESC textureDesc;
+RenderPacketPipeline<RenderPacket> renderPipeline;
+std::thread renderThread;
+uint64_t gameFrame = 0;
+
+// frames the game thread may run ahead of the render thread, 0 runs them in lock step
+size_t RenderPipelineDepth = 1;
+
+// vertex layout chosen by the asset pipeline for the loaded scene, the same for every mesh of it
+bool useCompressedVertices = false;
+UINT vertexStride;
+XMFLOAT3 positionDequantScale;
+XMFLOAT3 positionDequantOffset;
+
+// shader features of a material, with the number of lights they pick the pixel shader permutation
+struct Material {
+	bool textured;
+	bool specular;
+	bool normalMapped;
+	// sceneTextures the material table entry points at, NoMaterialTexture for the white and flat normal defaults
+	uint32_t diffuseTexture;
+	uint32_t normalTexture;
+};
+// materials of the scene, FrameDraw::material and the material root constant index them and materialTable
+std::vector<Material> sceneMaterials;
+
+// one entry of the material table the pixel shader reads, MaterialData in PixelShader.hlsl
+struct GpuMaterial {
+	XMFLOAT3 diffuseColor;
+	uint32_t diffuseTexture;	// bindless index, the white texture when untextured
+	XMFLOAT3 specularColor;		// black without specular, the full permutation then shades like the specialized one
+	float specularPower;
+	uint32_t normalTexture;		// bindless index of the tangent space normal map, the flat normal texture without one
+	uint32_t padding[3];
+};
+ID3D12Resource* materialTable;
+GpuAllocation materialTableMemory;
+
+// textures of the scene materials, every file is loaded once however many materials use it
+struct SceneTexture {
+	ID3D12Resource* resource;
+	GpuAllocation memory;
+	uint32_t descriptor;
+};
+std::vector<SceneTexture> sceneTextures;
+// 1x1 white, bound for untextured materials so every material works with the full permutation
+SceneTexture whiteTexture = { nullptr, GpuAllocation(), InvalidDescriptorIndex };
+// 1x1 (0.5, 0.5, 1), the normal map of materials without one, it leaves the vertex normal as it is
+SceneTexture flatNormalTexture = { nullptr, GpuAllocation(), InvalidDescriptorIndex };
+// the texture of meshes the obj file gives no material
+const char* DefaultMaterialTexture = "img.jpg";
 
 int LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescription, LPCWSTR filename, int &bytesPerRow);
 
-bool loadMesh(std::string objfileName, std::vector<Vertex>& vertexList, std::vector<DWORD>& indexList);
+// place a 2D texture, record its upload and create its bindless SRV
+bool CreateSceneTexture(const D3D12_RESOURCE_DESC& desc, const BYTE* data, int bytesPerRow, const wchar_t* name, SceneTexture& texture);
+
+// the textures, material table and shader features of the scene materials
+bool InitSceneMaterials(const std::vector<MeshAssetMaterial>& materials);
+
+// every mesh of the obj scene and the materials they use
+bool loadScene(std::string objfileName, std::vector<MeshAsset>& meshes, std::vector<MeshAssetMaterial>& materials);
+
+// obj -> mesh asset converter, runs when the .mesh file next to the obj is missing or stale
+bool ConvertObjToMeshAsset(std::string objfileName, std::vector<MeshAsset>& meshes, std::vector<MeshAssetMaterial>& materials);
+
+// the same for obj files of OutOfCoreObjBytes and more, streams them through ObjChunkStream in ObjConversionMemoryBudget
+// and writes the asset chunk by chunk instead of returning the meshes
+bool ConvertObjToMeshAssetOutOfCore(std::string objfileName, std::string assetFileName, uint64_t sourceTimestamp);
+
+// the layout the obj loader streams the faces into
+Vertex ObjVertexToVertex(const objl::Vertex& vertex);
+
+// one mesh of the obj file, optimized, with LODs and meshlets, the vertices are left to the caller
+void ConvertObjMesh(std::vector<Vertex>& vertexList, std::vector<uint32_t>& indexList, MeshAsset& asset);
+
+void OptimizeMesh(std::vector<Vertex>& vertexList, std::vector<uint32_t>& indexList);
+
+// quantize the mesh vertices into CompressedVertex relative to the scene bounds when the error stays within tolerance
+bool CompressMeshVertices(const std::vector<Vertex>& vertexList, const float boundsMin[3], const float boundsMax[3], MeshAsset& asset);
+
+// the renderer draws a scene with one vertex layout, an asset with both gets its compressed meshes decoded to Vertex
+void UnifyVertexLayout(std::vector<MeshAsset>& meshes);
+
+void CompressMeshIndices(const std::vector<uint32_t>& indexList, size_t vertexCount, MeshAsset& asset);
+
+// decode the asset indices if needed and pick 16 or 32 bit indices, runs on a worker thread
+bool PrepareMeshIndices(MeshAsset& mesh, std::vector<uint16_t>& indices16, std::vector<Submesh>& submeshes, std::vector<MeshLodDraw>& lodDraws,
+	bool allow16Bit = true);
+
+// append the simplified LODs of indexList to it, lods starts with LOD 0
+void GenerateMeshLods(const std::vector<Vertex>& vertexList, std::vector<uint32_t>& indexList, std::vector<MeshLod>& lods);
 
+// split LOD 0 into meshlets for cluster culling and report how much the CPU reference culls
+void BuildMeshAssetMeshlets(const std::vector<Vertex>& vertexList, const std::vector<uint32_t>& indexList, MeshAsset& asset);
+void ReportMeshletCulling(const MeshAsset& asset);
+
+// coarsest LOD of mesh whose error stays below LodErrorThresholdPixels on screen, counted from its firstLod
+size_t SelectMeshLod(const RenderPacket& packet, const XMFLOAT4X4& worldMat, const SceneMesh& mesh);
+
+// reorder triangles for overdraw after the vertex cache pass
+bool OptimizeMeshOverdraw = true;
+
+// faces without normals in the obj file only smooth into neighbours less than this far apart, sharper edges stay hard
+float NormalCreaseAngleDegrees = 60.0f;
+
+// obj files this large are converted out of core, split into spatial chunks instead of their groups
+uint64_t OutOfCoreObjBytes = 2ull << 30;
+
+// memory the out of core converter may use, the chunk it converts at a time included
+uint64_t ObjConversionMemoryBudget = 512ull << 20;
+
+// let the converter store meshes in the 20 byte CompressedVertex layout
+bool AllowCompressedVertices = true;
+
+// meshes above 65536 vertices are split into at most this many 16 bit submeshes, otherwise they keep 32 bit indices
+size_t MaxIndexSubmeshes = 16;
+
+// triangle count of every generated LOD relative to the full resolution mesh
+const float LodTriangleRatios[] = { 0.5f, 0.25f, 0.1f };
+
+// the renderer uses the coarsest LOD whose simplification error projects to less than this many pixels
+float LodErrorThresholdPixels = 1.0f;
+
+// the shader visible CBV/SRV/UAV heap, every descriptor in it is reached by index, see BindlessDescriptors.h
 ID3D12DescriptorHeap* mainDescriptorHeap;
-ID3D12Resource* textureBufferUploadHeap;
+UINT bindlessDescriptorSize;
+BindlessDescriptorHeap bindlessDescriptors;
+const uint32_t BindlessPersistentDescriptors = 4096;
+const uint32_t BindlessDynamicDescriptorsPerFrame = 256;
+// frames handed to the GPU so far and the last one in each frame slot, what descriptor frees wait for
+uint64_t frameSerial;
+uint64_t frameSlotSerial[frameBufferCount];
+// every frame up to this one finished on the GPU
+uint64_t completedFrameSerial;
+// staging of the init copies, the copies run once so the ranges are only freed in Cleanup
+std::vector<UploadRange> initUploads;
 
 // functions
 bool InitD3D();
@@ -178,17 +554,85 @@ bool InitCommandList();
 bool InitFenceAndEvent();
 bool InitSwapChain();
 bool InitDescriptorHeaps();
+D3D12_CPU_DESCRIPTOR_HANDLE BindlessCPUHandle(uint32_t index);
+D3D12_GPU_DESCRIPTOR_HANDLE BindlessGPUHandle(uint32_t index);
+// the descriptor goes back to the heap once the GPU finished the frame being recorded
+void FreeBindlessDescriptor(uint32_t index);
+// copy count descriptors from a CPU only heap into this frame's dynamic slice, returns the first index
+uint32_t StageFrameDescriptors(D3D12_CPU_DESCRIPTOR_HANDLE source, uint32_t count);
 bool InitRootSignature();
+// resource placed in gpuMemory, memory receives the range it occupies
+bool CreateGpuResource(uint32_t category, const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES state,
+	const D3D12_CLEAR_VALUE* clearValue, ID3D12Resource** resource, GpuAllocation& memory);
+// size bytes of upload memory, mapped
+bool AllocateUpload(UINT64 size, UINT64 alignment, UploadRange& range);
+void FreeUpload(UploadRange& range);
+// reserved and used memory per category
+void ReportGpuMemory();
+// megabuffers of vertexCapacity vertices of stride bytes and indexCapacity indices of format
+bool InitGeometryPool(UINT vertexCapacity, UINT stride, UINT indexCapacity, DXGI_FORMAT format);
+// record the copies of a mesh's vertices and indices into its ranges in the megabuffers into the init list
+bool UploadMeshGeometry(uint32_t mesh, const void* vertices, const void* indices);
+void UpdateGeometryViews();
+// render thread, move every mesh to the front of new megabuffers, the copies go to the graph's list
+bool CompactGeometry();
+// release what frames up to completedFrameSerial were the last to use
+void ReleaseRetiredGpuResources();
+// render thread, mark the heaps the frame reads and evict or restore heaps against the budget before it executes
+bool UpdateResidency();
+void ReportResidency();
 bool InitResources();
 bool InitViews();
 bool InitVSPS();
 bool InitPSO();
 
+// load the pipeline library written by the last run, an empty one if it is missing or stale
+bool InitPipelineCache();
+// write the library back when pipelines were added to it
+void SavePipelineCache();
+uint64_t HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+// watch the sources of the shaders in use
+bool StartShaderHotReload();
+// render thread at a frame boundary, take recompiled shaders and swap their pipelines in once they are built
+void ApplyShaderReloads();
+// pipeline of the permutation for material and lightCount lights, the full one while that is not built yet
+ID3D12PipelineState* SelectPipeline(const Material& material, UINT lightCount);
+// copy lights with the enabled ones packed to the front, returns how many are enabled
+UINT PackLights(const LightConstant& lights, LightConstant& packed);
+
+// build and compile the frame graph and create its transient resources
+bool InitRenderGraph();
+D3D12_RESOURCE_STATES ToD3D12States(uint32_t states);
+// open list for serial frame commands, acquired from the recorder when needed
+ID3D12GraphicsCommandList* GraphCommandList();
+void RecordGraphBarriers(const RenderGraphBarrier* barriers, size_t count);
+
+// record the transitions queued in tracker into list with a single ResourceBarrier call
+void FlushResourceBarriers(D3D12StateTracker& tracker, ID3D12GraphicsCommandList* list);
+// barriers for the first uses in tracker against resourceStates, list has to execute right before the tracked ones
+bool ResolveResourceStates(D3D12StateTracker& tracker, ID3D12GraphicsCommandList* list);
+void RecordResourceBarriers(ID3D12GraphicsCommandList* list, const D3D12StateTracker::Barrier* barriers, size_t count);
+
+// game thread, simulate and hand a render packet to the render thread
 void Update();
 
-void UpdatePipeline();
+// the held keys as camera movement for the next simulation steps
+void UpdateCameraInput();
+
+void StartRenderThread();
+void StopRenderThread();
+void RenderThreadMain();
+void ReportRenderPipeline();
+
+// render thread, per instance constants and draws of the packet
+void UpdateFrameConstants(const RenderPacket& packet);
+
+void UpdatePipeline(const RenderPacket& packet);
+
+// record a range of frameDraws into list, called from the recording workers
+void RecordMeshDraws(ID3D12GraphicsCommandList* list, const DrawRange& range);
 
-void Render();
+void Render(const RenderPacket& packet);
 
 void Cleanup();
 
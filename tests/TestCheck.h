@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdio>
+#include <cmath>
+
+// Checks for the engine tests. A failed CHECK prints its condition and the test keeps going, main returns
+// TestResult() so ctest sees the failure.
+
+namespace test
+{
+    inline int& Failures()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline void Fail(const char* file, int line, const char* condition)
+    {
+        std::printf("%s:%d: check failed: %s\n", file, line, condition);
+        Failures()++;
+    }
+}
+
+#define CHECK(condition) \
+    do { if (!(condition)) { test::Fail(__FILE__, __LINE__, #condition); } } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+    do { if (!(std::fabs(double(value) - double(expected)) <= double(tolerance))) { \
+        std::printf("  %s = %g, expected %g\n", #value, double(value), double(expected)); \
+        test::Fail(__FILE__, __LINE__, #value " near " #expected); } } while (0)
+
+inline int TestResult()
+{
+    if (test::Failures() > 0)
+    {
+        std::printf("%d checks failed\n", test::Failures());
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,274 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include "OBJ_Loader.h"
+#include "ObjScene.h"
+
+// Meshes and timing shared by the tests and benchmarks. TestVertex has the layout and member names of the
+// renderer's Vertex (stdafx.h), without DirectXMath.
+
+struct TestFloat2 { float x, y; };
+struct TestFloat3 { float x, y, z; };
+struct TestFloat4 { float x, y, z, w; };
+
+struct TestVertex
+{
+    TestFloat3 pos;
+    TestFloat2 texCoord;
+    TestFloat3 normal;
+    TestFloat4 tangent;
+};
+
+struct TestMesh
+{
+    std::vector<TestVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+inline TestVertex MakeTestVertex(float x, float y, float z, float u, float v, float nx, float ny, float nz)
+{
+    TestVertex vertex = { { x, y, z }, { u, v }, { nx, ny, nz }, { 0.0f, 0.0f, 0.0f, 0.0f } };
+    return vertex;
+}
+
+inline TestVertex ConvertObjVertex(const objl::Vertex& v)
+{
+    return MakeTestVertex(v.Position.X, v.Position.Y, v.Position.Z, v.TextureCoordinate.X, v.TextureCoordinate.Y,
+        v.Normal.X, v.Normal.Y, v.Normal.Z);
+}
+
+// teapot.obj as objl::Loader emits it, one vertex per face corner
+inline bool LoadTeapot(TestMesh& mesh)
+{
+    objl::Loader loader;
+    if (!loader.LoadFile(std::string(ENGINE_DIR) + "teapot.obj") || loader.LoadedMeshes.empty())
+    {
+        return false;
+    }
+    const objl::Mesh& source = loader.LoadedMeshes[0];
+    mesh.vertices.clear();
+    for (const objl::Vertex& v : source.Vertices)
+    {
+        mesh.vertices.push_back(ConvertObjVertex(v));
+    }
+    mesh.indices.assign(source.Indices.begin(), source.Indices.end());
+    return true;
+}
+
+// every mesh of an OBJ file in one, read the way the converter reads it
+inline bool LoadObjMesh(const std::string& path, bool flatNormalsWhenMissing, TestMesh& mesh)
+{
+    objl::Loader loader;
+    loader.FlatNormalsWhenMissing = flatNormalsWhenMissing;
+    ObjMeshCollector<TestVertex> collector(ConvertObjVertex);
+    if (!loader.LoadFile(path, collector))
+    {
+        return false;
+    }
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    for (const ObjMeshCollector<TestVertex>::Mesh& source : collector.meshes)
+    {
+        uint32_t base = uint32_t(mesh.vertices.size());
+        mesh.vertices.insert(mesh.vertices.end(), source.vertices.begin(), source.vertices.end());
+        for (uint32_t index : source.indices)
+        {
+            mesh.indices.push_back(base + index);
+        }
+    }
+    return true;
+}
+
+// UV sphere of radius 1 as an OBJ file without normals: quads, triangles at the poles, every face with its
+// own corners. jitter moves each corner by up to that much, so corners of neighbouring faces that share a
+// position are no longer bitwise equal.
+inline void WriteObjSphere(const std::string& path, int rings, int segments, float jitter)
+{
+    const float Pi = 3.14159265358979f;
+    FILE* file = std::fopen(path.c_str(), "w");
+    int written = 0;
+    auto corner = [&](int ring, int segment)
+    {
+        float theta = Pi * ring / rings;
+        float phi = 2.0f * Pi * (segment % segments) / segments;
+        float x = std::sin(theta) * std::cos(phi);
+        float y = std::cos(theta);
+        float z = std::sin(theta) * std::sin(phi);
+        float offset = jitter * float((written++ * 7919) % 13 - 6) / 6.0f;
+        std::fprintf(file, "v %.9g %.9g %.9g\nvt %g %g\n", x + offset, y - offset, z + offset, float(segment) / segments, float(ring) / rings);
+    };
+    int next = 1;
+    for (int ring = 0; ring < rings; ++ring)
+    {
+        for (int segment = 0; segment < segments; ++segment)
+        {
+            int count = ring == 0 || ring == rings - 1 ? 3 : 4;
+            if (ring == 0)
+            {
+                corner(0, segment);
+                corner(1, segment + 1);
+                corner(1, segment);
+            }
+            else if (ring == rings - 1)
+            {
+                corner(ring, segment);
+                corner(ring, segment + 1);
+                corner(ring + 1, segment);
+            }
+            else
+            {
+                corner(ring, segment);
+                corner(ring, segment + 1);
+                corner(ring + 1, segment + 1);
+                corner(ring + 1, segment);
+            }
+            std::fprintf(file, "f");
+            for (int k = 0; k < count; ++k)
+            {
+                std::fprintf(file, " %d/%d", next + k, next + k);
+            }
+            std::fprintf(file, "\n");
+            next += count;
+        }
+    }
+    std::fclose(file);
+}
+
+// (size + 1)^2 vertices, 2 size^2 triangles in the xy plane with a low wave in z
+inline TestMesh MakeGrid(uint32_t size)
+{
+    TestMesh mesh;
+    mesh.vertices.reserve(size_t(size + 1) * (size + 1));
+    for (uint32_t y = 0; y <= size; ++y)
+    {
+        for (uint32_t x = 0; x <= size; ++x)
+        {
+            float height = 0.01f * std::sin(x * 0.1f) * std::cos(y * 0.1f);
+            mesh.vertices.push_back(MakeTestVertex(float(x), float(y), height, float(x) / size, float(y) / size, 0.0f, 0.0f, 1.0f));
+        }
+    }
+    mesh.indices.reserve(size_t(size) * size * 6);
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            uint32_t corner = y * (size + 1) + x;
+            uint32_t quad[6] = { corner, corner + 1, corner + size + 1, corner + 1, corner + size + 2, corner + size + 1 };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+// UV sphere of radius 1 with a seam at u = 0, unit normals
+inline TestMesh MakeSphere(uint32_t rings, uint32_t segments)
+{
+    const float Pi = 3.14159265358979f;
+    TestMesh mesh;
+    for (uint32_t ring = 0; ring <= rings; ++ring)
+    {
+        float theta = Pi * ring / rings;
+        for (uint32_t segment = 0; segment <= segments; ++segment)
+        {
+            float phi = 2.0f * Pi * segment / segments;
+            float x = std::sin(theta) * std::cos(phi);
+            float y = std::cos(theta);
+            float z = std::sin(theta) * std::sin(phi);
+            mesh.vertices.push_back(MakeTestVertex(x, y, z, float(segment) / segments, float(ring) / rings, x, y, z));
+        }
+    }
+    for (uint32_t ring = 0; ring < rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            uint32_t a = ring * (segments + 1) + segment;
+            uint32_t b = a + segments + 1;
+            // counter-clockwise seen from outside
+            uint32_t quad[6] = { a, a + 1, b, a + 1, b + 1, b };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+// triangles in random order, what a mesh looks like to the vertex cache before optimization
+inline void ShuffleTriangles(std::vector<uint32_t>& indices, uint32_t seed)
+{
+    std::vector<uint32_t> order(indices.size() / 3);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = uint32_t(i);
+    }
+    std::mt19937 random(seed);
+    std::shuffle(order.begin(), order.end(), random);
+    std::vector<uint32_t> shuffled(indices.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            shuffled[i * 3 + k] = indices[order[i] * 3 + k];
+        }
+    }
+    indices.swap(shuffled);
+}
+
+// XMMatrixLookAtLH(eye, target, +y) * XMMatrixPerspectiveFovLH(fovY, aspect, zNear, zFar), row major
+inline void MakeViewProjection(const float* eye, const float* target, float fovY, float aspect, float zNear, float zFar, float* m)
+{
+    float z[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+    float length = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    z[0] /= length;
+    z[1] /= length;
+    z[2] /= length;
+    float x[3] = { z[2], 0.0f, -z[0] };
+    length = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+    x[0] /= length;
+    x[2] /= length;
+    float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    float view[16] = {
+        x[0], y[0], z[0], 0.0f,
+        x[1], y[1], z[1], 0.0f,
+        x[2], y[2], z[2], 0.0f,
+        -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]), -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]), -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f };
+    float yScale = 1.0f / std::tan(fovY * 0.5f);
+    float depth = zFar / (zFar - zNear);
+    float projection[16] = {
+        yScale / aspect, 0.0f, 0.0f, 0.0f,
+        0.0f, yScale, 0.0f, 0.0f,
+        0.0f, 0.0f, depth, 1.0f,
+        0.0f, 0.0f, -zNear * depth, 0.0f };
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k)
+            {
+                sum += view[row * 4 + k] * projection[k * 4 + column];
+            }
+            m[row * 4 + column] = sum;
+        }
+    }
+}
+
+class Stopwatch
+{
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    void Restart() { start = std::chrono::steady_clock::now(); }
+
+    double Milliseconds() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
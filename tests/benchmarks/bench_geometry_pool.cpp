@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <random>
+#include "GeometryPool.h"
+#include "TestMeshes.h"
+
+// GeometryPool cost of allocating or freeing a mesh's vertex and index ranges with 5000 or more meshes
+// live, then the time Compact takes to plan the copies for all of them.
+
+int main()
+{
+    std::mt19937 random(11);
+    GeometryPool pool;
+    pool.Init(1 << 24, 32, 1 << 26, 4);
+    std::vector<uint32_t> handles;
+    handles.reserve(100000);
+    const int Operations = 2000000;
+    Stopwatch timer;
+    for (int i = 0; i < Operations; ++i)
+    {
+        if (handles.size() < 5000 || (random() & 1))
+        {
+            uint32_t handle = pool.Allocate(1 + random() % 4096, 3 * (1 + random() % 4096));
+            if (handle != InvalidAllocation)
+            {
+                handles.push_back(handle);
+            }
+        }
+        else
+        {
+            size_t freed = random() % handles.size();
+            pool.Free(handles[freed]);
+            handles[freed] = handles.back();
+            handles.pop_back();
+        }
+    }
+    double nanoseconds = timer.Milliseconds() * 1e6 / Operations;
+    GeometryPoolStatistics statistics = pool.Statistics();
+
+    timer.Restart();
+    std::vector<GeometryCopy> vertexCopies;
+    std::vector<GeometryCopy> indexCopies;
+    pool.Compact(vertexCopies, indexCopies);
+    double compactMs = timer.Milliseconds();
+    std::printf("%.1f ns per allocate or free, %u meshes, fragmentation %.2f\n", nanoseconds, statistics.meshes, statistics.fragmentation);
+    std::printf("compact: %.2f ms, %zu vertex and %zu index copies\n", compactMs, vertexCopies.size(), indexCopies.size());
+    return 0;
+}
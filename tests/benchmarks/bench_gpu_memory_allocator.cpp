@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <random>
+#include "GpuMemoryAllocator.h"
+#include "TestMeshes.h"
+
+// TlsfAllocator cost per allocation or free on a 256 MB heap that is kept between 1000 and 2000 live
+// ranges of 1 B to 64 KB, and the fragmentation that leaves behind.
+
+int main()
+{
+    const uint64_t Capacity = 256ull << 20;
+    const int Operations = 1 << 22;
+    std::mt19937 random(3);
+    std::vector<uint64_t> sizes(1 << 20);
+    for (uint64_t& size : sizes)
+    {
+        size = 1 + random() % (64 << 10);
+    }
+
+    TlsfAllocator allocator;
+    allocator.Init(Capacity, 256);
+    std::vector<uint32_t> live;
+    live.reserve(2000);
+    int operations = 0;
+    Stopwatch timer;
+    for (int i = 0; i < Operations; ++i)
+    {
+        TlsfAllocation range;
+        if (allocator.Allocate(sizes[i & (sizes.size() - 1)], 256, range))
+        {
+            live.push_back(range.handle);
+        }
+        operations++;
+        if (live.size() >= 2000)
+        {
+            // free half of them in random order
+            while (live.size() > 1000)
+            {
+                size_t freed = random() % live.size();
+                allocator.Free(live[freed]);
+                live[freed] = live.back();
+                live.pop_back();
+                operations++;
+            }
+        }
+    }
+    double nanoseconds = timer.Milliseconds() * 1e6 / operations;
+    std::printf("%d allocations and frees: %.1f ns each, %.1f ns per pair, fragmentation %.3f over %u free blocks\n",
+        operations, nanoseconds, 2.0 * nanoseconds, allocator.Fragmentation(), allocator.FreeBlockCount());
+    return 0;
+}
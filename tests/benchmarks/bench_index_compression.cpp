@@ -0,0 +1,75 @@
+#include <cstdio>
+#include <cstdlib>
+#include "IndexCompression.h"
+#include "IndexFormat.h"
+#include "MeshOptimizer.h"
+#include "TestMeshes.h"
+
+// Index buffer size as 32 bit, 16 bit and compressed indices after the converter's optimization passes, on
+// teapot.obj and a grid, then encode and decode throughput on the grid and whether the decode reproduces it.
+// usage: bench_index_compression [grid size, default 1000 = 2M triangles]
+
+static void Optimize(TestMesh& mesh)
+{
+    WeldVertices(mesh.vertices, mesh.indices);
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    OptimizeVertexFetch(mesh.vertices, mesh.indices);
+}
+
+static void PrintSizes(const char* name, const TestMesh& mesh)
+{
+    std::vector<uint16_t> indices16;
+    std::vector<Submesh> submeshes;
+    bool fits16 = ConvertTo16BitIndices(mesh.indices, 64, indices16, submeshes);
+    std::vector<unsigned char> encoded;
+    EncodeIndexBuffer(mesh.indices, encoded);
+    std::printf("%s: %zu indices, %zu vertices\n", name, mesh.indices.size(), mesh.vertices.size());
+    std::printf("  32 bit      %10zu bytes\n", mesh.indices.size() * 4);
+    if (fits16)
+    {
+        std::printf("  16 bit      %10zu bytes in %zu submeshes\n", indices16.size() * 2, submeshes.size());
+    }
+    else
+    {
+        std::printf("  16 bit      more than 64 submeshes, stays 32 bit\n");
+    }
+    std::printf("  compressed  %10zu bytes, %.2f bits per index\n", encoded.size(), encoded.size() * 8.0 / mesh.indices.size());
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t gridSize = argc > 1 ? uint32_t(std::atoi(argv[1])) : 1000;
+
+    TestMesh teapot;
+    if (!LoadTeapot(teapot))
+    {
+        std::printf("teapot.obj not found in %s\n", ENGINE_DIR);
+        return 1;
+    }
+    Optimize(teapot);
+    PrintSizes("teapot.obj", teapot);
+
+    TestMesh grid = MakeGrid(gridSize);
+    ShuffleTriangles(grid.indices, 1);
+    Optimize(grid);
+    PrintSizes("grid", grid);
+
+    std::vector<unsigned char> encoded;
+    Stopwatch timer;
+    EncodeIndexBuffer(grid.indices, encoded);
+    double encodeMs = timer.Milliseconds();
+    std::vector<uint32_t> decoded;
+    timer.Restart();
+    bool decodedOk = DecodeIndexBuffer(encoded.data(), encoded.size(), grid.indices.size(), decoded);
+    double decodeMs = timer.Milliseconds();
+    std::printf("encode %.1f ms, %.1f M indices/s\n", encodeMs, grid.indices.size() / encodeMs / 1000.0);
+    std::printf("decode %.1f ms, %.1f M indices/s, %s\n", decodeMs, grid.indices.size() / decodeMs / 1000.0,
+        decodedOk && decoded == grid.indices ? "identical" : "differs");
+
+    std::vector<uint16_t> indices16;
+    std::vector<Submesh> submeshes;
+    timer.Restart();
+    ConvertTo16BitIndices(grid.indices, 64, indices16, submeshes);
+    std::printf("16 bit conversion %.1f ms\n", timer.Milliseconds());
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include "JobSystem.h"
+#include "TestMeshes.h"
+
+// JobSystem overheads and ParallelFor scaling: empty jobs spawned by a scheduler thread and by a thread
+// outside of it (through the external queue), then a fine grained loop for 2 to max threads against the
+// serial loop.
+// usage: bench_job_system [max threads, default hardware threads, at least 2]
+
+static double SpawnEmptyJobs(JobSystem& jobSystem, int count)
+{
+    JobCounter counter;
+    Stopwatch timer;
+    for (int i = 0; i < count; ++i)
+    {
+        jobSystem.Run([]() {}, &counter);
+    }
+    jobSystem.Wait(counter);
+    return timer.Milliseconds() * 1e6 / count;
+}
+
+static double SpawnExternalJobs(JobSystem& jobSystem, int count)
+{
+    double nanoseconds = 0.0;
+    std::thread external([&]()
+    {
+        nanoseconds = SpawnEmptyJobs(jobSystem, count);
+    });
+    external.join();
+    return nanoseconds;
+}
+
+static void Transform(std::vector<float>& values, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        values[i] = std::sin(float(i) * 0.001f) * values[i] + 1.0f;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int maxThreads = argc > 1 ? unsigned(std::atoi(argv[1])) : hardwareThreads;
+    const int JobCount = 1000000;
+    const int Rounds = 4;
+    std::printf("%u hardware threads\n", hardwareThreads);
+
+    std::vector<float> values(size_t(1) << 24, 0.0f);
+    Stopwatch timer;
+    for (int round = 0; round < Rounds; ++round)
+    {
+        Transform(values, 0, values.size());
+    }
+    double serialMs = timer.Milliseconds();
+    std::printf("serial loop, %d x 16M elements: %.1f ms\n", Rounds, serialMs);
+
+    // one worker at least, the external queue needs someone to poll it
+    for (unsigned int threads = 2; threads <= std::max(maxThreads, 2u); threads *= 2)
+    {
+        JobSystem jobSystem;
+        jobSystem.Init(threads - 1);
+        double spawn = SpawnEmptyJobs(jobSystem, JobCount);
+        double external = SpawnExternalJobs(jobSystem, JobCount);
+
+        timer.Restart();
+        for (int round = 0; round < Rounds; ++round)
+        {
+            jobSystem.ParallelFor(values.size(), 1024, [&](size_t begin, size_t end) { Transform(values, begin, end); });
+        }
+        double parallelMs = timer.Milliseconds();
+        std::printf("%zu threads: empty job %.0f ns, from outside %.0f ns, ParallelFor grain 1024 %.1f ms (%.2fx serial)\n",
+            jobSystem.ThreadCount(), spawn, external, parallelMs, serialMs / parallelMs);
+    }
+    return 0;
+}
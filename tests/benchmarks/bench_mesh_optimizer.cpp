@@ -0,0 +1,55 @@
+#include <cstdio>
+#include <cstdlib>
+#include "MeshOptimizer.h"
+#include "TestMeshes.h"
+
+// Vertex cache statistics after every pass of the converter's optimization order on teapot.obj, then the
+// time of each pass on a grid whose triangles are shuffled.
+// usage: bench_mesh_optimizer [grid size, default 1000 = 2M triangles]
+
+static void PrintStatistics(const char* stage, const TestMesh& mesh, double milliseconds)
+{
+    VertexCacheStatistics stats = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+    std::printf("  %-14s %9u vertices  ACMR %.3f  ATVR %.3f  %9.1f ms\n", stage, stats.vertexCount, stats.acmr, stats.atvr, milliseconds);
+}
+
+static void RunPasses(TestMesh& mesh)
+{
+    PrintStatistics("input", mesh, 0.0);
+
+    Stopwatch timer;
+    WeldVertices(mesh.vertices, mesh.indices);
+    PrintStatistics("weld", mesh, timer.Milliseconds());
+
+    timer.Restart();
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    PrintStatistics("vertex cache", mesh, timer.Milliseconds());
+
+    timer.Restart();
+    OptimizeOverdraw(mesh.indices, &mesh.vertices[0].pos.x, mesh.vertices.size(), sizeof(TestVertex));
+    PrintStatistics("overdraw", mesh, timer.Milliseconds());
+
+    timer.Restart();
+    OptimizeVertexFetch(mesh.vertices, mesh.indices);
+    PrintStatistics("vertex fetch", mesh, timer.Milliseconds());
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t gridSize = argc > 1 ? uint32_t(std::atoi(argv[1])) : 1000;
+
+    TestMesh teapot;
+    if (!LoadTeapot(teapot))
+    {
+        std::printf("teapot.obj not found in %s\n", ENGINE_DIR);
+        return 1;
+    }
+    std::printf("teapot.obj, %zu triangles\n", teapot.indices.size() / 3);
+    RunPasses(teapot);
+
+    TestMesh grid = MakeGrid(gridSize);
+    ShuffleTriangles(grid.indices, 1);
+    std::printf("shuffled grid, %zu triangles\n", grid.indices.size() / 3);
+    RunPasses(grid);
+    return 0;
+}
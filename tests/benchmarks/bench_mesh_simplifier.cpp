@@ -0,0 +1,55 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "TestMeshes.h"
+
+// The converter's LOD chain (GenerateMeshLods) on teapot.obj and on a grid: every level is simplified from
+// the previous one towards 50%, 25% and 10% of the triangles, and stops once a level removes less than 5%.
+// usage: bench_mesh_simplifier [grid size, default 1000 = 2M triangles]
+
+static void BuildLodChain(const char* name, TestMesh mesh)
+{
+    WeldVertices(mesh.vertices, mesh.indices);
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    OptimizeVertexFetch(mesh.vertices, mesh.indices);
+    std::printf("%s, %zu triangles, %zu vertices\n", name, mesh.indices.size() / 3, mesh.vertices.size());
+
+    const float Ratios[] = { 0.5f, 0.25f, 0.1f };
+    std::vector<uint32_t> previous = mesh.indices;
+    std::vector<uint32_t> simplified;
+    float error = 0.0f;
+    for (float ratio : Ratios)
+    {
+        size_t targetIndexCount = size_t(mesh.indices.size() / 3 * ratio) * 3;
+        Stopwatch timer;
+        float levelError = SimplifyMesh(previous, &mesh.vertices[0].pos.x, mesh.vertices.size(), sizeof(TestVertex),
+            targetIndexCount, FLT_MAX, simplified);
+        double milliseconds = timer.Milliseconds();
+        if (simplified.empty() || simplified.size() > previous.size() * 95 / 100)
+        {
+            std::printf("  %3.0f%%: stopped at %zu triangles\n", ratio * 100.0f, simplified.size() / 3);
+            break;
+        }
+        error += levelError;
+        std::printf("  %3.0f%%: %9zu triangles, error %.3f, %8.1f ms (%.2fM triangles/s)\n", ratio * 100.0f, simplified.size() / 3,
+            error, milliseconds, previous.size() / 3 / milliseconds * 1e-3);
+        previous.swap(simplified);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t gridSize = argc > 1 ? uint32_t(std::atoi(argv[1])) : 1000;
+
+    TestMesh teapot;
+    if (!LoadTeapot(teapot))
+    {
+        std::printf("teapot.obj not found in %s\n", ENGINE_DIR);
+        return 1;
+    }
+    BuildLodChain("teapot.obj", teapot);
+    BuildLodChain("grid", MakeGrid(gridSize));
+    return 0;
+}
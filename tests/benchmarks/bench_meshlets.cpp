@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <cstdlib>
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "TestMeshes.h"
+
+// Meshlets of teapot.obj after the converter's passes and the share of triangles CullMeshlets rejects for the
+// views of the converter's report: eight orbits at the default camera distance and two close ups. Then the
+// time BuildMeshlets takes on a grid.
+// usage: bench_meshlets [grid size, default 1000 = 2M triangles]
+
+int main(int argc, char** argv)
+{
+    uint32_t gridSize = argc > 1 ? uint32_t(std::atoi(argv[1])) : 1000;
+
+    TestMesh teapot;
+    if (!LoadTeapot(teapot))
+    {
+        std::printf("teapot.obj not found in %s\n", ENGINE_DIR);
+        return 1;
+    }
+    WeldVertices(teapot.vertices, teapot.indices);
+    OptimizeVertexCache(teapot.indices, teapot.vertices.size());
+    OptimizeVertexFetch(teapot.vertices, teapot.indices);
+
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<unsigned char> meshletTriangles;
+    BuildMeshlets(teapot.indices.data(), teapot.indices.size(), &teapot.vertices[0].pos.x, teapot.vertices.size(), sizeof(TestVertex),
+        meshlets, meshletVertices, meshletTriangles);
+    std::printf("teapot.obj: %zu meshlets, %.1f vertices and %.1f triangles on average\n", meshlets.size(),
+        double(meshletVertices.size()) / meshlets.size(), double(meshletTriangles.size()) / 3.0 / meshlets.size());
+
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (const TestVertex& v : teapot.vertices)
+    {
+        const float* p = &v.pos.x;
+        for (int k = 0; k < 3; ++k)
+        {
+            boundsMin[k] = std::min(boundsMin[k], p[k]);
+            boundsMax[k] = std::max(boundsMax[k], p[k]);
+        }
+    }
+    float center[3] = { (boundsMin[0] + boundsMax[0]) * 0.5f, (boundsMin[1] + boundsMax[1]) * 0.5f, (boundsMin[2] + boundsMax[2]) * 0.5f };
+    for (int view = 0; view < 10; ++view)
+    {
+        bool closeUp = view >= 8;
+        float angle = view * 3.14159265f / 4.0f;
+        float distance = closeUp ? 12.0f : 41.0f;
+        float height = closeUp ? 3.0f : 9.0f;
+        float eye[3] = { center[0] + distance * std::sin(angle), center[1] + height, center[2] - distance * std::cos(angle) };
+        float viewProjection[16];
+        MakeViewProjection(eye, center, 3.14f * (45.0f / 180.0f), 800.0f / 600.0f, 0.1f, 1000.0f, viewProjection);
+        float planes[6][4];
+        ExtractFrustumPlanes(viewProjection, planes);
+        MeshletCullingStatistics stats = CullMeshlets(meshlets, planes, eye);
+        std::printf("  view %d (%s, %3d deg): %2u frustum + %2u backface of %u meshlets, %5.1f%% of triangles rejected\n", view,
+            closeUp ? "close up" : "orbit", view * 45, stats.frustumCulledMeshlets, stats.backfaceCulledMeshlets, stats.meshletCount,
+            stats.culledTriangles * 100.0 / stats.triangleCount);
+    }
+
+    TestMesh grid = MakeGrid(gridSize);
+    Stopwatch timer;
+    BuildMeshlets(grid.indices.data(), grid.indices.size(), &grid.vertices[0].pos.x, grid.vertices.size(), sizeof(TestVertex),
+        meshlets, meshletVertices, meshletTriangles);
+    double buildMs = timer.Milliseconds();
+    std::printf("grid: %zu triangles in %zu meshlets, %.1f ms, %.1f M triangles/s\n", grid.indices.size() / 3, meshlets.size(), buildMs,
+        grid.indices.size() / 3 / buildMs / 1000.0);
+    return 0;
+}
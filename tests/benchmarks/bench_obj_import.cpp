@@ -0,0 +1,135 @@
+#include <cstdio>
+#include <cstdlib>
+#include "ObjScene.h"
+#include "MeshAsset.h"
+#include "TestMeshes.h"
+
+// The converter's import of a multi-material OBJ scene up to the mesh asset, without the optimization passes:
+// every group is a grid with its own usemtl, 64 materials share 16 diffuse maps and one bump map. Prints the
+// time to read the file through ObjMeshCollector, to build the material table and texture list, and to write
+// and read back the asset, and whether every mesh and material survives the round trip.
+// usage: bench_obj_import [groups, default 400] [grid size per group, default 20 = 800 triangles]
+
+static const int MaterialCount = 64;
+static const int TextureCount = 16;
+
+static void WriteScene(int groups, int grid)
+{
+    FILE* mtl = std::fopen("bench_obj_import.mtl", "w");
+    for (int i = 0; i < MaterialCount; ++i)
+    {
+        float specular = (i % 2) * 0.5f;
+        std::fprintf(mtl, "newmtl mat%d\nKd %f 0.5 0.25\nKs %f %f %f\nNs %d\nillum 2\nmap_Kd tex/t%d.jpg\n", i, i / 64.0,
+            specular, specular, specular, 10 + i, i % TextureCount);
+        if (i % 4 == 0)
+        {
+            std::fprintf(mtl, "map_bump tex/n0.png\n");
+        }
+    }
+    std::fclose(mtl);
+
+    FILE* obj = std::fopen("bench_obj_import.obj", "w");
+    std::fprintf(obj, "mtllib bench_obj_import.mtl\n");
+    size_t base = 0;
+    for (int g = 0; g < groups; ++g)
+    {
+        std::fprintf(obj, "g group%d\nusemtl mat%d\n", g, g % MaterialCount);
+        for (int y = 0; y <= grid; ++y)
+        {
+            for (int x = 0; x <= grid; ++x)
+            {
+                std::fprintf(obj, "v %d %d %d\nvt %f %f\n", x + g * grid, y, g, x / float(grid), y / float(grid));
+            }
+        }
+        std::fprintf(obj, "vn 0 0 1\n");
+        size_t normal = size_t(g) + 1;
+        for (int y = 0; y < grid; ++y)
+        {
+            for (int x = 0; x < grid; ++x)
+            {
+                size_t a = base + y * (grid + 1) + x + 1, b = a + 1, c = a + grid + 1, d = c + 1;
+                std::fprintf(obj, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\nf %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+                    a, a, normal, b, b, normal, d, d, normal, a, a, normal, d, d, normal, c, c, normal);
+            }
+        }
+        base += size_t(grid + 1) * (grid + 1);
+    }
+    std::fclose(obj);
+}
+
+int main(int argc, char** argv)
+{
+    int groups = argc > 1 ? std::atoi(argv[1]) : 400;
+    int grid = argc > 2 ? std::atoi(argv[2]) : 20;
+    WriteScene(groups, grid);
+
+    Stopwatch timer;
+    objl::Loader loader;
+    ObjMeshCollector<TestVertex> collector(ConvertObjVertex);
+    bool loaded = loader.LoadFile("bench_obj_import.obj", collector);
+    double loadMs = timer.Milliseconds();
+    if (!loaded)
+    {
+        std::printf("could not load the scene\n");
+        return 1;
+    }
+
+    timer.Restart();
+    MeshAssetMaterial defaultMaterial;
+    defaultMaterial.diffuseMap = "img.jpg";
+    std::vector<MeshAssetMaterial> materials;
+    std::vector<uint32_t> meshMaterials;
+    BuildObjMaterialTable(loader, collector.MaterialNames(), ObjDirectory("bench_obj_import.obj"), defaultMaterial, materials, meshMaterials);
+    std::vector<std::string> textures;
+    std::vector<uint32_t> diffuseTextures;
+    std::vector<uint32_t> bumpTextures;
+    BuildMaterialTextureList(materials, textures, diffuseTextures, bumpTextures);
+    double tableMs = timer.Milliseconds();
+
+    // group g was written with material g % 64
+    int wrongMaterial = 0;
+    size_t triangles = 0;
+    std::vector<MeshAsset> meshes(collector.meshes.size());
+    for (size_t i = 0; i < collector.meshes.size(); ++i)
+    {
+        const ObjMeshCollector<TestVertex>::Mesh& source = collector.meshes[i];
+        wrongMaterial += materials[meshMaterials[i]].name != "mat" + std::to_string(i % MaterialCount) ? 1 : 0;
+        triangles += source.indices.size() / 3;
+        MeshAsset& mesh = meshes[i];
+        mesh.vertexStride = sizeof(TestVertex);
+        mesh.vertexData.assign(reinterpret_cast<const unsigned char*>(source.vertices.data()),
+            reinterpret_cast<const unsigned char*>(source.vertices.data() + source.vertices.size()));
+        mesh.indices = source.indices;
+        mesh.indexCount = uint32_t(source.indices.size());
+        mesh.material = meshMaterials[i];
+    }
+    std::printf("%zu meshes, %zu triangles read in %.1f ms\n", collector.meshes.size(), triangles, loadMs);
+    std::printf("%zu materials, %zu textures, table and texture list in %.3f ms, %d meshes with the wrong material\n",
+        materials.size(), textures.size(), tableMs, wrongMaterial);
+
+    timer.Restart();
+    bool written = WriteMeshAsset("bench_obj_import.mesh", 1, meshes, materials);
+    double writeMs = timer.Milliseconds();
+    std::vector<MeshAsset> readMeshes;
+    std::vector<MeshAssetMaterial> readMaterials;
+    timer.Restart();
+    bool read = written && ReadMeshAsset("bench_obj_import.mesh", 1, readMeshes, readMaterials);
+    double readMs = timer.Milliseconds();
+    bool identical = read && readMeshes.size() == meshes.size() && readMaterials.size() == materials.size();
+    for (size_t i = 0; identical && i < meshes.size(); ++i)
+    {
+        identical = readMeshes[i].material == meshes[i].material && readMeshes[i].vertexData == meshes[i].vertexData &&
+            readMeshes[i].indices == meshes[i].indices;
+    }
+    for (size_t i = 0; identical && i < materials.size(); ++i)
+    {
+        identical = readMaterials[i].name == materials[i].name && readMaterials[i].diffuseMap == materials[i].diffuseMap &&
+            readMaterials[i].bumpMap == materials[i].bumpMap && readMaterials[i].specularPower == materials[i].specularPower;
+    }
+    std::printf("asset written in %.1f ms, read in %.1f ms, %s\n", writeMs, readMs, identical ? "identical" : "differs");
+
+    std::remove("bench_obj_import.obj");
+    std::remove("bench_obj_import.mtl");
+    std::remove("bench_obj_import.mesh");
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_set>
+#include <sys/resource.h>
+#include "OBJ_Loader.h"
+#include "TestMeshes.h"
+
+// objl::Loader on a generated scene: every group has two quads with a usemtl each, so the second one splits
+// the group into a mesh of its own. Prints the load time, meshes bound to the wrong material and repeated
+// mesh names. With the materials in the hundred thousands the material binding dominates the load.
+// The scene is read twice, first through LoadFile(Path, sink) into an ObjMeshCollector the way the converter
+// reads it, then into LoadedMeshes, each with the peak resident set size of the process after it.
+// usage: bench_obj_loader [groups, default 50000] [materials, default 100000] [same: one group name for all]
+
+static void WriteScene(int groups, int materials, bool sameName)
+{
+    FILE* mtl = std::fopen("bench_obj_loader.mtl", "w");
+    for (int i = 0; i < materials; ++i)
+    {
+        std::fprintf(mtl, "newmtl mat%d\nKd %f 0 0\n", i, (i % 256) / 256.0);
+    }
+    std::fclose(mtl);
+
+    FILE* obj = std::fopen("bench_obj_loader.obj", "w");
+    std::fprintf(obj, "mtllib bench_obj_loader.mtl\n");
+    long v = 0;
+    for (int g = 0; g < groups; ++g)
+    {
+        if (sameName)
+        {
+            std::fprintf(obj, "g part\n");
+        }
+        else
+        {
+            std::fprintf(obj, "g part%d\n", g);
+        }
+        for (int h = 0; h < 2; ++h)
+        {
+            std::fprintf(obj, "usemtl mat%d\n", (g * 2 + h) % materials);
+            std::fprintf(obj, "v %d 0 %d\nv %d 1 %d\nv %d 1 %d\nv %d 0 %d\n", g, h, g + 1, h, g + 1, h + 1, g, h + 1);
+            std::fprintf(obj, "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 1 0\n");
+            std::fprintf(obj, "f %ld/%ld/1 %ld/%ld/1 %ld/%ld/1\nf %ld/%ld/1 %ld/%ld/1 %ld/%ld/1\n",
+                v + 1, v + 1, v + 2, v + 2, v + 3, v + 3, v + 1, v + 1, v + 3, v + 3, v + 4, v + 4);
+            v += 4;
+        }
+    }
+    std::fclose(obj);
+}
+
+// the process high-water mark, it only ever grows
+static double PeakResidentMegabytes()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+int main(int argc, char** argv)
+{
+    int groups = argc > 1 ? std::atoi(argv[1]) : 50000;
+    int materials = argc > 2 ? std::atoi(argv[2]) : 100000;
+    bool sameName = argc > 3 && std::string(argv[3]) == "same";
+    WriteScene(groups, materials, sameName);
+
+    Stopwatch timer;
+    {
+        objl::Loader sinkLoader;
+        ObjMeshCollector<TestVertex> collector(ConvertObjVertex);
+        bool collected = sinkLoader.LoadFile("bench_obj_loader.obj", collector);
+        double sinkMs = timer.Milliseconds();
+        size_t vertexCount = 0;
+        for (const ObjMeshCollector<TestVertex>::Mesh& mesh : collector.meshes)
+        {
+            vertexCount += mesh.vertices.size();
+        }
+        std::printf("sink: %s, %zu meshes, %zu vertices in %.0f ms, peak RSS %.1f MB\n", collected ? "loaded" : "failed",
+            collector.meshes.size(), vertexCount, sinkMs, PeakResidentMegabytes());
+    }
+
+    timer.Restart();
+    objl::Loader loader;
+    bool loaded = loader.LoadFile("bench_obj_loader.obj");
+    double ms = timer.Milliseconds();
+
+    // mesh k was read with material k % materials
+    int wrongMaterial = 0;
+    std::unordered_set<std::string> names;
+    int repeatedNames = 0;
+    for (size_t k = 0; k < loader.LoadedMeshes.size(); ++k)
+    {
+        wrongMaterial += loader.LoadedMeshes[k].MeshMaterial.name != "mat" + std::to_string(k % materials) ? 1 : 0;
+        repeatedNames += names.insert(loader.LoadedMeshes[k].MeshName).second ? 0 : 1;
+    }
+    std::printf("LoadedMeshes: %d groups, %d materials: %s, %zu meshes in %.0f ms, %d with the wrong material, "
+        "%d repeated names, peak RSS %.1f MB\n", groups, materials, loaded ? "loaded" : "failed", loader.LoadedMeshes.size(), ms,
+        wrongMaterial, repeatedNames, PeakResidentMegabytes());
+    std::remove("bench_obj_loader.obj");
+    std::remove("bench_obj_loader.mtl");
+    return 0;
+}
@@ -0,0 +1,235 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include "ObjStreaming.h"
+#include "MeshAsset.h"
+#include "MeshOptimizer.h"
+#include "VertexNormals.h"
+#include "TangentSpace.h"
+#include "VertexCompression.h"
+#include "TestMeshes.h"
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// ObjChunkStream and a chunk by chunk conversion like ConvertObjToMeshAssetOutOfCore on a generated height
+// field scan: uvs, no normals, two materials in bands of rows. The last quarter of the rows tiles its uvs 7.5
+// times, more than half floats keep within the tolerance, so its meshes take the fallback. Every chunk is welded, smoothed, given
+// tangents, optimized and compressed against the stream bounds, a mesh that misses the tolerance keeps its
+// full precision vertices. Prints the partition, the throughput and the peak memory, then reads the asset
+// back, checks that every triangle arrived and times decoding the compressed meshes to one layout.
+// usage: bench_obj_streaming [vertices along a side, default 1024] [memory budget in MB, default 64]
+
+static double PeakMemoryMB()
+{
+#ifdef _WIN32
+    return 0.0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+static bool WriteTerrain(const char* path, int side)
+{
+    FILE* file = std::fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    for (int y = 0; y < side; ++y)
+    {
+        for (int x = 0; x < side; ++x)
+        {
+            float height = 0.05f * std::sin(x * 0.013f) * std::cos(y * 0.011f);
+            float tiling = y >= side * 3 / 4 ? 7.5f : 1.0f;
+            std::fprintf(file, "v %.6f %.6f %.6f\nvt %.5f %.5f\n", float(x) / side, height, float(y) / side, tiling * x / side,
+                tiling * y / side);
+        }
+    }
+    for (int y = 0; y + 1 < side; ++y)
+    {
+        if (y % 512 == 0)
+        {
+            std::fprintf(file, "usemtl %s\n", (y / 512) % 2 ? "rock" : "grass");
+        }
+        for (int x = 0; x + 1 < side; ++x)
+        {
+            int a = y * side + x + 1;
+            int b = a + 1;
+            int c = a + side;
+            int d = c + 1;
+            std::fprintf(file, "f %d/%d %d/%d %d/%d\nf %d/%d %d/%d %d/%d\n", a, a, c, c, b, b, b, b, c, c, d, d);
+        }
+    }
+    return std::fclose(file) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    int side = argc > 1 ? std::atoi(argv[1]) : 1024;
+    uint64_t budget = uint64_t(argc > 2 ? std::atoi(argv[2]) : 64) << 20;
+    const char* objPath = "bench_obj_streaming.obj";
+    const char* assetPath = "bench_obj_streaming.mesh";
+    if (!WriteTerrain(objPath, side))
+    {
+        std::printf("could not write %s\n", objPath);
+        return 1;
+    }
+    double objMB = GetFileSizeBytes(objPath) / (1024.0 * 1024.0);
+    std::printf("obj %.0f MB, budget %llu MB, peak memory after writing it %.1f MB\n", objMB, (unsigned long long)(budget >> 20), PeakMemoryMB());
+
+    Stopwatch timer;
+    uint64_t chunkTriangles = 0;
+    uint64_t meshVertices = 0;
+    uint32_t compressedMeshes = 0;
+    bool converted = false;
+    float streamBoundsMin[3], streamBoundsMax[3];
+    MeshAssetWriter writer;
+    {
+        ObjStreamSettings settings;
+        settings.memoryBudget = budget;
+        ObjChunkStream stream(settings);
+        if (!stream.Open(objPath, std::string(assetPath) + ".tmp") || !writer.Open(assetPath, 1))
+        {
+            std::printf("could not open the stream: %s\n", stream.Error().c_str());
+            return 1;
+        }
+        double partitionMs = timer.Milliseconds();
+        const ObjStreamStatistics& stats = stream.Statistics();
+        std::printf("partition: %llu triangles, %llu grid cells, %llu chunks (%llu split), at most %llu triangles a chunk, "
+            "%.0f MB spilled, attribute cache %.1f%% hits, %.1f s\n",
+            (unsigned long long)stats.triangles, (unsigned long long)stats.gridCells, (unsigned long long)stats.chunks,
+            (unsigned long long)stats.splitChunks, (unsigned long long)stats.maxChunkTriangles, stats.spilledBytes / (1024.0 * 1024.0),
+            stats.attributeReads ? 100.0 * double(stats.attributeReads - stats.attributeMisses) / double(stats.attributeReads) : 100.0,
+            partitionMs / 1000.0);
+
+        converted = stream.ForEachChunk([&](std::vector<ObjStreamTriangle>& triangles)
+        {
+            chunkTriangles += triangles.size();
+            std::vector<uint32_t> order(triangles.size());
+            for (uint32_t i = 0; i < order.size(); ++i)
+            {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return triangles[a].material < triangles[b].material; });
+
+            for (size_t first = 0; first < order.size();)
+            {
+                uint32_t material = triangles[order[first]].material;
+                size_t last = first;
+                while (last < order.size() && triangles[order[last]].material == material)
+                {
+                    last++;
+                }
+                TestMesh mesh;
+                for (size_t i = first; i < last; ++i)
+                {
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        const ObjStreamCorner& corner = triangles[order[i]].corners[k];
+                        mesh.indices.push_back(uint32_t(mesh.vertices.size()));
+                        mesh.vertices.push_back(MakeTestVertex(corner.pos[0], corner.pos[1], corner.pos[2], corner.texCoord[0],
+                            corner.texCoord[1], corner.normal[0], corner.normal[1], corner.normal[2]));
+                    }
+                }
+                first = last;
+
+                WeldVertices(mesh.vertices, mesh.indices);
+                GenerateSmoothNormals(mesh.vertices, mesh.indices, 60.0f);
+                GenerateTangents(mesh.vertices, mesh.indices);
+                OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+                OptimizeVertexFetch(mesh.vertices, mesh.indices);
+                meshVertices += mesh.vertices.size();
+
+                MeshAsset asset;
+                asset.material = material;
+                asset.indexCount = uint32_t(mesh.indices.size());
+                asset.indices.swap(mesh.indices);
+                std::vector<CompressedVertex> compressed;
+                VertexCompressionError error;
+                CompressVertices(reinterpret_cast<const unsigned char*>(mesh.vertices.data()), mesh.vertices.size(), sizeof(TestVertex),
+                    offsetof(TestVertex, pos), offsetof(TestVertex, texCoord), offsetof(TestVertex, normal), offsetof(TestVertex, tangent),
+                    stream.BoundsMin(), stream.BoundsMax(), compressed, error);
+                const unsigned char* vertexBytes = reinterpret_cast<const unsigned char*>(mesh.vertices.data());
+                size_t vertexSize = mesh.vertices.size() * sizeof(TestVertex);
+                asset.vertexStride = sizeof(TestVertex);
+                if (IsVertexCompressionAcceptable(error, VertexCompressionTolerance()))
+                {
+                    vertexBytes = reinterpret_cast<const unsigned char*>(compressed.data());
+                    vertexSize = compressed.size() * sizeof(CompressedVertex);
+                    asset.vertexStride = sizeof(CompressedVertex);
+                    asset.flags |= MeshAssetFlagCompressedVertices;
+                    compressedMeshes++;
+                }
+                asset.vertexData.assign(vertexBytes, vertexBytes + vertexSize);
+                for (int k = 0; k < 3; ++k)
+                {
+                    asset.boundsMin[k] = INFINITY;
+                    asset.boundsMax[k] = -INFINITY;
+                }
+                for (const TestVertex& vertex : mesh.vertices)
+                {
+                    const float* pos = &vertex.pos.x;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        asset.boundsMin[k] = std::min(asset.boundsMin[k], pos[k]);
+                        asset.boundsMax[k] = std::max(asset.boundsMax[k], pos[k]);
+                    }
+                }
+                writer.AddMesh(asset);
+            }
+            return true;
+        });
+        for (int k = 0; k < 3; ++k)
+        {
+            streamBoundsMin[k] = stream.BoundsMin()[k];
+            streamBoundsMax[k] = stream.BoundsMax()[k];
+        }
+    }
+    std::vector<MeshAssetMaterial> materials(3);
+    converted = writer.Finish(materials) && converted;
+    double seconds = timer.Milliseconds() / 1000.0;
+    std::printf("%s: %llu triangles, %.3f vertices a triangle, %u meshes (%u with compressed vertices), asset %.0f MB\n",
+        converted ? "converted" : "failed", (unsigned long long)chunkTriangles, double(meshVertices) / double(chunkTriangles),
+        writer.MeshCount(), compressedMeshes, GetFileSizeBytes(assetPath) / (1024.0 * 1024.0));
+    std::printf("%.1f s, %.1f MB/s, %.2f M triangles/s, peak memory %.1f MB\n", seconds, objMB / seconds, chunkTriangles / seconds / 1e6,
+        PeakMemoryMB());
+
+    std::vector<MeshAsset> meshes;
+    bool readBack = ReadMeshAsset(assetPath, 1, meshes, materials);
+    uint64_t readTriangles = 0;
+    for (const MeshAsset& mesh : meshes)
+    {
+        readTriangles += mesh.indexCount / 3;
+    }
+    timer.Restart();
+    float boundsMin[3], boundsMax[3];
+    MeshAssetSceneBounds(meshes, boundsMin, boundsMax);
+    // the renderer dequantizes with the union of the mesh bounds, it has to be what the chunks were quantized against
+    bool boundsMatch = true;
+    for (int k = 0; k < 3; ++k)
+    {
+        boundsMatch = boundsMatch && boundsMin[k] == streamBoundsMin[k] && boundsMax[k] == streamBoundsMax[k];
+    }
+    size_t decoded = 0;
+    for (const MeshAsset& mesh : meshes)
+    {
+        if (mesh.flags & MeshAssetFlagCompressedVertices)
+        {
+            std::vector<TestVertex> vertices(mesh.VertexCount());
+            DecompressVertices(reinterpret_cast<const CompressedVertex*>(mesh.vertexData.data()), vertices.size(), boundsMin, boundsMax,
+                reinterpret_cast<unsigned char*>(vertices.data()), sizeof(TestVertex), offsetof(TestVertex, pos),
+                offsetof(TestVertex, texCoord), offsetof(TestVertex, normal), offsetof(TestVertex, tangent));
+            decoded += vertices.size();
+        }
+    }
+    std::printf("read back %s: %zu meshes, %llu of %llu triangles, %zu compressed vertices decoded in %.1f ms, "
+        "scene bounds %s the stream bounds\n", readBack ? "ok" : "failed", meshes.size(), (unsigned long long)readTriangles,
+        (unsigned long long)chunkTriangles, decoded, timer.Milliseconds(), boundsMatch ? "match" : "differ from");
+
+    std::remove(objPath);
+    std::remove(assetPath);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <cstdio>
+#include <random>
+#include "RenderGraph.h"
+#include "TestMeshes.h"
+
+// RenderGraph::Compile time and transient memory for random graphs: every pass writes a new transient and
+// reads up to two earlier ones, a quarter of them have side effects, and a final pass reads the last eight
+// transients into the back buffer.
+
+int main()
+{
+    const int PassCounts[] = { 100, 500, 2000 };
+    for (int passCount : PassCounts)
+    {
+        std::mt19937 random(1);
+        RenderGraph graph;
+        std::vector<RenderGraphResourceHandle> resources;
+        resources.push_back(graph.ImportResource("back buffer", RenderGraphStatePresent, RenderGraphStatePresent));
+        for (int i = 0; i < passCount; ++i)
+        {
+            RenderGraphTextureDesc desc = { 0, 0, 0, uint64_t(1 + random() % 16) << 20, 65536 };
+            RenderGraphResourceHandle texture = graph.CreateTexture("texture", desc);
+            RenderGraphPassHandle pass = graph.AddPass("pass", nullptr, random() % 4 == 0);
+            int reads = int(random() % 3);
+            for (int k = 0; k < reads && resources.size() > 1; ++k)
+            {
+                graph.Read(pass, resources[1 + random() % (resources.size() - 1)], RenderGraphStateShaderResource);
+            }
+            graph.Write(pass, texture, random() % 2 ? RenderGraphStateRenderTarget : RenderGraphStateUnorderedAccess);
+            resources.push_back(texture);
+        }
+        RenderGraphPassHandle final = graph.AddPass("final", nullptr);
+        for (int k = 0; k < 8; ++k)
+        {
+            graph.Read(final, resources[resources.size() - 1 - k], RenderGraphStateShaderResource);
+        }
+        graph.Write(final, resources[0], RenderGraphStateRenderTarget);
+
+        const int Iterations = 20;
+        bool compiled = true;
+        Stopwatch timer;
+        for (int i = 0; i < Iterations; ++i)
+        {
+            compiled = graph.Compile() && compiled;
+        }
+        double milliseconds = timer.Milliseconds() / Iterations;
+        const RenderGraphStatistics& stats = graph.Statistics();
+        std::printf("%5d passes: %s in %.3f ms, %u kept, %u barriers, %u transients in %.1f MB (%.1f MB without aliasing)\n",
+            passCount, compiled ? "compiled" : "failed", milliseconds, stats.declaredPasses - stats.culledPasses, stats.barriers,
+            stats.transientResources, stats.transientHeapSize / 1048576.0, stats.transientUnaliasedSize / 1048576.0);
+    }
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include "MeshOptimizer.h"
+#include "TangentSpace.h"
+#include "VertexCompression.h"
+#include "TestMeshes.h"
+
+// GenerateTangents accuracy and throughput on UV spheres, where the tangent along +u is known: the angle
+// to the analytic tangent, corners whose handedness or direction disagrees with their triangle, then the
+// tangent error after compression, then the time for a large sphere serial and on the job system.
+// usage: bench_tangent_space [rings of the large sphere, default 512]
+
+// one vertex per face corner like the loader emits, mirrored: u runs back from 1 to 0 on the z < 0 half
+static TestMesh MakeCornerSphere(int rings, int segments, bool mirrored)
+{
+    const float Pi = 3.14159265358979f;
+    TestMesh mesh;
+    auto corner = [&](int ring, int segment)
+    {
+        float theta = Pi * ring / rings;
+        float phi = 2.0f * Pi * segment / segments;
+        float x = std::sin(theta) * std::cos(phi);
+        float y = std::cos(theta);
+        float z = std::sin(theta) * std::sin(phi);
+        float u = float(segment) / segments;
+        if (mirrored)
+        {
+            u = u <= 0.5f ? u * 2.0f : (1.0f - u) * 2.0f;
+        }
+        return MakeTestVertex(x, y, z, u, float(ring) / rings, x, y, z);
+    };
+    for (int ring = 0; ring < rings; ++ring)
+    {
+        for (int segment = 0; segment < segments; ++segment)
+        {
+            TestVertex quad[6] = { corner(ring, segment), corner(ring + 1, segment), corner(ring, segment + 1),
+                corner(ring, segment + 1), corner(ring + 1, segment), corner(ring + 1, segment + 1) };
+            for (const TestVertex& vertex : quad)
+            {
+                mesh.indices.push_back(uint32_t(mesh.vertices.size()));
+                mesh.vertices.push_back(vertex);
+            }
+        }
+    }
+    WeldVertices(mesh.vertices, mesh.indices);
+    return mesh;
+}
+
+static void MeasureAccuracy(bool mirrored)
+{
+    TestMesh mesh = MakeCornerSphere(64, 128, mirrored);
+    size_t welded = mesh.vertices.size();
+    TangentStatistics statistics = GenerateTangents(mesh.vertices, mesh.indices);
+
+    double maxError = 0.0;
+    double sumError = 0.0;
+    int measured = 0;
+    int wrongSign = 0;
+    int wrongDirection = 0;
+    int notOrthogonal = 0;
+    for (size_t t = 0; t < mesh.indices.size() / 3; ++t)
+    {
+        const TestVertex& a = mesh.vertices[mesh.indices[t * 3]];
+        const TestVertex& b = mesh.vertices[mesh.indices[t * 3 + 1]];
+        const TestVertex& c = mesh.vertices[mesh.indices[t * 3 + 2]];
+        float s1 = b.texCoord.x - a.texCoord.x;
+        float t1 = b.texCoord.y - a.texCoord.y;
+        float s2 = c.texCoord.x - a.texCoord.x;
+        float t2 = c.texCoord.y - a.texCoord.y;
+        float area = s1 * t2 - s2 * t1;
+        if (area == 0.0f)
+        {
+            continue;
+        }
+        // the triangle's own +u direction
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        float ux = ((b.pos.x - a.pos.x) * t2 - (c.pos.x - a.pos.x) * t1) * sign;
+        float uy = ((b.pos.y - a.pos.y) * t2 - (c.pos.y - a.pos.y) * t1) * sign;
+        float uz = ((b.pos.z - a.pos.z) * t2 - (c.pos.z - a.pos.z) * t1) * sign;
+        for (int k = 0; k < 3; ++k)
+        {
+            const TestVertex& v = mesh.vertices[mesh.indices[t * 3 + k]];
+            float radius = std::sqrt(v.pos.x * v.pos.x + v.pos.z * v.pos.z);
+            wrongSign += (area > 0.0f) != (v.tangent.w > 0.0f) ? 1 : 0;
+            // the poles have no unique tangent
+            if (radius < 0.2f)
+            {
+                continue;
+            }
+            wrongDirection += v.tangent.x * ux + v.tangent.y * uy + v.tangent.z * uz <= 0.0f ? 1 : 0;
+            notOrthogonal += std::fabs(v.tangent.x * v.normal.x + v.tangent.y * v.normal.y + v.tangent.z * v.normal.z) > 1e-4f ? 1 : 0;
+            // on the mirror line the analytic tangent depends on the side
+            if (std::fabs(v.pos.z) < 1e-3f)
+            {
+                continue;
+            }
+            float phi = std::atan2(v.pos.z, v.pos.x);
+            float ex = -std::sin(phi);
+            float ez = std::cos(phi);
+            if (mirrored && phi < 0.0f)
+            {
+                ex = -ex;
+                ez = -ez;
+            }
+            float cosine = std::max(-1.0f, std::min(1.0f, v.tangent.x * ex + v.tangent.z * ez));
+            double error = std::acos(cosine) * 180.0 / 3.14159265358979;
+            maxError = std::max(maxError, error);
+            sumError += error;
+            measured++;
+        }
+    }
+    std::printf("sphere%s: %zu welded vertices, %zu split, tangent vs analytic max %.3f avg %.4f deg, "
+        "%d corners with the wrong sign, %d against their triangle's +u, %d not orthogonal\n",
+        mirrored ? " mirrored" : "", welded, statistics.splitVertices, maxError, sumError / measured,
+        wrongSign, wrongDirection, notOrthogonal);
+}
+
+static void MeasureCompression()
+{
+    TestMesh mesh = MakeCornerSphere(64, 128, true);
+    GenerateTangents(mesh.vertices, mesh.indices);
+    std::vector<CompressedVertex> compressed;
+    VertexCompressionError error;
+    const float boundsMin[3] = { -1.0f, -1.0f, -1.0f };
+    const float boundsMax[3] = { 1.0f, 1.0f, 1.0f };
+    CompressVertices(reinterpret_cast<const unsigned char*>(mesh.vertices.data()), mesh.vertices.size(), sizeof(TestVertex),
+        offsetof(TestVertex, pos), offsetof(TestVertex, texCoord), offsetof(TestVertex, normal), offsetof(TestVertex, tangent),
+        boundsMin, boundsMax, compressed, error);
+    int wrongSigns = 0;
+    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        // the sign is stored in pos.w
+        wrongSigns += (compressed[i].pos[3] > 32767) != (mesh.vertices[i].tangent.w > 0.0f) ? 1 : 0;
+    }
+    std::printf("compressed, %zu bytes a vertex: tangent error max %.3f avg %.3f deg, %d wrong signs, %s\n",
+        sizeof(CompressedVertex), error.maxTangentDegrees, error.avgTangentDegrees, wrongSigns,
+        IsVertexCompressionAcceptable(error, VertexCompressionTolerance()) ? "within tolerance" : "over tolerance");
+}
+
+static void MeasureThroughput(int rings)
+{
+    TestMesh source = MakeCornerSphere(rings, rings * 2, true);
+    TestMesh serial = source;
+    Stopwatch timer;
+    TangentStatistics statistics = GenerateTangents(serial.vertices, serial.indices);
+    double serialMs = timer.Milliseconds();
+    std::printf("serial: %zu triangles, %zu vertices (+%zu split) in %.1f ms, %.1f M triangles/s\n", statistics.triangleCount,
+        source.vertices.size(), statistics.splitVertices, serialMs, statistics.triangleCount / serialMs / 1000.0);
+
+    unsigned int workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    JobSystem jobSystem;
+    jobSystem.Init(std::max(workers, 1u));
+    TestMesh parallel = source;
+    timer.Restart();
+    GenerateTangents(parallel.vertices, parallel.indices, &jobSystem);
+    double parallelMs = timer.Milliseconds();
+    bool identical = parallel.vertices.size() == serial.vertices.size() && parallel.indices == serial.indices &&
+        std::memcmp(parallel.vertices.data(), serial.vertices.data(), serial.vertices.size() * sizeof(TestVertex)) == 0;
+    std::printf("job system, %zu threads: %.1f ms (%.2fx serial), %s\n", jobSystem.ThreadCount(), parallelMs, serialMs / parallelMs,
+        identical ? "identical to serial" : "differs from serial");
+    jobSystem.Shutdown();
+}
+
+int main(int argc, char** argv)
+{
+    MeasureAccuracy(false);
+    MeasureAccuracy(true);
+    MeasureCompression();
+    MeasureThroughput(argc > 1 ? std::atoi(argv[1]) : 512);
+    return 0;
+}
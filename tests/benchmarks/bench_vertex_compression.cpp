@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <cfloat>
+#include <cstddef>
+#include "MeshOptimizer.h"
+#include "TangentSpace.h"
+#include "VertexCompression.h"
+#include "TestMeshes.h"
+
+// Before/after comparison of the converter's vertex layouts without the renderer: compression error
+// against VertexCompressionTolerance, vertex buffer size, and the vertex bytes a draw fetches. Fetched
+// bytes are the vertices the post-transform cache misses times the stride, for the triangle order as
+// loaded and after the optimization passes.
+
+struct LayoutReport
+{
+    VertexCacheStatistics cache;
+    size_t fullBytes;
+    size_t compressedBytes;
+};
+
+static LayoutReport Measure(const TestMesh& mesh)
+{
+    LayoutReport report;
+    report.cache = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+    report.fullBytes = size_t(report.cache.verticesTransformed) * sizeof(TestVertex);
+    report.compressedBytes = size_t(report.cache.verticesTransformed) * sizeof(CompressedVertex);
+    return report;
+}
+
+static void Compare(const char* name, TestMesh mesh)
+{
+    std::printf("%s, %zu triangles\n", name, mesh.indices.size() / 3);
+    LayoutReport loaded = Measure(mesh);
+
+    // the converter's passes, overdraw included
+    WeldVertices(mesh.vertices, mesh.indices);
+    GenerateTangents(mesh.vertices, mesh.indices);
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    OptimizeOverdraw(mesh.indices, &mesh.vertices[0].pos.x, mesh.vertices.size(), sizeof(TestVertex));
+    OptimizeVertexFetch(mesh.vertices, mesh.indices);
+    LayoutReport optimized = Measure(mesh);
+
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (const TestVertex& vertex : mesh.vertices)
+    {
+        const float* pos = &vertex.pos.x;
+        for (int k = 0; k < 3; ++k)
+        {
+            boundsMin[k] = std::min(boundsMin[k], pos[k]);
+            boundsMax[k] = std::max(boundsMax[k], pos[k]);
+        }
+    }
+
+    std::vector<CompressedVertex> compressed;
+    VertexCompressionError error;
+    Stopwatch timer;
+    CompressVertices(reinterpret_cast<const unsigned char*>(mesh.vertices.data()), mesh.vertices.size(), sizeof(TestVertex),
+        offsetof(TestVertex, pos), offsetof(TestVertex, texCoord), offsetof(TestVertex, normal), offsetof(TestVertex, tangent),
+        boundsMin, boundsMax, compressed, error);
+    double compressMs = timer.Milliseconds();
+    bool accepted = IsVertexCompressionAcceptable(error, VertexCompressionTolerance());
+
+    std::printf("  compression %s in %.2f ms\n", accepted ? "accepted" : "rejected", compressMs);
+    std::printf("    position error max %.2e avg %.2e (of bounds diagonal)\n", error.maxPosition, error.avgPosition);
+    std::printf("    texcoord error max %.2e avg %.2e\n", error.maxTexCoord, error.avgTexCoord);
+    std::printf("    normal error max %.3f avg %.3f deg, tangent error max %.3f avg %.3f deg\n",
+        error.maxNormalDegrees, error.avgNormalDegrees, error.maxTangentDegrees, error.avgTangentDegrees);
+    std::printf("  vertex buffer %zu -> %zu bytes (%zu -> %zu per vertex)\n",
+        mesh.vertices.size() * sizeof(TestVertex), compressed.size() * sizeof(CompressedVertex), sizeof(TestVertex), sizeof(CompressedVertex));
+    std::printf("  fetched per draw     %10s %10s\n", "full", "compressed");
+    std::printf("    as loaded          %10zu %10zu bytes, ACMR %.3f\n", loaded.fullBytes, loaded.compressedBytes, loaded.cache.acmr);
+    std::printf("    optimized          %10zu %10zu bytes, ACMR %.3f\n", optimized.fullBytes, optimized.compressedBytes, optimized.cache.acmr);
+    std::printf("    as loaded / optimized compressed: %.2fx\n", double(loaded.fullBytes) / double(optimized.compressedBytes));
+}
+
+int main()
+{
+    TestMesh teapot;
+    if (!LoadTeapot(teapot))
+    {
+        std::printf("teapot.obj not found in %s\n", ENGINE_DIR);
+        return 1;
+    }
+    Compare("teapot.obj", teapot);
+
+    TestMesh sphere = MakeSphere(250, 500);
+    ShuffleTriangles(sphere.indices, 2);
+    Compare("UV sphere, shuffled", sphere);
+
+    TestMesh grid = MakeGrid(500);
+    ShuffleTriangles(grid.indices, 3);
+    Compare("grid, shuffled", grid);
+    return 0;
+}
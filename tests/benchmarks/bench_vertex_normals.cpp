@@ -0,0 +1,54 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "MeshOptimizer.h"
+#include "VertexNormals.h"
+#include "TestMeshes.h"
+
+// GenerateSmoothNormals throughput on a UV sphere OBJ without normals, loaded and welded the way the converter
+// does it: serial, then on the job system, with the angle to the analytic normal and whether both runs agree.
+// usage: bench_vertex_normals [rings, default 512 for about 1M triangles]
+
+int main(int argc, char** argv)
+{
+    int rings = argc > 1 ? std::atoi(argv[1]) : 512;
+    WriteObjSphere("bench_vertex_normals.obj", rings, rings * 2, 0.0f);
+    TestMesh source;
+    bool loaded = LoadObjMesh("bench_vertex_normals.obj", false, source);
+    std::remove("bench_vertex_normals.obj");
+    if (!loaded)
+    {
+        std::printf("could not load the sphere\n");
+        return 1;
+    }
+    WeldVertices(source.vertices, source.indices);
+
+    TestMesh serial = source;
+    Stopwatch timer;
+    NormalStatistics statistics = GenerateSmoothNormals(serial.vertices, serial.indices, 60.0f);
+    double serialMs = timer.Milliseconds();
+    double maxError = 0.0;
+    for (const TestVertex& v : serial.vertices)
+    {
+        double length = std::sqrt(double(v.pos.x) * v.pos.x + double(v.pos.y) * v.pos.y + double(v.pos.z) * v.pos.z);
+        double cosine = (v.normal.x * v.pos.x + v.normal.y * v.pos.y + v.normal.z * v.pos.z) / length;
+        maxError = std::max(maxError, std::acos(std::min(1.0, cosine)) * 180.0 / 3.14159265358979);
+    }
+    std::printf("serial: %zu triangles, %zu vertices, %zu positions in %.1f ms, %.1f M triangles/s, max error %.4f deg\n",
+        statistics.smoothedTriangles, source.vertices.size(), statistics.positions, serialMs,
+        statistics.smoothedTriangles / serialMs / 1000.0, maxError);
+
+    unsigned int workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    JobSystem jobSystem;
+    jobSystem.Init(std::max(workers, 1u));
+    TestMesh parallel = source;
+    timer.Restart();
+    GenerateSmoothNormals(parallel.vertices, parallel.indices, 60.0f, &jobSystem);
+    double parallelMs = timer.Milliseconds();
+    bool identical = parallel.vertices.size() == serial.vertices.size() && parallel.indices == serial.indices &&
+        std::memcmp(parallel.vertices.data(), serial.vertices.data(), serial.vertices.size() * sizeof(TestVertex)) == 0;
+    std::printf("job system, %zu threads: %.1f ms (%.2fx serial), %s\n", jobSystem.ThreadCount(), parallelMs, serialMs / parallelMs,
+        identical ? "identical to serial" : "differs from serial");
+    jobSystem.Shutdown();
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include <thread>
+#include <random>
+#include "BindlessDescriptors.h"
+#include "TestCheck.h"
+
+// DescriptorIndexAllocator and BindlessDescriptorHeap: the free list hands every index out once, threads
+// allocating and freeing at the same time never get an index another thread holds, persistent frees wait
+// for their frame and every frame slot gets its own dynamic slice.
+
+static void TestExhaustAndRefill()
+{
+    DescriptorIndexAllocator allocator;
+    allocator.Init(1000);
+    std::vector<char> seen(1000, 0);
+    bool unique = true;
+    for (int i = 0; i < 1000; ++i)
+    {
+        uint32_t index = allocator.Allocate();
+        unique = unique && index < 1000 && !seen[index];
+        seen[std::min(index, 999u)] = 1;
+    }
+    CHECK(unique);
+    CHECK(allocator.Allocate() == InvalidDescriptorIndex);
+    CHECK(allocator.AllocatedCount() == 1000);
+
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        allocator.Free(i);
+    }
+    CHECK(allocator.AllocatedCount() == 0);
+    CHECK(allocator.Allocate() != InvalidDescriptorIndex);
+}
+
+static void TestConcurrentOwnership()
+{
+    // few indices and many threads, so the free list head changes under every compare exchange
+    DescriptorIndexAllocator allocator;
+    allocator.Init(256);
+    std::vector<std::atomic<int>> owners(256);
+    for (std::atomic<int>& owner : owners)
+    {
+        owner = 0;
+    }
+    std::atomic<int> doubleAllocations(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            std::mt19937 random(t);
+            std::vector<uint32_t> held;
+            for (int i = 0; i < 200000; ++i)
+            {
+                if (held.size() < 40 && (random() & 1))
+                {
+                    uint32_t index = allocator.Allocate();
+                    if (index == InvalidDescriptorIndex)
+                    {
+                        continue;
+                    }
+                    doubleAllocations += owners[index].exchange(1) != 0 ? 1 : 0;
+                    held.push_back(index);
+                }
+                else if (!held.empty())
+                {
+                    owners[held.back()] = 0;
+                    allocator.Free(held.back());
+                    held.pop_back();
+                }
+            }
+            for (uint32_t index : held)
+            {
+                owners[index] = 0;
+                allocator.Free(index);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(doubleAllocations.load() == 0);
+    CHECK(allocator.AllocatedCount() == 0);
+}
+
+static void TestHeap()
+{
+    // 4 persistent descriptors, 3 frames of 8 dynamic ones
+    BindlessDescriptorHeap heap;
+    heap.Init(4, 3, 8);
+    CHECK(heap.Capacity() == 4 + 3 * 8);
+    uint32_t persistent[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        persistent[i] = heap.AllocatePersistent();
+    }
+    CHECK(heap.AllocatePersistent() == InvalidDescriptorIndex);
+
+    // freed in frame 1, reused once frame 1 completed
+    heap.BeginFrame(0, 0);
+    heap.FreePersistent(persistent[2], 1);
+    CHECK(heap.Statistics().pendingFrees == 1);
+    heap.BeginFrame(1, 0);
+    CHECK(heap.AllocatePersistent() == InvalidDescriptorIndex);
+    heap.BeginFrame(2, 1);
+    CHECK(heap.Statistics().pendingFrees == 0);
+    CHECK(heap.AllocatePersistent() == persistent[2]);
+
+    // slot 2's slice follows the persistent part and slots 0 and 1
+    CHECK(heap.AllocateDynamic(5) == 4 + 16);
+    CHECK(heap.AllocateDynamic(3) == 4 + 21);
+    CHECK(heap.AllocateDynamic(1) == InvalidDescriptorIndex);
+    heap.BeginFrame(0, 2);
+    CHECK(heap.AllocateDynamic(8) == 4);
+    // the slot comes around again, its slice starts over
+    heap.BeginFrame(2, 3);
+    CHECK(heap.AllocateDynamic(2) == 4 + 16);
+
+    BindlessStatistics statistics = heap.Statistics();
+    CHECK(statistics.dynamicPeak == 8 && statistics.dynamicPerFrame == 8);
+    CHECK(statistics.dynamicOverflows == 1);
+    CHECK(statistics.persistentAllocated == 4 && statistics.persistentCapacity == 4);
+}
+
+static void TestDynamicFromThreads()
+{
+    // recording threads carve ranges out of the same slice, the ranges never overlap
+    BindlessDescriptorHeap heap;
+    heap.Init(16, 2, 4096);
+    heap.BeginFrame(1, 0);
+    std::vector<std::atomic<int>> used(heap.Capacity());
+    for (std::atomic<int>& slot : used)
+    {
+        slot = 0;
+    }
+    std::atomic<int> overlaps(0);
+    std::atomic<int> outside(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (uint32_t count = 1 + t; ; count = 1 + (count * 7) % 13)
+            {
+                uint32_t first = heap.AllocateDynamic(count);
+                if (first == InvalidDescriptorIndex)
+                {
+                    break;
+                }
+                outside += first < 16 + 4096 || first + count > 16 + 2 * 4096 ? 1 : 0;
+                for (uint32_t i = first; i < first + count && i < used.size(); ++i)
+                {
+                    overlaps += used[i].exchange(1) != 0 ? 1 : 0;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(overlaps.load() == 0);
+    CHECK(outside.load() == 0);
+    CHECK(heap.Statistics().dynamicOverflows == 4);
+}
+
+int main()
+{
+    TestExhaustAndRefill();
+    TestConcurrentOwnership();
+    TestHeap();
+    TestDynamicFromThreads();
+    return TestResult();
+}
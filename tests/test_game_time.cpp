@@ -0,0 +1,235 @@
+#include <cstring>
+#include <random>
+#include <functional>
+#include "GameTime.h"
+#include "CameraController.h"
+#include "TestCheck.h"
+
+// FixedTimestep and CameraController on simulated frame times. Ten seconds of held keys end in the same
+// camera pose, bit for bit, at 60 fps, at 500 fps, at random frame times and with 200 ms hitches, and the
+// drawn state lags the wall clock by exactly one step. Mouse look that arrives per frame lands on a
+// different step at each rate but turns the view by the same angle. A still camera reports no new poses.
+
+static const int64_t Second = 1000000000;
+
+struct RunResult
+{
+    CameraPose pose;
+    float spin;
+    uint64_t steps;
+    int poses;
+    double maxDrawnError;
+};
+
+// keys held for the first 360 steps, each step sees the keys as they were at its simulated time
+static RunResult Run(const std::function<int64_t()>& frameNanoseconds, CameraMode mode, bool mouseLook)
+{
+    const int64_t Duration = 10 * Second;
+    const float SpinSpeed = 0.18f;
+    FixedTimestep timestep;
+    CameraController camera;
+    float eye[3] = { 0.0f, 2.0f, -40.0f };
+    float target[3] = { 0.0f, 0.0f, 0.0f };
+    camera.SetLookAt(eye, target);
+    camera.SetMode(mode);
+
+    RunResult result = {};
+    CameraInput input = {};
+    float previousSpin = 0.0f;
+    for (int64_t time = 0; time < Duration;)
+    {
+        int64_t frame = std::min(frameNanoseconds(), Duration - time);
+        time += frame;
+        // mouse look for the first 3 seconds, the frame's share of it
+        int64_t looked = std::min(time, 3 * Second) - (time - frame);
+        if (mouseLook && looked > 0)
+        {
+            input.lookYaw += float(0.4 * looked * 1e-9);
+        }
+        uint32_t steps = timestep.Advance(frame);
+        for (uint32_t i = 0; i < steps; ++i)
+        {
+            bool held = timestep.TotalSteps() - steps + i < 360;
+            input.move[0] = held ? 1.0f : 0.0f;
+            input.move[2] = held ? 1.0f : 0.0f;
+            previousSpin = result.spin;
+            result.spin += SpinSpeed * timestep.StepSeconds();
+            camera.Step(input, timestep.StepSeconds());
+        }
+        // what the renderer draws against the continuous spin a step behind the wall clock
+        double drawn = previousSpin + (result.spin - previousSpin) * timestep.Alpha();
+        double expected = SpinSpeed * (double(time) * 1e-9 - timestep.StepSeconds());
+        if (time > Second / 10)
+        {
+            result.maxDrawnError = std::max(result.maxDrawnError, std::fabs(drawn - expected));
+        }
+        CameraPose pose;
+        result.poses += camera.Interpolate(timestep.Alpha(), pose) ? 1 : 0;
+    }
+    result.pose = camera.CurrentPose();
+    result.steps = timestep.TotalSteps();
+    return result;
+}
+
+static void ViewDirection(const CameraPose& pose, float* direction)
+{
+    float length = 0.0f;
+    for (int k = 0; k < 3; ++k)
+    {
+        direction[k] = pose.target[k] - pose.eye[k];
+        length += direction[k] * direction[k];
+    }
+    length = std::sqrt(length);
+    for (int k = 0; k < 3; ++k)
+    {
+        direction[k] /= length;
+    }
+}
+
+static void TestFrameRates()
+{
+    const CameraMode Modes[] = { CameraMode::FreeFly, CameraMode::Orbit };
+    for (CameraMode mode : Modes)
+    {
+        for (int mouseLook = 0; mouseLook < 2; ++mouseLook)
+        {
+            std::mt19937 random(7);
+            std::vector<RunResult> results;
+            results.push_back(Run([] { return Second / 60; }, mode, mouseLook != 0));
+            results.push_back(Run([] { return Second / 500; }, mode, mouseLook != 0));
+            results.push_back(Run([&] { return int64_t(1000000 + random() % 39000000); }, mode, mouseLook != 0));
+            results.push_back(Run([&] { return random() % 100 < 2 ? Second / 5 : 7000000; }, mode, mouseLook != 0));
+
+            const RunResult& reference = results[0];
+            int differentSteps = 0;
+            int differentPoses = 0;
+            int differentDirections = 0;
+            double maxDrawnError = 0.0;
+            for (const RunResult& result : results)
+            {
+                differentSteps += result.steps != 1200 || result.spin != reference.spin ? 1 : 0;
+                differentPoses += std::memcmp(&result.pose, &reference.pose, sizeof(CameraPose)) != 0 ? 1 : 0;
+                float direction[3], referenceDirection[3];
+                ViewDirection(result.pose, direction);
+                ViewDirection(reference.pose, referenceDirection);
+                float cosine = direction[0] * referenceDirection[0] + direction[1] * referenceDirection[1] + direction[2] * referenceDirection[2];
+                differentDirections += cosine < 1.0f - 1e-6f ? 1 : 0;
+                maxDrawnError = std::max(maxDrawnError, result.maxDrawnError);
+            }
+            CHECK(differentSteps == 0);
+            // keys are sampled per step, mouse look per frame: the look lands on other steps, the path differs
+            CHECK(mouseLook ? differentPoses > 0 : differentPoses == 0);
+            CHECK(differentDirections == 0);
+            CHECK(maxDrawnError < 1e-4);
+            // a pose for every frame while moving, 500 fps draws more of them than 60 fps
+            CHECK(results[1].poses > results[0].poses && results[0].poses > 180);
+        }
+    }
+}
+
+static void TestFixedTimestep()
+{
+    FixedTimestep timestep(10, 100);
+    CHECK(timestep.Advance(25) == 2 && std::fabs(timestep.Alpha() - 0.5f) < 1e-6f);
+    CHECK(timestep.Advance(5) == 1 && timestep.Alpha() == 0.0f);
+    // a stall counts for maxFrameNanoseconds, a clock that went backwards for nothing
+    CHECK(timestep.Advance(1000) == 10);
+    CHECK(timestep.Advance(-50) == 0 && timestep.TotalSteps() == 13);
+
+    // frames of any lengths that add up to the same time run the same steps
+    FixedTimestep even;
+    FixedTimestep uneven;
+    std::mt19937 random(3);
+    int64_t time = 0;
+    uint64_t unevenSteps = 0;
+    while (time < 60 * Second)
+    {
+        int64_t frame = 1 + random() % 30000000;
+        time += frame;
+        unevenSteps += uneven.Advance(frame);
+    }
+    uint64_t evenSteps = 0;
+    for (int64_t left = time; left > 0; left -= Second / 10)
+    {
+        evenSteps += even.Advance(std::min(left, Second / 10));
+    }
+    CHECK(evenSteps == unevenSteps && even.Alpha() == uneven.Alpha());
+    CHECK(unevenSteps == uint64_t(time / (Second / 120)));
+}
+
+static void TestCamera()
+{
+    // a still camera reports the pose it was set to, and the one after a look, nothing else
+    FixedTimestep timestep;
+    CameraController camera;
+    float eye[3] = { 0.0f, 0.0f, -5.0f };
+    float target[3] = { 0.0f, 0.0f, 0.0f };
+    camera.SetLookAt(eye, target);
+    CameraInput input = {};
+    CameraPose pose;
+    int poses = 0;
+    for (int frame = 0; frame < 1000; ++frame)
+    {
+        uint32_t steps = timestep.Advance(Second / 60);
+        for (uint32_t i = 0; i < steps; ++i)
+        {
+            camera.Step(input, timestep.StepSeconds());
+        }
+        input.lookYaw = frame == 500 ? 0.1f : 0.0f;
+        poses += camera.Interpolate(timestep.Alpha(), pose) ? 1 : 0;
+    }
+    CameraPose current = camera.CurrentPose();
+    CHECK(poses == 2 && std::memcmp(&current, &pose, sizeof(CameraPose)) == 0);
+
+    // a move that starts and ends within one frame's steps is still reported
+    CameraController tap;
+    tap.SetLookAt(eye, target);
+    CHECK(tap.Interpolate(0.0f, pose) && !tap.Interpolate(0.0f, pose));
+    CameraInput move = {};
+    move.move[2] = 1.0f;
+    tap.Step(move, 0.01f);
+    move.move[2] = 0.0f;
+    tap.Step(move, 0.01f);
+    CHECK(tap.Interpolate(0.5f, pose) && std::fabs(pose.eye[2] - (-5.0f + 0.1f)) < 1e-5f);
+    CHECK(!tap.Interpolate(0.5f, pose));
+
+    // switching modes keeps the view where it is
+    CameraController modes;
+    float otherEye[3] = { 1.0f, 2.0f, -5.0f };
+    float otherTarget[3] = { 0.0f, 0.0f, 3.0f };
+    modes.SetLookAt(otherEye, otherTarget);
+    CameraPose freeFly = modes.CurrentPose();
+    modes.SetMode(CameraMode::Orbit);
+    CameraPose orbit = modes.CurrentPose();
+    float maxError = 0.0f;
+    for (int k = 0; k < 3; ++k)
+    {
+        maxError = std::max(maxError, std::fabs(freeFly.eye[k] - otherEye[k]) + std::fabs(freeFly.target[k] - otherTarget[k]));
+        maxError = std::max(maxError, std::fabs(orbit.eye[k] - otherEye[k]) + std::fabs(orbit.target[k] - otherTarget[k]));
+    }
+    CHECK(maxError < 1e-5f);
+
+    // orbiting keeps the distance to the target
+    CameraInput orbitInput = {};
+    orbitInput.move[0] = 1.0f;
+    for (int i = 0; i < 120; ++i)
+    {
+        modes.Step(orbitInput, 1.0f / 120.0f);
+    }
+    CameraPose orbited = modes.CurrentPose();
+    float distance = 0.0f;
+    for (int k = 0; k < 3; ++k)
+    {
+        distance += (orbited.eye[k] - otherTarget[k]) * (orbited.eye[k] - otherTarget[k]);
+    }
+    CHECK(std::fabs(std::sqrt(distance) - std::sqrt(1.0f + 4.0f + 64.0f)) < 1e-4f);
+    CHECK(std::memcmp(orbited.target, orbit.target, sizeof(orbit.target)) == 0);
+}
+
+int main()
+{
+    TestFixedTimestep();
+    TestFrameRates();
+    TestCamera();
+    return TestResult();
+}
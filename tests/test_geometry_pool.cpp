@@ -0,0 +1,176 @@
+#include <cstring>
+#include <random>
+#include "GeometryPool.h"
+#include "TestCheck.h"
+
+// GeometryPool on CPU side copies of the megabuffers. Every mesh's vertices and indices are filled with a
+// pattern of its own, compaction copies the bytes the way the renderer does on the GPU, and every live mesh
+// has to read back its pattern at its new range.
+
+static void TestScripted()
+{
+    GeometryPool pool;
+    pool.Init(1000, 32, 3000, 2);
+    CHECK(pool.VertexBufferSize() == 32000 && pool.IndexBufferSize() == 6000);
+
+    uint32_t a = pool.Allocate(100, 300);
+    uint32_t b = pool.Allocate(200, 600);
+    uint32_t c = pool.Allocate(300, 900);
+    GeometryRange rangeB = pool.Range(b);
+    CHECK(rangeB.vertexCount == 200 && rangeB.indexCount == 600);
+    CHECK(pool.VertexOffset(b) == rangeB.firstVertex * 32ull && pool.IndexOffset(b) == rangeB.firstIndex * 2ull);
+
+    // the vertices fit but the indices do not, the vertex range is given back
+    CHECK(pool.Allocate(100, 2000) == InvalidAllocation);
+    CHECK(pool.Statistics().verticesUsed == 600 && pool.Statistics().meshes == 3);
+
+    // a hole in front, b and c move down by a's size in one merged copy each
+    pool.Free(a);
+    GeometryPoolStatistics before = pool.Statistics();
+    CHECK(before.meshes == 2 && before.verticesUsed == 500 && before.indicesUsed == 1500);
+    CHECK(before.fragmentation > 0.0);
+    GeometryRange oldB = pool.Range(b);
+    GeometryRange oldC = pool.Range(c);
+    std::vector<GeometryCopy> vertexCopies;
+    std::vector<GeometryCopy> indexCopies;
+    pool.Compact(vertexCopies, indexCopies);
+    CHECK(vertexCopies.size() == 1 && indexCopies.size() == 1);
+    CHECK(vertexCopies[0].sourceOffset == oldB.firstVertex * 32ull && vertexCopies[0].destinationOffset == 0);
+    CHECK(vertexCopies[0].size == 500 * 32ull && indexCopies[0].size == 1500 * 2ull);
+    CHECK(pool.Range(b).firstVertex == 0 && pool.Range(c).firstVertex == 200);
+    CHECK(pool.Range(c).vertexCount == oldC.vertexCount && pool.Range(c).firstIndex == 600);
+
+    GeometryPoolStatistics after = pool.Statistics();
+    CHECK(after.fragmentation == 0.0 && after.largestFreeVertices == 500 && after.largestFreeIndices == 1500);
+
+    // a freed handle is reused
+    uint32_t d = pool.Allocate(500, 1500);
+    CHECK(d == a);
+    CHECK(pool.Allocate(1, 3) == InvalidAllocation);
+}
+
+struct LiveMesh
+{
+    uint32_t handle;
+    uint32_t tag;
+};
+
+static void Fill(const GeometryPool& pool, const LiveMesh& mesh, std::vector<uint8_t>& vertexBuffer, std::vector<uint8_t>& indexBuffer)
+{
+    GeometryRange range = pool.Range(mesh.handle);
+    for (uint32_t i = 0; i < range.vertexCount; ++i)
+    {
+        uint32_t value = mesh.tag * 131 + i;
+        std::memcpy(&vertexBuffer[(uint64_t(range.firstVertex) + i) * pool.VertexStride()], &value, 4);
+    }
+    for (uint32_t i = 0; i < range.indexCount; ++i)
+    {
+        uint16_t value = uint16_t(mesh.tag * 7 + i);
+        std::memcpy(&indexBuffer[(uint64_t(range.firstIndex) + i) * pool.IndexSize()], &value, 2);
+    }
+}
+
+static bool Intact(const GeometryPool& pool, const LiveMesh& mesh, const std::vector<uint8_t>& vertexBuffer, const std::vector<uint8_t>& indexBuffer)
+{
+    GeometryRange range = pool.Range(mesh.handle);
+    for (uint32_t i = 0; i < range.vertexCount; ++i)
+    {
+        uint32_t value;
+        std::memcpy(&value, &vertexBuffer[(uint64_t(range.firstVertex) + i) * pool.VertexStride()], 4);
+        if (value != mesh.tag * 131 + i)
+        {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < range.indexCount; ++i)
+    {
+        uint16_t value;
+        std::memcpy(&value, &indexBuffer[(uint64_t(range.firstIndex) + i) * pool.IndexSize()], 2);
+        if (value != uint16_t(mesh.tag * 7 + i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void TestRandomCompaction()
+{
+    const uint32_t VertexCapacity = 1 << 22;
+    const uint32_t IndexCapacity = 1 << 23;
+    GeometryPool pool;
+    pool.Init(VertexCapacity, 32, IndexCapacity, 2);
+    std::vector<uint8_t> vertexBuffer(pool.VertexBufferSize());
+    std::vector<uint8_t> indexBuffer(pool.IndexBufferSize());
+
+    std::mt19937 random(11);
+    std::vector<LiveMesh> live;
+    uint32_t tag = 1;
+    int compactions = 0;
+    int damaged = 0;
+    int notPacked = 0;
+    for (int round = 0; round < 40; ++round)
+    {
+        for (int k = 0; k < 400; ++k)
+        {
+            if (live.empty() || random() % 100 < 55)
+            {
+                LiveMesh mesh = { pool.Allocate(1 + random() % 20000, 3 * (1 + random() % 20000)), tag++ };
+                if (mesh.handle != InvalidAllocation)
+                {
+                    Fill(pool, mesh, vertexBuffer, indexBuffer);
+                    live.push_back(mesh);
+                }
+            }
+            else
+            {
+                size_t freed = random() % live.size();
+                pool.Free(live[freed].handle);
+                live[freed] = live.back();
+                live.pop_back();
+            }
+        }
+
+        GeometryPoolStatistics before = pool.Statistics();
+        if (before.fragmentation > 0.5)
+        {
+            // the copies of the GPU compaction: from the old buffers into new ones
+            std::vector<GeometryCopy> vertexCopies;
+            std::vector<GeometryCopy> indexCopies;
+            pool.Compact(vertexCopies, indexCopies);
+            std::vector<uint8_t> newVertexBuffer(vertexBuffer.size());
+            std::vector<uint8_t> newIndexBuffer(indexBuffer.size());
+            for (const GeometryCopy& copy : vertexCopies)
+            {
+                std::memcpy(&newVertexBuffer[copy.destinationOffset], &vertexBuffer[copy.sourceOffset], copy.size);
+            }
+            for (const GeometryCopy& copy : indexCopies)
+            {
+                std::memcpy(&newIndexBuffer[copy.destinationOffset], &indexBuffer[copy.sourceOffset], copy.size);
+            }
+            vertexBuffer.swap(newVertexBuffer);
+            indexBuffer.swap(newIndexBuffer);
+
+            GeometryPoolStatistics after = pool.Statistics();
+            notPacked += after.fragmentation != 0.0 || after.meshes != before.meshes || after.verticesUsed != before.verticesUsed ? 1 : 0;
+            notPacked += after.largestFreeVertices != after.vertexCapacity - after.verticesUsed ? 1 : 0;
+            notPacked += after.largestFreeIndices != after.indexCapacity - after.indicesUsed ? 1 : 0;
+            compactions++;
+        }
+        for (const LiveMesh& mesh : live)
+        {
+            damaged += Intact(pool, mesh, vertexBuffer, indexBuffer) ? 0 : 1;
+        }
+    }
+    CHECK(damaged == 0);
+    CHECK(notPacked == 0);
+    CHECK(compactions > 10);
+    std::printf("%d compactions, %zu live meshes at the end\n", compactions, live.size());
+}
+
+int main()
+{
+    TestScripted();
+    TestRandomCompaction();
+    return TestResult();
+}
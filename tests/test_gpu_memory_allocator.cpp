@@ -0,0 +1,193 @@
+#include <map>
+#include <random>
+#include "GpuMemoryAllocator.h"
+#include "TestCheck.h"
+
+// TlsfAllocator under random allocations and frees of mixed sizes and alignments, every range checked
+// against its neighbours, then GpuMemoryAllocator pools on fake heaps: blocks are added as they fill up,
+// large requests get a heap of their own and empty heaps are released.
+
+static void TestRandomRanges()
+{
+    const uint64_t Capacity = 256ull << 20;
+    TlsfAllocator allocator;
+    allocator.Init(Capacity, 256);
+
+    std::mt19937_64 random(7);
+    // offset -> size and handle of every live range
+    std::map<uint64_t, std::pair<uint64_t, uint32_t>> live;
+    int misaligned = 0;
+    int overlapping = 0;
+    int failed = 0;
+    for (int i = 0; i < 2000000; ++i)
+    {
+        if (live.empty() || random() % 100 < 52)
+        {
+            // mostly up to 64 KB, one in ten up to 4 MB, alignments from 256 B to 64 KB
+            uint64_t size = 1 + random() % (random() % 10 == 0 ? (4 << 20) : (64 << 10));
+            uint64_t alignment = 1ull << (8 + random() % 9);
+            TlsfAllocation range;
+            if (!allocator.Allocate(size, alignment, range))
+            {
+                failed++;
+                continue;
+            }
+            misaligned += range.offset % alignment != 0 || range.size < size || range.offset + range.size > Capacity ? 1 : 0;
+            std::map<uint64_t, std::pair<uint64_t, uint32_t>>::iterator next = live.lower_bound(range.offset);
+            if (next != live.end() && range.offset + range.size > next->first)
+            {
+                overlapping++;
+            }
+            if (next != live.begin() && std::prev(next)->first + std::prev(next)->second.first > range.offset)
+            {
+                overlapping++;
+            }
+            live[range.offset] = std::make_pair(range.size, range.handle);
+        }
+        else
+        {
+            // free one of the lowest ranges, the rest of the heap stays busy and fragments
+            std::map<uint64_t, std::pair<uint64_t, uint32_t>>::iterator freed = live.begin();
+            std::advance(freed, random() % std::min<size_t>(live.size(), 64));
+            allocator.Free(freed->second.second);
+            live.erase(freed);
+        }
+    }
+    CHECK(misaligned == 0);
+    CHECK(overlapping == 0);
+
+    uint64_t used = 0;
+    for (const auto& range : live)
+    {
+        used += range.second.first;
+    }
+    CHECK(used == allocator.UsedSize());
+    CHECK(allocator.AllocationCount() == live.size());
+    std::printf("%zu live ranges, %d allocations did not fit, fragmentation %.3f over %u free blocks\n",
+        live.size(), failed, allocator.Fragmentation(), allocator.FreeBlockCount());
+
+    // every free block merges with its neighbours again
+    for (const auto& range : live)
+    {
+        allocator.Free(range.second.second);
+    }
+    CHECK(allocator.UsedSize() == 0 && allocator.Empty());
+    CHECK(allocator.FreeBlockCount() == 1);
+    CHECK(allocator.LargestFreeBlock() == Capacity);
+    CHECK(allocator.Fragmentation() == 0.0);
+}
+
+static void TestExactFit()
+{
+    // granularity rounding and a heap filled to the last byte
+    TlsfAllocator allocator;
+    allocator.Init(1 << 20, 65536);
+    std::vector<TlsfAllocation> ranges(16);
+    for (TlsfAllocation& range : ranges)
+    {
+        CHECK(allocator.Allocate(1, 65536, range) && range.size == 65536);
+    }
+    TlsfAllocation extra;
+    CHECK(!allocator.Allocate(1, 256, extra));
+    allocator.Free(ranges[3].handle);
+    allocator.Free(ranges[4].handle);
+    // the two neighbours merged, 128 KB fit where they were
+    CHECK(allocator.Allocate(2 * 65536, 65536, extra) && extra.offset == ranges[3].offset);
+
+    // sizes between bin starts: the last block is found even though its bin starts below the request
+    TlsfAllocator odd;
+    odd.Init(1000, 1);
+    TlsfAllocation front;
+    TlsfAllocation rest;
+    CHECK(odd.Allocate(500, 1, front));
+    CHECK(odd.Allocate(500, 1, rest) && rest.offset == 500);
+    odd.Free(rest.handle);
+    odd.Free(front.handle);
+    // 988 bytes free at 12, 16 byte aligned 984 of them end exactly at the end of the block
+    CHECK(odd.Allocate(12, 1, front));
+    CHECK(odd.Allocate(984, 16, rest) && rest.offset == 16);
+    CHECK(odd.FreeBlockCount() == 1 && odd.LargestFreeBlock() == 4);
+}
+
+struct FakeHeap
+{
+    uint32_t category;
+    uint64_t size;
+};
+
+static int liveHeaps = 0;
+
+struct FakeTraits
+{
+    typedef FakeHeap Heap;
+    static uint64_t Granularity(uint32_t category) { return category == GpuMemoryUpload ? 256 : 65536; }
+    static FakeHeap* CreateHeap(uint32_t category, uint64_t size)
+    {
+        liveHeaps++;
+        return new FakeHeap{ category, size };
+    }
+    static void DestroyHeap(FakeHeap* heap)
+    {
+        liveHeaps--;
+        delete heap;
+    }
+};
+
+static void TestPools()
+{
+    {
+        GpuMemoryAllocator<FakeTraits> pools;
+        pools.Init(32 << 20);
+        std::vector<GpuAllocation> buffers(100);
+        for (GpuAllocation& buffer : buffers)
+        {
+            CHECK(pools.Allocate(GpuMemoryBuffers, 1 << 20, 65536, buffer));
+        }
+        // 100 MB of buffers in 32 MB heaps
+        GpuMemoryStatistics statistics = pools.Statistics(GpuMemoryBuffers);
+        CHECK(statistics.blocks == 4 && statistics.allocations == 100);
+        CHECK(statistics.used == 100ull << 20 && statistics.reserved == 128ull << 20);
+
+        // larger than a block, 4 MB aligned like an MSAA texture
+        GpuAllocation texture;
+        CHECK(pools.Allocate(GpuMemoryTextures, 100 << 20, 4 << 20, texture));
+        CHECK(texture.offset % (4 << 20) == 0);
+        CHECK(pools.HeapOf(texture)->size >= (100u << 20) && pools.HeapOf(texture)->category == GpuMemoryTextures);
+        CHECK(liveHeaps == 5);
+
+        // ranges of one heap never overlap, categories never share one
+        bool apart = true;
+        for (size_t i = 1; i < buffers.size(); ++i)
+        {
+            const GpuAllocation& previous = buffers[i - 1];
+            apart = apart && (buffers[i].block != previous.block || buffers[i].offset >= previous.offset + previous.size);
+        }
+        CHECK(apart);
+        CHECK(pools.HeapOf(buffers[0]) != pools.HeapOf(texture));
+
+        for (GpuAllocation& buffer : buffers)
+        {
+            pools.Free(buffer);
+            CHECK(buffer.handle == InvalidAllocation);
+        }
+        pools.Free(texture);
+        // the last heap of a category stays
+        CHECK(pools.Statistics(GpuMemoryBuffers).blocks == 1 && pools.Statistics(GpuMemoryTextures).blocks == 1);
+        CHECK(liveHeaps == 2);
+
+        // a freed slot is reused before the pool grows
+        GpuAllocation reused;
+        CHECK(pools.Allocate(GpuMemoryBuffers, 40 << 20, 65536, reused));
+        CHECK(pools.Statistics(GpuMemoryBuffers).blocks == 2 && reused.block < 4);
+        pools.Free(reused);
+    }
+    CHECK(liveHeaps == 0);
+}
+
+int main()
+{
+    TestRandomRanges();
+    TestExactFit();
+    TestPools();
+    return TestResult();
+}
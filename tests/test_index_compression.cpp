@@ -0,0 +1,114 @@
+#include <random>
+#include "IndexCompression.h"
+#include "IndexFormat.h"
+#include "MeshOptimizer.h"
+#include "TestMeshes.h"
+#include "TestCheck.h"
+
+// The mesh asset's index codec and 16 bit conversion: streams decode to exactly what was encoded, from empty
+// buffers to deltas that wrap around 32 bits, truncated and corrupt streams are rejected, and a mesh too big
+// for 16 bit indices is split into submeshes whose indices plus baseVertex are the original indices.
+
+static bool RoundTrips(const std::vector<uint32_t>& indices)
+{
+    std::vector<unsigned char> encoded;
+    EncodeIndexBuffer(indices, encoded);
+    std::vector<uint32_t> decoded;
+    return DecodeIndexBuffer(encoded.data(), encoded.size(), indices.size(), decoded) && decoded == indices;
+}
+
+static void TestRoundTrip(const TestMesh& teapot)
+{
+    CHECK(RoundTrips({}));
+    CHECK(RoundTrips({ 0 }));
+    CHECK(RoundTrips(teapot.indices));
+
+    // the largest deltas in both directions, and a jump of exactly 2^31 that only fits as a wrapped delta
+    CHECK(RoundTrips({ 0, 0xFFFFFFFFu, 0, 0x7FFFFFFFu, 0x80000000u, 0, 0x80000000u, 0xFFFFFFFFu, 1 }));
+    std::mt19937 random(7);
+    std::vector<uint32_t> scattered(100000);
+    for (uint32_t& index : scattered)
+    {
+        index = uint32_t(random());
+    }
+    CHECK(RoundTrips(scattered));
+}
+
+static void TestCorrupt(const TestMesh& teapot)
+{
+    std::vector<unsigned char> encoded;
+    EncodeIndexBuffer(teapot.indices, encoded);
+    std::vector<uint32_t> decoded;
+    CHECK(DecodeIndexBuffer(encoded.data(), encoded.size(), teapot.indices.size(), decoded));
+
+    // every truncation runs out of bytes, also the one that only loses the last flushed byte
+    int accepted = 0;
+    for (size_t size = 0; size < encoded.size(); size += std::max<size_t>(1, size / 8))
+    {
+        accepted += DecodeIndexBuffer(encoded.data(), size, teapot.indices.size(), decoded) ? 1 : 0;
+    }
+    accepted += DecodeIndexBuffer(encoded.data(), encoded.size() - 1, teapot.indices.size(), decoded) ? 1 : 0;
+    CHECK(accepted == 0);
+
+    // asking for more indices than were written, and bytes that only ever continue a varint
+    CHECK(!DecodeIndexBuffer(encoded.data(), encoded.size(), teapot.indices.size() + 64, decoded));
+    std::vector<unsigned char> continuations(4096, 0xFF);
+    CHECK(!DecodeIndexBuffer(continuations.data(), continuations.size(), 16, decoded));
+}
+
+static void CheckSubmeshes(const std::vector<uint32_t>& indices, const std::vector<uint16_t>& indices16, const std::vector<Submesh>& submeshes)
+{
+    CHECK(indices16.size() == indices.size());
+    uint32_t next = 0;
+    int wrong = 0;
+    for (const Submesh& submesh : submeshes)
+    {
+        CHECK(submesh.startIndex == next && submesh.indexCount % 3 == 0);
+        for (uint32_t i = submesh.startIndex; i < submesh.startIndex + submesh.indexCount; ++i)
+        {
+            wrong += uint32_t(indices16[i] + submesh.baseVertex) != indices[i] ? 1 : 0;
+        }
+        next += submesh.indexCount;
+    }
+    CHECK(next == indices.size() && wrong == 0);
+}
+
+static void Test16Bit(const TestMesh& teapot)
+{
+    std::vector<uint16_t> indices16;
+    std::vector<Submesh> submeshes;
+    CHECK(ConvertTo16BitIndices(teapot.indices, 1, indices16, submeshes));
+    CHECK(submeshes.size() == 1 && submeshes[0].baseVertex == 0);
+    CheckSubmeshes(teapot.indices, indices16, submeshes);
+
+    // 601 * 601 vertices, rows of the grid are in first use order like after the vertex fetch pass
+    TestMesh grid = MakeGrid(600);
+    CHECK(grid.vertices.size() > 65536);
+    CHECK(ConvertTo16BitIndices(grid.indices, 64, indices16, submeshes));
+    CHECK(submeshes.size() > 1);
+    CheckSubmeshes(grid.indices, indices16, submeshes);
+
+    // one draw less than the split needs keeps 32 bit indices
+    size_t needed = submeshes.size();
+    CHECK(!ConvertTo16BitIndices(grid.indices, needed - 1, indices16, submeshes));
+    CHECK(indices16.empty() && submeshes.empty());
+    CHECK(ConvertTo16BitIndices(grid.indices, needed, indices16, submeshes) && submeshes.size() == needed);
+
+    // a single triangle whose vertices are further apart than 16 bits can not be drawn with any base vertex
+    CHECK(!ConvertTo16BitIndices({ 0, 1, 70000 }, 64, indices16, submeshes));
+    CHECK(indices16.empty() && submeshes.empty());
+}
+
+int main()
+{
+    TestMesh teapot;
+    CHECK(LoadTeapot(teapot));
+    WeldVertices(teapot.vertices, teapot.indices);
+    OptimizeVertexCache(teapot.indices, teapot.vertices.size());
+    OptimizeVertexFetch(teapot.vertices, teapot.indices);
+
+    TestRoundTrip(teapot);
+    TestCorrupt(teapot);
+    Test16Bit(teapot);
+    return TestResult();
+}
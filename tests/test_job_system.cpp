@@ -0,0 +1,133 @@
+#include <cmath>
+#include <memory>
+#include "JobSystem.h"
+#include "TestCheck.h"
+
+// JobSystem dependencies, submission from outside the scheduler and ParallelFor coverage, then a stress
+// run of many short waits on counters that are destroyed right after Wait returns. The target is built
+// with AddressSanitizer, a worker still touching a finished counter shows up as a use after free.
+
+static void TestDependencies(JobSystem& jobSystem)
+{
+    JobCounter first;
+    JobCounter second;
+    std::atomic<int> stage(0);
+    std::atomic<bool> ordered(true);
+    for (int i = 0; i < 100; ++i)
+    {
+        jobSystem.Run([&]() { stage.fetch_add(1); }, &first);
+    }
+    jobSystem.RunAfter(first, [&]()
+    {
+        ordered = ordered && stage.load() == 100;
+        stage.fetch_add(1000);
+    }, &second);
+    jobSystem.Wait(second);
+    CHECK(ordered);
+    CHECK(stage.load() == 1100);
+    CHECK(first.Done() && second.Done());
+
+    // a dependency that is already done starts the job right away
+    JobCounter third;
+    jobSystem.RunAfter(first, [&]() { stage.fetch_add(1); }, &third);
+    jobSystem.Wait(third);
+    CHECK(stage.load() == 1101);
+}
+
+static void TestExternalThread(JobSystem& jobSystem)
+{
+    JobCounter counter;
+    std::atomic<int> executed(0);
+    std::thread external([&]()
+    {
+        for (int i = 0; i < 10000; ++i)
+        {
+            jobSystem.Run([&]() { executed++; }, &counter);
+        }
+        jobSystem.Wait(counter);
+    });
+    external.join();
+    CHECK(executed.load() == 10000);
+}
+
+static void TestParallelFor(JobSystem& jobSystem)
+{
+    std::vector<int> hits(100003, 0);
+    jobSystem.ParallelFor(hits.size(), 7, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            hits[i]++;
+        }
+    });
+    CHECK(std::count(hits.begin(), hits.end(), 1) == int(hits.size()));
+
+    // nested loops wait inside jobs
+    std::vector<std::atomic<int>> rows(64);
+    for (std::atomic<int>& row : rows)
+    {
+        row = 0;
+    }
+    jobSystem.ParallelFor(rows.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            jobSystem.ParallelFor(1000, 16, [&](size_t b, size_t e) { rows[i].fetch_add(int(e - b)); });
+        }
+    });
+    bool complete = true;
+    for (std::atomic<int>& row : rows)
+    {
+        complete = complete && row.load() == 1000;
+    }
+    CHECK(complete);
+}
+
+static void TestShortWaits(JobSystem& jobSystem)
+{
+    const int Rounds = 20000;
+    int failures = 0;
+    for (int round = 0; round < Rounds; ++round)
+    {
+        // ParallelFor's counter lives on its stack frame
+        int hits[13] = {};
+        jobSystem.ParallelFor(13, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                hits[i]++;
+            }
+        });
+        failures += int(std::count(hits, hits + 13, 1) != 13);
+
+        // counters freed as soon as they are done, with a continuation handed off by the last job
+        std::unique_ptr<JobCounter> dependency(new JobCounter);
+        std::unique_ptr<JobCounter> done(new JobCounter);
+        std::atomic<int> executed(0);
+        for (int i = 0; i < 4; ++i)
+        {
+            jobSystem.Run([&]() { executed++; }, dependency.get());
+        }
+        jobSystem.RunAfter(*dependency, [&]() { executed += 100; }, done.get());
+        jobSystem.Wait(*done);
+        jobSystem.Wait(*dependency);
+        dependency.reset();
+        done.reset();
+        failures += int(executed.load() != 104);
+    }
+    CHECK(failures == 0);
+}
+
+int main()
+{
+    JobSystem jobSystem;
+    jobSystem.Init(7);
+
+    TestDependencies(jobSystem);
+    TestExternalThread(jobSystem);
+    TestParallelFor(jobSystem);
+    TestShortWaits(jobSystem);
+
+    jobSystem.Shutdown();
+    return TestResult();
+}
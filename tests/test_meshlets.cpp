@@ -0,0 +1,175 @@
+#include <array>
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "TestMeshes.h"
+#include "TestCheck.h"
+
+// BuildMeshlets and CullMeshlets on teapot.obj after the converter's passes, a sphere and a grid: meshlets stay
+// within the mesh shader limits, emit every source triangle exactly once through their local indices, bound
+// their vertices, and culling is conservative, no rejected meshlet has a front facing triangle in the frustum
+// for the views the converter reports (eight orbits and two close ups).
+
+struct MeshletMesh
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<unsigned char> triangles;
+};
+
+static MeshletMesh Build(const TestMesh& mesh)
+{
+    MeshletMesh result;
+    BuildMeshlets(mesh.indices.data(), mesh.indices.size(), &mesh.vertices[0].pos.x, mesh.vertices.size(), sizeof(TestVertex),
+        result.meshlets, result.vertices, result.triangles);
+    return result;
+}
+
+static std::array<uint32_t, 3> SourceTriangle(const MeshletMesh& mesh, const Meshlet& meshlet, uint32_t t)
+{
+    std::array<uint32_t, 3> triangle;
+    for (int k = 0; k < 3; ++k)
+    {
+        triangle[k] = mesh.vertices[meshlet.vertexOffset + mesh.triangles[meshlet.triangleOffset + t * 3 + k]];
+    }
+    return triangle;
+}
+
+static void TestLayout(const TestMesh& mesh)
+{
+    MeshletMesh result = Build(mesh);
+    CHECK(!result.meshlets.empty());
+    int overfull = 0;
+    int badLocalIndex = 0;
+    int outsideBounds = 0;
+    uint32_t nextVertex = 0;
+    uint32_t nextTriangle = 0;
+    std::vector<std::array<uint32_t, 3>> emitted;
+    for (const Meshlet& meshlet : result.meshlets)
+    {
+        overfull += meshlet.vertexCount > MeshletMaxVertices || meshlet.triangleCount > MeshletMaxTriangles ? 1 : 0;
+        CHECK(meshlet.vertexOffset == nextVertex && meshlet.triangleOffset == nextTriangle);
+        nextVertex += meshlet.vertexCount;
+        nextTriangle += meshlet.triangleCount * 3;
+        for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i)
+        {
+            badLocalIndex += result.triangles[meshlet.triangleOffset + i] >= meshlet.vertexCount ? 1 : 0;
+        }
+        for (uint32_t t = 0; t < meshlet.triangleCount && badLocalIndex == 0; ++t)
+        {
+            emitted.push_back(SourceTriangle(result, meshlet, t));
+        }
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            const TestFloat3& p = mesh.vertices[result.vertices[meshlet.vertexOffset + i]].pos;
+            float dx = p.x - meshlet.center[0], dy = p.y - meshlet.center[1], dz = p.z - meshlet.center[2];
+            outsideBounds += std::sqrt(dx * dx + dy * dy + dz * dz) > meshlet.radius * 1.0001f + 1e-6f ? 1 : 0;
+        }
+    }
+    CHECK(overfull == 0 && badLocalIndex == 0 && outsideBounds == 0);
+    CHECK(nextVertex == result.vertices.size() && nextTriangle == result.triangles.size());
+
+    // the same triangles with the same winding, each once
+    std::vector<std::array<uint32_t, 3>> source;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+        source.push_back({ { mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] } });
+    }
+    std::sort(source.begin(), source.end());
+    std::sort(emitted.begin(), emitted.end());
+    CHECK(emitted == source);
+}
+
+// front facing in the winding the normal cones use, a triangle whose normal points away from the camera is back facing
+static bool FrontFacing(const float* p0, const float* p1, const float* p2, const float* eye)
+{
+    float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float toTriangle[3] = { p0[0] - eye[0], p0[1] - eye[1], p0[2] - eye[2] };
+    return n[0] * toTriangle[0] + n[1] * toTriangle[1] + n[2] * toTriangle[2] < -1e-5f * length;
+}
+
+// not entirely behind one of the planes
+static bool InFrustum(const float planes[6][4], const float* p0, const float* p1, const float* p2)
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = planes[p];
+        if (plane[0] * p0[0] + plane[1] * p0[1] + plane[2] * p0[2] + plane[3] < 0 &&
+            plane[0] * p1[0] + plane[1] * p1[1] + plane[2] * p1[2] + plane[3] < 0 &&
+            plane[0] * p2[0] + plane[1] * p2[1] + plane[2] * p2[2] + plane[3] < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the views of the converter's report, scale 1 matches the teapot
+static void TestCulling(const TestMesh& mesh, float scale)
+{
+    MeshletMesh result = Build(mesh);
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (const TestVertex& v : mesh.vertices)
+    {
+        const float* p = &v.pos.x;
+        for (int k = 0; k < 3; ++k)
+        {
+            boundsMin[k] = std::min(boundsMin[k], p[k]);
+            boundsMax[k] = std::max(boundsMax[k], p[k]);
+        }
+    }
+    float center[3] = { (boundsMin[0] + boundsMax[0]) * 0.5f, (boundsMin[1] + boundsMax[1]) * 0.5f, (boundsMin[2] + boundsMax[2]) * 0.5f };
+
+    int culledFrontFacing = 0;
+    unsigned int culled = 0;
+    for (int view = 0; view < 10; ++view)
+    {
+        bool closeUp = view >= 8;
+        float angle = view * 3.14159265f / 4.0f;
+        float distance = (closeUp ? 12.0f : 41.0f) * scale;
+        float height = (closeUp ? 3.0f : 9.0f) * scale;
+        float eye[3] = { center[0] + distance * std::sin(angle), center[1] + height, center[2] - distance * std::cos(angle) };
+        float viewProjection[16];
+        MakeViewProjection(eye, center, 3.14f * (45.0f / 180.0f), 800.0f / 600.0f, 0.1f * scale, 1000.0f, viewProjection);
+        float planes[6][4];
+        ExtractFrustumPlanes(viewProjection, planes);
+
+        std::vector<bool> visible;
+        MeshletCullingStatistics stats = CullMeshlets(result.meshlets, planes, eye, &visible);
+        culled += stats.frustumCulledMeshlets + stats.backfaceCulledMeshlets;
+        for (size_t i = 0; i < result.meshlets.size(); ++i)
+        {
+            for (uint32_t t = 0; t < result.meshlets[i].triangleCount && !visible[i]; ++t)
+            {
+                std::array<uint32_t, 3> triangle = SourceTriangle(result, result.meshlets[i], t);
+                const float* p0 = &mesh.vertices[triangle[0]].pos.x;
+                const float* p1 = &mesh.vertices[triangle[1]].pos.x;
+                const float* p2 = &mesh.vertices[triangle[2]].pos.x;
+                culledFrontFacing += FrontFacing(p0, p1, p2, eye) && InFrustum(planes, p0, p1, p2) ? 1 : 0;
+            }
+        }
+    }
+    CHECK(culled > 0);
+    CHECK(culledFrontFacing == 0);
+}
+
+int main()
+{
+    TestMesh teapot;
+    CHECK(LoadTeapot(teapot));
+    WeldVertices(teapot.vertices, teapot.indices);
+    OptimizeVertexCache(teapot.indices, teapot.vertices.size());
+    OptimizeVertexFetch(teapot.vertices, teapot.indices);
+
+    TestMesh sphere = MakeSphere(48, 96);
+    TestMesh grid = MakeGrid(100);
+    TestLayout(teapot);
+    TestLayout(sphere);
+    TestLayout(grid);
+    TestCulling(teapot, 1.0f);
+    TestCulling(sphere, 0.1f);
+    return TestResult();
+}
@@ -0,0 +1,96 @@
+#include <sys/stat.h>
+#include <cstring>
+#include "OBJ_Loader.h"
+#include "ObjScene.h"
+#include "TestMeshes.h"
+#include "TestCheck.h"
+
+// objl::Loader's two ways of reading a file give the same meshes: LoadFile(Path) into LoadedMeshes and
+// LoadFile(Path, sink) into an ObjMeshCollector, which the converter uses. The scene has several groups, a
+// group name used twice, material switches inside a group, a material the .mtl file does not define,
+// polygons, negative indices and faces without normals.
+
+static const std::string Directory = "obj_loader_fixture/";
+
+static void WriteText(const std::string& path, const std::string& text)
+{
+    std::ofstream file(Directory + path, std::ios::binary | std::ios::trunc);
+    file << text;
+}
+
+static void WriteScene()
+{
+    mkdir(Directory.c_str(), 0755);
+    WriteText("scene.mtl",
+        "newmtl red\nKd 1 0 0\n"
+        "newmtl blue\nKd 0 0 1\nmap_Kd blue.png\n");
+    WriteText("scene.obj",
+        "mtllib scene.mtl\n"
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0 0 1\nv 1 0 1\nv 1 1 1\nv 0 1 1\n"
+        "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+        "vn 0 0 -1\nvn 0 0 1\n"
+        "g body\n"
+        "usemtl red\n"
+        "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+        "f 1/1/1 3/3/1 2/2/1\n"
+        "usemtl blue\n"
+        "f 5/1/2 6/2/2 7/3/2 8/4/2\n"
+        "g wheel\n"
+        "usemtl blue\n"
+        "f 1/1 2/2 6/2 7/3 5/4\n"
+        "usemtl missing\n"
+        "f 2 3 7\n"
+        "g body\n"
+        "usemtl red\n"
+        "f -3//-1 -2//-1 -1//-1\n"
+        "o last\n"
+        "f 4/4/2 3/3/2 7/3/2 8/4/2\n");
+}
+
+int main()
+{
+    WriteScene();
+    objl::Loader meshLoader;
+    CHECK(meshLoader.LoadFile(Directory + "scene.obj"));
+    objl::Loader sinkLoader;
+    ObjMeshCollector<TestVertex> collector(ConvertObjVertex);
+    CHECK(sinkLoader.LoadFile(Directory + "scene.obj", collector));
+
+    const std::vector<objl::Mesh>& meshes = meshLoader.LoadedMeshes;
+    CHECK(meshes.size() == 6 && collector.meshes.size() == meshes.size());
+    size_t vertexCount = 0;
+    int differentVertices = 0;
+    for (size_t i = 0; i < std::min(meshes.size(), collector.meshes.size()); ++i)
+    {
+        const objl::Mesh& mesh = meshes[i];
+        const ObjMeshCollector<TestVertex>::Mesh& collected = collector.meshes[i];
+        CHECK(collected.name == mesh.MeshName);
+        CHECK(collected.indices == std::vector<uint32_t>(mesh.Indices.begin(), mesh.Indices.end()));
+        CHECK(collected.vertices.size() == mesh.Vertices.size());
+        for (size_t v = 0; v < std::min(collected.vertices.size(), mesh.Vertices.size()); ++v)
+        {
+            TestVertex expected = ConvertObjVertex(mesh.Vertices[v]);
+            differentVertices += std::memcmp(&expected, &collected.vertices[v], sizeof(TestVertex)) != 0 ? 1 : 0;
+        }
+        vertexCount += mesh.Vertices.size();
+
+        // LoadedMeshes binds the material, a name the .mtl file does not define becomes the default material
+        if (collected.materialName == "missing")
+        {
+            CHECK(mesh.MeshMaterial.name.empty());
+        }
+        else
+        {
+            CHECK(collected.materialName == mesh.MeshMaterial.name);
+        }
+    }
+    CHECK(differentVertices == 0);
+    CHECK(collector.MaterialNames() == std::vector<std::string>({ "red", "blue", "blue", "missing", "red", "red" }));
+    CHECK(meshes.size() > 2 && meshes[2].MeshMaterial.map_Kd == "blue.png");
+
+    // both loaders read the same materials, LoadFile(Path) also keeps every vertex once more
+    CHECK(sinkLoader.LoadedMaterials.size() == 2 && meshLoader.LoadedMaterials.size() == 2);
+    CHECK(sinkLoader.LoadedMeshes.empty() && sinkLoader.LoadedVertices.empty());
+    CHECK(meshLoader.LoadedVertices.size() == vertexCount);
+    return TestResult();
+}
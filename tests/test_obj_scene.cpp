@@ -0,0 +1,92 @@
+#include <sys/stat.h>
+#include "ObjScene.h"
+#include "TestCheck.h"
+
+// The material table of an OBJ scene: meshes share the entry of their material in first use order, names the
+// MTL file does not define and empty names get the default material, texture maps are relative to the OBJ
+// file. The texture list has every file once, however many materials and slots use it.
+
+static const std::string Directory = "obj_scene_fixture/";
+
+static void WriteText(const std::string& path, const std::string& text)
+{
+    std::ofstream file(Directory + path, std::ios::binary | std::ios::trunc);
+    file << text;
+}
+
+static void TestMaterialTable()
+{
+    mkdir(Directory.c_str(), 0755);
+    WriteText("scene.mtl",
+        "newmtl red\nKd 1 0 0\nKs 0.5 0.5 0.5\nNs 0\nmap_Kd tex/red.png\n"
+        "newmtl blue\nKd 0 0 1\nNs 20\nmap_Kd /textures/blue.png\nmap_bump tex/normal.png\n");
+    objl::Loader loader;
+    CHECK(loader.LoadMaterialFile(Directory + "scene.mtl"));
+
+    MeshAssetMaterial defaultMaterial;
+    defaultMaterial.name = "ignored";
+    defaultMaterial.diffuseMap = "img.jpg";
+    std::vector<MeshAssetMaterial> materials;
+    std::vector<uint32_t> meshMaterials;
+    std::string directory = ObjDirectory(Directory + "scene.obj");
+    BuildObjMaterialTable(loader, { "red", "", "undefined", "blue", "red", "other", "" }, directory, defaultMaterial, materials,
+        meshMaterials);
+
+    // every undefined and empty name is the one default entry, which has no name
+    CHECK(meshMaterials == std::vector<uint32_t>({ 0, 1, 1, 2, 0, 1, 1 }));
+    CHECK(materials.size() == 3);
+    if (materials.size() == 3)
+    {
+        CHECK(materials[0].name == "red" && materials[0].diffuse[0] == 1.0f && materials[0].specular[1] == 0.5f);
+        CHECK(materials[0].specularPower == MeshAssetMaterial().specularPower);
+        CHECK(materials[0].diffuseMap == Directory + "tex/red.png" && materials[0].bumpMap.empty());
+        CHECK(materials[1].name.empty() && materials[1].diffuseMap == "img.jpg");
+        CHECK(materials[2].name == "blue" && materials[2].specularPower == 20.0f);
+        CHECK(materials[2].diffuseMap == "/textures/blue.png" && materials[2].bumpMap == Directory + "tex/normal.png");
+    }
+
+    // a scene where no mesh has a material is the default material alone
+    BuildObjMaterialTable(loader, { "", "" }, directory, defaultMaterial, materials, meshMaterials);
+    CHECK(materials.size() == 1 && materials[0].name.empty() && meshMaterials == std::vector<uint32_t>({ 0, 0 }));
+
+    CHECK(ObjDirectory("scene.obj").empty() && ObjDirectory("a\\b/scene.obj") == "a\\b/");
+    CHECK(ObjTexturePath("dir/", "C:\\maps\\a.png") == "C:\\maps\\a.png" && ObjTexturePath("dir/", "").empty());
+}
+
+static MeshAssetMaterial TexturedMaterial(const std::string& diffuseMap, const std::string& bumpMap)
+{
+    MeshAssetMaterial material;
+    material.diffuseMap = diffuseMap;
+    material.bumpMap = bumpMap;
+    return material;
+}
+
+static void TestTextureList()
+{
+    std::vector<MeshAssetMaterial> materials = {
+        TexturedMaterial("maps/brick.png", "maps/brick_normal.png"),
+        TexturedMaterial("", ""),
+        TexturedMaterial("maps/brick.png", ""),
+        TexturedMaterial("maps/wood.png", "maps/brick_normal.png"),
+        TexturedMaterial("maps/brick.png", "maps/brick_normal.png"),
+        // the same file in the other slot is still one texture
+        TexturedMaterial("maps/brick_normal.png", "") };
+    std::vector<std::string> textures;
+    std::vector<uint32_t> diffuseTextures;
+    std::vector<uint32_t> bumpTextures;
+    BuildMaterialTextureList(materials, textures, diffuseTextures, bumpTextures);
+
+    CHECK(textures == std::vector<std::string>({ "maps/brick.png", "maps/brick_normal.png", "maps/wood.png" }));
+    CHECK(diffuseTextures == std::vector<uint32_t>({ 0, NoMaterialTexture, 0, 2, 0, 1 }));
+    CHECK(bumpTextures == std::vector<uint32_t>({ 1, NoMaterialTexture, NoMaterialTexture, 1, 1, NoMaterialTexture }));
+
+    BuildMaterialTextureList({}, textures, diffuseTextures, bumpTextures);
+    CHECK(textures.empty() && diffuseTextures.empty() && bumpTextures.empty());
+}
+
+int main()
+{
+    TestMaterialTable();
+    TestTextureList();
+    return TestResult();
+}
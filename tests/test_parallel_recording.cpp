@@ -0,0 +1,212 @@
+#include <thread>
+#include <mutex>
+#include <cstdint>
+#include "ParallelRecording.h"
+#include "TestCheck.h"
+
+// ParallelCommandRecorder against recording mock traits: the lists record draw indices, the allocators
+// count their resets, and every call is checked against the list's open/closed state.
+
+struct MockAllocator
+{
+    int resets = 0;
+    bool inUse = false;  // a list recording into it is open
+};
+
+struct MockList
+{
+    MockAllocator* allocator = nullptr;
+    std::vector<size_t> commands;
+    bool open = false;
+};
+
+struct MockTraits
+{
+    typedef MockAllocator Allocator;
+    typedef MockList CommandList;
+
+    static int created;
+    static int badCalls;
+    static bool failClose;
+
+    static bool Create(MockAllocator*& allocator, MockList*& list)
+    {
+        allocator = new MockAllocator;
+        list = new MockList;
+        list->allocator = allocator;
+        created++;
+        return true;
+    }
+
+    static bool Reset(MockAllocator* allocator, MockList* list)
+    {
+        if (list->open || allocator->inUse)
+        {
+            badCalls++;
+        }
+        allocator->resets++;
+        allocator->inUse = true;
+        list->commands.clear();
+        list->open = true;
+        return true;
+    }
+
+    static bool Close(MockList* list)
+    {
+        if (!list->open)
+        {
+            badCalls++;
+        }
+        list->open = false;
+        list->allocator->inUse = false;
+        return !failClose;
+    }
+
+    static void Destroy(MockAllocator* allocator, MockList* list)
+    {
+        delete allocator;
+        delete list;
+    }
+};
+
+int MockTraits::created = 0;
+int MockTraits::badCalls = 0;
+bool MockTraits::failClose = false;
+
+static const size_t FrameBegin = SIZE_MAX;
+static const size_t FrameEnd = SIZE_MAX - 1;
+
+static void TestPartitionDraws()
+{
+    std::vector<DrawRange> ranges;
+    PartitionDraws(0, 4, 16, ranges);
+    CHECK(ranges.empty());
+
+    // fewer draws than one range needs still get a range
+    PartitionDraws(5, 4, 16, ranges);
+    CHECK(ranges.size() == 1 && ranges[0].first == 0 && ranges[0].count == 5);
+
+    PartitionDraws(1000, 4, 16, ranges);
+    CHECK(ranges.size() == 4);
+    size_t next = 0;
+    for (const DrawRange& range : ranges)
+    {
+        CHECK(range.first == next);
+        CHECK(range.count == 250);
+        next += range.count;
+    }
+
+    // the remainder goes to the first ranges, all of them keep the minimum
+    PartitionDraws(50, 8, 16, ranges);
+    CHECK(ranges.size() == 3);
+    CHECK(ranges[0].count == 17 && ranges[1].count == 17 && ranges[2].count == 16);
+}
+
+static void TestSubmissionOrder(JobSystem& jobSystem)
+{
+    const size_t FrameCount = 3;
+    ParallelCommandRecorder<MockTraits> recorder;
+    recorder.Init(FrameCount, 4, jobSystem);
+
+    std::mutex threadMutex;
+    std::vector<std::thread::id> recordingThreads;
+    size_t peakLists = 0;
+    for (size_t frame = 0; frame < 60; ++frame)
+    {
+        size_t drawCount = (frame * 37) % 500;
+        recorder.BeginFrame(frame % FrameCount);
+
+        MockList* begin = recorder.Acquire();
+        begin->commands.push_back(FrameBegin);
+        bool recorded = recorder.RecordParallel(drawCount, 16, [&](MockList* list, const DrawRange& range)
+        {
+            CHECK(list->open);
+            for (size_t i = range.first; i < range.first + range.count; ++i)
+            {
+                list->commands.push_back(i);
+                // let the workers finish out of order
+                std::this_thread::yield();
+            }
+            std::lock_guard<std::mutex> lock(threadMutex);
+            if (std::find(recordingThreads.begin(), recordingThreads.end(), std::this_thread::get_id()) == recordingThreads.end())
+            {
+                recordingThreads.push_back(std::this_thread::get_id());
+            }
+        });
+        CHECK(recorded);
+        MockList* end = recorder.Acquire();
+        end->commands.push_back(FrameEnd);
+
+        std::vector<size_t> stream;
+        size_t submitCalls = 0;
+        size_t listCount = 0;
+        bool submitted = recorder.Submit([&](MockList* const* lists, size_t count)
+        {
+            submitCalls++;
+            listCount = count;
+            for (size_t i = 0; i < count; ++i)
+            {
+                CHECK(!lists[i]->open);
+                stream.insert(stream.end(), lists[i]->commands.begin(), lists[i]->commands.end());
+            }
+        });
+        CHECK(submitted);
+        CHECK(submitCalls == 1);
+
+        // the concatenated lists are the single threaded command stream
+        CHECK(stream.size() == drawCount + 2);
+        CHECK(stream.front() == FrameBegin && stream.back() == FrameEnd);
+        bool ordered = true;
+        for (size_t i = 0; i < drawCount && i + 1 < stream.size(); ++i)
+        {
+            ordered = ordered && stream[i + 1] == i;
+        }
+        CHECK(ordered);
+
+        // the pool grows to the peak number of lists and is reused after that
+        peakLists = std::max(peakLists, listCount);
+        CHECK(recorder.PoolSize(frame % FrameCount) <= peakLists);
+    }
+    CHECK(peakLists == 6);
+    CHECK(MockTraits::created <= int(FrameCount * peakLists));
+    CHECK(MockTraits::badCalls == 0);
+    std::printf("60 frames, %d lists created, recorded on %zu threads\n", MockTraits::created, recordingThreads.size());
+    recorder.Destroy();
+}
+
+static void TestCloseFailure(JobSystem& jobSystem)
+{
+    ParallelCommandRecorder<MockTraits> recorder;
+    recorder.Init(1, 4, jobSystem);
+    recorder.BeginFrame(0);
+
+    MockTraits::failClose = true;
+    bool recorded = recorder.RecordParallel(100, 16, [](MockList* list, const DrawRange& range) { list->commands.push_back(range.first); });
+    MockTraits::failClose = false;
+    CHECK(!recorded);
+
+    // a frame with a failed list is not submitted
+    bool called = false;
+    CHECK(!recorder.Submit([&](MockList* const*, size_t) { called = true; }));
+    CHECK(!called);
+
+    // the next frame starts clean
+    recorder.BeginFrame(0);
+    CHECK(recorder.RecordParallel(100, 16, [](MockList* list, const DrawRange& range) { list->commands.push_back(range.first); }));
+    CHECK(recorder.Submit([&](MockList* const*, size_t count) { called = count == 4; }));
+    CHECK(called);
+    recorder.Destroy();
+}
+
+int main()
+{
+    JobSystem jobSystem;
+    jobSystem.Init(3);
+
+    TestPartitionDraws();
+    TestSubmissionOrder(jobSystem);
+    TestCloseFailure(jobSystem);
+
+    jobSystem.Shutdown();
+    return TestResult();
+}
@@ -0,0 +1,218 @@
+#include <thread>
+#include <fstream>
+#include "PipelineCache.h"
+#include "TestCheck.h"
+
+// PipelineHasher, the cache file and PipelineStateCache on fake traits: creating a pipeline takes a few
+// milliseconds and stores it in a fake library, so a second cache started from the library keys has to
+// load every pipeline and create none.
+
+struct FakeDesc
+{
+    const char* vertexShader;
+    int blendMode;
+};
+
+struct FakePipeline
+{
+    uint64_t key;
+};
+
+static uint64_t HashDesc(const FakeDesc& desc)
+{
+    PipelineHasher hasher;
+    hasher.AddString(desc.vertexShader);
+    hasher.AddValue(desc.blendMode);
+    return hasher.Hash();
+}
+
+static std::atomic<int> createCount(0);
+static std::atomic<int> storeCount(0);
+static std::vector<uint64_t> library;
+static std::mutex libraryMutex;
+
+struct FakeTraits
+{
+    typedef FakeDesc Desc;
+    typedef FakePipeline Pipeline;
+
+    static FakePipeline* Load(uint64_t key, const FakeDesc&)
+    {
+        std::lock_guard<std::mutex> lock(libraryMutex);
+        bool found = std::find(library.begin(), library.end(), key) != library.end();
+        return found ? new FakePipeline{ key } : nullptr;
+    }
+
+    static FakePipeline* Create(const FakeDesc& desc)
+    {
+        createCount++;
+        if (desc.blendMode < 0)
+        {
+            return nullptr;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        return new FakePipeline{ HashDesc(desc) };
+    }
+
+    static bool Store(uint64_t key, FakePipeline*)
+    {
+        std::lock_guard<std::mutex> lock(libraryMutex);
+        // the real library refuses a name twice
+        bool duplicate = std::find(library.begin(), library.end(), key) != library.end();
+        storeCount += duplicate ? 1000 : 1;
+        library.push_back(key);
+        return !duplicate;
+    }
+
+    static void Release(FakePipeline* pipeline) { delete pipeline; }
+};
+
+static void TestHasher()
+{
+    PipelineHasher joined;
+    PipelineHasher split;
+    joined.AddString("ab");
+    joined.AddString("c");
+    split.AddString("a");
+    split.AddString("bc");
+    CHECK(joined.Hash() != split.Hash());
+
+    PipelineHasher null;
+    PipelineHasher empty;
+    null.AddString(nullptr);
+    empty.AddString("");
+    CHECK(null.Hash() != empty.Hash());
+
+    // FNV-1a 64 reference value, the key has to be the same in every run and build
+    PipelineHasher hello;
+    hello.Add("hello", 5);
+    CHECK(hello.Hash() == 0xa430d84680aabd0bull);
+
+    FakeDesc first = { "vs0", 1 };
+    FakeDesc second = { "vs0", 2 };
+    CHECK(HashDesc(first) == HashDesc(FakeDesc{ "vs0", 1 }));
+    CHECK(HashDesc(first) != HashDesc(second));
+}
+
+static void TestCacheFile()
+{
+    const char* path = "test_pipeline_cache.cache";
+    std::vector<uint64_t> keys = { 1, 2, 3 };
+    std::vector<unsigned char> blob(1000);
+    for (size_t i = 0; i < blob.size(); ++i)
+    {
+        blob[i] = (unsigned char)(i * 7);
+    }
+    CHECK(WritePipelineCacheFile(path, 42, keys, blob.data(), blob.size()));
+
+    std::vector<uint64_t> readKeys;
+    std::vector<unsigned char> readBlob;
+    CHECK(ReadPipelineCacheFile(path, 42, readKeys, readBlob));
+    CHECK(readKeys == keys && readBlob == blob);
+    // another adapter or driver
+    CHECK(!ReadPipelineCacheFile(path, 43, readKeys, readBlob));
+    CHECK(!ReadPipelineCacheFile("missing.cache", 42, readKeys, readBlob));
+
+    // one flipped byte in the library
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(sizeof(PipelineCacheFileHeader) + keys.size() * sizeof(uint64_t) + 500);
+    file.put(char(0x55));
+    file.close();
+    CHECK(!ReadPipelineCacheFile(path, 42, readKeys, readBlob));
+
+    // a write cut short
+    CHECK(WritePipelineCacheFile(path, 42, keys, blob.data(), blob.size()));
+    std::ifstream whole(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(whole)), std::istreambuf_iterator<char>());
+    whole.close();
+    std::ofstream truncated(path, std::ios::binary | std::ios::trunc);
+    truncated.write(bytes.data(), 600);
+    truncated.close();
+    CHECK(!ReadPipelineCacheFile(path, 42, readKeys, readBlob));
+    std::remove(path);
+}
+
+static void TestRequests(JobSystem& jobSystem)
+{
+    // 64 pipelines, every one requested twice while the first request is still building
+    static const char* Shaders[] = { "vs0", "vs1", "vs2", "vs3" };
+    std::vector<FakeDesc> descs;
+    for (int i = 0; i < 64; ++i)
+    {
+        descs.push_back(FakeDesc{ Shaders[i % 4], i / 4 });
+    }
+
+    std::vector<uint64_t> keys;
+    {
+        PipelineStateCache<FakeTraits> cache;
+        cache.Init(&jobSystem, std::vector<uint64_t>());
+        for (const FakeDesc& desc : descs)
+        {
+            cache.Request(HashDesc(desc), desc);
+        }
+        for (const FakeDesc& desc : descs)
+        {
+            cache.Request(HashDesc(desc), desc);
+        }
+        cache.WaitAll();
+
+        PipelineCacheStatistics statistics = cache.Statistics();
+        CHECK(statistics.created == 64 && statistics.loaded == 0 && statistics.failed == 0);
+        CHECK(createCount.load() == 64 && storeCount.load() == 64);
+        CHECK(cache.LibraryChanged() && cache.LibraryKeys().size() == 64);
+        bool found = true;
+        for (const FakeDesc& desc : descs)
+        {
+            FakePipeline* pipeline = cache.Find(HashDesc(desc));
+            found = found && pipeline && pipeline->key == HashDesc(desc) && cache.Done(HashDesc(desc));
+        }
+        CHECK(found);
+        CHECK(!cache.Find(HashDesc(FakeDesc{ "vs9", 0 })));
+        keys = cache.LibraryKeys();
+    }
+
+    // warm start: everything comes from the library, nothing is stored twice
+    createCount = 0;
+    {
+        PipelineStateCache<FakeTraits> cache;
+        cache.Init(&jobSystem, keys);
+        bool found = true;
+        for (const FakeDesc& desc : descs)
+        {
+            found = found && cache.Get(HashDesc(desc), desc) != nullptr;
+        }
+        CHECK(found);
+        PipelineCacheStatistics statistics = cache.Statistics();
+        CHECK(statistics.created == 0 && statistics.loaded == 64);
+        CHECK(createCount.load() == 0 && storeCount.load() == 64);
+        CHECK(!cache.LibraryChanged());
+
+        // a failed creation is reported and not added to the library
+        FakeDesc broken = { "vs0", -1 };
+        CHECK(cache.Get(HashDesc(broken), broken) == nullptr);
+        CHECK(cache.Done(HashDesc(broken)));
+        CHECK(cache.Statistics().failed == 1);
+        CHECK(!cache.LibraryChanged());
+    }
+
+    // without a job system requests build on the calling thread
+    {
+        PipelineStateCache<FakeTraits> cache;
+        cache.Init(nullptr, keys);
+        cache.Request(HashDesc(descs[5]), descs[5]);
+        CHECK(cache.Find(HashDesc(descs[5])) != nullptr);
+    }
+}
+
+int main()
+{
+    JobSystem jobSystem;
+    jobSystem.Init(3);
+
+    TestHasher();
+    TestCacheFile();
+    TestRequests(jobSystem);
+
+    jobSystem.Shutdown();
+    return TestResult();
+}
@@ -0,0 +1,413 @@
+#include <random>
+#include <map>
+#include "RenderGraph.h"
+#include "TestCheck.h"
+
+// RenderGraph compile results checked against the declared passes: every access finds its resource in the
+// declared state once the pass's barriers ran, hazards keep their declaration order, transients alive at
+// the same time never share memory, and imported resources end in their final state. A small deferred
+// frame checks culling, read merging and the barrier batches by hand, random graphs check the rest.
+
+struct DeclaredAccess
+{
+    RenderGraphResourceHandle resource;
+    uint32_t state;
+};
+
+// the test's copy of what was declared, the graph does not expose its passes
+struct GraphBuilder
+{
+    RenderGraph graph;
+    std::vector<std::vector<DeclaredAccess>> accesses;
+    std::vector<bool> sideEffects;
+
+    RenderGraphPassHandle AddPass(const char* name, bool sideEffect = false)
+    {
+        accesses.emplace_back();
+        sideEffects.push_back(sideEffect);
+        return graph.AddPass(name, nullptr, sideEffect);
+    }
+
+    void Read(RenderGraphPassHandle pass, RenderGraphResourceHandle resource, uint32_t state)
+    {
+        accesses[pass].push_back(DeclaredAccess{ resource, state });
+        graph.Read(pass, resource, state);
+    }
+
+    void Write(RenderGraphPassHandle pass, RenderGraphResourceHandle resource, uint32_t state)
+    {
+        accesses[pass].push_back(DeclaredAccess{ resource, state });
+        graph.Write(pass, resource, state);
+    }
+};
+
+static bool IsWriteState(uint32_t state)
+{
+    return (state & RenderGraphWriteStates) != 0;
+}
+
+// replays the compiled graph, returns false on the first inconsistency
+static bool ValidateCompiledGraph(const GraphBuilder& builder, std::map<RenderGraphResourceHandle, uint32_t> initialStates,
+    std::map<RenderGraphResourceHandle, uint32_t> finalStates)
+{
+    const RenderGraph& graph = builder.graph;
+    const std::vector<RenderGraphPassHandle>& order = graph.ExecutionOrder();
+    std::vector<uint32_t> position(builder.accesses.size(), UINT32_MAX);
+    for (uint32_t i = 0; i < uint32_t(order.size()); ++i)
+    {
+        position[order[i]] = i;
+    }
+
+    // passes that write an imported resource or have side effects always run
+    for (size_t p = 0; p < builder.accesses.size(); ++p)
+    {
+        bool root = builder.sideEffects[p];
+        for (const DeclaredAccess& access : builder.accesses[p])
+        {
+            root = root || (IsWriteState(access.state) && initialStates.count(access.resource) != 0);
+        }
+        if (root && position[p] == UINT32_MAX)
+        {
+            std::printf("  pass %zu culled\n", p);
+            return false;
+        }
+    }
+
+    // hazards between kept passes keep their declaration order
+    for (size_t a = 0; a < builder.accesses.size(); ++a)
+    {
+        for (size_t b = a + 1; b < builder.accesses.size(); ++b)
+        {
+            if (position[a] == UINT32_MAX || position[b] == UINT32_MAX)
+            {
+                continue;
+            }
+            for (const DeclaredAccess& first : builder.accesses[a])
+            {
+                for (const DeclaredAccess& second : builder.accesses[b])
+                {
+                    if (first.resource == second.resource && (IsWriteState(first.state) || IsWriteState(second.state)) && position[a] > position[b])
+                    {
+                        std::printf("  pass %zu runs before pass %zu\n", b, a);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    // replay the barriers
+    std::vector<uint32_t> current(graph.ResourceCount());
+    for (RenderGraphResourceHandle r = 0; r < graph.ResourceCount(); ++r)
+    {
+        current[r] = graph.IsTransient(r) ? graph.TransientCreationState(r) : initialStates[r];
+    }
+    auto apply = [&](const std::vector<RenderGraphBarrier>& barriers) -> bool
+    {
+        for (const RenderGraphBarrier& barrier : barriers)
+        {
+            if (barrier.type == RenderGraphBarrier::Transition)
+            {
+                if (barrier.stateBefore != current[barrier.resource] || barrier.stateBefore == barrier.stateAfter)
+                {
+                    std::printf("  transition of %s from %x, resource is in %x\n", graph.ResourceName(barrier.resource).c_str(),
+                        barrier.stateBefore, current[barrier.resource]);
+                    return false;
+                }
+                current[barrier.resource] = barrier.stateAfter;
+            }
+        }
+        return true;
+    };
+    for (uint32_t i = 0; i < uint32_t(order.size()); ++i)
+    {
+        if (!apply(graph.PassBarriers(i)))
+        {
+            return false;
+        }
+        for (const DeclaredAccess& access : builder.accesses[order[i]])
+        {
+            uint32_t state = current[access.resource];
+            bool satisfied = IsWriteState(access.state)
+                ? state == access.state || (state == RenderGraphStateDepthWrite && (access.state & ~RenderGraphStateDepthRead) == RenderGraphStateDepthWrite)
+                : (state & access.state) == access.state || (state == RenderGraphStateDepthWrite && access.state == RenderGraphStateDepthRead &&
+                    std::any_of(builder.accesses[order[i]].begin(), builder.accesses[order[i]].end(), [&](const DeclaredAccess& other)
+                    { return other.resource == access.resource && other.state == RenderGraphStateDepthWrite; }));
+            if (!satisfied)
+            {
+                std::printf("  pass %u uses %s as %x, it is in %x\n", order[i], graph.ResourceName(access.resource).c_str(), access.state, state);
+                return false;
+            }
+        }
+    }
+    if (!apply(graph.FinalBarriers()))
+    {
+        return false;
+    }
+    for (const std::pair<const RenderGraphResourceHandle, uint32_t>& final : finalStates)
+    {
+        if (current[final.first] != final.second)
+        {
+            std::printf("  %s ends in %x\n", graph.ResourceName(final.first).c_str(), current[final.first]);
+            return false;
+        }
+    }
+    // transients are created in the state the graph leaves them in, the next execution starts there
+    for (RenderGraphResourceHandle r = 0; r < graph.ResourceCount(); ++r)
+    {
+        if (graph.IsTransient(r) && graph.IsUsed(r) && current[r] != graph.TransientCreationState(r))
+        {
+            return false;
+        }
+    }
+
+    // transients alive at the same time do not share memory
+    std::vector<uint32_t> firstUse(graph.ResourceCount(), UINT32_MAX);
+    std::vector<uint32_t> lastUse(graph.ResourceCount(), 0);
+    for (uint32_t i = 0; i < uint32_t(order.size()); ++i)
+    {
+        for (const DeclaredAccess& access : builder.accesses[order[i]])
+        {
+            firstUse[access.resource] = std::min(firstUse[access.resource], i);
+            lastUse[access.resource] = std::max(lastUse[access.resource], i);
+        }
+    }
+    for (RenderGraphResourceHandle a = 0; a < graph.ResourceCount(); ++a)
+    {
+        if (!graph.IsTransient(a) || firstUse[a] == UINT32_MAX)
+        {
+            continue;
+        }
+        const RenderGraphTextureDesc& descA = graph.TextureDesc(a);
+        uint64_t offsetA = graph.TransientOffset(a);
+        if (offsetA % std::max<uint64_t>(descA.alignment, 1) != 0 || offsetA + descA.size > graph.TransientHeapSize())
+        {
+            return false;
+        }
+        for (RenderGraphResourceHandle b = a + 1; b < graph.ResourceCount(); ++b)
+        {
+            if (!graph.IsTransient(b) || firstUse[b] == UINT32_MAX)
+            {
+                continue;
+            }
+            uint64_t offsetB = graph.TransientOffset(b);
+            bool memoryOverlaps = offsetA < offsetB + graph.TextureDesc(b).size && offsetB < offsetA + descA.size;
+            bool lifetimesOverlap = firstUse[a] <= lastUse[b] && firstUse[b] <= lastUse[a];
+            if (memoryOverlaps && lifetimesOverlap)
+            {
+                std::printf("  %s and %s share memory\n", graph.ResourceName(a).c_str(), graph.ResourceName(b).c_str());
+                return false;
+            }
+            // the later one takes the memory over with an aliasing barrier at its first use
+            if (memoryOverlaps)
+            {
+                RenderGraphResourceHandle later = firstUse[a] > firstUse[b] ? a : b;
+                const std::vector<RenderGraphBarrier>& barriers = graph.PassBarriers(firstUse[later]);
+                bool aliased = std::any_of(barriers.begin(), barriers.end(), [&](const RenderGraphBarrier& barrier)
+                {
+                    return barrier.type == RenderGraphBarrier::Aliasing && barrier.resource == later;
+                });
+                if (!aliased)
+                {
+                    std::printf("  %s has no aliasing barrier\n", graph.ResourceName(later).c_str());
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void TestDeferredFrame()
+{
+    GraphBuilder builder;
+    RenderGraph& graph = builder.graph;
+    RenderGraphResourceHandle backBuffer = graph.ImportResource("back buffer", RenderGraphStatePresent, RenderGraphStatePresent);
+    RenderGraphTextureDesc full = { 1920, 1080, 0, 8u << 20, 65536 };
+    RenderGraphTextureDesc half = { 960, 540, 0, 2u << 20, 65536 };
+    RenderGraphResourceHandle depth = graph.CreateTexture("depth", full);
+    RenderGraphResourceHandle gbuffer = graph.CreateTexture("gbuffer", full);
+    RenderGraphResourceHandle ssao = graph.CreateTexture("ssao", half);
+    RenderGraphResourceHandle blur = graph.CreateTexture("blur", half);
+    RenderGraphResourceHandle unused = graph.CreateTexture("unused", full);
+
+    RenderGraphPassHandle depthPass = builder.AddPass("depth");
+    builder.Write(depthPass, depth, RenderGraphStateDepthWrite);
+    RenderGraphPassHandle deadPass = builder.AddPass("dead");
+    builder.Read(deadPass, depth, RenderGraphStateShaderResource);
+    builder.Write(deadPass, unused, RenderGraphStateRenderTarget);
+    RenderGraphPassHandle gbufferPass = builder.AddPass("gbuffer");
+    builder.Read(gbufferPass, depth, RenderGraphStateDepthRead);
+    builder.Write(gbufferPass, gbuffer, RenderGraphStateRenderTarget);
+    RenderGraphPassHandle ssaoPass = builder.AddPass("ssao");
+    builder.Read(ssaoPass, depth, RenderGraphStateShaderResource);
+    builder.Write(ssaoPass, ssao, RenderGraphStateUnorderedAccess);
+    RenderGraphPassHandle blurPass = builder.AddPass("blur");
+    builder.Read(blurPass, ssao, RenderGraphStateShaderResource);
+    builder.Write(blurPass, blur, RenderGraphStateUnorderedAccess);
+    RenderGraphPassHandle lightPass = builder.AddPass("light");
+    builder.Read(lightPass, gbuffer, RenderGraphStateShaderResource);
+    builder.Read(lightPass, blur, RenderGraphStateShaderResource);
+    builder.Write(lightPass, backBuffer, RenderGraphStateRenderTarget);
+
+    CHECK(graph.Compile());
+    CHECK(ValidateCompiledGraph(builder, { { backBuffer, RenderGraphStatePresent } }, { { backBuffer, RenderGraphStatePresent } }));
+
+    std::vector<RenderGraphPassHandle> expected = { depthPass, gbufferPass, ssaoPass, blurPass, lightPass };
+    CHECK(graph.ExecutionOrder() == expected);
+    CHECK(graph.Statistics().culledPasses == 1);
+    CHECK(!graph.IsUsed(unused));
+
+    // depth goes to depth read and shader resource at once for both readers
+    const std::vector<RenderGraphBarrier>& gbufferBarriers = graph.PassBarriers(1);
+    bool mergedRead = std::any_of(gbufferBarriers.begin(), gbufferBarriers.end(), [&](const RenderGraphBarrier& barrier)
+    {
+        return barrier.resource == depth && barrier.stateAfter == (RenderGraphStateDepthRead | RenderGraphStateShaderResource);
+    });
+    CHECK(mergedRead);
+    const std::vector<RenderGraphBarrier>& ssaoBarriers = graph.PassBarriers(2);
+    CHECK(std::none_of(ssaoBarriers.begin(), ssaoBarriers.end(), [&](const RenderGraphBarrier& barrier) { return barrier.resource == depth; }));
+
+    // one transition back to present at the end
+    CHECK(graph.FinalBarriers().size() == 1);
+    CHECK(graph.FinalBarriers().size() == 1 && graph.FinalBarriers()[0].resource == backBuffer &&
+        graph.FinalBarriers()[0].stateAfter == RenderGraphStatePresent);
+
+    // ssao is dead once blur ran, the half resolution textures cannot both fit in what depth leaves
+    CHECK(graph.TransientHeapSize() < graph.Statistics().transientUnaliasedSize);
+
+    // the pass callbacks run in execution order between the barrier batches
+    std::vector<std::string> ran;
+    RenderGraph executed;
+    RenderGraphResourceHandle target = executed.ImportResource("target", RenderGraphStateCommon, RenderGraphStateCommon);
+    RenderGraphResourceHandle temporary = executed.CreateTexture("temporary", half);
+    RenderGraphPassHandle consumer = executed.AddPass("consumer", [&]() { ran.push_back("consumer"); });
+    executed.Read(consumer, temporary, RenderGraphStateShaderResource);
+    executed.Write(consumer, target, RenderGraphStateRenderTarget);
+    RenderGraphPassHandle producer = executed.AddPass("producer", [&]() { ran.push_back("producer"); });
+    executed.Write(producer, temporary, RenderGraphStateRenderTarget);
+    CHECK(executed.Compile());
+    size_t batches = 0;
+    executed.Execute([&](const RenderGraphBarrier*, size_t count) { batches += count > 0 ? 1 : 0; });
+    // the producer is declared after its reader, it only overwrites what nothing reads anymore and is culled
+    CHECK(ran.size() == 1 && ran[0] == "consumer");
+    CHECK(batches >= 2);
+}
+
+static void TestInvalidAccess()
+{
+    RenderGraph graph;
+    RenderGraphResourceHandle target = graph.ImportResource("target", RenderGraphStateCommon, RenderGraphStateCommon);
+    RenderGraphPassHandle pass = graph.AddPass("feedback", nullptr);
+    graph.Read(pass, target, RenderGraphStateShaderResource);
+    graph.Write(pass, target, RenderGraphStateRenderTarget);
+    CHECK(!graph.Compile());
+    CHECK(!graph.Compiled());
+
+    // depth may be tested and written by the same pass
+    RenderGraph depthGraph;
+    RenderGraphResourceHandle depth = depthGraph.ImportResource("depth", RenderGraphStateDepthWrite, RenderGraphStateDepthWrite);
+    RenderGraphPassHandle depthPass = depthGraph.AddPass("depth", nullptr);
+    depthGraph.Read(depthPass, depth, RenderGraphStateDepthRead);
+    depthGraph.Write(depthPass, depth, RenderGraphStateDepthWrite);
+    CHECK(depthGraph.Compile());
+    CHECK(depthGraph.Statistics().barriers == 0);
+}
+
+static void TestUnorderedAccessChain()
+{
+    GraphBuilder builder;
+    RenderGraph& graph = builder.graph;
+    RenderGraphResourceHandle output = graph.ImportResource("output", RenderGraphStateCommon, RenderGraphStateShaderResource);
+    for (int i = 0; i < 3; ++i)
+    {
+        builder.Write(builder.AddPass("accumulate"), output, RenderGraphStateUnorderedAccess);
+    }
+    CHECK(graph.Compile());
+    CHECK(ValidateCompiledGraph(builder, { { output, RenderGraphStateCommon } }, { { output, RenderGraphStateShaderResource } }));
+    // a transition before the first write, a UAV barrier between the others
+    CHECK(graph.PassBarriers(0).size() == 1 && graph.PassBarriers(0)[0].type == RenderGraphBarrier::Transition);
+    CHECK(graph.PassBarriers(1).size() == 1 && graph.PassBarriers(1)[0].type == RenderGraphBarrier::UnorderedAccess);
+    CHECK(graph.PassBarriers(2).size() == 1 && graph.PassBarriers(2)[0].type == RenderGraphBarrier::UnorderedAccess);
+}
+
+static void TestRandomGraphs()
+{
+    const uint32_t ReadStates[] = { RenderGraphStateShaderResource, RenderGraphStateCopySource, RenderGraphStateDepthRead,
+        RenderGraphStateShaderResource | RenderGraphStateCopySource };
+    const uint32_t WriteStates[] = { RenderGraphStateRenderTarget, RenderGraphStateUnorderedAccess, RenderGraphStateCopyDest,
+        RenderGraphStateDepthWrite };
+
+    std::mt19937 random(7);
+    int valid = 0;
+    const int GraphCount = 300;
+    for (int g = 0; g < GraphCount; ++g)
+    {
+        GraphBuilder builder;
+        RenderGraph& graph = builder.graph;
+        std::map<RenderGraphResourceHandle, uint32_t> initialStates;
+        std::map<RenderGraphResourceHandle, uint32_t> finalStates;
+        std::vector<RenderGraphResourceHandle> resources;
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t initial = ReadStates[random() % 4];
+            uint32_t final = i == 0 ? RenderGraphStatePresent : ReadStates[random() % 4];
+            RenderGraphResourceHandle imported = graph.ImportResource("imported", initial, final);
+            initialStates[imported] = initial;
+            finalStates[imported] = final;
+            resources.push_back(imported);
+        }
+        for (int i = 0; i < 24; ++i)
+        {
+            RenderGraphTextureDesc desc = { 0, 0, 0, uint64_t(1 + random() % 16) << 16, uint64_t(1) << (12 + random() % 5) };
+            resources.push_back(graph.CreateTexture("transient", desc));
+        }
+
+        int passCount = 10 + int(random() % 40);
+        for (int p = 0; p < passCount; ++p)
+        {
+            RenderGraphPassHandle pass = builder.AddPass("pass", random() % 10 == 0);
+            std::vector<RenderGraphResourceHandle> used;
+            int reads = int(random() % 4);
+            for (int k = 0; k < reads; ++k)
+            {
+                RenderGraphResourceHandle resource = resources[random() % resources.size()];
+                if (std::find(used.begin(), used.end(), resource) == used.end())
+                {
+                    used.push_back(resource);
+                    builder.Read(pass, resource, ReadStates[random() % 4]);
+                }
+            }
+            RenderGraphResourceHandle written = resources[random() % resources.size()];
+            if (std::find(used.begin(), used.end(), written) == used.end())
+            {
+                builder.Write(pass, written, WriteStates[random() % 4]);
+            }
+        }
+
+        if (!graph.Compile())
+        {
+            std::printf("graph %d failed to compile\n", g);
+            CHECK(false);
+            continue;
+        }
+        if (ValidateCompiledGraph(builder, initialStates, finalStates))
+        {
+            valid++;
+        }
+        else
+        {
+            std::printf("graph %d is inconsistent\n", g);
+        }
+    }
+    CHECK(valid == GraphCount);
+}
+
+int main()
+{
+    TestDeferredFrame();
+    TestInvalidAccess();
+    TestUnorderedAccessChain();
+    TestRandomGraphs();
+    return TestResult();
+}
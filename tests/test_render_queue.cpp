@@ -0,0 +1,151 @@
+#include <vector>
+#include "RenderQueue.h"
+#include "TestCheck.h"
+
+// RenderPacketPipeline with a game thread and a render thread, the renderer's loop without D3D12: the game
+// thread fills packets with its frame number, the render thread reads them slowly enough for the game
+// thread to catch up. At depth 0, 1 and 2 packets arrive in order, none is written to while it is read,
+// the game thread is never more than the depth ahead, and Close wakes a blocked BeginWrite and BeginRead.
+
+struct TestPacket
+{
+    uint64_t frame;
+    uint64_t payload[64];
+    std::atomic<bool> reading;
+
+    TestPacket() : frame(0), reading(false) {}
+};
+
+static void TestThreads(size_t depth)
+{
+    const uint64_t Frames = 20000;
+    RenderPacketPipeline<TestPacket> pipeline;
+    pipeline.Init(depth);
+    std::atomic<uint64_t> renderedFrames(0);
+    int outOfOrder = 0;
+    int torn = 0;
+    int writtenWhileRead = 0;
+    int tooFarAhead = 0;
+
+    std::thread renderThread([&]()
+    {
+        uint64_t expected = 0;
+        while (TestPacket* packet = pipeline.BeginRead())
+        {
+            packet->reading.store(true);
+            outOfOrder += packet->frame != expected++ ? 1 : 0;
+            // a slow frame now and then, the game thread runs into the depth limit
+            if (packet->frame % 64 == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            for (uint64_t value : packet->payload)
+            {
+                torn += value != packet->frame ? 1 : 0;
+            }
+            packet->reading.store(false);
+            renderedFrames.fetch_add(1);
+            pipeline.EndRead(packet);
+        }
+    });
+
+    for (uint64_t frame = 0; frame < Frames; ++frame)
+    {
+        TestPacket* packet = pipeline.BeginWrite();
+        if (!packet)
+        {
+            break;
+        }
+        writtenWhileRead += packet->reading.load() ? 1 : 0;
+        // frames handed over minus frames the render thread is done with
+        tooFarAhead += frame - renderedFrames.load() > depth ? 1 : 0;
+        packet->frame = frame;
+        for (uint64_t& value : packet->payload)
+        {
+            value = frame;
+        }
+        pipeline.EndWrite(packet);
+    }
+    pipeline.Close();
+    renderThread.join();
+
+    RenderPipelineStatistics stats = pipeline.Statistics();
+    CHECK(renderedFrames.load() == Frames);
+    CHECK(stats.framesProduced == Frames && stats.framesConsumed == Frames);
+    CHECK(outOfOrder == 0 && torn == 0 && writtenWhileRead == 0);
+    CHECK(tooFarAhead == 0);
+    std::printf("depth %zu: %llu frames, latency avg %.3f max %.3f ms, game waited %.1f ms, render waited %.1f ms\n", depth,
+        (unsigned long long)stats.framesConsumed, stats.averageLatencyMs, stats.maxLatencyMs, stats.gameWaitMs, stats.renderWaitMs);
+}
+
+// true when call returns within a second of Close
+template <typename Call>
+static bool WakesOnClose(RenderPacketPipeline<TestPacket>& pipeline, Call call)
+{
+    std::atomic<bool> returned(false);
+    bool gotNull = false;
+    std::thread blocked([&]()
+    {
+        gotNull = call() == nullptr;
+        returned.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    bool waited = !returned.load();
+    pipeline.Close();
+    std::chrono::steady_clock::time_point closed = std::chrono::steady_clock::now();
+    while (!returned.load() && std::chrono::steady_clock::now() - closed < std::chrono::seconds(1))
+    {
+        std::this_thread::yield();
+    }
+    bool woke = returned.load();
+    blocked.join();
+    return waited && woke && gotNull;
+}
+
+static void TestClose()
+{
+    // the game thread waits for the one packet of depth 0, the render thread for a packet that never comes
+    RenderPacketPipeline<TestPacket> pipeline;
+    pipeline.Init(0);
+    TestPacket* packet = pipeline.BeginWrite();
+    CHECK(packet != nullptr);
+    CHECK(WakesOnClose(pipeline, [&] { return pipeline.BeginWrite(); }));
+    pipeline.Init(1);
+    CHECK(WakesOnClose(pipeline, [&] { return pipeline.BeginRead(); }));
+
+    // packets handed over before Close are still read, also when Close comes right after the last one
+    int lost = 0;
+    for (int attempt = 0; attempt < 2000; ++attempt)
+    {
+        pipeline.Init(2);
+        std::atomic<bool> go(false);
+        std::thread game([&]()
+        {
+            while (!go.load()) {}
+            TestPacket* written = pipeline.BeginWrite();
+            written->frame = uint64_t(attempt);
+            pipeline.EndWrite(written);
+            pipeline.Close();
+        });
+        go.store(true);
+        TestPacket* read = pipeline.BeginRead();
+        lost += read == nullptr || read->frame != uint64_t(attempt) ? 1 : 0;
+        if (read)
+        {
+            pipeline.EndRead(read);
+        }
+        game.join();
+        lost += pipeline.BeginRead() != nullptr ? 1 : 0;
+    }
+    CHECK(lost == 0);
+}
+
+int main()
+{
+    for (size_t depth = 0; depth <= 2; ++depth)
+    {
+        TestThreads(depth);
+    }
+    TestClose();
+    return TestResult();
+}
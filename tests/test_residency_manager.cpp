@@ -0,0 +1,189 @@
+#include <random>
+#include "ResidencyManager.h"
+#include "TestCheck.h"
+
+// ResidencyManager on plain objects that record whether they are resident. A scripted run checks the LRU
+// order, the budget and that objects a frame in flight may read are never evicted. A random run of 20000
+// frames compares against a model: resident bytes add up, only objects the GPU is done with are evicted,
+// nothing is evicted while an object used less recently stays, and a frame's objects are resident.
+
+struct FakeHeap
+{
+    int id;
+    bool resident;
+};
+
+static const uint64_t MB = 1 << 20;
+
+// applies what EndFrame asked for, false when it asked for something that makes no sense
+static bool Apply(std::vector<FakeHeap*>& makeResident, std::vector<FakeHeap*>& evict)
+{
+    bool valid = true;
+    for (FakeHeap* heap : makeResident)
+    {
+        valid = valid && !heap->resident;
+        heap->resident = true;
+    }
+    for (FakeHeap* heap : evict)
+    {
+        valid = valid && heap->resident;
+        heap->resident = false;
+    }
+    makeResident.clear();
+    evict.clear();
+    return valid;
+}
+
+static void TestScripted()
+{
+    ResidencyManager<FakeHeap> residency;
+    std::vector<FakeHeap> heaps(10);
+    std::vector<uint32_t> handles(10);
+    std::vector<FakeHeap*> makeResident;
+    std::vector<FakeHeap*> evict;
+
+    residency.BeginFrame(0, 0, UINT64_MAX);
+    for (int i = 0; i < 10; ++i)
+    {
+        heaps[i] = FakeHeap{ i, true };
+        handles[i] = residency.Track(&heaps[i], 10 * MB);
+    }
+    residency.EndFrame(makeResident, evict);
+    CHECK(makeResident.empty() && evict.empty());
+
+    // 50 MB budget, frame 1 uses 0 to 4 and frame 0 is done: 5 to 9 go, least recently tracked first
+    residency.BeginFrame(1, 0, 50 * MB);
+    for (int i = 4; i >= 0; --i)
+    {
+        residency.Use(handles[i]);
+    }
+    ResidencyFrameTelemetry telemetry = residency.EndFrame(makeResident, evict);
+    CHECK(evict.size() == 5 && evict[0] == &heaps[5] && evict[4] == &heaps[9]);
+    CHECK(Apply(makeResident, evict));
+    CHECK(telemetry.evicted == 5 && telemetry.residentBytes == 50 * MB && !telemetry.overBudget);
+    CHECK(telemetry.usedBytes == 50 * MB && telemetry.evictedBytes == 50 * MB);
+
+    // frame 2 needs 7 back, everything resident was used by frame 1 which is still in flight
+    residency.BeginFrame(2, 0, 50 * MB);
+    residency.Use(handles[7]);
+    residency.Use(handles[7]);
+    telemetry = residency.EndFrame(makeResident, evict);
+    CHECK(telemetry.madeResident == 1 && makeResident.size() == 1 && makeResident[0] == &heaps[7]);
+    CHECK(telemetry.evicted == 0 && telemetry.overBudget);
+    CHECK(Apply(makeResident, evict));
+
+    // frame 1 done: its uses were 4, 3, 2, 1, 0 in that order, 1 is used again, so 4 is the oldest
+    residency.BeginFrame(3, 1, 50 * MB);
+    residency.Use(handles[7]);
+    residency.Use(handles[1]);
+    telemetry = residency.EndFrame(makeResident, evict);
+    CHECK(evict.size() == 1 && evict[0] == &heaps[4]);
+    CHECK(Apply(makeResident, evict));
+    CHECK(!telemetry.overBudget && residency.IsResident(handles[7]) && !residency.IsResident(handles[4]));
+
+    // the budget shrinks, the unused ones go in LRU order: 3, 2, 0
+    residency.BeginFrame(4, 3, 20 * MB);
+    residency.Use(handles[1]);
+    telemetry = residency.EndFrame(makeResident, evict);
+    CHECK(evict.size() == 3 && evict[0] == &heaps[3] && evict[1] == &heaps[2] && evict[2] == &heaps[0]);
+    CHECK(Apply(makeResident, evict));
+    CHECK(telemetry.residentBytes == 20 * MB);
+
+    // an evicted and a resident object untracked, a restore of an untracked object is dropped
+    residency.BeginFrame(5, 4, 20 * MB);
+    residency.Use(handles[9]);
+    residency.Untrack(handles[9]);
+    residency.Untrack(handles[1]);
+    residency.EndFrame(makeResident, evict);
+    CHECK(makeResident.empty());
+    ResidencyStatistics statistics = residency.Statistics();
+    CHECK(statistics.trackedObjects == 8 && statistics.trackedBytes == 80 * MB);
+    CHECK(residency.ResidentBytes() == 10 * MB);
+    CHECK(statistics.evicted == 9 && statistics.madeResident == 1 && statistics.overBudgetFrames == 1);
+
+    // a handle is reused by the next object tracked
+    FakeHeap late = { 10, true };
+    uint32_t lateHandle = residency.Track(&late, 5 * MB);
+    CHECK(lateHandle == handles[1] || lateHandle == handles[9]);
+    CHECK(residency.IsResident(lateHandle));
+}
+
+static void TestRandomFrames()
+{
+    const int HeapCount = 200;
+    const uint64_t FramesInFlight = 3;
+    std::mt19937 random(5);
+    ResidencyManager<FakeHeap> residency;
+    std::vector<FakeHeap> heaps(HeapCount);
+    std::vector<uint32_t> handles(HeapCount);
+    std::vector<uint64_t> sizes(HeapCount);
+    std::vector<uint64_t> lastUse(HeapCount, 0);
+    std::vector<FakeHeap*> makeResident;
+    std::vector<FakeHeap*> evict;
+
+    residency.BeginFrame(0, 0, UINT64_MAX);
+    for (int i = 0; i < HeapCount; ++i)
+    {
+        heaps[i] = FakeHeap{ i, true };
+        sizes[i] = (1 + random() % 64) * MB;
+        handles[i] = residency.Track(&heaps[i], sizes[i]);
+    }
+    residency.EndFrame(makeResident, evict);
+
+    int invalid = 0;
+    int evictedInFlight = 0;
+    int evictedOutOfOrder = 0;
+    int missing = 0;
+    int miscounted = 0;
+    int overBudget = 0;
+    uint64_t evictions = 0;
+    for (uint64_t frame = 1; frame < 20000; ++frame)
+    {
+        uint64_t completed = frame >= FramesInFlight ? frame - FramesInFlight : 0;
+        uint64_t budget = (1500 + random() % 1500) * MB;
+        residency.BeginFrame(frame, completed, budget);
+        // most uses go to a hot set of 30
+        int uses = int(random() % 40);
+        for (int u = 0; u < uses; ++u)
+        {
+            int i = random() % 4 == 0 ? int(random() % HeapCount) : int(random() % 30);
+            residency.Use(handles[i]);
+            lastUse[i] = frame;
+        }
+        ResidencyFrameTelemetry telemetry = residency.EndFrame(makeResident, evict);
+
+        uint64_t newestEvicted = 0;
+        for (FakeHeap* heap : evict)
+        {
+            evictedInFlight += lastUse[heap->id] > completed ? 1 : 0;
+            newestEvicted = std::max(newestEvicted, lastUse[heap->id]);
+        }
+        evictions += evict.size();
+        invalid += Apply(makeResident, evict) ? 0 : 1;
+
+        uint64_t resident = 0;
+        for (int i = 0; i < HeapCount; ++i)
+        {
+            resident += heaps[i].resident ? sizes[i] : 0;
+            missing += lastUse[i] == frame && !heaps[i].resident ? 1 : 0;
+            evictedOutOfOrder += heaps[i].resident && lastUse[i] < newestEvicted ? 1 : 0;
+        }
+        miscounted += resident != telemetry.residentBytes || resident != residency.ResidentBytes() ? 1 : 0;
+        overBudget += telemetry.overBudget ? 1 : 0;
+        miscounted += !telemetry.overBudget && resident > budget ? 1 : 0;
+    }
+    CHECK(invalid == 0);
+    CHECK(evictedInFlight == 0);
+    CHECK(evictedOutOfOrder == 0);
+    CHECK(missing == 0);
+    CHECK(miscounted == 0);
+    CHECK(evictions > 0);
+    std::printf("20000 frames: %llu evictions, %d frames over budget\n", (unsigned long long)evictions, overBudget);
+}
+
+int main()
+{
+    TestScripted();
+    TestRandomFrames();
+    return TestResult();
+}
@@ -0,0 +1,314 @@
+#include <string>
+#include <random>
+#include "ResourceStateTracker.h"
+#include "TestCheck.h"
+
+// ResourceStateTracker and ResourceStateTable recorded into a fake command list. The scripted cases check
+// batching, merging and dropped transitions barrier by barrier. The random case records lists that use
+// resources and subresources in random states, submits them in order and replays every barrier on a
+// simulated GPU state, so a barrier whose before state is wrong or a use without the right state fails.
+
+struct FakeResource
+{
+    const char* name;
+};
+
+typedef ResourceBarrierRecord<FakeResource> Barrier;
+
+// state bits with the layout of D3D12_RESOURCE_STATES
+enum : uint32_t
+{
+    Common = 0x0,
+    VertexBuffer = 0x1,
+    IndexBuffer = 0x2,
+    RenderTarget = 0x4,
+    UnorderedAccess = 0x8,
+    DepthWrite = 0x10,
+    DepthRead = 0x20,
+    NonPixelShaderResource = 0x40,
+    PixelShaderResource = 0x80,
+    CopyDest = 0x400,
+    CopySource = 0x800,
+};
+const uint32_t ReadOnlyStates = VertexBuffer | IndexBuffer | DepthRead | NonPixelShaderResource | PixelShaderResource | CopySource;
+
+struct FakeCommandList
+{
+    std::vector<std::string> log;
+    int calls = 0;
+
+    void ResourceBarrier(const Barrier* barriers, size_t count)
+    {
+        calls++;
+        for (size_t i = 0; i < count; ++i)
+        {
+            char entry[128];
+            const Barrier& barrier = barriers[i];
+            if (barrier.type == Barrier::Transition)
+            {
+                snprintf(entry, sizeof(entry), "%s/%d %x->%x", barrier.resource->name, int(barrier.subresource), barrier.stateBefore, barrier.stateAfter);
+            }
+            else if (barrier.type == Barrier::UnorderedAccess)
+            {
+                snprintf(entry, sizeof(entry), "uav %s", barrier.resource ? barrier.resource->name : "*");
+            }
+            else
+            {
+                snprintf(entry, sizeof(entry), "alias %s->%s", barrier.before ? barrier.before->name : "*", barrier.resource->name);
+            }
+            log.push_back(entry);
+        }
+    }
+
+    void Flush(ResourceStateTracker<FakeResource>& tracker)
+    {
+        tracker.FlushBarriers([this](const Barrier* barriers, size_t count) { ResourceBarrier(barriers, count); });
+    }
+
+    void Record(const std::vector<Barrier>& barriers)
+    {
+        if (!barriers.empty())
+        {
+            ResourceBarrier(barriers.data(), barriers.size());
+        }
+    }
+};
+
+typedef std::vector<std::string> Log;
+
+static void TestScripted()
+{
+    FakeResource vertexBuffer = { "vb" };
+    FakeResource texture = { "tex" };
+    FakeResource backBuffer = { "bb" };
+    FakeResource depth = { "depth" };
+    ResourceStateTable<FakeResource> table;
+    table.Register(&vertexBuffer, CopyDest);
+    table.Register(&texture, CopyDest);
+    table.Register(&backBuffer, Common);
+    table.Register(&depth, DepthWrite);
+
+    // upload: first uses stay pending, the known transitions go out in one call
+    ResourceStateTracker<FakeResource> upload(ReadOnlyStates);
+    FakeCommandList uploadList;
+    upload.TransitionResource(&vertexBuffer, CopyDest);
+    upload.TransitionResource(&texture, CopyDest);
+    CHECK(upload.QueuedBarrierCount() == 0);
+    CHECK(upload.PendingBarriers().size() == 2);
+    upload.TransitionResource(&vertexBuffer, VertexBuffer);
+    upload.TransitionResource(&texture, PixelShaderResource | NonPixelShaderResource);
+    // covered by the combined read state
+    upload.TransitionResource(&texture, PixelShaderResource);
+    uploadList.Flush(upload);
+    CHECK(uploadList.log == Log({ "vb/-1 400->1", "tex/-1 400->c0" }));
+    CHECK(uploadList.calls == 1);
+    std::vector<Barrier> resolved;
+    CHECK(table.Resolve(upload, resolved));
+    // the list expected the states the resources were registered in
+    CHECK(resolved.empty());
+    CHECK(table.State(&texture) == (PixelShaderResource | NonPixelShaderResource));
+
+    // two lists recorded in parallel, submitted in order
+    ResourceStateTracker<FakeResource> first(ReadOnlyStates);
+    ResourceStateTracker<FakeResource> second(ReadOnlyStates);
+    FakeCommandList firstList;
+    FakeCommandList secondList;
+    first.TransitionResource(&backBuffer, RenderTarget);
+    first.TransitionResource(&depth, DepthWrite);
+    first.TransitionResource(&backBuffer, Common);
+    first.TransitionResource(&backBuffer, RenderTarget);
+    firstList.Flush(first);
+    // the round trip folds away
+    CHECK(firstList.log.empty());
+    second.TransitionResource(&backBuffer, Common);
+    second.TransitionResource(&texture, NonPixelShaderResource);
+    second.TransitionResource(&texture, CopyDest);
+    second.TransitionResource(&texture, CopySource);
+    secondList.Flush(second);
+    CHECK(secondList.log == Log({ "tex/-1 40->800" }));
+
+    FakeCommandList firstResolved;
+    FakeCommandList secondResolved;
+    resolved.clear();
+    CHECK(table.Resolve(first, resolved));
+    firstResolved.Record(resolved);
+    resolved.clear();
+    CHECK(table.Resolve(second, resolved));
+    secondResolved.Record(resolved);
+    CHECK(firstResolved.log == Log({ "bb/-1 0->4" }));
+    // resolved against what the first list left
+    CHECK(secondResolved.log == Log({ "bb/-1 4->0", "tex/-1 c0->40" }));
+    CHECK(table.State(&backBuffer) == Common);
+    CHECK(table.State(&texture) == CopySource);
+
+    // a subresource moved on its own, then the whole resource
+    ResourceStateTracker<FakeResource> mips(ReadOnlyStates);
+    FakeCommandList mipList;
+    mips.TransitionResource(&texture, RenderTarget, 2);
+    mips.TransitionResource(&texture, CopySource, 2);
+    mips.TransitionResource(&texture, PixelShaderResource);
+    mipList.Flush(mips);
+    CHECK(mipList.log == Log({ "tex/2 4->80" }));
+    FakeCommandList mipResolved;
+    resolved.clear();
+    table.Resolve(mips, resolved);
+    mipResolved.Record(resolved);
+    CHECK(mipResolved.log == Log({ "tex/-1 800->80", "tex/2 80->4" }));
+    CHECK(table.State(&texture) == PixelShaderResource && table.State(&texture, 2) == PixelShaderResource);
+
+    // UAV and aliasing barriers keep their place in the batch
+    ResourceStateTracker<FakeResource> compute(ReadOnlyStates);
+    FakeCommandList computeList;
+    compute.TransitionResource(&texture, UnorderedAccess);
+    compute.UAVBarrier(&texture);
+    compute.AliasBarrier(nullptr, &depth);
+    computeList.Flush(compute);
+    CHECK(computeList.log == Log({ "uav tex", "alias *->depth" }));
+
+    // a resource the table does not know is reported
+    FakeResource stranger = { "stranger" };
+    ResourceStateTracker<FakeResource> unknown(ReadOnlyStates);
+    unknown.TransitionResource(&stranger, CopyDest);
+    resolved.clear();
+    CHECK(!table.Resolve(unknown, resolved));
+    CHECK(resolved.empty());
+}
+
+// what the GPU would see: the state of every subresource
+struct SimulatedResource
+{
+    FakeResource resource;
+    std::vector<uint32_t> subresources;
+};
+
+static size_t executedTransitions = 0;
+
+static bool ExecuteBarriers(const std::vector<Barrier>& barriers, std::vector<SimulatedResource>& gpu)
+{
+    for (const Barrier& barrier : barriers)
+    {
+        if (barrier.type != Barrier::Transition)
+        {
+            continue;
+        }
+        SimulatedResource& target = *std::find_if(gpu.begin(), gpu.end(), [&](const SimulatedResource& simulated)
+        {
+            return &simulated.resource == barrier.resource;
+        });
+        for (size_t s = 0; s < target.subresources.size(); ++s)
+        {
+            if (barrier.subresource != AllSubresources && barrier.subresource != s)
+            {
+                continue;
+            }
+            if (target.subresources[s] != barrier.stateBefore || barrier.stateBefore == barrier.stateAfter)
+            {
+                std::printf("  %s/%zu is in %x, barrier from %x\n", target.resource.name, s, target.subresources[s], barrier.stateBefore);
+                return false;
+            }
+            target.subresources[s] = barrier.stateAfter;
+        }
+        executedTransitions++;
+    }
+    return true;
+}
+
+static void TestRandomLists()
+{
+    const uint32_t States[] = { Common, VertexBuffer, RenderTarget, UnorderedAccess, NonPixelShaderResource, PixelShaderResource,
+        NonPixelShaderResource | PixelShaderResource, CopyDest, CopySource, PixelShaderResource | CopySource };
+    const size_t ResourceCount = 6;
+    const uint32_t SubresourceCount = 4;
+
+    std::mt19937 random(11);
+    std::vector<SimulatedResource> gpu(ResourceCount);
+    ResourceStateTable<FakeResource> table;
+    const char* Names[ResourceCount] = { "a", "b", "c", "d", "e", "f" };
+    for (size_t r = 0; r < ResourceCount; ++r)
+    {
+        uint32_t created = States[random() % 10];
+        gpu[r].resource.name = Names[r];
+        gpu[r].subresources.assign(SubresourceCount, created);
+        table.Register(&gpu[r].resource, created);
+    }
+
+    // a list's commands: a barrier batch and the use it was flushed for
+    struct Step
+    {
+        std::vector<Barrier> barriers;
+        size_t resource;
+        uint32_t subresource;
+        uint32_t state;
+    };
+
+    int consistent = 0;
+    const int Submissions = 2000;
+    for (int submission = 0; submission < Submissions; ++submission)
+    {
+        // up to four lists recorded independently, then resolved and executed in order
+        size_t listCount = 1 + random() % 4;
+        std::vector<ResourceStateTracker<FakeResource>> trackers(listCount, ResourceStateTracker<FakeResource>(ReadOnlyStates));
+        std::vector<std::vector<Step>> lists(listCount);
+        for (size_t l = 0; l < listCount; ++l)
+        {
+            int uses = 1 + int(random() % 12);
+            for (int u = 0; u < uses; ++u)
+            {
+                Step step;
+                step.resource = random() % ResourceCount;
+                step.subresource = random() % 3 == 0 ? uint32_t(random() % SubresourceCount) : AllSubresources;
+                step.state = States[random() % 10];
+                trackers[l].TransitionResource(&gpu[step.resource].resource, step.state, step.subresource);
+                // uses the flush skips are folded into the next batch
+                if (random() % 3 != 0 || u == uses - 1)
+                {
+                    trackers[l].FlushBarriers([&](const Barrier* barriers, size_t count) { step.barriers.assign(barriers, barriers + count); });
+                    lists[l].push_back(step);
+                }
+            }
+        }
+
+        bool ok = true;
+        for (size_t l = 0; l < listCount && ok; ++l)
+        {
+            std::vector<Barrier> resolved;
+            ok = table.Resolve(trackers[l], resolved) && ExecuteBarriers(resolved, gpu);
+            for (size_t s = 0; s < lists[l].size() && ok; ++s)
+            {
+                const Step& step = lists[l][s];
+                ok = ExecuteBarriers(step.barriers, gpu);
+                // the use the batch was flushed for finds its state
+                for (uint32_t sub = 0; sub < SubresourceCount && ok; ++sub)
+                {
+                    if (step.subresource == AllSubresources || step.subresource == sub)
+                    {
+                        ok = resourcestates::Covers(gpu[step.resource].subresources[sub], step.state, ReadOnlyStates);
+                    }
+                }
+            }
+        }
+        // the table agrees with the GPU after every submission
+        for (size_t r = 0; r < ResourceCount && ok; ++r)
+        {
+            for (uint32_t s = 0; s < SubresourceCount; ++s)
+            {
+                ok = ok && table.State(&gpu[r].resource, s) == gpu[r].subresources[s];
+            }
+        }
+        consistent += ok ? 1 : 0;
+        if (!ok)
+        {
+            std::printf("submission %d is inconsistent\n", submission);
+            break;
+        }
+    }
+    CHECK(consistent == Submissions);
+    std::printf("%d submissions, %zu transitions replayed\n", consistent, executedTransitions);
+}
+
+int main()
+{
+    TestScripted();
+    TestRandomLists();
+    return TestResult();
+}
@@ -0,0 +1,116 @@
+#include <sys/stat.h>
+#include "ShaderCache.h"
+#include "TestCheck.h"
+
+// ShaderCache keys on a small shader tree written by the test: the key follows every included file, does
+// not depend on the order the defines are listed in, and matches the key BuildShaders.py computes for the
+// same tree, so the runtime finds the blobs the build step wrote.
+
+static const std::string Directory = "shader_cache_fixture/";
+
+static void WriteText(const std::string& path, const std::string& text)
+{
+    std::ofstream file(Directory + path, std::ios::binary | std::ios::trunc);
+    file << text;
+}
+
+static void WriteShaderTree()
+{
+    mkdir(Directory.c_str(), 0755);
+    mkdir((Directory + "lighting").c_str(), 0755);
+    mkdir((Directory + ShaderCacheDirectory).c_str(), 0755);
+    WriteText("Main.hlsl",
+        "#include \"Common.hlsli\"\n"
+        "  #include \"lighting/Light.hlsli\" // indented\n"
+        "#include <system.hlsli>\n"
+        "float4 main(float4 position : POSITION) : SV_POSITION { return Shade(position); }\n");
+    WriteText("Common.hlsli", "cbuffer Constants : register(b0) { float4x4 viewProjection; };\n");
+    WriteText("lighting/Light.hlsli",
+        "#include \"../Common.hlsli\"\n"
+        "float4 Shade(float4 p) { return mul(viewProjection, p); }\n");
+}
+
+static uint64_t Key(const ShaderPermutation& permutation)
+{
+    uint64_t key = 0;
+    CHECK(ComputeShaderKey(Directory, permutation, key));
+    return key;
+}
+
+static void TestIncludes()
+{
+    std::vector<std::string> includes;
+    FindShaderIncludes("#include \"a.hlsli\"\n\t#include \"b/c.hlsli\"\n#include <d.hlsli>\n// #include \"e.hlsli\"\n", includes);
+    CHECK(includes == std::vector<std::string>({ "a.hlsli", "b/c.hlsli" }));
+
+    std::vector<std::string> files;
+    CHECK(CollectShaderFiles(Directory + "Main.hlsl", files));
+    CHECK(files == std::vector<std::string>({ Directory + "Main.hlsl", Directory + "Common.hlsli",
+        Directory + "lighting/Light.hlsli", Directory + "lighting/../Common.hlsli" }));
+}
+
+static void TestKeys()
+{
+    ShaderPermutation plain = { "Main.hlsl", "main", "vs_6_0", {} };
+    ShaderPermutation defined = { "Main.hlsl", "main", "vs_6_0", { { "SKINNED", "1" }, { "COMPRESSED_VERTEX", "1" } } };
+    ShaderPermutation reordered = { "Main.hlsl", "main", "vs_6_0", { { "COMPRESSED_VERTEX", "1" }, { "SKINNED", "1" } } };
+    ShaderPermutation otherValue = { "Main.hlsl", "main", "vs_6_0", { { "COMPRESSED_VERTEX", "0" }, { "SKINNED", "1" } } };
+
+    CHECK(ShaderPermutationName(defined) == "Main.hlsl|main|vs_6_0|COMPRESSED_VERTEX=1;SKINNED=1");
+    CHECK(ShaderPermutationName(plain) == "Main.hlsl|main|vs_6_0|");
+    uint64_t plainKey = Key(plain);
+    CHECK(Key(defined) == Key(reordered));
+    CHECK(Key(defined) != plainKey && Key(otherValue) != Key(defined));
+    CHECK(Key(ShaderPermutation{ "Main.hlsl", "main", "vs_6_1", {} }) != plainKey);
+
+    // shader_key of BuildShaders.py on the same tree, the "../Common.hlsli" include is hashed as written
+    CHECK(plainKey == 0x224b3a2800a5a8a4ull);
+    CHECK(Key(defined) == 0x7b108f0d65e5edebull);
+
+    // an edit to an included file changes the key, writing the same text back restores it
+    WriteText("lighting/Light.hlsli",
+        "#include \"../Common.hlsli\"\n"
+        "float4 Shade(float4 p) { return mul(viewProjection, p) * 2; }\n");
+    CHECK(Key(plain) != plainKey);
+    WriteText("lighting/Light.hlsli",
+        "#include \"../Common.hlsli\"\n"
+        "float4 Shade(float4 p) { return mul(viewProjection, p); }\n");
+    CHECK(Key(plain) == plainKey);
+
+    uint64_t key = 0;
+    ShaderPermutation missing = { "Missing.hlsl", "main", "vs_6_0", {} };
+    CHECK(!ComputeShaderKey(Directory, missing, key));
+}
+
+static void TestPrecompiled()
+{
+    ShaderPermutation plain = { "Main.hlsl", "main", "vs_6_0", {} };
+    uint64_t key = Key(plain);
+    std::ofstream blob(ShaderBlobPath(Directory, key), std::ios::binary | std::ios::trunc);
+    blob << "DXBC";
+    blob.close();
+    char line[64];
+    snprintf(line, sizeof(line), " %016llx\n", (unsigned long long)key);
+    WriteText(std::string(ShaderCacheDirectory) + "/manifest.txt", "# name key\n" + ShaderPermutationName(plain) + line);
+
+    std::vector<unsigned char> bytecode;
+    CHECK(LoadPrecompiledShader(Directory, plain, true, bytecode) && bytecode.size() == 4);
+    bytecode.clear();
+    CHECK(LoadPrecompiledShader(Directory, plain, false, bytecode) && bytecode.size() == 4);
+
+    // a stale blob is never picked up while the sources are checked, the manifest still names it
+    WriteText("Common.hlsli", "cbuffer Constants : register(b1) { float4x4 viewProjection; };\n");
+    CHECK(!LoadPrecompiledShader(Directory, plain, true, bytecode));
+    CHECK(LoadPrecompiledShader(Directory, plain, false, bytecode));
+    ShaderPermutation unlisted = { "Main.hlsl", "main", "ps_6_0", {} };
+    CHECK(!LoadPrecompiledShader(Directory, unlisted, false, bytecode));
+}
+
+int main()
+{
+    WriteShaderTree();
+    TestIncludes();
+    TestKeys();
+    TestPrecompiled();
+    return TestResult();
+}
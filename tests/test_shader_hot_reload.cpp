@@ -0,0 +1,123 @@
+#include <sys/stat.h>
+#include <cstdio>
+#include "ShaderHotReload.h"
+#include "TestCheck.h"
+
+// ShaderHotReloader on a small shader tree written by the test, with a compile function that returns the
+// source text as bytecode and fails on sources that contain "error". File changes go through inotify the way
+// an editor makes them: written in place, in bursts, or written elsewhere and renamed over the source.
+
+static const std::string Directory = "shader_reload_fixture/";
+
+static void WriteText(const std::string& path, const std::string& text)
+{
+    std::ofstream file(Directory + path, std::ios::binary | std::ios::trunc);
+    file << text;
+}
+
+// an editor's save: a temporary file renamed over the old one
+static void WriteTextAndRename(const std::string& path, const std::string& text)
+{
+    WriteText(path + ".tmp", text);
+    std::rename((Directory + path + ".tmp").c_str(), (Directory + path).c_str());
+}
+
+// what arrived once count shaders are there or a second went by, and a while longer for anything extra
+static std::vector<ReloadedShader> TakeReloaded(ShaderHotReloader& reloader, size_t count)
+{
+    std::vector<ReloadedShader> shaders;
+    for (int i = 0; i < 50 && shaders.size() < count; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        reloader.TakeReloaded(shaders);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    reloader.TakeReloaded(shaders);
+    return shaders;
+}
+
+static std::string Text(const ReloadedShader& shader)
+{
+    return std::string(shader.bytecode.begin(), shader.bytecode.end());
+}
+
+int main()
+{
+    mkdir(Directory.c_str(), 0755);
+    mkdir((Directory + "extra").c_str(), 0755);
+    WriteText("Lit.hlsl", "#include \"Common.hlsli\"\nlit\n");
+    WriteText("Sky.hlsl", "sky\n");
+    WriteText("Common.hlsli", "common\n");
+    WriteText("extra/Noise.hlsli", "noise\n");
+
+    ShaderPermutation lit = { "Lit.hlsl", "main", "ps_6_0", {} };
+    ShaderPermutation litShadowed = { "Lit.hlsl", "main", "ps_6_0", { { "SHADOWS", "1" } } };
+    ShaderPermutation sky = { "Sky.hlsl", "main", "ps_6_0", {} };
+    std::atomic<int> compiles(0);
+    ShaderHotReloader reloader;
+    bool started = reloader.Start(Directory, { lit, litShadowed, sky }, [&](const ShaderPermutation& permutation, std::vector<unsigned char>& bytecode)
+    {
+        compiles++;
+        std::string text;
+        if (!ReadShaderFile(Directory + permutation.source, text) || text.find("error") != std::string::npos)
+        {
+            return false;
+        }
+        bytecode.assign(text.begin(), text.end());
+        return true;
+    }, 100);
+    CHECK(started);
+
+    // an include edit recompiles every permutation of every source that includes it
+    WriteText("Common.hlsli", "common 2\n");
+    std::vector<ReloadedShader> shaders = TakeReloaded(reloader, 2);
+    CHECK(shaders.size() == 2);
+    int litShaders = 0;
+    for (const ReloadedShader& shader : shaders)
+    {
+        litShaders += shader.permutation.source == "Lit.hlsl" ? 1 : 0;
+    }
+    CHECK(litShaders == 2);
+
+    // a burst of writes is compiled once, with what the last one wrote
+    int before = compiles.load();
+    for (int i = 0; i < 5; ++i)
+    {
+        WriteText("Sky.hlsl", "sky " + std::to_string(i) + "\n");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    shaders = TakeReloaded(reloader, 1);
+    CHECK(shaders.size() == 1 && compiles.load() - before == 1);
+    CHECK(!shaders.empty() && Text(shaders[0]) == "sky 4\n");
+
+    // a save that renames over the source, and the include it adds lives in a directory nobody watched
+    WriteTextAndRename("Sky.hlsl", "#include \"extra/Noise.hlsli\"\nsky 5\n");
+    shaders = TakeReloaded(reloader, 1);
+    CHECK(shaders.size() == 1 && shaders[0].permutation.source == "Sky.hlsl");
+    WriteText("extra/Noise.hlsli", "noise 2\n");
+    shaders = TakeReloaded(reloader, 1);
+    CHECK(shaders.size() == 1 && shaders[0].permutation.source == "Sky.hlsl");
+
+    // a compile that fails publishes nothing, the old shader keeps running
+    WriteText("Sky.hlsl", "error\n");
+    shaders = TakeReloaded(reloader, 1);
+    CHECK(shaders.empty());
+    CHECK(reloader.Statistics().failed == 1);
+
+    // a file no permutation reads is ignored
+    before = compiles.load();
+    WriteText("Notes.txt", "not a shader\n");
+    shaders = TakeReloaded(reloader, 1);
+    CHECK(shaders.empty() && compiles.load() == before);
+
+    ShaderReloadStatistics statistics = reloader.Statistics();
+    CHECK(statistics.compiled == 5 && statistics.changes == 5);
+
+    // Stop waits for at most one poll of the reload thread, 50 ms, and some scheduling
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    reloader.Stop();
+    double stopMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    CHECK(stopMs < 100.0);
+    std::printf("%u batches, %u compiled, %u failed, stop took %.1f ms\n", statistics.changes, statistics.compiled, statistics.failed, stopMs);
+    return TestResult();
+}
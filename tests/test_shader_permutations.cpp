@@ -0,0 +1,192 @@
+#include <cstdio>
+#include <map>
+#include <random>
+#include "ShaderPermutations.h"
+#include "TestCheck.h"
+
+// ShaderPermutations.h against the files it mirrors: the pixel permutations are the ones ShaderList.txt makes
+// BuildShaders.py build, with the same keys, PixelShader.hlsl has the features and light array the mirror
+// assumes, and every specialized reference shader gives what the full shader gives with the disabled features
+// fed neutral inputs, which is how the renderer draws when a permutation is missing.
+
+static std::string EngineFile(const std::string& name)
+{
+    std::string text;
+    CHECK(ReadShaderFile(std::string(ENGINE_DIR) + name, text));
+    return text;
+}
+
+static void TestIndices()
+{
+    int wrong = 0;
+    for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+    {
+        wrong += PixelPermutationIndex(PixelPermutationFeatures(i)) != i ? 1 : 0;
+    }
+    CHECK(wrong == 0);
+}
+
+// "key name" lines of BuildShaders.py --keys
+static std::map<std::string, uint64_t> ScriptKeys()
+{
+    std::map<std::string, uint64_t> keys;
+#ifdef PYTHON_EXECUTABLE
+    std::string command = std::string("\"") + PYTHON_EXECUTABLE + "\" \"" + ENGINE_DIR + "BuildShaders.py\" --keys";
+    FILE* output = popen(command.c_str(), "r");
+    CHECK(output != nullptr);
+    if (!output)
+    {
+        return keys;
+    }
+    char line[512];
+    while (std::fgets(line, sizeof(line), output))
+    {
+        unsigned long long key;
+        char name[400];
+        if (std::sscanf(line, "%16llx %399s", &key, name) == 2 && std::string(name).find('|') != std::string::npos)
+        {
+            keys[name] = key;
+        }
+    }
+    CHECK(pclose(output) == 0);
+#else
+    std::printf("no Python interpreter was found at configure time, BuildShaders.py can not be compared\n");
+    CHECK(false);
+#endif
+    return keys;
+}
+
+static void TestScriptKeys()
+{
+    std::map<std::string, uint64_t> keys = ScriptKeys();
+    int pixelPermutations = 0;
+    for (const std::pair<const std::string, uint64_t>& entry : keys)
+    {
+        pixelPermutations += entry.first.compare(0, 17, "PixelShader.hlsl|") == 0 ? 1 : 0;
+    }
+    // ShaderList.txt builds exactly the permutations the renderer selects from
+    CHECK(pixelPermutations == int(PixelPermutationCount));
+
+    int missing = 0;
+    int differentKey = 0;
+    for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+    {
+        ShaderPermutation permutation = PixelShaderPermutation(PixelPermutationFeatures(i));
+        auto found = keys.find(ShaderPermutationName(permutation));
+        uint64_t key = 0;
+        CHECK(ComputeShaderKey(ENGINE_DIR, permutation, key));
+        missing += found == keys.end() ? 1 : 0;
+        differentKey += found != keys.end() && found->second != key ? 1 : 0;
+    }
+    CHECK(missing == 0 && differentKey == 0);
+}
+
+static void TestShaderSource()
+{
+    std::string shader = EngineFile("PixelShader.hlsl");
+    // the defaults are the full shader and the light buffer holds MaxPointLights lights
+    std::string lights = std::to_string(MaxPointLights);
+    CHECK(shader.find("#define LIGHT_COUNT " + lights) != std::string::npos);
+    CHECK(shader.find("PointLightData pointLights[" + lights + "];") != std::string::npos);
+    CHECK(shader.find("i < LIGHT_COUNT;") != std::string::npos);
+    const char* features[] = { "USE_TEXTURE", "USE_SPECULAR", "USE_NORMAL_MAP" };
+    for (const char* feature : features)
+    {
+        CHECK(shader.find(std::string("#define ") + feature + " 1") != std::string::npos);
+        CHECK(shader.find(std::string("#if ") + feature + "\n") != std::string::npos);
+    }
+}
+
+static float Random(std::mt19937& random, float low, float high)
+{
+    return std::uniform_real_distribution<float>(low, high)(random);
+}
+
+static void RandomFloats(std::mt19937& random, float* values, int count, float low, float high)
+{
+    for (int k = 0; k < count; ++k)
+    {
+        values[k] = Random(random, low, high);
+    }
+}
+
+static void TestReference()
+{
+    std::mt19937 random(5);
+    ReferencePixelShader full = SelectReferencePixelShader({ MaxPointLights, true, true, true });
+    int mismatches = 0;
+    for (int sample = 0; sample < 200; ++sample)
+    {
+        ReferenceLighting lighting = {};
+        RandomFloats(random, lighting.ambientLight, 3, 0.0f, 0.3f);
+        RandomFloats(random, lighting.cameraPos, 3, -10.0f, 10.0f);
+        for (ReferencePointLight& light : lighting.pointLights)
+        {
+            RandomFloats(random, light.diffuseColor, 3, 0.0f, 1.0f);
+            RandomFloats(random, light.specularColor, 3, 0.0f, 1.0f);
+            RandomFloats(random, light.position, 3, -8.0f, 8.0f);
+            light.specularPower = 1.0f;
+            light.innerRadius = Random(random, 0.5f, 4.0f);
+            light.outerRadius = light.innerRadius + Random(random, 1.0f, 20.0f);
+        }
+        ReferencePixel pixel = {};
+        RandomFloats(random, pixel.worldPos, 3, -2.0f, 2.0f);
+        RandomFloats(random, pixel.normalWorld, 3, -1.0f, 1.0f);
+        RandomFloats(random, pixel.tangentWorld, 3, -1.0f, 1.0f);
+        pixel.tangentWorld[3] = sample % 2 == 0 ? 1.0f : -1.0f;
+        RandomFloats(random, pixel.texel, 4, 0.0f, 1.0f);
+        RandomFloats(random, pixel.normalTexel, 3, 0.0f, 1.0f);
+        ReferenceMaterial material = {};
+        RandomFloats(random, material.diffuseColor, 3, 0.0f, 1.0f);
+        RandomFloats(random, material.specularColor, 3, 0.0f, 1.0f);
+        material.specularPower = Random(random, 2.0f, 64.0f);
+
+        for (uint32_t i = 0; i < PixelPermutationCount; ++i)
+        {
+            PixelShaderFeatures features = PixelPermutationFeatures(i);
+            float specialized[4];
+            SelectReferencePixelShader(features)(pixel, material, lighting, specialized);
+
+            // what the full shader gets for the same draw: black lights after the packed ones, the white
+            // texture, a black Ks and the flat normal texture
+            ReferenceLighting padded = lighting;
+            for (uint32_t k = features.lightCount; k < MaxPointLights; ++k)
+            {
+                ReferencePointLight& light = padded.pointLights[k];
+                light.diffuseColor[0] = light.diffuseColor[1] = light.diffuseColor[2] = 0.0f;
+                light.specularColor[0] = light.specularColor[1] = light.specularColor[2] = 0.0f;
+            }
+            ReferencePixel neutralPixel = pixel;
+            ReferenceMaterial neutralMaterial = material;
+            if (!features.texture)
+            {
+                neutralPixel.texel[0] = neutralPixel.texel[1] = neutralPixel.texel[2] = neutralPixel.texel[3] = 1.0f;
+            }
+            if (!features.specular)
+            {
+                neutralMaterial.specularColor[0] = neutralMaterial.specularColor[1] = neutralMaterial.specularColor[2] = 0.0f;
+            }
+            if (!features.normalMap)
+            {
+                neutralPixel.normalTexel[0] = neutralPixel.normalTexel[1] = 0.5f;
+                neutralPixel.normalTexel[2] = 1.0f;
+            }
+            float expected[4];
+            full(neutralPixel, neutralMaterial, padded, expected);
+            for (int k = 0; k < 4; ++k)
+            {
+                mismatches += std::fabs(specialized[k] - expected[k]) > 1e-5f ? 1 : 0;
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+int main()
+{
+    TestIndices();
+    TestScriptKeys();
+    TestShaderSource();
+    TestReference();
+    return TestResult();
+}
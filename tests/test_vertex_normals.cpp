@@ -0,0 +1,145 @@
+#include <cstring>
+#include "MeshOptimizer.h"
+#include "VertexNormals.h"
+#include "TestMeshes.h"
+#include "TestCheck.h"
+
+// GenerateSmoothNormals on OBJ files without normals, read the way the converter reads them. A cube with one
+// face cut into a fan: below the crease angle every corner gets its face normal, above it the diagonal,
+// whatever the triangulation. A UV sphere matches the analytic normal with exact and with jittered positions,
+// and the job system gives the same bytes as the serial run.
+
+const double Degrees = 180.0 / 3.14159265358979;
+
+static double AngleDegrees(const TestFloat3& a, float x, float y, float z)
+{
+    double length = std::sqrt(double(x) * x + double(y) * y + double(z) * z);
+    double cosine = (a.x * x + a.y * y + a.z * z) / length;
+    return std::acos(std::min(1.0, cosine)) * Degrees;
+}
+
+static bool WriteCube(const char* path)
+{
+    // face x+ is a fan of four triangles around its center, vertex 9
+    FILE* file = std::fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    std::fprintf(file, "v -1 -1 -1\nv 1 -1 -1\nv 1 1 -1\nv -1 1 -1\nv -1 -1 1\nv 1 -1 1\nv 1 1 1\nv -1 1 1\nv 1 0 0\n");
+    std::fprintf(file, "f 1 4 3 2\nf 5 6 7 8\nf 1 5 8 4\nf 2 3 9\nf 3 7 9\nf 7 6 9\nf 6 2 9\nf 1 2 6 5\nf 4 8 7 3\n");
+    std::fclose(file);
+    return true;
+}
+
+static void TestCube()
+{
+    CHECK(WriteCube("normals_cube.obj"));
+    const float Creases[] = { 60.0f, 180.0f };
+    for (float crease : Creases)
+    {
+        TestMesh mesh;
+        CHECK(LoadObjMesh("normals_cube.obj", false, mesh));
+        WeldVertices(mesh.vertices, mesh.indices);
+        NormalStatistics statistics = GenerateSmoothNormals(mesh.vertices, mesh.indices, crease);
+        CHECK(statistics.smoothedTriangles == 14 && statistics.positions == 9);
+
+        double maxError = 0.0;
+        int inward = 0;
+        for (size_t c = 0; c < mesh.indices.size(); ++c)
+        {
+            const TestVertex& v = mesh.vertices[mesh.indices[c]];
+            const TestVertex& a = mesh.vertices[mesh.indices[c / 3 * 3]];
+            const TestVertex& b = mesh.vertices[mesh.indices[c / 3 * 3 + 1]];
+            const TestVertex& d = mesh.vertices[mesh.indices[c / 3 * 3 + 2]];
+            if (crease < 90.0f)
+            {
+                // the face normal, (p1 - p0) x (p2 - p0)
+                float e1[3] = { b.pos.x - a.pos.x, b.pos.y - a.pos.y, b.pos.z - a.pos.z };
+                float e2[3] = { d.pos.x - a.pos.x, d.pos.y - a.pos.y, d.pos.z - a.pos.z };
+                maxError = std::max(maxError, AngleDegrees(v.normal, e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                    e1[0] * e2[1] - e1[1] * e2[0]));
+            }
+            else
+            {
+                // the diagonal through the corner, the fan center has the face normal
+                maxError = std::max(maxError, AngleDegrees(v.normal, v.pos.x, v.pos.y, v.pos.z));
+            }
+            inward += v.normal.x * v.pos.x + v.normal.y * v.pos.y + v.normal.z * v.pos.z <= 0.0f ? 1 : 0;
+        }
+        CHECK(maxError < 1e-3);
+        CHECK(inward == 0);
+        // at 60 degrees every corner vertex splits into one per face, at 180 none does
+        CHECK(statistics.splitVertices == (crease < 90.0f ? 16u : 0u));
+        std::printf("cube, crease %.0f: max error %.5f deg, %zu split vertices\n", crease, maxError, statistics.splitVertices);
+    }
+
+    // the loader's own flat normals for faces without any
+    TestMesh flat;
+    CHECK(LoadObjMesh("normals_cube.obj", true, flat));
+    int valid = 0;
+    for (const TestVertex& v : flat.vertices)
+    {
+        float length = std::sqrt(v.normal.x * v.normal.x + v.normal.y * v.normal.y + v.normal.z * v.normal.z);
+        valid += std::fabs(length - 1.0f) < 1e-5f && v.normal.x * v.pos.x + v.normal.y * v.pos.y + v.normal.z * v.pos.z > 0.0f ? 1 : 0;
+    }
+    CHECK(valid == int(flat.vertices.size()));
+    std::remove("normals_cube.obj");
+}
+
+static void TestSphere()
+{
+    const float Jitters[] = { 0.0f, 1e-7f };
+    for (float jitter : Jitters)
+    {
+        WriteObjSphere("normals_sphere.obj", 64, 128, jitter);
+        TestMesh mesh;
+        CHECK(LoadObjMesh("normals_sphere.obj", false, mesh));
+        WeldVertices(mesh.vertices, mesh.indices);
+        NormalStatistics statistics = GenerateSmoothNormals(mesh.vertices, mesh.indices, 60.0f);
+
+        double maxError = 0.0;
+        for (const TestVertex& v : mesh.vertices)
+        {
+            maxError = std::max(maxError, AngleDegrees(v.normal, v.pos.x, v.pos.y, v.pos.z));
+        }
+        // near duplicates across hash cell borders merge like exact ones, the seam at u = 0 does not split
+        CHECK(maxError < 0.05);
+        CHECK(statistics.positions == 64 * 128 - 128 + 2);
+        CHECK(statistics.splitVertices == 0);
+        std::printf("sphere, jitter %g: max error %.4f deg over %zu positions\n", jitter, maxError, statistics.positions);
+    }
+
+    // the same bytes with and without workers
+    WriteObjSphere("normals_sphere.obj", 96, 192, 0.0f);
+    TestMesh serial;
+    CHECK(LoadObjMesh("normals_sphere.obj", false, serial));
+    std::remove("normals_sphere.obj");
+    WeldVertices(serial.vertices, serial.indices);
+    TestMesh parallel = serial;
+    GenerateSmoothNormals(serial.vertices, serial.indices, 60.0f);
+    JobSystem jobSystem;
+    jobSystem.Init(3);
+    GenerateSmoothNormals(parallel.vertices, parallel.indices, 60.0f, &jobSystem);
+    jobSystem.Shutdown();
+    CHECK(parallel.indices == serial.indices && parallel.vertices.size() == serial.vertices.size());
+    CHECK(std::memcmp(parallel.vertices.data(), serial.vertices.data(), serial.vertices.size() * sizeof(TestVertex)) == 0);
+}
+
+static void TestExistingNormals()
+{
+    // triangles that came with normals keep them and take no part
+    TestMesh mesh = MakeSphere(8, 16);
+    std::vector<TestVertex> before = mesh.vertices;
+    NormalStatistics statistics = GenerateSmoothNormals(mesh.vertices, mesh.indices, 60.0f);
+    CHECK(statistics.smoothedTriangles == 0 && statistics.splitVertices == 0);
+    CHECK(std::memcmp(before.data(), mesh.vertices.data(), before.size() * sizeof(TestVertex)) == 0);
+}
+
+int main()
+{
+    TestCube();
+    TestSphere();
+    TestExistingNormals();
+    return TestResult();
+}